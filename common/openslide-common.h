@@ -30,6 +30,9 @@
 struct common_usage_info {
   const char *parameter_string;
   const char *summary;
+  // optional tool-specific options; NULL-terminated like any
+  // GOptionEntry array, or NULL for none
+  const GOptionEntry *entries;
 };
 
 void common_fix_argv(int *argc, char ***argv);
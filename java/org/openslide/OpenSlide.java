@@ -248,6 +248,36 @@ public final class OpenSlide implements Closeable {
         }
     }
 
+    // takes the reader lock; the library writes pixels directly into the
+    // buffer's memory, with no copies across the JNI boundary.  Pixels
+    // are native-byte-order premultiplied ARGB ints.
+    public void paintRegionARGB(java.nio.ByteBuffer dest, long x, long y,
+            long plane, int level, int w, int h) throws IOException {
+        if (!dest.isDirect()) {
+            throw new IllegalArgumentException("dest must be a direct buffer");
+        }
+
+        if ((long) w * (long) h * 4 > dest.capacity()) {
+            throw new ArrayIndexOutOfBoundsException("Size of data ("
+                    + dest.capacity() + ") is less than w * h * 4");
+        }
+
+        if (w < 0 || h < 0) {
+            throw new IllegalArgumentException("w and h must be nonnegative");
+        }
+
+        Lock rl = lock.readLock();
+        rl.lock();
+        try {
+            checkDisposed();
+            OpenSlideJNI.openslide_read_region_direct(osr, dest, x, y, plane,
+                    level, w, h);
+            checkError();
+        } finally {
+            rl.unlock();
+        }
+    }
+
     public void paintRegion(Graphics2D g, int dx, int dy, long sx, long sy, long plane,
             int w, int h, double downsample) throws IOException {
         if (downsample < 1.0) {
@@ -78,6 +78,10 @@ class OpenSlideJNI {
     native static void openslide_read_region(long osr, int dest[], long x,
             long y, long plane, int level, long w, long h);
 
+    native static void openslide_read_region_direct(long osr,
+            java.nio.ByteBuffer dest, long x, long y, long plane, int level,
+            long w, long h);
+
     native static void openslide_get_associated_image_dimensions(long osr,
             String name, long dim[]);
 
@@ -142,6 +142,19 @@ static void osj_read_region(JNIEnv *env, jobject obj, jlong osr, jintArray dest,
   (*env)->ReleasePrimitiveArrayCritical(env, dest, dest2, 0);
 }
 
+static void osj_read_region_direct(JNIEnv *env, jobject obj, jlong osr,
+          jobject dest,
+          jlong x, jlong y, jlong plane, jint level, jlong w, jlong h) {
+  // the library writes straight into the direct buffer's memory, with
+  // no copy across the JNI boundary; bounds are checked in Java
+  uint32_t *dest2 = (*env)->GetDirectBufferAddress(env, dest);
+  if (dest2 == NULL) {
+    return;
+  }
+
+  openslide_read_region((openslide_t *) osr, dest2, x, y, plane, level, w, h);
+}
+
 static void osj_get_associated_image_dimensions(JNIEnv *env, jobject obj, jlong osr,
             jstring name, jlongArray dim) {
   int64_t dims[2];
@@ -203,6 +216,7 @@ static JNINativeMethod methods[] = {
   { "openslide_get_property_value", "(JLjava/lang/String;)Ljava/lang/String;", (void *) osj_get_property_value },
   { "openslide_get_associated_image_names", "(J)[Ljava/lang/String;", (void *) osj_get_associated_image_names },
   { "openslide_read_region", "(J[IJJJIJJ)V", (void *) osj_read_region },
+  { "openslide_read_region_direct", "(JLjava/nio/ByteBuffer;JJJIJJ)V", (void *) osj_read_region_direct },
   { "openslide_get_associated_image_dimensions", "(JLjava/lang/String;[J)V", (void *) osj_get_associated_image_dimensions },
   { "openslide_read_associated_image", "(JLjava/lang/String;[I)V", (void *) osj_read_associated_image },
   { "openslide_get_error", "(J)Ljava/lang/String;", (void *) osj_get_error },
@@ -1,9 +1,12 @@
 #ifdef __EMSCRIPTEN__
 
+#include <cstdlib>
 #include <iostream>
 #include <emscripten/bind.h>
+#include <emscripten/val.h>
 
 #include "openslide-private.h"
+#include "openslide-simd.h"
 #include "deepzoom-private.h"
 
 
@@ -13,6 +16,11 @@ private:
 
   openslide_t * osr;
 
+  // tile buffer in WASM linear memory, reused across reads; JS sees it
+  // as a view over the module heap with no copy
+  uint32_t * buf = nullptr;
+  size_t buf_size = 0;
+
 public:
 
   Openslide () {
@@ -25,6 +33,55 @@ public:
   void close () {
     if (this->osr)
       openslide_close (this->osr);
+
+    std :: free (this->buf);
+    this->buf = nullptr;
+    this->buf_size = 0;
+  }
+
+  // Decode a region into linear memory and return its heap offset.  The
+  // buffer holds RGBA bytes (converted in place with the SIMD128 kernel
+  // when the module is built with -msimd128) and stays valid until the
+  // next read or close; a worker can postMessage the region of
+  // wasmMemory.buffer directly instead of structured-cloning a copy.
+  uintptr_t read_region (double x, double y, int32_t plane, int32_t level,
+                         int32_t w, int32_t h) {
+    // an empty region has no bytes to expose, so report it like a
+    // failure rather than handing out a zero-length allocation
+    if (!this->osr || w <= 0 || h <= 0) {
+      return 0;
+    }
+
+    size_t size = (size_t) w * h * 4;
+    if (size != this->buf_size) {
+      std :: free (this->buf);
+      this->buf = static_cast < uint32_t * > (std :: malloc (size));
+      if (!this->buf) {
+        // leave no stale size behind: a later same-size call must not
+        // skip reallocation and write through the null buffer, which in
+        // WASM linear memory would silently corrupt the heap at offset 0
+        this->buf_size = 0;
+        return 0;
+      }
+      this->buf_size = size;
+    }
+
+    openslide_read_region(this->osr, this->buf,
+                          (int64_t) x, (int64_t) y, plane, level, w, h);
+    _openslide_simd_argb_to_rgba(reinterpret_cast < uint8_t * > (this->buf),
+                                 size);
+    return reinterpret_cast < uintptr_t > (this->buf);
+  }
+
+  // the same read handed back as a typed view over the heap, for
+  // callers that prefer a Uint8Array to a raw offset
+  emscripten :: val read_region_view (double x, double y, int32_t plane,
+                                      int32_t level, int32_t w, int32_t h) {
+    if (!this->read_region(x, y, plane, level, w, h)) {
+      return emscripten :: val :: null();
+    }
+    return emscripten :: val(emscripten :: typed_memory_view(
+      this->buf_size, reinterpret_cast < uint8_t * > (this->buf)));
   }
 
   int get_level_width (int32_t level)  {
@@ -98,6 +155,8 @@ EMSCRIPTEN_BINDINGS(openslide) {
     .constructor <> ()
     .function("open", &Openslide::open)
     .function("close", &Openslide::close)
+    .function("read_region", &Openslide::read_region)
+    .function("read_region_view", &Openslide::read_region_view)
     .function("get_level_width", &Openslide::get_level_width)
     .function("get_level_height", &Openslide::get_level_height)
     .function("get_level_count", &Openslide::get_level_count)
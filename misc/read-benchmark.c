@@ -1,53 +1,272 @@
-/* Read slide level 0 in 1000 x 1000 regions and report time in pixels
-   per second. */
+/* Benchmark region reads across thread counts, region sizes, access
+   patterns, and cold/warm cache phases, reporting throughput and
+   latency percentiles per slide. */
 /* gcc -O2 -g -std=gnu99 -o read-benchmark read-benchmark.c \
-   $(pkg-config --cflags --libs openslide) */
+   $(pkg-config --cflags --libs openslide) -lpthread */
 
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
 #include <time.h>
 #include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <openslide.h>
 
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 
-#define REGION_WIDTH 1000
-#define REGION_HEIGHT 1000
-#define RUNS 5
+#define MAX_SWEEP 16
+#define DEFAULT_REGIONS 256
+
+enum pattern {
+  PATTERN_RASTER,
+  PATTERN_RANDOM,
+};
+
+struct region {
+  int64_t x;
+  int64_t y;
+};
+
+struct worker {
+  openslide_t *osr;
+  const struct region *regions;
+  int64_t count;
+  int64_t size;
+  double *latencies;  // seconds, one per region
+  pthread_t thread;
+};
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *worker_run(void *data) {
+  struct worker *wk = data;
+  uint32_t *buf = malloc(wk->size * wk->size * 4);
+  assert(buf != NULL);
+
+  for (int64_t i = 0; i < wk->count; i++) {
+    double start = now();
+    openslide_read_region(wk->osr, buf,
+                          wk->regions[i].x, wk->regions[i].y, 0, 0,
+                          wk->size, wk->size);
+    wk->latencies[i] = now() - start;
+  }
+
+  free(buf);
+  return NULL;
+}
+
+static int cmpdouble(const void *p1, const void *p2) {
+  double d1 = *(const double *) p1;
+  double d2 = *(const double *) p2;
+  return (d1 > d2) - (d1 < d2);
+}
+
+static double percentile(const double *sorted, int64_t count, double pct) {
+  int64_t idx = (int64_t) (pct / 100.0 * count);
+  return sorted[MIN(idx, count - 1)];
+}
+
+// lay out the regions each worker will read; raster partitions the
+// slide's rows among the workers in scan order, random scatters
+// regions uniformly with a per-worker seed so runs are reproducible
+static struct region *make_regions(int64_t w, int64_t h, int64_t size,
+                                   enum pattern pattern,
+                                   int worker_num, int64_t count) {
+  struct region *regions = malloc(count * sizeof(*regions));
+  assert(regions != NULL);
+
+  int64_t cols = (w + size - 1) / size;
+  int64_t rows = (h + size - 1) / size;
+  unsigned seed = 42 + worker_num;
+
+  for (int64_t i = 0; i < count; i++) {
+    int64_t tile;
+    if (pattern == PATTERN_RANDOM) {
+      tile = (int64_t) rand_r(&seed) % (cols * rows);
+    } else {
+      tile = (worker_num * count + i) % (cols * rows);
+    }
+    regions[i].x = (tile % cols) * size;
+    regions[i].y = (tile / cols) * size;
+  }
+  return regions;
+}
+
+struct result {
+  double mpx_per_s;
+  double p50_ms;
+  double p95_ms;
+  double p99_ms;
+};
+
+// run one phase: all workers read their regions concurrently
+static struct result run_phase(openslide_t *osr, struct worker *workers,
+                               int threads, int64_t per_thread,
+                               int64_t size) {
+  double start = now();
+  for (int t = 0; t < threads; t++) {
+    pthread_create(&workers[t].thread, NULL, worker_run, &workers[t]);
+  }
+  for (int t = 0; t < threads; t++) {
+    pthread_join(workers[t].thread, NULL);
+  }
+  double elapsed = now() - start;
+  assert(openslide_get_error(osr) == NULL);
+
+  int64_t total = (int64_t) threads * per_thread;
+  double *all = malloc(total * sizeof(double));
+  assert(all != NULL);
+  for (int t = 0; t < threads; t++) {
+    memcpy(all + (int64_t) t * per_thread, workers[t].latencies,
+           per_thread * sizeof(double));
+  }
+  qsort(all, total, sizeof(double), cmpdouble);
+
+  struct result r;
+  r.mpx_per_s = total * size * size / (elapsed * 1e6);
+  r.p50_ms = percentile(all, total, 50) * 1e3;
+  r.p95_ms = percentile(all, total, 95) * 1e3;
+  r.p99_ms = percentile(all, total, 99) * 1e3;
+  free(all);
+  return r;
+}
+
+static void report(int json, const char *slide, const char *vendor,
+                   int threads, int64_t size, enum pattern pattern,
+                   const char *phase, int64_t regions,
+                   const struct result *r) {
+  const char *pat = pattern == PATTERN_RANDOM ? "random" : "raster";
+  if (json) {
+    printf("{\"slide\": \"%s\", \"vendor\": \"%s\", \"threads\": %d, "
+           "\"region\": %"PRId64", \"pattern\": \"%s\", \"phase\": \"%s\", "
+           "\"regions\": %"PRId64", \"mpx_per_s\": %.2f, "
+           "\"p50_ms\": %.3f, \"p95_ms\": %.3f, \"p99_ms\": %.3f}\n",
+           slide, vendor, threads, size, pat, phase, regions,
+           r->mpx_per_s, r->p50_ms, r->p95_ms, r->p99_ms);
+  } else {
+    printf("%-8s %2d thr  %5"PRId64" px  %-6s  %-4s  "
+           "%8.1f Mpx/s  p50 %7.2f ms  p95 %7.2f ms  p99 %7.2f ms\n",
+           vendor, threads, size, pat, phase,
+           r->mpx_per_s, r->p50_ms, r->p95_ms, r->p99_ms);
+  }
+}
+
+static int parse_sweep(const char *arg, int64_t *values) {
+  int count = 0;
+  char *copy = strdup(arg);
+  for (char *tok = strtok(copy, ","); tok && count < MAX_SWEEP;
+       tok = strtok(NULL, ",")) {
+    values[count++] = atoll(tok);
+    assert(values[count - 1] > 0);
+  }
+  free(copy);
+  return count;
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "Usage: %s [options] slide...\n"
+          "  -t N[,N...]  thread counts to sweep (default 1)\n"
+          "  -s N[,N...]  square region sizes to sweep (default 1000)\n"
+          "  -r N         regions per thread per phase (default %d)\n"
+          "  -R           random access pattern (default raster)\n"
+          "  -j           machine-readable JSON output, one object per line\n",
+          argv0, DEFAULT_REGIONS);
+}
 
 int main(int argc, char **argv) {
-  if (argc != 2) {
-    printf("Arguments: slide\n");
+  int64_t threads[MAX_SWEEP] = {1};
+  int thread_count = 1;
+  int64_t sizes[MAX_SWEEP] = {1000};
+  int size_count = 1;
+  int64_t per_thread = DEFAULT_REGIONS;
+  enum pattern pattern = PATTERN_RASTER;
+  int json = 0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "t:s:r:Rj")) != -1) {
+    switch (opt) {
+    case 't':
+      thread_count = parse_sweep(optarg, threads);
+      break;
+    case 's':
+      size_count = parse_sweep(optarg, sizes);
+      break;
+    case 'r':
+      per_thread = atoll(optarg);
+      assert(per_thread > 0);
+      break;
+    case 'R':
+      pattern = PATTERN_RANDOM;
+      break;
+    case 'j':
+      json = 1;
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (optind >= argc || !thread_count || !size_count) {
+    usage(argv[0]);
     return 1;
   }
-  const char *slide = argv[1];
-
-  uint32_t *buf = malloc(REGION_WIDTH * REGION_HEIGHT * 4);
-  openslide_t *osr = openslide_open(slide);
-  assert(osr != NULL && openslide_get_error(osr) == NULL);
-  int64_t w, h;
-  openslide_get_level0_dimensions(osr, &w, &h);
-
-  struct timespec start, end;
-  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
-  for (int64_t i = 0; i < RUNS; i++) {
-    for (int64_t y = 0; y < h; y += REGION_HEIGHT) {
-      for (int64_t x = 0; x < w; x += REGION_WIDTH) {
-        openslide_read_region(osr, buf, x, y, 0,
-                              MIN(w - x, REGION_WIDTH),
-                              MIN(h - y, REGION_HEIGHT));
+
+  for (int a = optind; a < argc; a++) {
+    const char *slide = argv[a];
+
+    for (int si = 0; si < size_count; si++) {
+      for (int ti = 0; ti < thread_count; ti++) {
+        int nthreads = threads[ti];
+        int64_t size = sizes[si];
+
+        // a fresh object per configuration so each cold phase really
+        // starts with an empty cache
+        openslide_t *osr = openslide_open(slide);
+        assert(osr != NULL && openslide_get_error(osr) == NULL);
+        const char *vendor =
+          openslide_get_property_value(osr, OPENSLIDE_PROPERTY_NAME_VENDOR);
+        int64_t w, h;
+        openslide_get_level0_dimensions(osr, &w, &h);
+
+        struct worker *workers = calloc(nthreads, sizeof(*workers));
+        assert(workers != NULL);
+        for (int t = 0; t < nthreads; t++) {
+          workers[t].osr = osr;
+          workers[t].regions = make_regions(w, h, size, pattern,
+                                            t, per_thread);
+          workers[t].count = per_thread;
+          workers[t].size = size;
+          workers[t].latencies = malloc(per_thread * sizeof(double));
+          assert(workers[t].latencies != NULL);
+        }
+
+        // cold: first touch of each region; warm: the same regions
+        // again, now served from the tile cache
+        struct result cold = run_phase(osr, workers, nthreads,
+                                       per_thread, size);
+        report(json, slide, vendor, nthreads, size, pattern, "cold",
+               (int64_t) nthreads * per_thread, &cold);
+        struct result warm = run_phase(osr, workers, nthreads,
+                                       per_thread, size);
+        report(json, slide, vendor, nthreads, size, pattern, "warm",
+               (int64_t) nthreads * per_thread, &warm);
+
+        for (int t = 0; t < nthreads; t++) {
+          free((void *) workers[t].regions);
+          free(workers[t].latencies);
+        }
+        free(workers);
+        openslide_close(osr);
       }
     }
   }
-  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &end);
-  double elapsed = (end.tv_sec + end.tv_nsec / 1e9) -
-                   (start.tv_sec + start.tv_nsec / 1e9);
-  assert(openslide_get_error(osr) == NULL);
-  printf("%.1f million pixels per CPU-second\n",
-         w * h * RUNS / (elapsed * 1e6));
-
-  openslide_close(osr);
-  free(buf);
   return 0;
 }
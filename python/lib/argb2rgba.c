@@ -21,27 +21,8 @@
 
 
 #include "argb2rgba.h"
+#include "openslide-simd.h"
 
 void argb2rgba(unsigned char *buf, unsigned int len) {
-
-  unsigned int cur;
-  unsigned char a, r, g, b;
-
-  for (cur = 0; cur < len; cur += 4) {
-    a = buf[cur + CA];
-    r = buf[cur + CR];
-    g = buf[cur + CG];
-    b = buf[cur + CB];
-
-    if (a != 0 && a != 255) {
-      r = r * 255 / a;
-      g = g * 255 / a;
-      b = b * 255 / a;
-    }
-
-    buf[cur + 0] = r;
-    buf[cur + 1] = g;
-    buf[cur + 2] = b;
-    buf[cur + 3] = a;
-  }
+  _openslide_simd_argb_to_rgba(buf, len);
 }
@@ -35,6 +35,15 @@ struct _dimensions {
 };
 
 
+/* a cached DeepZoom tile, keyed by (plane, level, col, row) */
+struct _dz_cache_entry {
+  int64_t key;
+  uint32_t *pixels;
+  int64_t w;
+  int64_t h;
+};
+
+
 /* the main structure */
 struct _deepzoom {
   // openslide object
@@ -71,6 +80,17 @@ struct _deepzoom {
   // Slide background color
   char *bg_color;
 
+  // DeepZoom tile cache: key -> struct _dz_cache_entry, with the
+  // entries also kept on an LRU queue; repeated fetches of a tile skip
+  // the slide read even after the slide cache has churned
+  GHashTable *tile_cache;
+  GQueue *tile_lru;
+#if !GLIB_CHECK_VERSION(2,31,0)
+  GMutex *cache_lock;
+#else
+  GMutex cache_lock;
+#endif
+
   // error handling, NULL if no error
   gpointer error; // must use g_atomic_pointer!
 };
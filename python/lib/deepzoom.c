@@ -22,17 +22,62 @@
  */
 
 #include "deepzoom.h"
+#include "argb2rgba.h"
 #include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <setjmp.h>
+#include <jpeglib.h>
+#include <png.h>
+
+// number of decoded DeepZoom tiles kept in the per-object cache
+#define DZ_CACHE_MAX_TILES 64
+
+#define DZ_JPEG_DEFAULT_QUALITY 75
 
 
 static deepzoom_t *create_deepzoom(void) {
 
   deepzoom_t *dpz = g_slice_new0(deepzoom_t);
 
+  dpz->tile_cache = g_hash_table_new(g_int64_hash, g_int64_equal);
+  dpz->tile_lru = g_queue_new();
+#if !GLIB_CHECK_VERSION(2,31,0)
+  dpz->cache_lock = g_mutex_new();
+#else
+  g_mutex_init(&dpz->cache_lock);
+#endif
+
   return dpz;
 }
 
 
+static void cache_lock(deepzoom_t *dpz) {
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_lock(dpz->cache_lock);
+#else
+  g_mutex_lock(&dpz->cache_lock);
+#endif
+}
+
+static void cache_unlock(deepzoom_t *dpz) {
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_unlock(dpz->cache_lock);
+#else
+  g_mutex_unlock(&dpz->cache_lock);
+#endif
+}
+
+static int64_t cache_key(int64_t plane, int32_t level, int64_t col, int64_t row) {
+  return (plane << 56) | ((int64_t) level << 48) | (row << 24) | col;
+}
+
+static void cache_entry_free(struct _dz_cache_entry *entry) {
+  g_free(entry->pixels);
+  g_slice_free(struct _dz_cache_entry, entry);
+}
+
+
 int32_t *deepzoom_slide_from_dz_level_eval(deepzoom_t *dpz) {
   int32_t *slide_from_dz_level = NULL;
 
@@ -234,6 +279,18 @@ void deepzoom_close(deepzoom_t *dpz) {
 
   openslide_close(dpz->osr);
 
+  struct _dz_cache_entry *entry;
+  while ((entry = g_queue_pop_head(dpz->tile_lru))) {
+    cache_entry_free(entry);
+  }
+  g_queue_free(dpz->tile_lru);
+  g_hash_table_destroy(dpz->tile_cache);
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_free(dpz->cache_lock);
+#else
+  g_mutex_clear(&dpz->cache_lock);
+#endif
+
   g_free(dpz->l_dimensions);
   g_free(dpz->z_dimensions);
   g_free(dpz->slide_from_dz_level);
@@ -413,27 +470,272 @@ void deepzoom_get_tile(deepzoom_t *dpz, uint32_t *dest, int64_t plane, int32_t l
 
   deepzoom_get_tile_info(dpz, level, w, h, &x, &y, &lvl, &outw, &outh, &sw, &sh);
 
-  if (outw == -1 || outh == -1) {
-    goto FAIL;
+  if (outw == -1 || outh == -1 || dest == NULL) {
+    return;
   }
 
-  dest = g_slice_alloc(outw * outh * 4);;
+  int64_t key = cache_key(plane, level, w, h);
+  int64_t size = outw * outh * 4;
+
+  // serve from the DeepZoom tile cache when possible
+  cache_lock(dpz);
+  struct _dz_cache_entry *entry = g_hash_table_lookup(dpz->tile_cache, &key);
+  if (entry) {
+    memcpy(dest, entry->pixels, size);
+    g_queue_remove(dpz->tile_lru, entry);
+    g_queue_push_tail(dpz->tile_lru, entry);
+    cache_unlock(dpz);
+    return;
+  }
+  cache_unlock(dpz);
 
-  // Return read_region() parameters plus tile size for final scaling
   openslide_read_region(dpz->osr, dest, x, y, plane, lvl, outw, outh);
 
-  char *error = g_strdup(openslide_get_error(dpz->osr));
+  const char *error = openslide_get_error(dpz->osr);
   if (error) {
-    goto FAIL;
+    gchar *msg = g_strdup(error);
+    if (!g_atomic_pointer_compare_and_exchange(&dpz->error, NULL, msg)) {
+      g_free(msg);
+    }
+    return;
   }
 
-  return;
+  // keep a copy, evicting the least recently fetched tiles
+  entry = g_slice_new0(struct _dz_cache_entry);
+  entry->key = key;
+  entry->pixels = g_malloc(size);
+  memcpy(entry->pixels, dest, size);
+  entry->w = outw;
+  entry->h = outh;
+
+  cache_lock(dpz);
+  if (!g_hash_table_lookup(dpz->tile_cache, &key)) {
+    g_hash_table_insert(dpz->tile_cache, &entry->key, entry);
+    g_queue_push_tail(dpz->tile_lru, entry);
+    while (g_queue_get_length(dpz->tile_lru) > DZ_CACHE_MAX_TILES) {
+      struct _dz_cache_entry *evicted = g_queue_pop_head(dpz->tile_lru);
+      g_hash_table_remove(dpz->tile_cache, &evicted->key);
+      cache_entry_free(evicted);
+    }
+  } else {
+    // another thread fetched the same tile first
+    cache_entry_free(entry);
+  }
+  cache_unlock(dpz);
+}
 
-FAIL:
 
-  dest = NULL;
+void deepzoom_get_tiles(deepzoom_t *dpz, uint32_t *const *dests, int64_t plane,
+                        int32_t level, int64_t col, int64_t row,
+                        int64_t cols, int64_t rows) {
+
+  if (cols <= 0 || rows <= 0 || dests == NULL) {
+    return;
+  }
+
+  // decode every slide tile under the rectangle in one pass: a NULL
+  // destination populates the slide cache without copying output, so
+  // the per-tile reads below find their source tiles already decoded
+  int64_t x0, y0, w0, h0, x1, y1, w1, h1, sw, sh;
+  int32_t lvl;
+  deepzoom_get_tile_info(dpz, level, col, row,
+                         &x0, &y0, &lvl, &w0, &h0, &sw, &sh);
+  deepzoom_get_tile_info(dpz, level, col + cols - 1, row + rows - 1,
+                         &x1, &y1, &lvl, &w1, &h1, &sw, &sh);
+  if (w0 != -1 && w1 != -1) {
+    double ds = dpz->l0_l_downsamples[lvl];
+    openslide_read_region(dpz->osr, NULL, x0, y0, plane, lvl,
+                          (int64_t) ((x1 - x0) / ds) + w1,
+                          (int64_t) ((y1 - y0) / ds) + h1);
+  }
+
+  for (int64_t r = 0; r < rows; ++r) {
+    for (int64_t c = 0; c < cols; ++c) {
+      deepzoom_get_tile(dpz, dests[r * cols + c], plane, level,
+                        col + c, row + r);
+    }
+  }
+}
+
+// fetch one tile for encoding; returns the pixels and dimensions, or
+// NULL if the tile is invalid or the read failed
+static uint32_t *get_tile_pixels(deepzoom_t *dpz, int64_t plane,
+                                 int32_t level, int64_t w, int64_t h,
+                                 int64_t *outw, int64_t *outh) {
+  int64_t x, y, sw, sh;
+  int32_t lvl;
+
+  deepzoom_get_tile_info(dpz, level, w, h, &x, &y, &lvl, outw, outh, &sw, &sh);
+  if (*outw == -1 || *outh == -1) {
+    return NULL;
+  }
+
+  uint32_t *pixels = g_malloc(*outw * *outh * 4);
+  deepzoom_get_tile(dpz, pixels, plane, level, w, h);
+  if (g_atomic_pointer_get(&dpz->error)) {
+    g_free(pixels);
+    return NULL;
+  }
+  return pixels;
+}
+
+
+struct dz_jpeg_error {
+  struct jpeg_error_mgr base;
+  jmp_buf env;
+};
+
+static void dz_jpeg_error_exit(j_common_ptr cinfo) {
+  struct dz_jpeg_error *jerr = (struct dz_jpeg_error *) cinfo->err;
+  longjmp(jerr->env, 1);
+}
+
+
+uint8_t *deepzoom_get_tile_jpeg(deepzoom_t *dpz, int64_t plane,
+                                int32_t level, int64_t w, int64_t h,
+                                int32_t quality, int64_t *len_OUT) {
+
+  *len_OUT = 0;
+
+  int64_t outw, outh;
+  uint32_t *pixels = get_tile_pixels(dpz, plane, level, w, h, &outw, &outh);
+  if (pixels == NULL) {
+    return NULL;
+  }
+
+  if (quality <= 0 || quality > 100) {
+    quality = DZ_JPEG_DEFAULT_QUALITY;
+  }
+
+  // the blob is allocated by libjpeg with malloc(); the caller frees
+  // it with free()
+  unsigned char *blob = NULL;
+  unsigned long blob_len = 0;
+  uint8_t *row = g_malloc(outw * 3);
+
+  struct jpeg_compress_struct cinfo;
+  struct dz_jpeg_error jerr;
+  cinfo.err = jpeg_std_error(&jerr.base);
+  jerr.base.error_exit = dz_jpeg_error_exit;
+
+  if (setjmp(jerr.env)) {
+    jpeg_destroy_compress(&cinfo);
+    free(blob);
+    g_free(row);
+    g_free(pixels);
+    return NULL;
+  }
+
+  jpeg_create_compress(&cinfo);
+  jpeg_mem_dest(&cinfo, &blob, &blob_len);
+
+  cinfo.image_width = outw;
+  cinfo.image_height = outh;
+  cinfo.input_components = 3;
+  cinfo.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, quality, TRUE);
+
+  jpeg_start_compress(&cinfo, TRUE);
+  while (cinfo.next_scanline < cinfo.image_height) {
+    const uint8_t *src = (const uint8_t *) (pixels + cinfo.next_scanline * outw);
+    for (int64_t i = 0; i < outw; ++i) {
+      row[i * 3] = src[i * 4 + CR];
+      row[i * 3 + 1] = src[i * 4 + CG];
+      row[i * 3 + 2] = src[i * 4 + CB];
+    }
+    JSAMPROW rows[1] = {row};
+    jpeg_write_scanlines(&cinfo, rows, 1);
+  }
+  jpeg_finish_compress(&cinfo);
+  jpeg_destroy_compress(&cinfo);
+
+  g_free(row);
+  g_free(pixels);
+
+  *len_OUT = blob_len;
+  return blob;
+}
+
+
+struct dz_png_blob {
+  uint8_t *data;
+  size_t len;
+  size_t cap;
+};
+
+static void dz_png_append(png_structp png_ptr, png_bytep data,
+                          png_size_t length) {
+  struct dz_png_blob *blob = png_get_io_ptr(png_ptr);
+  if (blob->len + length > blob->cap) {
+    blob->cap = MAX(blob->cap * 2, blob->len + length);
+    // plain realloc, so the caller can free() the finished blob
+    blob->data = realloc(blob->data, blob->cap);
+    if (blob->data == NULL) {
+      png_error(png_ptr, "Out of memory");
+    }
+  }
+  memcpy(blob->data + blob->len, data, length);
+  blob->len += length;
+}
+
+static void dz_png_flush(png_structp png_ptr G_GNUC_UNUSED) {}
+
+
+uint8_t *deepzoom_get_tile_png(deepzoom_t *dpz, int64_t plane,
+                               int32_t level, int64_t w, int64_t h,
+                               int64_t *len_OUT) {
+
+  *len_OUT = 0;
+
+  int64_t outw, outh;
+  uint32_t *pixels = get_tile_pixels(dpz, plane, level, w, h, &outw, &outh);
+  if (pixels == NULL) {
+    return NULL;
+  }
+
+  struct dz_png_blob blob = {
+    .cap = 8192,
+  };
+  blob.data = malloc(blob.cap);
+
+  png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING,
+                                                NULL, NULL, NULL);
+  png_infop info_ptr = png_ptr ? png_create_info_struct(png_ptr) : NULL;
+  if (info_ptr == NULL || blob.data == NULL) {
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    free(blob.data);
+    g_free(pixels);
+    return NULL;
+  }
+
+  if (setjmp(png_jmpbuf(png_ptr))) {
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    free(blob.data);
+    g_free(pixels);
+    return NULL;
+  }
+
+  png_set_write_fn(png_ptr, &blob, dz_png_append, dz_png_flush);
+  png_set_IHDR(png_ptr, info_ptr, outw, outh, 8,
+               PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE,
+               PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(png_ptr, info_ptr);
+
+  // reorder in place, then hand libpng the rows directly
+  argb2rgba((unsigned char *) pixels, outw * outh * 4);
+  for (int64_t y = 0; y < outh; ++y) {
+    png_write_row(png_ptr, (png_bytep) (pixels + y * outw));
+  }
+  png_write_end(png_ptr, info_ptr);
+  png_destroy_write_struct(&png_ptr, &info_ptr);
+  g_free(pixels);
+
+  *len_OUT = blob.len;
+  return blob.data;
 }
 
+
 const char * const *deepzoom_get_property_names(deepzoom_t *dpz) {
   const char * const * properties = openslide_get_property_names(dpz->osr);
   return properties;
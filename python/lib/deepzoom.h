@@ -236,6 +236,83 @@ void deepzoom_get_tile(deepzoom_t *dpz,
                        int64_t w, int64_t h);
 
 
+/**
+ * Copy a rectangle of Deep Zoom tiles in one pass.
+ *
+ * Equivalent to calling deepzoom_get_tile() for each tile of the
+ * rectangle, but the slide region covering the whole rectangle is
+ * decoded first, so slide tiles shared by adjacent Deep Zoom tiles are
+ * decoded once instead of once per tile.  Each destination buffer must
+ * be sized for its tile as reported by deepzoom_get_tile_info(); a
+ * NULL destination skips that tile.
+ *
+ * @param dpz The DeepZoom object.
+ * @param[out] dests The destination buffers, row-major, cols * rows entries.
+ * @param plane Image plane to read (0 for brightfield; >= 0 for fluorescence).
+ * @param level The desired level.
+ * @param col The column of the top-left tile.
+ * @param row The row of the top-left tile.
+ * @param cols The number of tile columns to copy.
+ * @param rows The number of tile rows to copy.
+ */
+OPENSLIDE_PUBLIC()
+void deepzoom_get_tiles(deepzoom_t *dpz,
+                        uint32_t *const *dests,
+                        int64_t plane,
+                        int32_t level,
+                        int64_t col, int64_t row,
+                        int64_t cols, int64_t rows);
+
+
+/**
+ * Fetch a Deep Zoom tile as a JPEG blob ready to send on the wire.
+ *
+ * The tile is read through the same cache as deepzoom_get_tile() and
+ * encoded directly from the internal buffer, with no intermediate
+ * RGBA conversion pass or caller-side copies.  Alpha is dropped.
+ *
+ * @param dpz The DeepZoom object.
+ * @param plane Image plane to read (0 for brightfield; >= 0 for fluorescence).
+ * @param level The desired level.
+ * @param w The column of the desired tile.
+ * @param h The row of the desired tile.
+ * @param quality JPEG quality, 1-100; out-of-range values select 75.
+ * @param[out] len_OUT The size of the returned blob in bytes.
+ * @return The encoded JPEG data, or NULL if the tile is invalid or an
+ *         error occurred.  Free with free().
+ */
+OPENSLIDE_PUBLIC()
+uint8_t *deepzoom_get_tile_jpeg(deepzoom_t *dpz,
+                                int64_t plane,
+                                int32_t level,
+                                int64_t w, int64_t h,
+                                int32_t quality,
+                                int64_t *len_OUT);
+
+
+/**
+ * Fetch a Deep Zoom tile as a PNG blob ready to send on the wire.
+ *
+ * The tile is read through the same cache as deepzoom_get_tile() and
+ * encoded directly from the internal buffer, preserving alpha.
+ *
+ * @param dpz The DeepZoom object.
+ * @param plane Image plane to read (0 for brightfield; >= 0 for fluorescence).
+ * @param level The desired level.
+ * @param w The column of the desired tile.
+ * @param h The row of the desired tile.
+ * @param[out] len_OUT The size of the returned blob in bytes.
+ * @return The encoded PNG data, or NULL if the tile is invalid or an
+ *         error occurred.  Free with free().
+ */
+OPENSLIDE_PUBLIC()
+uint8_t *deepzoom_get_tile_png(deepzoom_t *dpz,
+                               int64_t plane,
+                               int32_t level,
+                               int64_t w, int64_t h,
+                               int64_t *len_OUT);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -15,7 +15,7 @@ cdef extern from "openslide.h":
   void openslide_get_level_dimensions(openslide_t * osr, int level, int64_t * w, int64_t * h);
   double openslide_get_level_downsample(openslide_t * osr, int level);
   int openslide_get_best_level_for_downsample(openslide_t * osr, double downsample);
-  void openslide_read_region(openslide_t * osr, unsigned int * dest, int64_t x, int64_t y, int64_t plane, int level, int64_t w, int64_t h);
+  void openslide_read_region(openslide_t * osr, unsigned int * dest, int64_t x, int64_t y, int64_t plane, int level, int64_t w, int64_t h) nogil;
   void openslide_close(openslide_t * osr);
   const char * openslide_get_error(openslide_t * osr);
 
@@ -29,7 +29,7 @@ cdef extern from "openslide.h":
 
 cdef extern from "argb2rgba.h":
 
-  void argb2rgba (unsigned char * buf, unsigned int len);
+  void argb2rgba (unsigned char * buf, unsigned int len) nogil;
 
 cdef class Openslide:
 
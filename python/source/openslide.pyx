@@ -454,6 +454,65 @@ cdef class Openslide:
     elif self._plane == FLUORESCENCE:
       return self._read_fluorescence_region(self._level, x, y, plane, w, h)
 
+  def read_region_into (self, np.uint32_t [:, ::1] dest, long int x, long int y, long int plane, long int w, long int h):
+    '''
+    Read a region directly into a caller-provided buffer.
+
+    Any writable C-contiguous buffer of uint32 values can be used as
+    destination (e.g. a pre-allocated numpy array), so the pixels land
+    in the caller's memory without an intermediate copy.
+    The GIL is released for the whole native read and the in-place
+    ARGB -> RGBA conversion, allowing multi-threaded data loaders to
+    decode tiles concurrently.
+
+    Parameters
+    ----------
+      dest : buffer
+        Writable C-contiguous uint32 buffer of shape (h, w).
+        On return each element holds an RGBA pixel for brightfield
+        slides, or the raw plane values for fluorescence ones.
+
+      x : int
+        The top left x-coordinate, in the level 0 reference frame.
+
+      y : int
+        The top left y-coordinate, in the level 0 reference frame.
+
+      plane : int
+        Image plane to read (0 for brightfield; >= 0 for fluorescence).
+
+      w : int
+        The width of the region. Must be non-negative.
+
+      h : int
+        The height of the region. Must be non-negative.
+
+    Returns
+    -------
+      self
+
+    Notes
+    -----
+    .. warning::
+      If an error occurs or has occurred an OpenslideError is raised
+    '''
+
+    if dest.shape[0] != h or dest.shape[1] != w:
+      raise OpenslideError('Incorrect destination buffer. '
+                           'The request shape is: ({:d}, {:d}). '
+                           'The buffer shape is: ({:d}, {:d})'.format(h, w, dest.shape[0], dest.shape[1]))
+
+    cdef int level = self._level
+    cdef int convert = self._plane == BRIGHTFIELD
+    cdef unsigned int * ptr = <unsigned int *> &dest[0, 0]
+
+    with nogil:
+      openslide_read_region(self.thisptr, ptr, x, y, plane, level, w, h)
+      if convert:
+        argb2rgba(<unsigned char *> ptr, w * h * 4)
+
+    return self._get_error()
+
   def read_associated_image (self, str name):
     '''
     Copy pre-multiplied ARGB data from an associated image.
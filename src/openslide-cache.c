@@ -27,9 +27,43 @@
 #include "openslide-private.h"
 
 #include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#endif
 
 #define DEFAULT_CACHE_SIZE (1024*1024*32)
 
+// power of two; keys are spread across shards by hash so concurrent
+// gets from different threads rarely touch the same mutex
+#define CACHE_SHARD_COUNT 16
+
+// fraction of each shard reserved for the protected segment under the
+// segmented-LRU policy
+#define CACHE_PROTECTED_NUM 4
+#define CACHE_PROTECTED_DEN 5
+
+// fraction of the cache capacity that may be held as recycled tile
+// buffers awaiting reuse
+#define SLAB_RETAIN_DEN 4
+
+// upper bound on per-node partitions in NUMA mode; must divide
+// CACHE_SHARD_COUNT
+#define CACHE_NUMA_MAX_PARTITIONS 8
+
+// tile buffer alignment within a preallocated arena
+#define ARENA_ALIGN 64
+// huge page size assumed when MAP_HUGETLB is requested
+#define ARENA_HUGE_PAGE (2 * 1024 * 1024)
+
+// compressed second tier: byte budget in megabytes; unset or
+// non-positive disables the tier
+#define COMPRESSED_TIER_ENV "OPENSLIDE_CACHE_COMPRESSED_MB"
+
 // hash table key
 struct _openslide_cache_key {
   uint64_t binding_id;  // distinguishes values from different slide handles
@@ -42,35 +76,164 @@ struct _openslide_cache_key {
 // hash table value
 struct _openslide_cache_value {
   GList *link;            // direct pointer to the node in the list
+  GQueue *list;           // the segment currently holding the node
   struct _openslide_cache_key *key; // for removing keys when aged out
-  openslide_cache_t *cache; // sadly, for total_bytes and the list
+  struct _openslide_cache_shard *shard; // sadly, for total_size and the list
+  struct binding_account *account;      // byte accounting, holds a ref
 
   struct _openslide_cache_entry *entry;  // may outlive the value
 };
 
+// compressed-tier value: a tile's original bitstream, kept after the
+// decoded pixels age out so a later touch re-decodes from RAM instead
+// of re-reading the slide
+struct compressed_value {
+  GList *link;            // direct pointer to the node in the LRU list
+  struct _openslide_cache_key *key;  // for removing keys when aged out
+  openslide_cache_t *cache;  // sadly, for compressed_size and the list
+  uint8_t *data;          // owned bitstream
+  int64_t len;
+  const char *codec;      // interned codec name from the raw tile reader
+};
+
+// Per-binding byte accounting, shared by a binding and all of its
+// resident entries.  Bytes are cross-shard totals, so they live under
+// their own lock rather than a shard mutex; they only change on insert
+// and eviction, not on hits.  Refcounted because entries inserted
+// through a binding can outlive a rebind of that binding.
+struct binding_account {
+  gint refcount;   // atomic ops only
+  uint64_t bytes;  // resident bytes across all shards, under accounts lock
+  uint64_t quota;  // optional per-slide cap in bytes, 0 for fair share only
+};
+
+G_LOCK_DEFINE_STATIC(accounts);
+
+// entries scanned from the cold end for an over-fair-share victim
+// before falling back to strict LRU eviction
+#define FAIR_EVICT_SCAN 8
+
+static struct binding_account *account_new(void) {
+  struct binding_account *account = g_slice_new0(struct binding_account);
+  g_atomic_int_set(&account->refcount, 1);
+  return account;
+}
+
+static void account_ref(struct binding_account *account) {
+  g_atomic_int_inc(&account->refcount);
+}
+
+static void account_unref(struct binding_account *account) {
+  if (g_atomic_int_dec_and_test(&account->refcount)) {
+    g_slice_free(struct binding_account, account);
+  }
+}
+
+static uint64_t account_bytes(struct binding_account *account) {
+  G_LOCK(accounts);
+  uint64_t bytes = account->bytes;
+  G_UNLOCK(accounts);
+  return bytes;
+}
+
+// pool of recycled tile buffers, keyed by exact buffer size.  Tile
+// buffers are far too large for the g_slice magazine layer, so without
+// recycling every tile decode costs a malloc/free pair.  Refcounted
+// separately from the cache because in-flight entries may return their
+// buffers after the cache itself has been destroyed.
+struct slab_pool {
+  gint refcount;  // atomic ops only
+#if !GLIB_CHECK_VERSION(2,31,0)
+  GMutex *mutex;
+#else
+  GMutex mutex;
+#endif
+  // buffer size -> GQueue of free buffers, one table per NUMA
+  // partition so recycled buffers stay on the node that first
+  // touched their pages; only table 0 is used outside NUMA mode
+  GHashTable *free_lists[CACHE_NUMA_MAX_PARTITIONS];
+  int partitions;
+  uint64_t retained;
+  uint64_t retain_capacity;
+
+  // preallocated region backing tile buffers when guaranteed residency
+  // was requested; NULL otherwise.  Fresh buffers are bump-allocated
+  // from it and recycled through the free lists forever, so the arena
+  // never fragments beyond the working set of distinct tile sizes
+  uint8_t *arena;
+  uint64_t arena_size;
+  uint64_t arena_used;  // bump offset, under the pool mutex
+};
+
+static bool slab_in_arena(struct slab_pool *pool, void *data) {
+  return pool->arena &&
+         (uint8_t *) data >= pool->arena &&
+         (uint8_t *) data < pool->arena + pool->arena_size;
+}
+
 // datum
 struct _openslide_cache_entry {
   gint refcount;  // atomic ops only
   void *data;
   uint64_t size;
+  struct slab_pool *pool;  // recycles data on the last unref; holds a ref
 };
 
-struct _openslide_cache {
+// one slice of the cache: private mutex, LRU list, and hash table
+struct _openslide_cache_shard {
 #if !GLIB_CHECK_VERSION(2,31,0)
   GMutex *mutex;
 #else
   GMutex mutex;
 #endif
-  GQueue *list;
+  GQueue *list;            // probationary segment; the only segment for LRU
+  GQueue *protected_list;  // protected segment, unused for LRU
   GHashTable *hashtable;
-  int refcount;
+
+  uint64_t capacity;
+  uint64_t total_size;
+  uint64_t protected_capacity;
+  uint64_t protected_size;
+
+  // statistics, updated under the shard mutex
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t insertions;
+  uint64_t evictions;
+};
+
+struct _openslide_cache {
+#if !GLIB_CHECK_VERSION(2,31,0)
+  GMutex *mutex;  // protects released and next_binding_id
+#else
+  GMutex mutex;
+#endif
+  struct _openslide_cache_shard shards[CACHE_SHARD_COUNT];
+  struct slab_pool *pool;
+  int numa_partitions;  // 1 unless NUMA mode is enabled
+  gint refcount;  // atomic ops only
+  gint bound_handles;  // slide handles currently bound, atomic ops only
   bool released;
   uint64_t next_binding_id;
 
   uint64_t capacity;
-  uint64_t total_size;
+  openslide_cache_policy_t policy;
 
   gint warned_overlarge_entry;
+
+  // compressed second tier, present when compressed_capacity > 0.  A
+  // single mutex is enough: the tier is only touched on decoded-tier
+  // misses and insertions, never on hits, and its critical sections
+  // only move list nodes
+#if !GLIB_CHECK_VERSION(2,31,0)
+  GMutex *compressed_mutex;
+#else
+  GMutex compressed_mutex;
+#endif
+  GQueue *compressed_list;       // LRU; most recently touched at the head
+  GHashTable *compressed_table;
+  uint64_t compressed_capacity;  // bytes, 0 when the tier is disabled
+  uint64_t compressed_size;
 };
 
 // connection between a cache (possibly shared between multiple slide handles)
@@ -83,33 +246,541 @@ struct _openslide_cache_binding {
 #endif
   openslide_cache_t *cache;
   uint64_t id;  // unique id assigned by cache upon bind
+  struct binding_account *account;  // byte accounting for this binding
+
+  // per-slide statistics; pointer-sized atomic counters so get and put
+  // never touch the binding mutex (see counter_inc())
+  volatile gpointer hits;
+  volatile gpointer misses;
+
+  // tile capture for the tile iterator, under the binding mutex: while
+  // armed, the first entry that passes through get or put is recorded
+  // with an extra reference
+  gint capture_armed;  // atomic ops for the unlocked fast-path check
+  struct _openslide_cache_entry *captured;
+  void *captured_data;
+  uint64_t captured_size;
 };
 
+// statistics counters.  GLib has no 64-bit atomics, so use the
+// pointer-sized ones, the widest available; on 32-bit platforms the
+// counters wrap at 2^32, which statistics consumers can tolerate
+static void counter_inc(volatile gpointer *counter) {
+#if GLIB_CHECK_VERSION(2,30,0)
+  g_atomic_pointer_add(counter, 1);
+#else
+  gpointer old;
+  do {
+    old = g_atomic_pointer_get(counter);
+  } while (!g_atomic_pointer_compare_and_exchange(counter, old,
+             (gpointer) ((guintptr) old + 1)));
+#endif
+}
+
+static uint64_t counter_read(volatile gpointer *counter) {
+  return (guintptr) g_atomic_pointer_get(counter);
+}
+
+static void cache_lock(openslide_cache_t *cache) {
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_lock(cache->mutex);
+#else
+  g_mutex_lock(&cache->mutex);
+#endif
+}
+
+static void cache_unlock(openslide_cache_t *cache) {
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_unlock(cache->mutex);
+#else
+  g_mutex_unlock(&cache->mutex);
+#endif
+}
+
+static void shard_lock(struct _openslide_cache_shard *shard) {
+  // shard mutexes are the contention point for concurrent readers;
+  // credit acquisition wait to the lock-wait timing stage
+  int64_t perf = _openslide_perf_begin();
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_lock(shard->mutex);
+#else
+  g_mutex_lock(&shard->mutex);
+#endif
+  _openslide_perf_end(_OPENSLIDE_PERF_CACHE_LOCK, perf);
+}
+
+static void shard_unlock(struct _openslide_cache_shard *shard) {
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_unlock(shard->mutex);
+#else
+  g_mutex_unlock(&shard->mutex);
+#endif
+}
+
+static void slab_pool_lock(struct slab_pool *pool) {
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_lock(pool->mutex);
+#else
+  g_mutex_lock(&pool->mutex);
+#endif
+}
+
+static void slab_pool_unlock(struct slab_pool *pool) {
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_unlock(pool->mutex);
+#else
+  g_mutex_unlock(&pool->mutex);
+#endif
+}
+
+static void binding_lock(struct _openslide_cache_binding *cb) {
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_lock(cb->mutex);
+#else
+  g_mutex_lock(&cb->mutex);
+#endif
+}
+
+static void binding_unlock(struct _openslide_cache_binding *cb) {
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_unlock(cb->mutex);
+#else
+  g_mutex_unlock(&cb->mutex);
+#endif
+}
+
+static void compressed_lock(openslide_cache_t *cache) {
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_lock(cache->compressed_mutex);
+#else
+  g_mutex_lock(&cache->compressed_mutex);
+#endif
+}
+
+static void compressed_unlock(openslide_cache_t *cache) {
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_unlock(cache->compressed_mutex);
+#else
+  g_mutex_unlock(&cache->compressed_mutex);
+#endif
+}
+
+// NUMA partitioning
+//
+// On multi-socket machines a shared cache hands out tile buffers that
+// were first-touched on whichever node inserted them, and cross-node
+// hits pay the interconnect on every access.  When the
+// OPENSLIDE_CACHE_NUMA environment variable is set, each node gets a
+// private group of shards and a private slab free list: gets are served
+// from the requesting thread's group and misses re-decode into it, so
+// a thread only ever reads buffers its own node allocated.  Tiles hot
+// on both sockets end up cached once per node, trading some capacity
+// for node-local hits.
+
+#ifdef __linux__
+
+static int numa_partition_count(void) {
+  // nodes are listed as a single id or a range, e.g. "0" or "0-1"
+  char *contents = NULL;
+  int nodes = 1;
+  if (g_file_get_contents("/sys/devices/system/node/possible",
+                          &contents, NULL, NULL)) {
+    const char *dash = strchr(contents, '-');
+    if (dash) {
+      nodes = atoi(dash + 1) + 1;
+    }
+    g_free(contents);
+  }
+
+  // power of two so partitioned shard selection stays a mask, and a
+  // divisor of CACHE_SHARD_COUNT so every partition gets whole shards
+  int partitions = 1;
+  while (partitions * 2 <= MIN(nodes, CACHE_NUMA_MAX_PARTITIONS)) {
+    partitions *= 2;
+  }
+  return partitions;
+}
+
+// current thread's node, resolved once and cached; worker threads on
+// tile servers are typically pinned, so staleness after a migration
+// only costs locality, never correctness
+#if !GLIB_CHECK_VERSION(2,31,0)
+static GStaticPrivate numa_node_key = G_STATIC_PRIVATE_INIT;
+#define numa_node_get() g_static_private_get(&numa_node_key)
+#define numa_node_set(v) g_static_private_set(&numa_node_key, (v), NULL)
+#else
+static GPrivate numa_node_key;
+#define numa_node_get() g_private_get(&numa_node_key)
+#define numa_node_set(v) g_private_set(&numa_node_key, (v))
+#endif
+
+static int numa_current_partition(int partitions) {
+  if (partitions <= 1) {
+    return 0;
+  }
+  gpointer cached = numa_node_get();
+  if (!cached) {
+    unsigned int cpu = 0;
+    unsigned int node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL)) {
+      node = 0;
+    }
+    cached = GINT_TO_POINTER((int) node + 1);
+    numa_node_set(cached);
+  }
+  return (GPOINTER_TO_INT(cached) - 1) % partitions;
+}
+
+#else
+
+static int numa_partition_count(void) {
+  return 1;
+}
+
+static int numa_current_partition(int partitions G_GNUC_UNUSED) {
+  return 0;
+}
+
+#endif
+
+// slab pool
+static void slab_free_list_destroy(gpointer data) {
+  GQueue *list = data;
+  void *buf;
+  while ((buf = g_queue_pop_head(list))) {
+    g_free(buf);
+  }
+  g_queue_free(list);
+}
+
+// map a resident arena for tile buffers: huge pages if requested and
+// available, transparent huge pages otherwise, mlock'd when pinning was
+// asked for.  All of it is best-effort; on any failure the pool simply
+// falls back to ordinary allocation
+#ifdef __linux__
+
+static void arena_create(struct slab_pool *pool, uint64_t size, int flags) {
+  // round up so huge mappings are legal and THP can map the whole thing
+  size = (size + ARENA_HUGE_PAGE - 1) / ARENA_HUGE_PAGE * ARENA_HUGE_PAGE;
+
+  void *arena = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  if (flags & _OPENSLIDE_CACHE_HUGEPAGE) {
+    arena = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  }
+#endif
+  if (arena == MAP_FAILED) {
+    arena = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (arena == MAP_FAILED) {
+      return;
+    }
+#ifdef MADV_HUGEPAGE
+    if (flags & _OPENSLIDE_CACHE_HUGEPAGE) {
+      madvise(arena, size, MADV_HUGEPAGE);
+    }
+#endif
+  }
+  if (flags & _OPENSLIDE_CACHE_PINNED) {
+    // commonly limited by RLIMIT_MEMLOCK; the mapping is still useful
+    // unpinned
+    mlock(arena, size);
+  }
+  pool->arena = arena;
+  pool->arena_size = size;
+}
+
+#else
+
+static void arena_create(struct slab_pool *pool G_GNUC_UNUSED,
+                         uint64_t size G_GNUC_UNUSED,
+                         int flags G_GNUC_UNUSED) {
+}
+
+#endif
+
+static struct slab_pool *slab_pool_create(uint64_t retain_capacity,
+                                          int partitions,
+                                          uint64_t arena_size,
+                                          int flags) {
+  struct slab_pool *pool = g_slice_new0(struct slab_pool);
+  g_atomic_int_set(&pool->refcount, 1);
+#if !GLIB_CHECK_VERSION(2,31,0)
+  pool->mutex = g_mutex_new();
+#else
+  g_mutex_init(&pool->mutex);
+#endif
+  pool->partitions = partitions;
+  for (int i = 0; i < partitions; i++) {
+    pool->free_lists[i] = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                                NULL, slab_free_list_destroy);
+  }
+  pool->retain_capacity = retain_capacity;
+  if (flags & (_OPENSLIDE_CACHE_PINNED | _OPENSLIDE_CACHE_HUGEPAGE)) {
+    arena_create(pool, arena_size, flags);
+  }
+  return pool;
+}
+
+static void slab_pool_ref(struct slab_pool *pool) {
+  g_atomic_int_inc(&pool->refcount);
+}
+
+static void slab_pool_unref(struct slab_pool *pool) {
+  if (!g_atomic_int_dec_and_test(&pool->refcount)) {
+    return;
+  }
+  for (int i = 0; i < pool->partitions; i++) {
+    if (pool->arena) {
+      // drain the lists here; arena buffers must not reach g_free()
+      GHashTableIter iter;
+      gpointer list_ptr;
+      g_hash_table_iter_init(&iter, pool->free_lists[i]);
+      while (g_hash_table_iter_next(&iter, NULL, &list_ptr)) {
+        GQueue *list = list_ptr;
+        void *buf;
+        while ((buf = g_queue_pop_head(list))) {
+          if (!slab_in_arena(pool, buf)) {
+            g_free(buf);
+          }
+        }
+      }
+    }
+    g_hash_table_unref(pool->free_lists[i]);
+  }
+#ifdef __linux__
+  if (pool->arena) {
+    munmap(pool->arena, pool->arena_size);
+  }
+#endif
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_free(pool->mutex);
+#else
+  g_mutex_clear(&pool->mutex);
+#endif
+  g_slice_free(struct slab_pool, pool);
+}
 
+// pop a recycled buffer of exactly the requested size, or fall back to
+// the allocator; returned buffers are not zeroed
+static void *slab_pool_alloc(struct slab_pool *pool, uint64_t size) {
+  GHashTable *free_lists =
+    pool->free_lists[numa_current_partition(pool->partitions)];
+  slab_pool_lock(pool);
+  GQueue *list = g_hash_table_lookup(free_lists,
+                                     GSIZE_TO_POINTER(size));
+  void *buf = list ? g_queue_pop_head(list) : NULL;
+  if (buf) {
+    if (!slab_in_arena(pool, buf)) {
+      pool->retained -= size;
+    }
+  } else if (pool->arena) {
+    // bump-allocate from the resident arena while it lasts
+    uint64_t aligned = (size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+    if (pool->arena_used + aligned <= pool->arena_size) {
+      buf = pool->arena + pool->arena_used;
+      pool->arena_used += aligned;
+    }
+  }
+  slab_pool_unlock(pool);
+
+  return buf ? buf : g_malloc(size);
+}
+
+static void slab_pool_free(struct slab_pool *pool, uint64_t size,
+                           void *data) {
+  // recycle onto the freeing thread's list; in partitioned mode the
+  // thread that decoded a tile is nearly always the one that drops the
+  // last reference, so the buffer's pages stay node-local
+  GHashTable *free_lists =
+    pool->free_lists[numa_current_partition(pool->partitions)];
+  slab_pool_lock(pool);
+  // arena buffers are permanently allocated, so recycling them is free
+  // and releasing them would just leak arena space; they bypass the
+  // retained-bytes cap
+  bool in_arena = slab_in_arena(pool, data);
+  if (in_arena || pool->retained + size <= pool->retain_capacity) {
+    GQueue *list = g_hash_table_lookup(free_lists,
+                                       GSIZE_TO_POINTER(size));
+    if (list == NULL) {
+      list = g_queue_new();
+      g_hash_table_insert(free_lists, GSIZE_TO_POINTER(size), list);
+    }
+    g_queue_push_head(list, data);
+    if (!in_arena) {
+      pool->retained += size;
+    }
+    data = NULL;
+  }
+  slab_pool_unlock(pool);
+
+  // only if the pool is full
+  g_free(data);
+}
+
+// outstanding tile buffers: data pointer -> owning pool.  A buffer is
+// allocated through a binding but may be handed back after the binding
+// was pointed at a different cache; freeing it into the new cache's
+// pool would fail the arena membership test and g_free() a pointer
+// inside the old pool's mmap'd arena.  Record the origin pool instead,
+// with a ref that keeps its arena mapped until _openslide_cache_put()
+// passes the ref to the entry or the buffer is freed.
+G_LOCK_DEFINE_STATIC(tile_buffers);
+static GHashTable *tile_buffer_pools;
+
+static void tile_buffer_register(void *data, struct slab_pool *pool) {
+  G_LOCK(tile_buffers);
+  if (tile_buffer_pools == NULL) {
+    tile_buffer_pools = g_hash_table_new(g_direct_hash, g_direct_equal);
+  }
+  g_hash_table_insert(tile_buffer_pools, data, pool);
+  G_UNLOCK(tile_buffers);
+}
+
+// take the pool ref recorded at allocation; the caller owns it
+static struct slab_pool *tile_buffer_take_pool(void *data) {
+  G_LOCK(tile_buffers);
+  struct slab_pool *pool = g_hash_table_lookup(tile_buffer_pools, data);
+  g_hash_table_remove(tile_buffer_pools, data);
+  G_UNLOCK(tile_buffers);
+  // fails if data didn't come from _openslide_cache_tile_alloc()
+  g_assert(pool);
+  return pool;
+}
 
 // eviction
-// mutex must be held
-static void possibly_evict(openslide_cache_t *cache, uint64_t incoming_size) {
-
-  uint64_t size = cache->total_size + incoming_size;
-  uint64_t target = cache->capacity;
-  g_assert(size > cache->total_size);
-
-  while(size > target) {
-    // get key of last element
-    struct _openslide_cache_value *value = g_queue_peek_tail(cache->list);
-    if (value == NULL) {
-      return; // cache is empty
+// shard mutex must be held
+// evict one entry; prefer the coldest entry belonging to a binding
+// whose resident bytes exceed its fair share of the cache, scanning a
+// bounded distance from the cold end before falling back to strict
+// LRU.  This keeps one slide's giant tiles from displacing every other
+// slide's working set when several handles share a cache.
+// shard mutex must be held; returns the evicted size, 0 if empty
+static uint64_t evict_one(openslide_cache_t *cache,
+                          struct _openslide_cache_shard *shard) {
+  // age out of the probationary segment first, so one-shot scans
+  // cannot displace the protected working set
+  GQueue *lists[] = { shard->list, shard->protected_list };
+  struct _openslide_cache_value *victim = NULL;
+
+  int handles = g_atomic_int_get(&cache->bound_handles);
+  if (handles > 1) {
+    uint64_t fair_share = cache->capacity / handles;
+    int scanned = 0;
+    for (unsigned i = 0; i < G_N_ELEMENTS(lists) && !victim; i++) {
+      for (GList *link = g_queue_peek_tail_link(lists[i]);
+           link && scanned < FAIR_EVICT_SCAN;
+           link = link->prev, scanned++) {
+        struct _openslide_cache_value *value = link->data;
+        if (account_bytes(value->account) > fair_share) {
+          victim = value;
+          break;
+        }
+      }
+    }
+  }
+
+  if (victim == NULL) {
+    victim = g_queue_peek_tail(shard->list);
+    if (victim == NULL) {
+      victim = g_queue_peek_tail(shard->protected_list);
+    }
+    if (victim == NULL) {
+      return 0; // shard is empty
     }
-    struct _openslide_cache_key *key = value->key;
+  }
+
+  //g_debug("EVICT: size: %d", victim->entry->size);
 
-    //g_debug("EVICT: size: %d", value->entry->size);
+  uint64_t size = victim->entry->size;
 
-    size -= value->entry->size;
+  // remove from hashtable, this will trigger removal from everything
+  bool result = g_hash_table_remove(shard->hashtable, victim->key);
+  g_assert(result);
+  shard->evictions++;
+  return size;
+}
 
-    // remove from hashtable, this will trigger removal from everything
-    bool result = g_hash_table_remove(cache->hashtable, key);
-    g_assert(result);
+// evict the coldest entry in the shard owned by the given binding,
+// for keeping the binding under its quota
+// shard mutex must be held; returns the evicted size, 0 if none found
+static uint64_t evict_one_from_account(struct _openslide_cache_shard *shard,
+                                       struct binding_account *account) {
+  GQueue *lists[] = { shard->list, shard->protected_list };
+  for (unsigned i = 0; i < G_N_ELEMENTS(lists); i++) {
+    for (GList *link = g_queue_peek_tail_link(lists[i]);
+         link; link = link->prev) {
+      struct _openslide_cache_value *value = link->data;
+      if (value->account == account) {
+        uint64_t size = value->entry->size;
+        bool result = g_hash_table_remove(shard->hashtable, value->key);
+        g_assert(result);
+        shard->evictions++;
+        return size;
+      }
+    }
+  }
+  return 0;
+}
+
+static void possibly_evict(openslide_cache_t *cache,
+                           struct _openslide_cache_shard *shard,
+                           uint64_t incoming_size,
+                           struct binding_account *account) {
+  // per-slide quota: make room among the binding's own entries.  The
+  // quota is enforced against entries in this shard, so it is
+  // approximate across shards, but systematic overshoot stays bounded
+  // by the shard count
+  if (account->quota) {
+    while (account_bytes(account) + incoming_size > account->quota &&
+           evict_one_from_account(shard, account)) {
+      // evicted one of our own; bytes have already been debited
+    }
+  }
+
+  uint64_t size = shard->total_size + incoming_size;
+  uint64_t target = shard->capacity;
+  g_assert(size > shard->total_size);
+
+  while (size > target) {
+    uint64_t evicted = evict_one(cache, shard);
+    if (evicted == 0) {
+      return; // shard is empty
+    }
+    size -= evicted;
+  }
+}
+
+// promote an entry on hit, according to the cache policy
+// shard mutex must be held
+static void promote_value(openslide_cache_t *cache,
+                          struct _openslide_cache_shard *shard,
+                          struct _openslide_cache_value *value) {
+  if (cache->policy != OPENSLIDE_CACHE_SLRU ||
+      value->list == shard->protected_list) {
+    // plain LRU, or already protected: just move to the segment head
+    g_queue_unlink(value->list, value->link);
+    g_queue_push_head_link(value->list, value->link);
+    return;
+  }
+
+  // second touch: promote from probation into the protected segment
+  g_queue_unlink(shard->list, value->link);
+  g_queue_push_head_link(shard->protected_list, value->link);
+  value->list = shard->protected_list;
+  shard->protected_size += value->entry->size;
+
+  // demote the coldest protected entries back to probation until the
+  // protected segment fits again; keep at least the newly promoted entry
+  while (shard->protected_size > shard->protected_capacity &&
+         shard->protected_list->length > 1) {
+    struct _openslide_cache_value *demoted =
+      g_queue_peek_tail(shard->protected_list);
+    g_queue_unlink(shard->protected_list, demoted->link);
+    g_queue_push_head_link(shard->list, demoted->link);
+    demoted->list = shard->list;
+    shard->protected_size -= demoted->entry->size;
   }
 }
 
@@ -124,6 +795,22 @@ static guint hash_func(gconstpointer key) {
                   ((34369 * (uint64_t) c_key->y) + ((uint64_t) c_key->x) + ((uint64_t) c_key->channel)));
 }
 
+static struct _openslide_cache_shard *shard_for_key(openslide_cache_t *cache,
+                                                    const struct _openslide_cache_key *key) {
+  // mix the high bits back in so shard choice isn't correlated with the
+  // low bits the hash table buckets on
+  guint hash = hash_func(key);
+  guint index = (hash ^ (hash >> 16)) & (CACHE_SHARD_COUNT - 1);
+  if (cache->numa_partitions > 1) {
+    // restrict each node to its own group of shards; the same key may
+    // then be cached once per node, which is the point
+    guint group = CACHE_SHARD_COUNT / cache->numa_partitions;
+    index = (index % group) +
+            numa_current_partition(cache->numa_partitions) * group;
+  }
+  return &cache->shards[index];
+}
+
 static gboolean key_equal_func(gconstpointer a,
              gconstpointer b) {
   const struct _openslide_cache_key *c_a = a;
@@ -143,12 +830,22 @@ static void hash_destroy_key(gpointer data) {
 static void hash_destroy_value(gpointer data) {
   struct _openslide_cache_value *value = data;
 
-  // remove the item from the list
-  g_queue_delete_link(value->cache->list, value->link);
+  // remove the item from its segment
+  g_queue_delete_link(value->list, value->link);
 
   // decrement the total size
-  g_assert(value->entry->size <= value->cache->total_size);
-  value->cache->total_size -= value->entry->size;
+  g_assert(value->entry->size <= value->shard->total_size);
+  value->shard->total_size -= value->entry->size;
+  if (value->list == value->shard->protected_list) {
+    value->shard->protected_size -= value->entry->size;
+  }
+
+  // debit the binding's account
+  G_LOCK(accounts);
+  g_assert(value->entry->size <= value->account->bytes);
+  value->account->bytes -= value->entry->size;
+  G_UNLOCK(accounts);
+  account_unref(value->account);
 
   // unref the entry
   _openslide_cache_entry_unref(value->entry);
@@ -157,7 +854,25 @@ static void hash_destroy_value(gpointer data) {
   g_slice_free(struct _openslide_cache_value, value);
 }
 
-openslide_cache_t *_openslide_cache_create(uint64_t capacity_in_bytes) {
+// the tier mutex must be held
+static void compressed_destroy_value(gpointer data) {
+  struct compressed_value *value = data;
+
+  // remove the item from the LRU list
+  g_queue_delete_link(value->cache->compressed_list, value->link);
+
+  // decrement the total size
+  g_assert((uint64_t) value->len <= value->cache->compressed_size);
+  value->cache->compressed_size -= value->len;
+
+  // free the bitstream and the value
+  g_free(value->data);
+  g_slice_free(struct compressed_value, value);
+}
+
+openslide_cache_t *_openslide_cache_create_with_flags(uint64_t capacity_in_bytes,
+                                                      openslide_cache_policy_t policy,
+                                                      int flags) {
   openslide_cache_t *cache = g_slice_new0(openslide_cache_t);
 
   // init mutex
@@ -166,67 +881,133 @@ openslide_cache_t *_openslide_cache_create(uint64_t capacity_in_bytes) {
 #else
   g_mutex_init (&cache->mutex);
 #endif
-  // init queue
-  cache->list = g_queue_new();
-
-  // init hashtable
-  cache->hashtable = g_hash_table_new_full(hash_func,
-             key_equal_func,
-             hash_destroy_key,
-             hash_destroy_value);
-
-  // init refcount
-  cache->refcount = 1;
 
   // init byte_capacity
   cache->capacity = capacity_in_bytes;
+  cache->policy = policy;
 
-  return cache;
-}
+  // per-node partitioning is opt-in; it duplicates hot tiles across
+  // nodes, which only pays off on multi-socket machines
+  cache->numa_partitions = 1;
+  if (g_getenv("OPENSLIDE_CACHE_NUMA")) {
+    cache->numa_partitions = numa_partition_count();
+  }
 
-static void cache_ref(openslide_cache_t *cache) {
+  // init slab pool; the arena must cover resident entries plus
+  // recycled buffers awaiting reuse
+  cache->pool = slab_pool_create(capacity_in_bytes / SLAB_RETAIN_DEN,
+                                 cache->numa_partitions,
+                                 capacity_in_bytes +
+                                 capacity_in_bytes / SLAB_RETAIN_DEN,
+                                 flags);
+
+  // init shards
+  for (int i = 0; i < CACHE_SHARD_COUNT; i++) {
+    struct _openslide_cache_shard *shard = &cache->shards[i];
 #if !GLIB_CHECK_VERSION(2,31,0)
-  g_mutex_lock(cache->mutex);
+    shard->mutex = g_mutex_new();
 #else
-  g_mutex_lock(&cache->mutex);
+    g_mutex_init(&shard->mutex);
 #endif
-  cache->refcount++;
+    shard->list = g_queue_new();
+    shard->protected_list = g_queue_new();
+    shard->hashtable = g_hash_table_new_full(hash_func,
+               key_equal_func,
+               hash_destroy_key,
+               hash_destroy_value);
+    shard->capacity = capacity_in_bytes / CACHE_SHARD_COUNT;
+    shard->protected_capacity =
+      shard->capacity * CACHE_PROTECTED_NUM / CACHE_PROTECTED_DEN;
+  }
+
+  // compressed second tier, opt-in via environment
+  const char *tier = g_getenv(COMPRESSED_TIER_ENV);
+  if (tier) {
+    int64_t mb = g_ascii_strtoll(tier, NULL, 10);
+    if (mb > 0) {
+      cache->compressed_capacity = (uint64_t) mb * 1024 * 1024;
 #if !GLIB_CHECK_VERSION(2,31,0)
-  g_mutex_unlock(cache->mutex);
+      cache->compressed_mutex = g_mutex_new();
 #else
-  g_mutex_unlock(&cache->mutex);
+      g_mutex_init(&cache->compressed_mutex);
 #endif
+      cache->compressed_list = g_queue_new();
+      cache->compressed_table = g_hash_table_new_full(hash_func,
+                                                      key_equal_func,
+                                                      hash_destroy_key,
+                                                      compressed_destroy_value);
+    }
+  }
+
+  // init refcount
+  g_atomic_int_set(&cache->refcount, 1);
+
+  return cache;
+}
+
+openslide_cache_t *_openslide_cache_create_with_policy(uint64_t capacity_in_bytes,
+                                                       openslide_cache_policy_t policy) {
+  // latency-critical deployments can ask for guaranteed-resident tile
+  // storage without code changes
+  int flags = 0;
+  if (g_getenv("OPENSLIDE_CACHE_PINNED")) {
+    flags |= _OPENSLIDE_CACHE_PINNED;
+  }
+  if (g_getenv("OPENSLIDE_CACHE_HUGEPAGES")) {
+    flags |= _OPENSLIDE_CACHE_HUGEPAGE;
+  }
+  return _openslide_cache_create_with_flags(capacity_in_bytes, policy, flags);
+}
+
+openslide_cache_t *_openslide_cache_create(uint64_t capacity_in_bytes) {
+  return _openslide_cache_create_with_policy(capacity_in_bytes,
+                                             OPENSLIDE_CACHE_LRU);
+}
+
+static void cache_ref(openslide_cache_t *cache) {
+  g_atomic_int_inc(&cache->refcount);
 }
 
 static void cache_unref(openslide_cache_t *cache) {
-#if !GLIB_CHECK_VERSION(2,31,0)
-  g_mutex_lock(cache->mutex);
-#else
-  g_mutex_lock(&cache->mutex);
-#endif
   // decrement refcount, return if references remain
-  if (--cache->refcount) {
+  if (!g_atomic_int_dec_and_test(&cache->refcount)) {
+    return;
+  }
+
+  for (int i = 0; i < CACHE_SHARD_COUNT; i++) {
+    struct _openslide_cache_shard *shard = &cache->shards[i];
+    // clear hashtable (auto-deletes all data)
+    g_hash_table_unref(shard->hashtable);
+    // clear lists
+    g_queue_free(shard->list);
+    g_queue_free(shard->protected_list);
 #if !GLIB_CHECK_VERSION(2,31,0)
-    g_mutex_unlock(cache->mutex);
+    g_mutex_free(shard->mutex);
 #else
-    g_mutex_unlock(&cache->mutex);
+    g_mutex_clear(&shard->mutex);
 #endif
-    return;
   }
-  // clear hashtable (auto-deletes all data)
-  g_hash_table_unref(cache->hashtable);
+
+  // tear down the compressed tier, if present
+  if (cache->compressed_capacity) {
+    g_hash_table_unref(cache->compressed_table);
+    g_queue_free(cache->compressed_list);
 #if !GLIB_CHECK_VERSION(2,31,0)
-  g_mutex_unlock(cache->mutex);
+    g_mutex_free(cache->compressed_mutex);
 #else
-  g_mutex_unlock(&cache->mutex);
+    g_mutex_clear(&cache->compressed_mutex);
 #endif
+  }
 
-  // clear list
-  g_queue_free(cache->list);
+  // drop the pool; entries evicted above have already returned their
+  // buffers to it
+  slab_pool_unref(cache->pool);
 
   // free mutex
 #if !GLIB_CHECK_VERSION(2,31,0)
   g_mutex_free(cache->mutex);
+#else
+  g_mutex_clear(&cache->mutex);
 #endif
 
   // destroy struct
@@ -234,18 +1015,10 @@ static void cache_unref(openslide_cache_t *cache) {
 }
 
 void _openslide_cache_release(openslide_cache_t *cache) {
-#if !GLIB_CHECK_VERSION(2,31,0)
-  g_mutex_lock(cache->mutex);
-#else
-  g_mutex_lock(&cache->mutex);
-#endif
+  cache_lock(cache);
   bool already_released = cache->released;
   cache->released = true;
-#if !GLIB_CHECK_VERSION(2,31,0)
-  g_mutex_unlock(cache->mutex);
-#else
-  g_mutex_unlock(&cache->mutex);
-#endif
+  cache_unlock(cache);
   g_return_if_fail(!already_released);
 
   cache_unref(cache);
@@ -254,8 +1027,15 @@ void _openslide_cache_release(openslide_cache_t *cache) {
 struct _openslide_cache_binding *_openslide_cache_binding_create(void) {
   struct _openslide_cache_binding *cb =
     g_slice_new0(struct _openslide_cache_binding);
+#if !GLIB_CHECK_VERSION(2,31,0)
+  cb->mutex = g_mutex_new();
+#else
+  g_mutex_init(&cb->mutex);
+#endif
   cb->cache = _openslide_cache_create(DEFAULT_CACHE_SIZE);
   cb->id = cb->cache->next_binding_id++;
+  cb->account = account_new();
+  g_atomic_int_set(&cb->cache->bound_handles, 1);
   return cb;
 }
 
@@ -263,56 +1043,114 @@ void _openslide_cache_binding_set(struct _openslide_cache_binding *cb,
                                   openslide_cache_t *cache) {
   cache_ref(cache);
 
-#if !GLIB_CHECK_VERSION(2,31,0)
-  g_mutex_lock(cache->mutex);
-#else
-  g_mutex_lock(&cache->mutex);
-#endif
+  cache_lock(cache);
   uint64_t id = cache->next_binding_id++;
-#if !GLIB_CHECK_VERSION(2,31,0)
-  g_mutex_unlock(cache->mutex);
-#else
-  g_mutex_unlock(&cache->mutex);
-#endif
+  cache_unlock(cache);
 
-#if !GLIB_CHECK_VERSION(2,31,0)
-  g_mutex_lock(cb->mutex);
-#else
-  g_mutex_lock(&cb->mutex);
-#endif
+  // fresh account for the new (cache, id) pair; entries inserted into
+  // the old cache keep the old account alive until they age out.  The
+  // quota follows the slide handle.
+  struct binding_account *account = account_new();
+
+  binding_lock(cb);
   openslide_cache_t *old = cb->cache;
   cb->cache = cache;
   cb->id = id;
-#if !GLIB_CHECK_VERSION(2,31,0)
-  g_mutex_unlock(cb->mutex);
-#else
-  g_mutex_unlock(&cb->mutex);
-#endif
-
+  struct binding_account *old_account = cb->account;
+  G_LOCK(accounts);
+  account->quota = old_account->quota;
+  G_UNLOCK(accounts);
+  cb->account = account;
+  binding_unlock(cb);
+
+  g_atomic_int_inc(&cache->bound_handles);
+  g_atomic_int_add(&old->bound_handles, -1);
+  account_unref(old_account);
   cache_unref(old);
 }
 
 void _openslide_cache_binding_destroy(struct _openslide_cache_binding *cb) {
-#if !GLIB_CHECK_VERSION(2,31,0)
-  g_mutex_lock(cb->mutex);
-#else
-  g_mutex_lock(&cb->mutex);
-#endif
+  binding_lock(cb);
+  g_atomic_int_add(&cb->cache->bound_handles, -1);
+  account_unref(cb->account);
   cache_unref(cb->cache);
-#if !GLIB_CHECK_VERSION(2,31,0)
-  g_mutex_unlock(cb->mutex);
-#else
-  g_mutex_unlock(&cb->mutex);
-#endif
+  binding_unlock(cb);
 
 #if !GLIB_CHECK_VERSION(2,31,0)
-  g_mutex_clear(cb->mutex);
+  g_mutex_free(cb->mutex);
 #else
   g_mutex_clear(&cb->mutex);
 #endif
   g_slice_free(struct _openslide_cache_binding, cb);
 }
 
+// take a private reference on the bound cache, so the binding mutex is
+// held only for the snapshot rather than across the whole operation
+static openslide_cache_t *binding_get_cache(struct _openslide_cache_binding *cb,
+                                            uint64_t *id) {
+  binding_lock(cb);
+  openslide_cache_t *cache = cb->cache;
+  *id = cb->id;
+  cache_ref(cache);
+  binding_unlock(cb);
+  return cache;
+}
+
+// like binding_get_cache, but also returns a reference on the account
+static openslide_cache_t *binding_get_cache_account(struct _openslide_cache_binding *cb,
+                                                    uint64_t *id,
+                                                    struct binding_account **account) {
+  binding_lock(cb);
+  openslide_cache_t *cache = cb->cache;
+  *id = cb->id;
+  cache_ref(cache);
+  *account = cb->account;
+  account_ref(*account);
+  binding_unlock(cb);
+  return cache;
+}
+
+// tile capture
+
+// binding mutex must be held
+static void possibly_capture(struct _openslide_cache_binding *cb,
+                             struct _openslide_cache_entry *entry) {
+  if (g_atomic_int_get(&cb->capture_armed) && cb->captured == NULL) {
+    g_atomic_int_inc(&entry->refcount);
+    cb->captured = entry;
+    cb->captured_data = entry->data;
+    cb->captured_size = entry->size;
+  }
+}
+
+void _openslide_cache_binding_arm_capture(struct _openslide_cache_binding *cb) {
+  binding_lock(cb);
+  g_assert(!g_atomic_int_get(&cb->capture_armed) && cb->captured == NULL);
+  g_atomic_int_set(&cb->capture_armed, true);
+  binding_unlock(cb);
+}
+
+// disarm and return the captured entry, if any; the caller owns the
+// reference and must unref it when done with the data
+struct _openslide_cache_entry *_openslide_cache_binding_take_capture(struct _openslide_cache_binding *cb,
+                                                                     void **data,
+                                                                     uint64_t *size) {
+  binding_lock(cb);
+  struct _openslide_cache_entry *entry = cb->captured;
+  if (data) {
+    *data = cb->captured_data;
+  }
+  if (size) {
+    *size = cb->captured_size;
+  }
+  g_atomic_int_set(&cb->capture_armed, false);
+  cb->captured = NULL;
+  cb->captured_data = NULL;
+  cb->captured_size = 0;
+  binding_unlock(cb);
+  return entry;
+}
+
 // put and get
 
 // the cache retains one reference, and the caller gets another one.  the
@@ -325,6 +1163,12 @@ void _openslide_cache_put(struct _openslide_cache_binding *cb,
         void *data,
         uint64_t size_in_bytes,
         struct _openslide_cache_entry **_entry) {
+  // get cache
+  uint64_t binding_id;
+  struct binding_account *account;
+  openslide_cache_t *cache = binding_get_cache_account(cb, &binding_id,
+                                                       &account);
+
   // always create cache entry for caller's reference
   struct _openslide_cache_entry *entry =
       g_slice_new(struct _openslide_cache_entry);
@@ -332,78 +1176,81 @@ void _openslide_cache_put(struct _openslide_cache_binding *cb,
   g_atomic_int_set(&entry->refcount, 1);
   entry->data = data;
   entry->size = size_in_bytes;
+  // take over the pool ref recorded when the buffer was allocated; the
+  // binding may have been rebound since, so this is not always
+  // cache->pool
+  entry->pool = tile_buffer_take_pool(data);
   *_entry = entry;
 
-  // get cache and lock
-#if !GLIB_CHECK_VERSION(2,31,0)
-  g_mutex_lock(cb->mutex);
-#else
-  g_mutex_lock(&cb->mutex);
-#endif
-  openslide_cache_t *cache = cb->cache;
-#if !GLIB_CHECK_VERSION(2,31,0)
-  g_mutex_lock(cache->mutex);
-#else
-  g_mutex_lock(&cache->mutex);
-#endif
+  // create key
+  struct _openslide_cache_key *key = g_slice_new(struct _openslide_cache_key);
+  key->binding_id = binding_id;
+  key->plane = plane;
+  key->x = x;
+  key->y = y;
+  key->channel = channel;
 
-  // don't try to put anything in the cache that cannot possibly fit
+  struct _openslide_cache_shard *shard = shard_for_key(cache, key);
+  shard_lock(shard);
+
+  // don't try to put anything in the cache that cannot possibly fit.
+  // Entries larger than the shard share but within the whole-cache
+  // capacity (e.g. decoded associated images) are still admitted: the
+  // shard temporarily exceeds its 1/CACHE_SHARD_COUNT target and later
+  // evictions drive it back
   if (size_in_bytes > cache->capacity) {
     //g_debug("refused %p", entry);
-#if !GLIB_CHECK_VERSION(2,31,0)
-    g_mutex_unlock(cache->mutex);
-#else
-    g_mutex_unlock(&cache->mutex);
-#endif
+    shard_unlock(shard);
     _openslide_performance_warn_once(&cache->warned_overlarge_entry,
                                      "Rejecting overlarge cache entry of "
                                      "size %"PRIu64" bytes", size_in_bytes);
-#if !GLIB_CHECK_VERSION(2,31,0)
-    g_mutex_unlock(cb->mutex);
-#else
-    g_mutex_unlock(&cb->mutex);
-#endif
+    g_slice_free(struct _openslide_cache_key, key);
+    account_unref(account);
+    cache_unref(cache);
     return;
   }
 
-  possibly_evict(cache, size_in_bytes); // already checks for wraparound
-
-  // create key
-  struct _openslide_cache_key *key = g_slice_new(struct _openslide_cache_key);
-  key->binding_id = cb->id;
-  key->plane = plane;
-  key->x = x;
-  key->y = y;
-  key->channel = channel;
+  // already checks for wraparound
+  possibly_evict(cache, shard, size_in_bytes, account);
 
   // create value
   struct _openslide_cache_value *value =
     g_slice_new(struct _openslide_cache_value);
   value->key = key;
-  value->cache = cache;
+  value->shard = shard;
   value->entry = entry;
+  value->account = account;  // transfer the reference
 
-  // insert at head of queue
-  g_queue_push_head(cache->list, value);
-  value->link = g_queue_peek_head_link(cache->list);
+  // credit the binding's account
+  G_LOCK(accounts);
+  account->bytes += size_in_bytes;
+  G_UNLOCK(accounts);
+
+  // new entries always start in the probationary segment
+  g_queue_push_head(shard->list, value);
+  value->link = g_queue_peek_head_link(shard->list);
+  value->list = shard->list;
 
   // insert into hash table
-  g_hash_table_replace(cache->hashtable, key, value);
+  g_hash_table_replace(shard->hashtable, key, value);
 
   // increase size
-  cache->total_size += size_in_bytes;
+  shard->total_size += size_in_bytes;
+  shard->insertions++;
 
   // another ref for the cache
   g_atomic_int_inc(&entry->refcount);
 
   // unlock
-#if !GLIB_CHECK_VERSION(2,31,0)
-  g_mutex_unlock(cache->mutex);
-  g_mutex_unlock(cb->mutex);
-#else
-  g_mutex_unlock(&cache->mutex);
-  g_mutex_unlock(&cb->mutex);
-#endif
+  shard_unlock(shard);
+  cache_unref(cache);
+
+  // capture is rare; skip the binding mutex unless armed
+  if (g_atomic_int_get(&cb->capture_armed)) {
+    binding_lock(cb);
+    possibly_capture(cb, entry);
+    binding_unlock(cb);
+  }
 
   //g_debug("insert %p", entry);
 }
@@ -415,75 +1262,272 @@ void *_openslide_cache_get(struct _openslide_cache_binding *cb,
          int64_t y,
          int64_t channel,
          struct _openslide_cache_entry **_entry) {
-  // get cache and lock
-#if !GLIB_CHECK_VERSION(2,31,0)
-  g_mutex_lock(cb->mutex);
-#else
-  g_mutex_lock(&cb->mutex);
-#endif
-  openslide_cache_t *cache = cb->cache;
-#if !GLIB_CHECK_VERSION(2,31,0)
-  g_mutex_lock(cache->mutex);
-#else
-  g_mutex_lock(&cache->mutex);
-#endif
+  // get cache
+  uint64_t binding_id;
+  openslide_cache_t *cache = binding_get_cache(cb, &binding_id);
 
   // create key
   struct _openslide_cache_key key = {
-    .binding_id = cb->id,
+    .binding_id = binding_id,
     .plane = plane,
     .x = x,
     .y = y,
     .channel = channel
   };
 
+  struct _openslide_cache_shard *shard = shard_for_key(cache, &key);
+  shard_lock(shard);
+
   // lookup key, maybe return NULL
-  struct _openslide_cache_value *value = g_hash_table_lookup(cache->hashtable,
+  struct _openslide_cache_value *value = g_hash_table_lookup(shard->hashtable,
                    &key);
   if (value == NULL) {
-#if !GLIB_CHECK_VERSION(2,31,0)
-    g_mutex_unlock(cache->mutex);
-    g_mutex_unlock(cb->mutex);
-#else
-    g_mutex_unlock(&cache->mutex);
-    g_mutex_unlock(&cb->mutex);
-#endif
+    shard->misses++;
+    shard_unlock(shard);
+    cache_unref(cache);
+
+    counter_inc(&cb->misses);
+
     *_entry = NULL;
     return NULL;
   }
 
-  // if found, move to front of list
-  GList *link = value->link;
-  g_queue_unlink(cache->list, link);
-  g_queue_push_head_link(cache->list, link);
+  // if found, promote according to the cache policy
+  promote_value(cache, shard, value);
 
   // acquire entry reference for the caller
   struct _openslide_cache_entry *entry = value->entry;
   g_atomic_int_inc(&entry->refcount);
+  shard->hits++;
 
-  //g_debug("cache hit! %p %"PRIu64" %p %"PRId64" %"PRId64, (void *) entry, cb->id, (void *) plane, x, y);
+  //g_debug("cache hit! %p %"PRIu64" %p %"PRId64" %"PRId64, (void *) entry, binding_id, (void *) plane, x, y);
 
   // unlock
-#if !GLIB_CHECK_VERSION(2,31,0)
-  g_mutex_unlock(cache->mutex);
-  g_mutex_unlock(cb->mutex);
-#else
-  g_mutex_unlock(&cache->mutex);
-  g_mutex_unlock(&cb->mutex);
-#endif
+  shard_unlock(shard);
+  cache_unref(cache);
+
+  counter_inc(&cb->hits);
+  // capture is rare; skip the binding mutex unless armed
+  if (g_atomic_int_get(&cb->capture_armed)) {
+    binding_lock(cb);
+    possibly_capture(cb, entry);
+    binding_unlock(cb);
+  }
 
   // return data
   *_entry = entry;
   return entry->data;
 }
 
+// compressed second tier
+//
+// The tier holds original tile bitstreams, which are 10-20x smaller
+// than the decoded pixels, so tiles aged out of the decoded tier
+// usually survive here and a later touch costs one re-decode from RAM
+// instead of a trip back to storage.  Backends that can produce a
+// standalone bitstream feed the tier at decode time and consult it on
+// decoded-tier misses; everything else is unaffected.
+
+bool _openslide_cache_has_compressed_tier(struct _openslide_cache_binding *cb) {
+  uint64_t binding_id;
+  openslide_cache_t *cache = binding_get_cache(cb, &binding_id);
+  // immutable after create, so no lock
+  bool enabled = cache->compressed_capacity > 0;
+  cache_unref(cache);
+  return enabled;
+}
+
+// takes ownership of data, which must have been allocated with
+// g_malloc(); codec is copied by interning
+void _openslide_cache_put_compressed(struct _openslide_cache_binding *cb,
+                                     void *plane,
+                                     int64_t x,
+                                     int64_t y,
+                                     int64_t channel,
+                                     uint8_t *data,
+                                     int64_t len,
+                                     const char *codec) {
+  uint64_t binding_id;
+  openslide_cache_t *cache = binding_get_cache(cb, &binding_id);
+
+  // tier disabled, or a bitstream that could never fit
+  if (cache->compressed_capacity == 0 ||
+      (uint64_t) len > cache->compressed_capacity) {
+    g_free(data);
+    cache_unref(cache);
+    return;
+  }
+
+  // create key
+  struct _openslide_cache_key *key = g_slice_new(struct _openslide_cache_key);
+  key->binding_id = binding_id;
+  key->plane = plane;
+  key->x = x;
+  key->y = y;
+  key->channel = channel;
+
+  compressed_lock(cache);
+
+  if (g_hash_table_lookup(cache->compressed_table, key)) {
+    // racing insert of the same tile; the resident copy wins
+    compressed_unlock(cache);
+    g_slice_free(struct _openslide_cache_key, key);
+    g_free(data);
+    cache_unref(cache);
+    return;
+  }
+
+  // make room
+  while (cache->compressed_size + len > cache->compressed_capacity) {
+    struct compressed_value *oldest = g_queue_peek_tail(cache->compressed_list);
+    g_hash_table_remove(cache->compressed_table, oldest->key);
+  }
+
+  // create value
+  struct compressed_value *value = g_slice_new(struct compressed_value);
+  value->key = key;
+  value->cache = cache;
+  value->data = data;
+  value->len = len;
+  value->codec = g_intern_string(codec);
+
+  // insert
+  g_queue_push_head(cache->compressed_list, value);
+  value->link = g_queue_peek_head_link(cache->compressed_list);
+  g_hash_table_replace(cache->compressed_table, key, value);
+  cache->compressed_size += len;
+
+  compressed_unlock(cache);
+  cache_unref(cache);
+}
+
+// returns a copy of the stored bitstream, to be freed with g_free(), or
+// NULL.  *codec points to an interned string and remains valid after
+// the tier drops the tile.
+uint8_t *_openslide_cache_get_compressed(struct _openslide_cache_binding *cb,
+                                         void *plane,
+                                         int64_t x,
+                                         int64_t y,
+                                         int64_t channel,
+                                         int64_t *len,
+                                         const char **codec) {
+  uint64_t binding_id;
+  openslide_cache_t *cache = binding_get_cache(cb, &binding_id);
+  if (cache->compressed_capacity == 0) {
+    cache_unref(cache);
+    return NULL;
+  }
+
+  // create key
+  struct _openslide_cache_key key = {
+    .binding_id = binding_id,
+    .plane = plane,
+    .x = x,
+    .y = y,
+    .channel = channel
+  };
+
+  compressed_lock(cache);
+
+  // lookup key, maybe return NULL
+  struct compressed_value *value = g_hash_table_lookup(cache->compressed_table,
+                                                       &key);
+  if (value == NULL) {
+    compressed_unlock(cache);
+    cache_unref(cache);
+    return NULL;
+  }
+
+  // keep the bitstream resident and move it to the LRU head: the caller
+  // is about to re-insert the decoded pixels, and when those age out
+  // again this copy is still the cheapest way back
+  g_queue_unlink(cache->compressed_list, value->link);
+  g_queue_push_head_link(cache->compressed_list, value->link);
+
+  uint8_t *data = g_malloc(value->len);
+  memcpy(data, value->data, value->len);
+  *len = value->len;
+  *codec = value->codec;
+
+  compressed_unlock(cache);
+  cache_unref(cache);
+  return data;
+}
+
+// statistics
+
+void _openslide_cache_get_stats(openslide_cache_t *cache,
+                                uint64_t *hits, uint64_t *misses,
+                                uint64_t *insertions, uint64_t *evictions,
+                                uint64_t *bytes, uint64_t *entries) {
+  uint64_t counts[6] = { 0 };
+
+  for (int i = 0; i < CACHE_SHARD_COUNT; i++) {
+    struct _openslide_cache_shard *shard = &cache->shards[i];
+    shard_lock(shard);
+    counts[0] += shard->hits;
+    counts[1] += shard->misses;
+    counts[2] += shard->insertions;
+    counts[3] += shard->evictions;
+    counts[4] += shard->total_size;
+    counts[5] += g_hash_table_size(shard->hashtable);
+    shard_unlock(shard);
+  }
+
+  if (hits) {
+    *hits = counts[0];
+  }
+  if (misses) {
+    *misses = counts[1];
+  }
+  if (insertions) {
+    *insertions = counts[2];
+  }
+  if (evictions) {
+    *evictions = counts[3];
+  }
+  if (bytes) {
+    *bytes = counts[4];
+  }
+  if (entries) {
+    *entries = counts[5];
+  }
+}
+
+void _openslide_cache_binding_get_stats(struct _openslide_cache_binding *cb,
+                                        uint64_t *hits, uint64_t *misses) {
+  if (hits) {
+    *hits = counter_read(&cb->hits);
+  }
+  if (misses) {
+    *misses = counter_read(&cb->misses);
+  }
+}
+
+void _openslide_cache_binding_set_quota(struct _openslide_cache_binding *cb,
+                                        uint64_t quota) {
+  binding_lock(cb);
+  G_LOCK(accounts);
+  cb->account->quota = quota;
+  G_UNLOCK(accounts);
+  binding_unlock(cb);
+}
+
+uint64_t _openslide_cache_binding_get_usage(struct _openslide_cache_binding *cb) {
+  binding_lock(cb);
+  uint64_t bytes = account_bytes(cb->account);
+  binding_unlock(cb);
+  return bytes;
+}
+
 // value unref
 void _openslide_cache_entry_unref(struct _openslide_cache_entry *entry) {
   //g_debug("unref %p, refs %d", entry, g_atomic_int_get(&entry->refcount));
 
   if (g_atomic_int_dec_and_test(&entry->refcount)) {
-    // free the data
-    g_slice_free1(entry->size, entry->data);
+    // recycle the data
+    slab_pool_free(entry->pool, entry->size, entry->data);
+    slab_pool_unref(entry->pool);
 
     // free the entry
     g_slice_free(struct _openslide_cache_entry, entry);
@@ -491,3 +1535,29 @@ void _openslide_cache_entry_unref(struct _openslide_cache_entry *entry) {
     //g_debug("free %p", entry);
   }
 }
+
+// tile buffer allocation
+//
+// Buffers destined for _openslide_cache_put() must come from here so
+// the entry can recycle them; buffers that fail to fill are returned
+// with _openslide_cache_tile_free().
+void *_openslide_cache_tile_alloc(struct _openslide_cache_binding *cb,
+                                  uint64_t size) {
+  uint64_t binding_id;
+  openslide_cache_t *cache = binding_get_cache(cb, &binding_id);
+  struct slab_pool *pool = cache->pool;
+  slab_pool_ref(pool);
+  void *buf = slab_pool_alloc(pool, size);
+  tile_buffer_register(buf, pool);
+  cache_unref(cache);
+  return buf;
+}
+
+void _openslide_cache_tile_free(struct _openslide_cache_binding *cb G_GNUC_UNUSED,
+                                uint64_t size, void *data) {
+  // return the buffer to the pool it was allocated from, which is not
+  // necessarily the binding's current pool after a rebind
+  struct slab_pool *pool = tile_buffer_take_pool(data);
+  slab_pool_free(pool, size, data);
+  slab_pool_unref(pool);
+}
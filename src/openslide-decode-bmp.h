@@ -1,7 +1,7 @@
 /*
  *  OpenSlide, a library for reading whole slide image files
  *
- *  Copyright (c) 2007-2013 Carnegie Mellon University
+ *  Copyright (c) 2007-2015 Carnegie Mellon University
  *  All rights reserved.
  *
  *  OpenSlide is free software: you can redistribute it and/or modify
@@ -19,20 +19,19 @@
  *
  */
 
-#ifndef OPENSLIDE_OPENSLIDE_DECODE_GDKPIXBUF_H_
-#define OPENSLIDE_OPENSLIDE_DECODE_GDKPIXBUF_H_
+#ifndef OPENSLIDE_OPENSLIDE_DECODE_BMP_H_
+#define OPENSLIDE_OPENSLIDE_DECODE_BMP_H_
 
 #include <stdint.h>
 #include <glib.h>
 
-/* Support for formats supported by gdk-pixbuf (BMP, PNM, etc.) */
+/* Direct decode of uncompressed Windows BMP images */
 
-bool _openslide_gdkpixbuf_read(const char *format,
-                               const char *filename,
-                               int64_t offset,
-                               int64_t length,
-                               uint32_t *dest,
-                               int32_t w, int32_t h,
-                               GError **err);
+bool _openslide_bmp_read(const char *filename,
+                         int64_t offset,
+                         int64_t length,
+                         uint32_t *dest,
+                         int32_t w, int32_t h,
+                         GError **err);
 
 #endif
@@ -28,6 +28,7 @@
 
 #include "openslide-private.h"
 #include "openslide-decode-jp2k.h"
+#include "openslide-simd.h"
 
 #include <openjpeg.h>
 
@@ -74,30 +75,12 @@ static void unpack_argb(enum _openslide_jp2k_colorspace space,
       c0_sub_y == 1 && c1_sub_y == 1 && c2_sub_y == 1) {
     // Aperio 33003
     for (int32_t y = 0; y < h; y++) {
-      int32_t c0_row_base = y * comps[0].w;
-      int32_t c1_row_base = y * comps[1].w;
-      int32_t c2_row_base = y * comps[2].w;
-      int32_t x;
-      for (x = 0; x < w - 1; x += 2) {
-        uint8_t c0 = comps[0].data[c0_row_base + x];
-        uint8_t c1 = comps[1].data[c1_row_base + (x / 2)];
-        uint8_t c2 = comps[2].data[c2_row_base + (x / 2)];
-        int16_t R_chroma = _openslide_R_Cr[c2];
-        int16_t G_chroma = (_openslide_G_Cb[c1] + _openslide_G_Cr[c2]) >> 16;
-        int16_t B_chroma = _openslide_B_Cb[c1];
-        write_pixel_ycbcr(dest++, c0, R_chroma, G_chroma, B_chroma);
-        c0 = comps[0].data[c0_row_base + x + 1];
-        write_pixel_ycbcr(dest++, c0, R_chroma, G_chroma, B_chroma);
-      }
-      if (x < w) {
-        uint8_t c0 = comps[0].data[c0_row_base + x];
-        uint8_t c1 = comps[1].data[c1_row_base + (x / 2)];
-        uint8_t c2 = comps[2].data[c2_row_base + (x / 2)];
-        int16_t R_chroma = _openslide_R_Cr[c2];
-        int16_t G_chroma = (_openslide_G_Cb[c1] + _openslide_G_Cr[c2]) >> 16;
-        int16_t B_chroma = _openslide_B_Cb[c1];
-        write_pixel_ycbcr(dest++, c0, R_chroma, G_chroma, B_chroma);
-      }
+      _openslide_simd_ycbcr422_to_argb(dest,
+                                       comps[0].data + y * comps[0].w,
+                                       comps[1].data + y * comps[1].w,
+                                       comps[2].data + y * comps[2].w,
+                                       w);
+      dest += w;
     }
 
   } else if (space == OPENSLIDE_JP2K_YCBCR) {
@@ -130,15 +113,12 @@ static void unpack_argb(enum _openslide_jp2k_colorspace space,
              c0_sub_y == 1 && c1_sub_y == 1 && c2_sub_y == 1) {
     // Aperio 33005
     for (int32_t y = 0; y < h; y++) {
-      int32_t c0_row_base = y * comps[0].w;
-      int32_t c1_row_base = y * comps[1].w;
-      int32_t c2_row_base = y * comps[2].w;
-      for (int32_t x = 0; x < w; x++) {
-        uint8_t c0 = comps[0].data[c0_row_base + x];
-        uint8_t c1 = comps[1].data[c1_row_base + x];
-        uint8_t c2 = comps[2].data[c2_row_base + x];
-        write_pixel_rgb(dest++, c0, c1, c2);
-      }
+      _openslide_simd_rgb_to_argb(dest,
+                                  comps[0].data + y * comps[0].w,
+                                  comps[1].data + y * comps[1].w,
+                                  comps[2].data + y * comps[2].w,
+                                  w);
+      dest += w;
     }
 
   } else if (space == OPENSLIDE_JP2K_RGB) {
@@ -185,6 +165,25 @@ static void error_callback(const char *msg, void *data) {
 
 #ifdef HAVE_OPENJPEG2
 
+// below this size, concurrent decode of independent tiles beats paying
+// OpenJPEG's per-decode thread startup cost
+#define JP2K_THREADED_DECODE_MIN_PIXELS (512 * 512)
+
+#if OPJ_VERSION_MAJOR > 2 || \
+    (OPJ_VERSION_MAJOR == 2 && OPJ_VERSION_MINOR >= 2)
+#define HAVE_OPJ_THREADS 1
+#endif
+
+#ifdef HAVE_OPJ_THREADS
+static int jp2k_decode_threads(void) {
+#if GLIB_CHECK_VERSION(2,36,0)
+  return g_get_num_processors();
+#else
+  return 1;
+#endif
+}
+#endif
+
 static OPJ_SIZE_T read_callback(void *buf, OPJ_SIZE_T count, void *data) {
   struct buffer_state *state = data;
 
@@ -218,17 +217,23 @@ static OPJ_BOOL seek_callback(OPJ_OFF_T offset, void *data) {
   return OPJ_TRUE;
 }
 
-bool _openslide_jp2k_decode_buffer(uint32_t *dest,
-                                   int32_t w, int32_t h,
-                                   void *data, int32_t datalen,
-                                   enum _openslide_jp2k_colorspace space,
-                                   GError **err) {
+bool _openslide_jp2k_decode_buffer_reduced(uint32_t *dest,
+                                           int32_t w, int32_t h,
+                                           void *data, int32_t datalen,
+                                           enum _openslide_jp2k_colorspace space,
+                                           int32_t reduce,
+                                           GError **err) {
   opj_image_t *image = NULL;
   GError *tmp_err = NULL;
   bool success = false;
 
   g_assert(data != NULL);
   g_assert(datalen >= 0);
+  g_assert(reduce >= 0);
+
+  // dimensions of the decoded image after discarding resolution levels
+  int32_t rw = _openslide_jp2k_reduced_dim(w, reduce);
+  int32_t rh = _openslide_jp2k_reduced_dim(h, reduce);
 
   // init stream
   // avoid tracking stream offset (and implementing skip callback) by having
@@ -248,8 +253,24 @@ bool _openslide_jp2k_decode_buffer(uint32_t *dest,
   opj_codec_t *codec = opj_create_decompress(OPJ_CODEC_J2K);
   opj_dparameters_t parameters;
   opj_set_default_decoder_parameters(&parameters);
+  // discard the finest DWT levels rather than decoding coefficients
+  // the caller would downsample away
+  parameters.cp_reduce = reduce;
   opj_setup_decoder(codec, &parameters);
 
+#ifdef HAVE_OPJ_THREADS
+  // enable OpenJPEG's internal threading for large images; small tiles
+  // are better served by decoding several of them concurrently on
+  // separate codec instances
+  if ((int64_t) rw * rh >= JP2K_THREADED_DECODE_MIN_PIXELS &&
+      opj_has_thread_support()) {
+    int threads = jp2k_decode_threads();
+    if (threads > 1) {
+      opj_codec_set_threads(codec, threads);
+    }
+  }
+#endif
+
   // enable error handlers
   // note: don't use info_handler, it outputs lots of junk
   opj_set_warning_handler(codec, warning_callback, &tmp_err);
@@ -267,7 +288,8 @@ bool _openslide_jp2k_decode_buffer(uint32_t *dest,
   }
   g_clear_error(&tmp_err);  // clear any spurious message
 
-  // sanity checks
+  // sanity checks; image dimensions stay in full-resolution coordinates
+  // even when resolution levels are discarded
   if (image->x1 != (OPJ_UINT32) w || image->y1 != (OPJ_UINT32) h) {
     g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
                 "Dimensional mismatch reading JP2K, "
@@ -285,7 +307,9 @@ bool _openslide_jp2k_decode_buffer(uint32_t *dest,
   // TODO more checks?
 
   // decode
+  int64_t perf = _openslide_perf_begin();
   if (!opj_decode(codec, stream, image)) {
+    _openslide_perf_end(_OPENSLIDE_PERF_DECODE, perf);
     if (tmp_err) {
       g_propagate_error(err, tmp_err);
     } else {
@@ -294,27 +318,30 @@ bool _openslide_jp2k_decode_buffer(uint32_t *dest,
     }
     goto DONE;
   }
+  _openslide_perf_end(_OPENSLIDE_PERF_DECODE, perf);
   g_clear_error(&tmp_err);  // clear any spurious message
 
   // copy pixels
+  perf = _openslide_perf_begin();
   if (image->numcomps == 3) {
     // 3-channels image
-    unpack_argb(space, image->comps, dest, w, h);
+    unpack_argb(space, image->comps, dest, rw, rh);
 
   } else if (image->numcomps == 1) { // Fluorescence case
-    int c0_sub_x = w / image->comps[0].w;
-    int c0_sub_y = h / image->comps[0].h;
+    int c0_sub_x = rw / image->comps[0].w;
+    int c0_sub_y = rh / image->comps[0].h;
 
-    for (int32_t y = 0; y < h; ++y) {
+    for (int32_t y = 0; y < rh; ++y) {
       int32_t c0_row_base = (y / c0_sub_y) * image->comps[0].w;
 
-      for (int32_t x = 0; x < w; ++x) {
+      for (int32_t x = 0; x < rw; ++x) {
         uint32_t c0 = image->comps[0].data[c0_row_base + (x / c0_sub_x)];
-        dest[y * w + x] = c0;
+        dest[y * rw + x] = c0;
       }
     }
 
   }
+  _openslide_perf_end(_OPENSLIDE_PERF_CONVERT, perf);
 
   success = true;
 
@@ -327,16 +354,22 @@ DONE:
 
 #else  // HAVE_OPENJPEG2
 
-bool _openslide_jp2k_decode_buffer(uint32_t *dest,
-                                   int32_t w, int32_t h,
-                                   void *data, int32_t datalen,
-                                   enum _openslide_jp2k_colorspace space,
-                                   GError **err) {
+bool _openslide_jp2k_decode_buffer_reduced(uint32_t *dest,
+                                           int32_t w, int32_t h,
+                                           void *data, int32_t datalen,
+                                           enum _openslide_jp2k_colorspace space,
+                                           int32_t reduce,
+                                           GError **err) {
   GError *tmp_err = NULL;
   bool success = false;
 
   // opj_cio_open interprets a NULL buffer as opening for write
   g_assert(data != NULL);
+  g_assert(reduce >= 0);
+
+  // dimensions of the decoded image after discarding resolution levels
+  int32_t rw = _openslide_jp2k_reduced_dim(w, reduce);
+  int32_t rh = _openslide_jp2k_reduced_dim(h, reduce);
 
   // init decompressor
   opj_cio_t *stream = NULL;
@@ -352,12 +385,17 @@ bool _openslide_jp2k_decode_buffer(uint32_t *dest,
   opj_dparameters_t parameters;
   dinfo = opj_create_decompress(CODEC_J2K);
   opj_set_default_decoder_parameters(&parameters);
+  // discard the finest DWT levels rather than decoding coefficients
+  // the caller would downsample away
+  parameters.cp_reduce = reduce;
   opj_setup_decoder(dinfo, &parameters);
   stream = opj_cio_open((opj_common_ptr) dinfo, data, datalen);
   opj_set_event_mgr((opj_common_ptr) dinfo, &event_callbacks, &tmp_err);
 
   // decode
+  int64_t perf = _openslide_perf_begin();
   image = opj_decode(dinfo, stream);
+  _openslide_perf_end(_OPENSLIDE_PERF_DECODE, perf);
 
   // check error
   if (tmp_err) {
@@ -386,7 +424,8 @@ bool _openslide_jp2k_decode_buffer(uint32_t *dest,
     goto DONE;
   }
 
-  // sanity checks
+  // sanity checks; image dimensions stay in full-resolution coordinates
+  // even when resolution levels are discarded
   if (image->x1 != w || image->y1 != h) {
     g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
                 "Dimensional mismatch reading JP2K, "
@@ -405,24 +444,26 @@ bool _openslide_jp2k_decode_buffer(uint32_t *dest,
   // TODO more checks?
 
   // copy pixels
+  perf = _openslide_perf_begin();
   if (image->numcomps == 3) {
     // 3-channels image
-    unpack_argb(space, image->comps, dest, w, h);
+    unpack_argb(space, image->comps, dest, rw, rh);
 
   } else if (image->numcomps == 1) { // Fluorescence case
-    int c0_sub_x = w / image->comps[0].w;
-    int c0_sub_y = h / image->comps[0].h;
+    int c0_sub_x = rw / image->comps[0].w;
+    int c0_sub_y = rh / image->comps[0].h;
 
-    for (int32_t y = 0; y < h; ++y) {
+    for (int32_t y = 0; y < rh; ++y) {
       int32_t c0_row_base = (y / c0_sub_y) * image->comps[0].w;
 
-      for (int32_t x = 0; x < w; ++x) {
+      for (int32_t x = 0; x < rw; ++x) {
         uint32_t c0 = image->comps[0].data[c0_row_base + (x / c0_sub_x)];
-        dest[y * w + x] = c0;
+        dest[y * rw + x] = c0;
       }
     }
 
   }
+  _openslide_perf_end(_OPENSLIDE_PERF_CONVERT, perf);
 
   success = true;
 
@@ -440,3 +481,12 @@ DONE:
 }
 
 #endif // HAVE_OPENJPEG2
+
+bool _openslide_jp2k_decode_buffer(uint32_t *dest,
+                                   int32_t w, int32_t h,
+                                   void *data, int32_t datalen,
+                                   enum _openslide_jp2k_colorspace space,
+                                   GError **err) {
+  return _openslide_jp2k_decode_buffer_reduced(dest, w, h, data, datalen,
+                                               space, 0, err);
+}
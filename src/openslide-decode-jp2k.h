@@ -38,4 +38,23 @@ bool _openslide_jp2k_decode_buffer(uint32_t *dest,
                                    enum _openslide_jp2k_colorspace space,
                                    GError **err);
 
+// compute the pixel dimension of a full-resolution dimension after
+// discarding the given number of DWT resolution levels
+static inline int32_t _openslide_jp2k_reduced_dim(int32_t dim,
+                                                  int32_t reduce) {
+  return (dim + (1 << reduce) - 1) >> reduce;
+}
+
+// decode at reduced resolution by discarding DWT resolution levels.
+// w and h are the full-resolution codestream dimensions; dest must hold
+// _openslide_jp2k_reduced_dim(w, reduce) *
+// _openslide_jp2k_reduced_dim(h, reduce) pixels.  reduce must not
+// exceed the number of resolution levels in the codestream.
+bool _openslide_jp2k_decode_buffer_reduced(uint32_t *dest,
+                                           int32_t w, int32_t h,
+                                           void *data, int32_t datalen,
+                                           enum _openslide_jp2k_colorspace space,
+                                           int32_t reduce,
+                                           GError **err);
+
 #endif
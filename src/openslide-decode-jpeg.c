@@ -32,6 +32,7 @@
 #include <setjmp.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <jpeglib.h>
 #include <jerror.h>
 
@@ -41,6 +42,10 @@
 #define JCS_EXT_ARGB 15
 #endif
 
+#if !GLIB_CHECK_VERSION(2,22,0)
+#define g_mapped_file_unref g_mapped_file_free
+#endif
+
 static const uint8_t one_pixel_rgb_jpeg[] = {
   0xff, 0xd8, 0xff, 0xdb, 0x00, 0x43, 0x00, 0x08, 0x06, 0x06, 0x07, 0x06,
   0x05, 0x08, 0x07, 0x07, 0x07, 0x09, 0x09, 0x08, 0x0a, 0x0c, 0x14, 0x0d,
@@ -70,8 +75,46 @@ struct _openslide_jpeg_decompress {
   struct openslide_jpeg_error_mgr jerr;
   JSAMPROW rows[MAX_SAMP_FACTOR];
   gsize allocated_row_size;
+  bool created;  // jpeg_create_decompress() has completed
+};
+
+// Each thread keeps one decompress context for reuse.
+// jpeg_create_decompress() and the permanent-pool allocations behind it
+// are measurable at high tile rates; jpeg_abort_decompress() resets
+// state between images while keeping the object.
+struct context_slot {
+  struct _openslide_jpeg_decompress *dc;
 };
 
+static void context_slot_free(gpointer data) {
+  struct context_slot *slot = data;
+  if (slot->dc) {
+    jpeg_destroy_decompress(&slot->dc->cinfo);
+    g_slice_free(struct _openslide_jpeg_decompress, slot->dc);
+  }
+  g_free(slot);
+}
+
+#if GLIB_CHECK_VERSION(2,32,0)
+static GPrivate context_slot_key = G_PRIVATE_INIT(context_slot_free);
+#define context_slot_key_get() g_private_get(&context_slot_key)
+#define context_slot_key_set(v) g_private_set(&context_slot_key, v)
+#else
+static GStaticPrivate context_slot_key = G_STATIC_PRIVATE_INIT;
+#define context_slot_key_get() g_static_private_get(&context_slot_key)
+#define context_slot_key_set(v) g_static_private_set(&context_slot_key, v, \
+                                                     context_slot_free)
+#endif
+
+static struct context_slot *get_context_slot(void) {
+  struct context_slot *slot = context_slot_key_get();
+  if (slot == NULL) {
+    slot = g_new0(struct context_slot, 1);
+    context_slot_key_set(slot);
+  }
+  return slot;
+}
+
 struct associated_image {
   struct _openslide_associated_image base;
   char *filename;
@@ -158,7 +201,14 @@ static void *detect_jcs_alpha_extensions(void *arg G_GNUC_UNUSED) {
 // the caller must assign the struct _openslide_jpeg_decompress * before
 // calling setjmp() so that nothing will be clobbered by a longjmp()
 struct _openslide_jpeg_decompress *_openslide_jpeg_decompress_create(struct jpeg_decompress_struct **out_cinfo) {
-  struct _openslide_jpeg_decompress *dc = g_slice_new0(struct _openslide_jpeg_decompress);
+  // reuse this thread's cached context if available
+  struct context_slot *slot = get_context_slot();
+  struct _openslide_jpeg_decompress *dc = slot->dc;
+  if (dc) {
+    slot->dc = NULL;
+  } else {
+    dc = g_slice_new0(struct _openslide_jpeg_decompress);
+  }
   *out_cinfo = &dc->cinfo;
   return dc;
 }
@@ -167,7 +217,10 @@ struct _openslide_jpeg_decompress *_openslide_jpeg_decompress_create(struct jpeg
 void _openslide_jpeg_decompress_init(struct _openslide_jpeg_decompress *dc,
                                      jmp_buf *env) {
   dc->cinfo.err = error_handler_init(&dc->jerr, env);
-  jpeg_create_decompress(&dc->cinfo);
+  if (!dc->created) {
+    jpeg_create_decompress(&dc->cinfo);
+    dc->created = true;
+  }
 }
 
 bool _openslide_jpeg_decompress_run(struct _openslide_jpeg_decompress *dc,
@@ -258,6 +311,21 @@ bool _openslide_jpeg_decompress_run(struct _openslide_jpeg_decompress *dc,
   return true;
 }
 
+// prepare dc for another jpeg_read_header()/_run() cycle, keeping the
+// libjpeg object (and any tables loaded from a tables-only datastream,
+// which live in the permanent pool) for the next image
+void _openslide_jpeg_decompress_reset(struct _openslide_jpeg_decompress *dc) {
+  g_assert(dc->jerr.err == NULL);
+  if (dc->allocated_row_size) {
+    for (uint32_t row = 0; row < G_N_ELEMENTS(dc->rows); row++) {
+      g_slice_free1(dc->allocated_row_size, dc->rows[row]);
+    }
+    dc->allocated_row_size = 0;
+  }
+  memset(dc->rows, 0, sizeof(dc->rows));
+  jpeg_abort_decompress(&dc->cinfo);
+}
+
 void _openslide_jpeg_propagate_error(GError **err,
                                      struct _openslide_jpeg_decompress *dc) {
   g_propagate_error(err, dc->jerr.err);
@@ -265,14 +333,25 @@ void _openslide_jpeg_propagate_error(GError **err,
 }
 
 void _openslide_jpeg_decompress_destroy(struct _openslide_jpeg_decompress *dc) {
-  jpeg_destroy_decompress(&dc->cinfo);
   g_assert(dc->jerr.err == NULL);
   if (dc->allocated_row_size) {
     for (uint32_t row = 0; row < G_N_ELEMENTS(dc->rows); row++) {
       g_slice_free1(dc->allocated_row_size, dc->rows[row]);
     }
+    dc->allocated_row_size = 0;
+  }
+  memset(dc->rows, 0, sizeof(dc->rows));
+
+  struct context_slot *slot = get_context_slot();
+  if (dc->created && slot->dc == NULL) {
+    // release per-image state but keep the object for this thread's
+    // next decode; safe even after a longjmp mid-decode
+    jpeg_abort_decompress(&dc->cinfo);
+    slot->dc = dc;
+  } else {
+    jpeg_destroy_decompress(&dc->cinfo);
+    g_slice_free(struct _openslide_jpeg_decompress, dc);
   }
-  g_slice_free(struct _openslide_jpeg_decompress, dc);
 }
 
 static bool jpeg_get_dimensions(FILE *f,  // or:
@@ -351,6 +430,7 @@ static bool jpeg_decode(FILE *f,  // or:
                         GError **err) {
   volatile bool result = false;
   jmp_buf env;
+  int64_t perf = _openslide_perf_begin();
 
   struct jpeg_decompress_struct *cinfo;
   struct _openslide_jpeg_decompress *dc =
@@ -385,6 +465,7 @@ static bool jpeg_decode(FILE *f,  // or:
 
 DONE:
   _openslide_jpeg_decompress_destroy(dc);
+  _openslide_perf_end(_OPENSLIDE_PERF_DECODE, perf);
 
   return result;
 }
@@ -396,6 +477,24 @@ bool _openslide_jpeg_read(const char *filename,
                           GError **err) {
   //g_debug("read JPEG: %s %"PRId64, filename, offset);
 
+  // map the file if we can; the memory source then hands libjpeg
+  // pointers directly into the mapping, with no reads or copies on the
+  // decode path
+  GMappedFile *mapped = g_mapped_file_new(filename, false, NULL);
+  if (mapped) {
+    gsize len = g_mapped_file_get_length(mapped);
+    if ((uint64_t) offset < len) {
+      bool success = jpeg_decode(NULL,
+                                 g_mapped_file_get_contents(mapped) + offset,
+                                 MIN(len - offset, UINT32_MAX),
+                                 dest, false, w, h, err);
+      g_mapped_file_unref(mapped);
+      return success;
+    }
+    // fall back for consistent error handling
+    g_mapped_file_unref(mapped);
+  }
+
   FILE *f = _openslide_fopen(filename, "rb", err);
   if (f == NULL) {
     return false;
@@ -94,6 +94,8 @@ bool _openslide_jpeg_decompress_run(struct _openslide_jpeg_decompress *dc,
                                     int32_t w, int32_t h,
                                     GError **err);
 
+void _openslide_jpeg_decompress_reset(struct _openslide_jpeg_decompress *dc);
+
 void _openslide_jpeg_propagate_error(GError **err,
                                      struct _openslide_jpeg_decompress *dc);
 
@@ -30,6 +30,14 @@
 #define BUSY_TIMEOUT 500  // ms
 #define PROFILE 0
 
+// map the database read-only into the process so page reads bypass the
+// read() copy; ignored (harmlessly) by SQLite < 3.7.17
+#define MMAP_SIZE "1073741824"
+
+// connections kept idle for reuse; concurrent paints beyond this open
+// and close their own
+#define POOL_MAX_IDLE 8
+
 /* Can only use API supported in SQLite 3.6.20 for RHEL 6 compatibility */
 
 #if PROFILE
@@ -68,6 +76,9 @@ static sqlite3 *do_open(const char *filename, int flags, GError **err) {
 
   sqlite3_busy_timeout(db, BUSY_TIMEOUT);
 
+  // best-effort; unknown or unsupported pragmas are ignored
+  sqlite3_exec(db, "PRAGMA mmap_size=" MMAP_SIZE ";", NULL, NULL, NULL);
+
 #if PROFILE
   sqlite3_profile(db, profile_callback, NULL);
 #endif
@@ -134,3 +145,137 @@ void _openslide_sqlite_close(sqlite3 *db) {
   }
 }
 #define sqlite3_close _OPENSLIDE_POISON(_openslide_sqlite_close)
+
+// connection pool
+//
+// Opening the database and re-preparing queries on every paint is the
+// dominant cost on statement-per-tile formats.  The pool reuses idle
+// connections across paints -- effectively one connection per
+// concurrently-painting thread -- and each connection caches its
+// prepared statements keyed by SQL text, so the hot path is reduced to
+// reset/bind/step.
+
+struct _openslide_sqlite_conn {
+  sqlite3 *db;
+  GHashTable *stmts;  // SQL text -> sqlite3_stmt, owned by the conn
+};
+
+struct _openslide_sqlite_pool {
+#if !GLIB_CHECK_VERSION(2,31,0)
+  GMutex *mutex;
+#else
+  GMutex mutex;
+#endif
+  char *filename;
+  GQueue *idle;  // struct _openslide_sqlite_conn
+};
+
+static void stmt_destroy(gpointer data) {
+  sqlite3_finalize(data);
+}
+
+static void conn_destroy(struct _openslide_sqlite_conn *conn) {
+  // statements must go before the connection
+  g_hash_table_unref(conn->stmts);
+  _openslide_sqlite_close(conn->db);
+  g_slice_free(struct _openslide_sqlite_conn, conn);
+}
+
+struct _openslide_sqlite_pool *_openslide_sqlite_pool_create(const char *filename) {
+  struct _openslide_sqlite_pool *pool =
+    g_slice_new0(struct _openslide_sqlite_pool);
+#if !GLIB_CHECK_VERSION(2,31,0)
+  pool->mutex = g_mutex_new();
+#else
+  g_mutex_init(&pool->mutex);
+#endif
+  pool->filename = g_strdup(filename);
+  pool->idle = g_queue_new();
+  return pool;
+}
+
+void _openslide_sqlite_pool_destroy(struct _openslide_sqlite_pool *pool) {
+  struct _openslide_sqlite_conn *conn;
+  while ((conn = g_queue_pop_head(pool->idle))) {
+    conn_destroy(conn);
+  }
+  g_queue_free(pool->idle);
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_free(pool->mutex);
+#else
+  g_mutex_clear(&pool->mutex);
+#endif
+  g_free(pool->filename);
+  g_slice_free(struct _openslide_sqlite_pool, pool);
+}
+
+struct _openslide_sqlite_conn *_openslide_sqlite_pool_get(struct _openslide_sqlite_pool *pool,
+                                                          GError **err) {
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_lock(pool->mutex);
+  struct _openslide_sqlite_conn *conn = g_queue_pop_head(pool->idle);
+  g_mutex_unlock(pool->mutex);
+#else
+  g_mutex_lock(&pool->mutex);
+  struct _openslide_sqlite_conn *conn = g_queue_pop_head(pool->idle);
+  g_mutex_unlock(&pool->mutex);
+#endif
+  if (conn) {
+    return conn;
+  }
+
+  sqlite3 *db = _openslide_sqlite_open(pool->filename, err);
+  if (!db) {
+    return NULL;
+  }
+  conn = g_slice_new0(struct _openslide_sqlite_conn);
+  conn->db = db;
+  conn->stmts = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                      g_free, stmt_destroy);
+  return conn;
+}
+
+void _openslide_sqlite_pool_put(struct _openslide_sqlite_pool *pool,
+                                struct _openslide_sqlite_conn *conn) {
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_lock(pool->mutex);
+  if (pool->idle->length < POOL_MAX_IDLE) {
+    g_queue_push_head(pool->idle, conn);
+    conn = NULL;
+  }
+  g_mutex_unlock(pool->mutex);
+#else
+  g_mutex_lock(&pool->mutex);
+  if (pool->idle->length < POOL_MAX_IDLE) {
+    g_queue_push_head(pool->idle, conn);
+    conn = NULL;
+  }
+  g_mutex_unlock(&pool->mutex);
+#endif
+  if (conn) {
+    conn_destroy(conn);
+  }
+}
+
+sqlite3 *_openslide_sqlite_conn_db(struct _openslide_sqlite_conn *conn) {
+  return conn->db;
+}
+
+// returns a statement owned by the connection; do not finalize it.
+// The statement comes back reset with bindings cleared, ready to bind.
+sqlite3_stmt *_openslide_sqlite_conn_prepare(struct _openslide_sqlite_conn *conn,
+                                             const char *sql,
+                                             GError **err) {
+  sqlite3_stmt *stmt = g_hash_table_lookup(conn->stmts, sql);
+  if (stmt) {
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    return stmt;
+  }
+
+  stmt = _openslide_sqlite_prepare(conn->db, sql, err);
+  if (stmt) {
+    g_hash_table_insert(conn->stmts, g_strdup(sql), stmt);
+  }
+  return stmt;
+}
@@ -36,4 +36,20 @@ void _openslide_sqlite_propagate_error(sqlite3 *db, GError **err);
 void _openslide_sqlite_propagate_stmt_error(sqlite3_stmt *stmt, GError **err);
 void _openslide_sqlite_close(sqlite3 *db);
 
+/* Connection pool with per-connection prepared-statement cache */
+
+struct _openslide_sqlite_pool;
+struct _openslide_sqlite_conn;
+
+struct _openslide_sqlite_pool *_openslide_sqlite_pool_create(const char *filename);
+void _openslide_sqlite_pool_destroy(struct _openslide_sqlite_pool *pool);
+struct _openslide_sqlite_conn *_openslide_sqlite_pool_get(struct _openslide_sqlite_pool *pool,
+                                                          GError **err);
+void _openslide_sqlite_pool_put(struct _openslide_sqlite_pool *pool,
+                                struct _openslide_sqlite_conn *conn);
+sqlite3 *_openslide_sqlite_conn_db(struct _openslide_sqlite_conn *conn);
+sqlite3_stmt *_openslide_sqlite_conn_prepare(struct _openslide_sqlite_conn *conn,
+                                             const char *sql,
+                                             GError **err);
+
 #endif
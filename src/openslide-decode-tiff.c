@@ -40,6 +40,10 @@
 
 #define HANDLE_CACHE_MAX 32
 
+// number of TIFF handles to open eagerly when a tiffcache is created,
+// so threads don't each pay the full directory scan on first touch
+#define HANDLE_PREWARM_ENV "OPENSLIDE_TIFF_PREWARM"
+
 struct _openslide_tiffcache {
   char *filename;
   GQueue *cache;
@@ -49,8 +53,31 @@ struct _openslide_tiffcache {
   GMutex lock;
 #endif
   int outstanding;
+  // I/O policy captured from the opening thread, so reads issued from
+  // worker threads keep honoring openslide_open_with_options() flags
+  int32_t io_policy;
 };
 
+// the handle pool lock serializes every concurrent tile read on a
+// slide; credit acquisition wait to the lock-wait timing stage
+static void tiffcache_lock(struct _openslide_tiffcache *tc) {
+  int64_t perf = _openslide_perf_begin();
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_lock(tc->lock);
+#else
+  g_mutex_lock(&tc->lock);
+#endif
+  _openslide_perf_end(_OPENSLIDE_PERF_TIFFCACHE_LOCK, perf);
+}
+
+static void tiffcache_unlock(struct _openslide_tiffcache *tc) {
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_unlock(tc->lock);
+#else
+  g_mutex_unlock(&tc->lock);
+#endif
+}
+
 // not thread-safe, like libtiff
 struct tiff_file_handle {
   struct _openslide_tiffcache *tc;
@@ -306,11 +333,13 @@ bool _openslide_tiff_read_tile(struct _openslide_tiff_level *tiffl,
     }
 
     // decompress
+    int64_t perf = _openslide_perf_begin();
     bool ret = decode_jpeg(buf, buflen, tables, tables_len,
                            tiffl->photometric == PHOTOMETRIC_YCBCR ? JCS_YCbCr : JCS_RGB,
                            dest,
                            tiffl->tile_w, tiffl->tile_h,
                            err);
+    _openslide_perf_end(_OPENSLIDE_PERF_DECODE, perf);
     g_free(buf);
     return ret;
   } else {
@@ -318,9 +347,14 @@ bool _openslide_tiff_read_tile(struct _openslide_tiff_level *tiffl,
     _openslide_performance_warn_once(&tiffl->warned_read_indirect,
                                      "Using slow libtiff read path for "
                                      "directory %d", tiffl->dir);
-    return tiff_read_region(tiff, dest,
-                            tile_col * tiffl->tile_w, tile_row * tiffl->tile_h,
-                            tiffl->tile_w, tiffl->tile_h, err);
+    // libtiff reads and decodes internally; credit the whole call to
+    // the decode stage
+    int64_t perf = _openslide_perf_begin();
+    bool ret = tiff_read_region(tiff, dest,
+                                tile_col * tiffl->tile_w, tile_row * tiffl->tile_h,
+                                tiffl->tile_w, tiffl->tile_h, err);
+    _openslide_perf_end(_OPENSLIDE_PERF_DECODE, perf);
+    return ret;
   }
 }
 
@@ -351,7 +385,9 @@ bool _openslide_tiff_read_tile_data(struct _openslide_tiff_level *tiffl,
 
   // get raw tile
   tdata_t buf = g_malloc(tile_size);
+  int64_t perf = _openslide_perf_begin();
   tsize_t size = TIFFReadRawTile(tiff, tile_no, buf, tile_size);
+  _openslide_perf_end(_OPENSLIDE_PERF_IO, perf);
   if (size == -1) {
     g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
                 "Cannot read raw tile");
@@ -399,6 +435,334 @@ bool _openslide_tiff_check_missing_tile(struct _openslide_tiff_level *tiffl,
   return true;
 }
 
+// snapshot the tile offset and byte-count arrays of the current
+// directory, so extent lookups for the I/O preload don't need a TIFF
+// handle; failure just means the caller goes without preloading
+bool _openslide_tiff_get_tile_extents(TIFF *tiff,
+                                      tdir_t dir,
+                                      uint64_t **_offsets,
+                                      uint64_t **_lengths,
+                                      int64_t *_count) {
+  if (!_openslide_tiff_set_dir(tiff, dir, NULL)) {
+    return false;
+  }
+  if (!TIFFIsTiled(tiff)) {
+    return false;
+  }
+
+  toff_t *offsets;
+  toff_t *sizes;
+  if (!TIFFGetField(tiff, TIFFTAG_TILEOFFSETS, &offsets) ||
+      !TIFFGetField(tiff, TIFFTAG_TILEBYTECOUNTS, &sizes)) {
+    return false;
+  }
+  int64_t count = TIFFNumberOfTiles(tiff);
+  if (count <= 0) {
+    return false;
+  }
+
+  uint64_t *out_offsets = g_new(uint64_t, count);
+  uint64_t *out_lengths = g_new(uint64_t, count);
+  for (int64_t i = 0; i < count; i++) {
+    out_offsets[i] = offsets[i];
+    out_lengths[i] = sizes[i];
+  }
+
+  *_offsets = out_offsets;
+  *_lengths = out_lengths;
+  *_count = count;
+  return true;
+}
+
+// Striped images are expensive through TIFFRGBAImage: every strip is a
+// separate read -- and tiff_do_read() reopens the file for each one --
+// followed by the usual three pixel-format passes.  For JPEG-compressed
+// strips we can do much better: coalesce strips that are adjacent on
+// disk into single reads, then decode them back-to-back with one libjpeg
+// context, writing rows straight into the destination buffer.
+
+// same criteria as the tile fast path in _openslide_tiff_level_init()
+static bool jpeg_strips_direct_ok(TIFF *tiff) {
+  uint16_t compression = 0, planar_config = 0, photometric = 0;
+  uint16_t bits_per_sample = 0, samples_per_pixel = 0;
+  TIFFGetField(tiff, TIFFTAG_COMPRESSION, &compression);
+  TIFFGetField(tiff, TIFFTAG_PLANARCONFIG, &planar_config);
+  TIFFGetField(tiff, TIFFTAG_PHOTOMETRIC, &photometric);
+  TIFFGetField(tiff, TIFFTAG_BITSPERSAMPLE, &bits_per_sample);
+  TIFFGetField(tiff, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel);
+  return !TIFFIsTiled(tiff) &&
+         compression == COMPRESSION_JPEG &&
+         planar_config == PLANARCONFIG_CONTIG &&
+         (photometric == PHOTOMETRIC_RGB || photometric == PHOTOMETRIC_YCBCR) &&
+         bits_per_sample == 8 &&
+         samples_per_pixel == 3;
+}
+
+static bool read_jpeg_strips_batched(TIFF *tiff, const char *filename,
+                                     uint32_t *dest,
+                                     int64_t w, int64_t h,
+                                     GError **err) {
+  uint32_t rows_per_strip;
+  if (!TIFFGetField(tiff, TIFFTAG_ROWSPERSTRIP, &rows_per_strip) ||
+      rows_per_strip == 0) {
+    g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                "Cannot get rows per strip");
+    return false;
+  }
+  tstrip_t nstrips = TIFFNumberOfStrips(tiff);
+  toff_t *offsets;
+  toff_t *sizes;
+  if (!TIFFGetField(tiff, TIFFTAG_STRIPOFFSETS, &offsets) ||
+      !TIFFGetField(tiff, TIFFTAG_STRIPBYTECOUNTS, &sizes)) {
+    g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                "Cannot get strip offsets");
+    return false;
+  }
+  if ((int64_t) nstrips * rows_per_strip < h) {
+    g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                "Strips don't cover image");
+    return false;
+  }
+
+  // strip i decodes from cum[i] in one contiguous buffer; consecutive
+  // strips that are also adjacent on disk are fetched with a single read
+  int64_t *cum = g_new(int64_t, nstrips + 1);
+  cum[0] = 0;
+  for (tstrip_t i = 0; i < nstrips; i++) {
+    if (sizes[i] == 0) {
+      g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                  "Missing strip %u", (unsigned) i);
+      g_free(cum);
+      return false;
+    }
+    cum[i + 1] = cum[i] + sizes[i];
+  }
+  uint8_t *buf = g_malloc(cum[nstrips]);
+
+  FILE *f = _openslide_fopen(filename, "rb", err);
+  if (!f) {
+    g_free(buf);
+    g_free(cum);
+    return false;
+  }
+  int64_t perf = _openslide_perf_begin();
+  bool io_ok = true;
+  tstrip_t i = 0;
+  while (i < nstrips && io_ok) {
+    // extend the run while the next strip follows directly on disk
+    tstrip_t j = i + 1;
+    while (j < nstrips && offsets[j] == offsets[j - 1] + sizes[j - 1]) {
+      j++;
+    }
+    io_ok = !fseeko(f, offsets[i], SEEK_SET) &&
+            fread(buf + cum[i], cum[j] - cum[i], 1, f) == 1;
+    i = j;
+  }
+  _openslide_perf_end(_OPENSLIDE_PERF_IO, perf);
+  fclose(f);
+  if (!io_ok) {
+    _openslide_io_error(err, "Couldn't read strip data");
+    g_free(buf);
+    g_free(cum);
+    return false;
+  }
+
+  // read tables
+  void *tables;
+  uint32_t tables_len;
+  if (!TIFFGetField(tiff, TIFFTAG_JPEGTABLES, &tables_len, &tables)) {
+    // no separate tables
+    tables = NULL;
+    tables_len = 0;
+  }
+  uint16_t photometric = PHOTOMETRIC_RGB;
+  TIFFGetField(tiff, TIFFTAG_PHOTOMETRIC, &photometric);
+
+  volatile bool result = false;
+  jmp_buf env;
+  struct jpeg_decompress_struct *cinfo;
+  struct _openslide_jpeg_decompress *dc =
+    _openslide_jpeg_decompress_create(&cinfo);
+
+  perf = _openslide_perf_begin();
+  if (setjmp(env) == 0) {
+    _openslide_jpeg_decompress_init(dc, &env);
+
+    // load JPEG tables once; they survive the per-strip resets
+    if (tables) {
+      _openslide_jpeg_mem_src(cinfo, tables, tables_len);
+      if (jpeg_read_header(cinfo, false) != JPEG_HEADER_TABLES_ONLY) {
+        g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                    "Couldn't load JPEG tables");
+        goto DONE;
+      }
+    }
+
+    int64_t row = 0;
+    for (tstrip_t n = 0; n < nstrips && row < h; n++) {
+      int64_t rows = MIN((int64_t) rows_per_strip, h - row);
+      _openslide_jpeg_mem_src(cinfo, buf + cum[n], sizes[n]);
+      if (jpeg_read_header(cinfo, true) != JPEG_HEADER_OK) {
+        g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                    "Couldn't read JPEG header");
+        goto DONE;
+      }
+      cinfo->jpeg_color_space =
+        photometric == PHOTOMETRIC_YCBCR ? JCS_YCbCr : JCS_RGB;
+      if (!_openslide_jpeg_decompress_run(dc, dest + row * w, false,
+                                          w, rows, err)) {
+        goto DONE;
+      }
+      _openslide_jpeg_decompress_reset(dc);
+      row += rows;
+    }
+    result = true;
+  } else {
+    // setjmp has returned again
+    _openslide_jpeg_propagate_error(err, dc);
+  }
+
+DONE:
+  _openslide_jpeg_decompress_destroy(dc);
+  _openslide_perf_end(_OPENSLIDE_PERF_DECODE, perf);
+  g_free(buf);
+  g_free(cum);
+  return result;
+}
+
+// Return one tile's compressed bytes as a standalone bitstream for
+// transcoding, without decoding.  JPEG tiles stored with a shared
+// JPEGTables tag get the tables spliced in after SOI so the result
+// decodes on its own; JPEG 2000 codestreams are already standalone.
+uint8_t *_openslide_tiff_read_raw_tile(struct _openslide_tiff_level *tiffl,
+                                       TIFF *tiff,
+                                       int64_t tile_col, int64_t tile_row,
+                                       int64_t *len, const char **codec,
+                                       GError **err) {
+  if (tile_col < 0 || tile_col >= tiffl->tiles_across ||
+      tile_row < 0 || tile_row >= tiffl->tiles_down) {
+    g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                "Tile out of range");
+    return NULL;
+  }
+
+  // set directory
+  if (!_openslide_tiff_set_dir(tiff, tiffl->dir, err)) {
+    return NULL;
+  }
+
+  uint16_t compression;
+  if (!TIFFGetField(tiff, TIFFTAG_COMPRESSION, &compression)) {
+    g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                "Cannot get required TIFF tag: %d", TIFFTAG_COMPRESSION);
+    return NULL;
+  }
+  switch (compression) {
+  case COMPRESSION_JPEG:
+    *codec = "jpeg";
+    break;
+  case 33003:  // Aperio JP2K YCbCr
+  case 33005:  // Aperio JP2K RGB
+    *codec = "jp2k";
+    break;
+  default:
+    g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                "Can't extract raw tiles with TIFF compression %u",
+                compression);
+    return NULL;
+  }
+
+  void *buf;
+  int32_t buflen;
+  if (!_openslide_tiff_read_tile_data(tiffl, tiff,
+                                      &buf, &buflen,
+                                      tile_col, tile_row,
+                                      err)) {
+    return NULL;
+  }
+  if (buflen == 0) {
+    g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                "Missing tile");
+    g_free(buf);
+    return NULL;
+  }
+
+  if (compression == COMPRESSION_JPEG) {
+    uint8_t *tables;
+    uint32_t tables_len;
+    uint8_t *raw = buf;
+    if (TIFFGetField(tiff, TIFFTAG_JPEGTABLES, &tables_len, &tables) &&
+        tables_len > 4 && buflen > 2 &&
+        tables[0] == 0xff && tables[1] == 0xd8 &&
+        raw[0] == 0xff && raw[1] == 0xd8) {
+      // SOI + tables segments (dropping the tables EOI) + tile data
+      // after its SOI
+      uint8_t *merged = g_malloc((int64_t) tables_len - 4 + buflen);
+      memcpy(merged, tables, tables_len - 2);
+      memcpy(merged + tables_len - 2, raw + 2, buflen - 2);
+      g_free(buf);
+      *len = (int64_t) tables_len - 4 + buflen;
+      return merged;
+    }
+  }
+
+  *len = buflen;
+  return buf;
+}
+
+bool _openslide_tiff_decode_raw_tile(struct _openslide_tiff_level *tiffl,
+                                     const uint8_t *buf, int64_t len,
+                                     const char *codec,
+                                     enum _openslide_jp2k_colorspace space,
+                                     uint32_t *dest,
+                                     GError **err) {
+  if (g_str_equal(codec, "jp2k")) {
+    return _openslide_jp2k_decode_buffer(dest,
+                                         tiffl->tile_w, tiffl->tile_h,
+                                         (void *) buf, len,
+                                         space,
+                                         err);
+  }
+  if (!g_str_equal(codec, "jpeg")) {
+    g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                "Unknown tile codec \"%s\"", codec);
+    return false;
+  }
+
+  volatile bool result = false;
+  jmp_buf env;
+  struct jpeg_decompress_struct *cinfo;
+  struct _openslide_jpeg_decompress *dc =
+    _openslide_jpeg_decompress_create(&cinfo);
+
+  int64_t perf = _openslide_perf_begin();
+  if (setjmp(env) == 0) {
+    _openslide_jpeg_decompress_init(dc, &env);
+
+    _openslide_jpeg_mem_src(cinfo, buf, len);
+    if (jpeg_read_header(cinfo, true) != JPEG_HEADER_OK) {
+      g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                  "Couldn't read JPEG header");
+      goto DONE;
+    }
+    // the stream carries no JFIF/Adobe marker, so force the colorspace
+    // recorded in the directory
+    cinfo->jpeg_color_space =
+      tiffl->photometric == PHOTOMETRIC_YCBCR ? JCS_YCbCr : JCS_RGB;
+    result = _openslide_jpeg_decompress_run(dc, dest, false,
+                                            tiffl->tile_w, tiffl->tile_h,
+                                            err);
+  } else {
+    // setjmp has returned again
+    _openslide_jpeg_propagate_error(err, dc);
+  }
+
+DONE:
+  _openslide_jpeg_decompress_destroy(dc);
+  _openslide_perf_end(_OPENSLIDE_PERF_DECODE, perf);
+  return result;
+}
+
 static bool _get_associated_image_data(TIFF *tiff,
                                        struct associated_image *img,
                                        uint32_t *dest,
@@ -420,7 +784,13 @@ static bool _get_associated_image_data(TIFF *tiff,
     return false;
   }
 
-  // load the image
+  // load the image; on any trouble with the batched path, fall back to
+  // TIFFRGBAImage, which overwrites dest from scratch
+  if (jpeg_strips_direct_ok(tiff) &&
+      read_jpeg_strips_batched(tiff, img->tc->filename, dest,
+                               width, height, NULL)) {
+    return true;
+  }
   return tiff_read_region(tiff, dest, 0, 0, width, height, err);
 }
 
@@ -511,11 +881,20 @@ static tsize_t tiff_do_read(thandle_t th, tdata_t buf, tsize_t size) {
   if (f == NULL) {
     return 0;
   }
+  // _openslide_fopen() applies the opening thread's policy; reads often
+  // come from worker threads, so reapply the captured one
+  if (hdl->tc->io_policy) {
+    _openslide_io_advise(f, hdl->tc->io_policy);
+  }
   if (fseeko(f, hdl->offset, SEEK_SET)) {
     fclose(f);
     return 0;
   }
   int64_t rsize = fread(buf, 1, size, f);
+  if (hdl->tc->io_policy & OPENSLIDE_OPEN_NO_CACHE) {
+    // drop what this read pulled in before giving up the descriptor
+    _openslide_io_drop_cache(f, hdl->offset, rsize);
+  }
   hdl->offset += rsize;
   fclose(f);
   return rsize;
@@ -647,29 +1026,42 @@ struct _openslide_tiffcache *_openslide_tiffcache_create(const char *filename) {
   struct _openslide_tiffcache *tc = g_slice_new0(struct _openslide_tiffcache);
   tc->filename = g_strdup(filename);
   tc->cache = g_queue_new();
+  // created on the opening thread, where the caller's policy is set
+  tc->io_policy = _openslide_io_policy_get();
 #if !GLIB_CHECK_VERSION(2,31,0)
   tc->lock = g_mutex_new();
 #else
   g_mutex_init(&tc->lock);
 #endif
+
+  // optionally pre-warm the pool; nobody else can see tc yet, so no
+  // locking.  Failures are ignored here and will be reported by the
+  // first _openslide_tiffcache_get().
+  const char *prewarm = g_getenv(HANDLE_PREWARM_ENV);
+  if (prewarm) {
+    int64_t count = g_ascii_strtoll(prewarm, NULL, 10);
+    count = CLAMP(count, 0, HANDLE_CACHE_MAX);
+    for (int64_t i = 0; i < count; i++) {
+      TIFF *tiff = tiff_open(tc, NULL);
+      if (tiff == NULL) {
+        break;
+      }
+      g_queue_push_head(tc->cache, tiff);
+    }
+  }
+
   return tc;
 }
 
 TIFF *_openslide_tiffcache_get(struct _openslide_tiffcache *tc, GError **err) {
   //g_debug("get TIFF");
-#if !GLIB_CHECK_VERSION(2,31,0)
-  g_mutex_lock(tc->lock);
-#else
-  g_mutex_lock(&tc->lock);
-#endif
+  tiffcache_lock(tc);
 
   tc->outstanding++;
+  // strict LIFO: always reuse the most recently returned handle, whose
+  // libtiff directory and strip caches are most likely to still be warm
   TIFF *tiff = g_queue_pop_head(tc->cache);
-#if !GLIB_CHECK_VERSION(2,31,0)
-  g_mutex_unlock(tc->lock);
-#else
-  g_mutex_unlock(&tc->lock);
-#endif
+  tiffcache_unlock(tc);
 
   if (tiff == NULL) {
     //g_debug("create TIFF");
@@ -678,17 +1070,9 @@ TIFF *_openslide_tiffcache_get(struct _openslide_tiffcache *tc, GError **err) {
     tiff = tiff_open(tc, err);
   }
   if (tiff == NULL) {
-#if !GLIB_CHECK_VERSION(2,31,0)
-    g_mutex_lock(tc->lock);
-#else
-    g_mutex_lock(&tc->lock);
-#endif
+    tiffcache_lock(tc);
     tc->outstanding--;
-#if !GLIB_CHECK_VERSION(2,31,0)
-    g_mutex_unlock(tc->lock);
-#else
-    g_mutex_unlock(&tc->lock);
-#endif
+    tiffcache_unlock(tc);
   }
   return tiff;
 }
@@ -699,22 +1083,14 @@ void _openslide_tiffcache_put(struct _openslide_tiffcache *tc, TIFF *tiff) {
   }
 
   //g_debug("put TIFF");
-#if !GLIB_CHECK_VERSION(2,31,0)
-  g_mutex_lock(tc->lock);
-#else
-  g_mutex_lock(&tc->lock);
-#endif
+  tiffcache_lock(tc);
   g_assert(tc->outstanding);
   tc->outstanding--;
   if (g_queue_get_length(tc->cache) < HANDLE_CACHE_MAX) {
     g_queue_push_head(tc->cache, tiff);
     tiff = NULL;
   }
-#if !GLIB_CHECK_VERSION(2,31,0)
-  g_mutex_unlock(tc->lock);
-#else
-  g_mutex_unlock(&tc->lock);
-#endif
+  tiffcache_unlock(tc);
 
   if (tiff) {
     //g_debug("too many TIFFs");
@@ -722,6 +1098,10 @@ void _openslide_tiffcache_put(struct _openslide_tiffcache *tc, TIFF *tiff) {
   }
 }
 
+const char *_openslide_tiffcache_get_filename(struct _openslide_tiffcache *tc) {
+  return tc->filename;
+}
+
 void _openslide_tiffcache_destroy(struct _openslide_tiffcache *tc) {
   if (tc == NULL) {
     return;
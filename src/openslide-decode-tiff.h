@@ -24,6 +24,7 @@
 
 #include "openslide-private.h"
 #include "openslide-hash.h"
+#include "openslide-decode-jp2k.h"
 
 #include <stdint.h>
 #include <glib.h>
@@ -69,6 +70,22 @@ bool _openslide_tiff_read_tile_data(struct _openslide_tiff_level *tiffl,
                                     int64_t tile_col, int64_t tile_row,
                                     GError **err);
 
+uint8_t *_openslide_tiff_read_raw_tile(struct _openslide_tiff_level *tiffl,
+                                       TIFF *tiff,
+                                       int64_t tile_col, int64_t tile_row,
+                                       int64_t *len, const char **codec,
+                                       GError **err);
+
+// decode a bitstream produced by _openslide_tiff_read_raw_tile()
+// without touching the file; space selects the JPEG 2000 colorspace
+// and is ignored for JPEG
+bool _openslide_tiff_decode_raw_tile(struct _openslide_tiff_level *tiffl,
+                                     const uint8_t *buf, int64_t len,
+                                     const char *codec,
+                                     enum _openslide_jp2k_colorspace space,
+                                     uint32_t *dest,
+                                     GError **err);
+
 bool _openslide_tiff_clip_tile(struct _openslide_tiff_level *tiffl,
                                uint32_t *tiledata,
                                int64_t tile_col, int64_t tile_row,
@@ -84,6 +101,14 @@ bool _openslide_tiff_set_dir(TIFF *tiff,
                              tdir_t dir,
                              GError **err);
 
+// copy out the tile offset/byte-count arrays of a directory for extent
+// lookups; returns false (with no error) if they aren't available
+bool _openslide_tiff_get_tile_extents(TIFF *tiff,
+                                      tdir_t dir,
+                                      uint64_t **offsets,
+                                      uint64_t **lengths,
+                                      int64_t *count);
+
 
 /* TIFF handles are not thread-safe, so we have a handle cache for
    multithreaded access */
@@ -93,6 +118,8 @@ TIFF *_openslide_tiffcache_get(struct _openslide_tiffcache *tc, GError **err);
 
 void _openslide_tiffcache_put(struct _openslide_tiffcache *tc, TIFF *tiff);
 
+const char *_openslide_tiffcache_get_filename(struct _openslide_tiffcache *tc);
+
 void _openslide_tiffcache_destroy(struct _openslide_tiffcache *tc);
 
 #endif
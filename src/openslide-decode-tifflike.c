@@ -54,6 +54,7 @@
 #include <string.h>
 #include <math.h>
 #include <glib.h>
+#include <glib/gstdio.h>
 
 #include <tiff.h>
 
@@ -68,13 +69,19 @@
 
 #define NO_OFFSET UINT64_MAX
 
+#if !GLIB_CHECK_VERSION(2,22,0)
+#define g_mapped_file_unref g_mapped_file_free
+#endif
+
 #define NDPI_TAG 65420
 
 
 struct _openslide_tifflike {
   char *filename;
   bool big_endian;
+  bool bigtiff;
   bool ndpi;
+  GMappedFile *mapped;  // optional; NULL if the file couldn't be mapped
   GPtrArray *directories;
 #if !GLIB_CHECK_VERSION(2,31,0)
   GMutex *value_lock;
@@ -85,7 +92,10 @@ struct _openslide_tifflike {
 
 struct tiff_directory {
   GHashTable *items;
-  uint64_t offset;  // only for NDPI fixups
+  uint64_t offset;  // directory location; also used for NDPI fixups
+  // whether the entry table has been parsed into items; only the chain
+  // skeleton is read at create time
+  bool parsed;
 };
 
 struct tiff_item {
@@ -93,6 +103,10 @@ struct tiff_item {
   int64_t count;
   uint64_t offset;
 
+  // original location of the value bytes, for the reopen cache; unlike
+  // offset, never cleared when the value is populated
+  uint64_t file_offset;
+
   // data format variants
   uint64_t *uints;
   int64_t *sints;
@@ -134,15 +148,47 @@ static void fix_byte_order(void *data, int32_t size, int64_t count,
   }
 }
 
+// directory reader backed by either a mapped view or a FILE*
+struct tiff_reader {
+  const uint8_t *map;  // mapped view, or NULL to read through f
+  uint64_t map_len;
+  uint64_t pos;
+  FILE *f;
+};
+
+static bool reader_seek(struct tiff_reader *r, uint64_t off) {
+  if (r->map) {
+    if (off > r->map_len) {
+      return false;
+    }
+    r->pos = off;
+    return true;
+  }
+  return fseeko(r->f, off, SEEK_SET) == 0;
+}
+
+static bool reader_read(struct tiff_reader *r, void *buf, size_t len) {
+  if (r->map) {
+    if (len > r->map_len - r->pos) {
+      return false;
+    }
+    memcpy(buf, r->map + r->pos, len);
+    r->pos += len;
+    return true;
+  }
+  return fread(buf, len, 1, r->f) == 1;
+}
+
 // only sets *ok on failure
-static uint64_t read_uint(FILE *f, int32_t size, bool big_endian, bool *ok) {
+static uint64_t read_uint(struct tiff_reader *r, int32_t size,
+                          bool big_endian, bool *ok) {
   g_assert(ok != NULL);
 #ifdef _MSC_VER
   uint8_t* buf = (uint8_t*)calloc(size, sizeof(uint8_t));
 #else
   uint8_t buf[size];
 #endif
-  if (fread(buf, size, 1, f) != 1) {
+  if (!reader_read(r, buf, size)) {
     *ok = false;
     return 0;
   }
@@ -377,6 +423,7 @@ static bool populate_item(struct _openslide_tifflike *tl,
                           struct tiff_item *item,
                           GError **err) {
   void *buf = NULL;
+  FILE *f = NULL;
   bool success = false;
 
 #if !GLIB_CHECK_VERSION(2,31,0)
@@ -393,32 +440,64 @@ static bool populate_item(struct _openslide_tifflike *tl,
     return true;
   }
 
-  FILE *f = _openslide_fopen(tl->filename, "rb", err);
-  if (!f) {
-    goto FAIL;
-  }
-
   uint64_t count = item->count;
   int32_t value_size = get_value_size(item->type, &count);
   g_assert(value_size);
   ssize_t len = value_size * count;
 
-  buf = g_try_malloc(len);
-  if (buf == NULL) {
-    g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
-                "Cannot allocate TIFF value");
-    goto FAIL;
-  }
+  if (tl->mapped) {
+    // read directly from the mapped view
+    const uint8_t *map =
+      (const uint8_t *) g_mapped_file_get_contents(tl->mapped);
+    uint64_t map_len = g_mapped_file_get_length(tl->mapped);
+    if (item->offset > map_len || (uint64_t) len > map_len - item->offset) {
+      g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                  "TIFF value extends past end of file");
+      goto FAIL;
+    }
+    const uint8_t *value = map + item->offset;
 
-  //g_debug("reading tiff value: len: %"PRId64", offset %"PRIu64, len, item->offset);
-  if (fseeko(f, item->offset, SEEK_SET)) {
-    _openslide_io_error(err, "Couldn't seek to read TIFF value");
-    goto FAIL;
-  }
-  if (fread(buf, len, 1, f) != 1) {
-    g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
-                "Couldn't read TIFF value");
-    goto FAIL;
+    bool swap = tl->big_endian != (G_BYTE_ORDER == G_BIG_ENDIAN);
+    if ((value_size == 1 || !swap) &&
+        (uintptr_t) value % value_size == 0) {
+      // zero-copy: convert in place from the mapped view
+      if (!set_item_values(item, value, err)) {
+        goto FAIL;
+      }
+      success = true;
+      goto FAIL;
+    }
+    // needs byte swapping or realignment; copy out first
+    buf = g_try_malloc(len);
+    if (buf == NULL) {
+      g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                  "Cannot allocate TIFF value");
+      goto FAIL;
+    }
+    memcpy(buf, value, len);
+  } else {
+    f = _openslide_fopen(tl->filename, "rb", err);
+    if (!f) {
+      goto FAIL;
+    }
+
+    buf = g_try_malloc(len);
+    if (buf == NULL) {
+      g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                  "Cannot allocate TIFF value");
+      goto FAIL;
+    }
+
+    //g_debug("reading tiff value: len: %"PRId64", offset %"PRIu64, len, item->offset);
+    if (fseeko(f, item->offset, SEEK_SET)) {
+      _openslide_io_error(err, "Couldn't seek to read TIFF value");
+      goto FAIL;
+    }
+    if (fread(buf, len, 1, f) != 1) {
+      g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                  "Couldn't read TIFF value");
+      goto FAIL;
+    }
   }
 
   fix_byte_order(buf, value_size, count, tl->big_endian);
@@ -449,6 +528,10 @@ static void tiff_directory_destroy(struct tiff_directory *d) {
   g_slice_free(struct tiff_directory, d);
 }
 
+static bool ensure_directory_parsed(struct _openslide_tifflike *tl,
+                                    struct tiff_directory *d,
+                                    GError **err);
+
 static void tiff_item_destroy(gpointer data) {
   struct tiff_item *item = data;
 
@@ -459,65 +542,257 @@ static void tiff_item_destroy(gpointer data) {
   g_slice_free(struct tiff_item, item);
 }
 
-static struct tiff_directory *read_directory(FILE *f, int64_t *diroff,
-                                             struct tiff_directory *first_dir,
-                                             GHashTable *loop_detector,
-                                             bool bigtiff,
-                                             bool ndpi,
-                                             bool big_endian,
-                                             GError **err) {
-  int64_t off = *diroff;
-  *diroff = 0;
-  struct tiff_directory *d = NULL;
-  bool ok = true;
 
-  //  g_debug("diroff: %"PRId64, off);
+// Reopen cache: when OPENSLIDE_INDEX_CACHE_DIR names a directory, the
+// parsed directory structure is serialized there after first open and
+// reloaded on later opens, validated against the slide's size and
+// mtime.  Values stay lazy; the cache stores only tag headers and
+// value locations, so a hit skips the whole IFD walk.
+
+#define INDEX_CACHE_DIR_ENV "OPENSLIDE_INDEX_CACHE_DIR"
+#define INDEX_CACHE_MAGIC 0x4f53544c  // "OSTL"
+#define INDEX_CACHE_VERSION 1
+
+struct index_cache_header {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t file_size;
+  int64_t file_mtime;
+  uint8_t big_endian;
+  uint8_t ndpi;
+  uint16_t pad;
+  uint32_t dir_count;
+};
 
-  if (off <= 0) {
-    g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
-                "Bad offset");
-    goto FAIL;
+struct index_cache_dir {
+  uint64_t offset;
+  uint32_t item_count;
+  uint32_t pad;
+};
+
+struct index_cache_item {
+  uint16_t tag;
+  uint16_t type;
+  uint32_t pad;
+  int64_t count;
+  uint64_t offset;
+};
+
+static char *index_cache_path(const char *filename) {
+  const char *dir = g_getenv(INDEX_CACHE_DIR_ENV);
+  if (!dir || !dir[0]) {
+    return NULL;
   }
+  // key the cache file on the slide path so unrelated slides in the
+  // same cache directory can't collide
+  char *hash = g_compute_checksum_for_string(G_CHECKSUM_SHA256,
+                                             filename, -1);
+  char *name = g_strconcat(hash, ".ostl", NULL);
+  char *path = g_build_filename(dir, name, NULL);
+  g_free(name);
+  g_free(hash);
+  return path;
+}
 
-  // loop detection
-  if (g_hash_table_lookup_extended(loop_detector, &off, NULL, NULL)) {
-    // loop
-    g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
-                "Loop detected");
+static bool index_cache_stat(const char *filename,
+                             uint64_t *size, int64_t *mtime) {
+#if GLIB_CHECK_VERSION(2,26,0)
+  GStatBuf st;
+#else
+  struct stat st;
+#endif
+  if (g_stat(filename, &st)) {
+    return false;
+  }
+  *size = st.st_size;
+  *mtime = st.st_mtime;
+  return true;
+}
+
+static struct _openslide_tifflike *index_cache_load(const char *filename,
+                                                    const char *path) {
+  char *contents = NULL;
+  gsize len;
+  struct _openslide_tifflike *tl = NULL;
+
+  if (!g_file_get_contents(path, &contents, &len, NULL)) {
+    return NULL;
+  }
+  const uint8_t *p = (const uint8_t *) contents;
+
+  if (len < sizeof(struct index_cache_header)) {
+    goto FAIL;
+  }
+  struct index_cache_header hdr;
+  memcpy(&hdr, p, sizeof(hdr));
+  p += sizeof(hdr);
+  len -= sizeof(hdr);
+
+  uint64_t file_size;
+  int64_t file_mtime;
+  if (hdr.magic != INDEX_CACHE_MAGIC ||
+      hdr.version != INDEX_CACHE_VERSION ||
+      hdr.dir_count == 0 ||
+      !index_cache_stat(filename, &file_size, &file_mtime) ||
+      hdr.file_size != file_size ||
+      hdr.file_mtime != file_mtime) {
     goto FAIL;
   }
-  int64_t *key = g_slice_new(int64_t);
-  *key = off;
-  g_hash_table_insert(loop_detector, key, NULL);
 
-  // no loop, let's seek
-  if (fseeko(f, off, SEEK_SET) != 0) {
+  tl = g_slice_new0(struct _openslide_tifflike);
+  tl->filename = g_strdup(filename);
+  tl->big_endian = hdr.big_endian;
+  tl->ndpi = hdr.ndpi;
+  // map the slide for lazy value loads, like the parsing path
+  tl->mapped = g_mapped_file_new(filename, false, NULL);
+  tl->directories = g_ptr_array_new();
+#if !GLIB_CHECK_VERSION(2,31,0)
+  tl->value_lock = g_mutex_new();
+#else
+  g_mutex_init(&tl->value_lock);
+#endif
+
+  for (uint32_t n = 0; n < hdr.dir_count; n++) {
+    if (len < sizeof(struct index_cache_dir)) {
+      goto FAIL;
+    }
+    struct index_cache_dir cdir;
+    memcpy(&cdir, p, sizeof(cdir));
+    p += sizeof(cdir);
+    len -= sizeof(cdir);
+
+    struct tiff_directory *d = g_slice_new0(struct tiff_directory);
+    d->items = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                     NULL, tiff_item_destroy);
+    d->offset = cdir.offset;
+    // the cache stores the full entry table
+    d->parsed = true;
+    g_ptr_array_add(tl->directories, d);
+
+    for (uint32_t i = 0; i < cdir.item_count; i++) {
+      if (len < sizeof(struct index_cache_item)) {
+        goto FAIL;
+      }
+      struct index_cache_item citem;
+      memcpy(&citem, p, sizeof(citem));
+      p += sizeof(citem);
+      len -= sizeof(citem);
+
+      uint64_t vcount = citem.count;
+      if (citem.count < 0 || !get_value_size(citem.type, &vcount)) {
+        goto FAIL;
+      }
+
+      struct tiff_item *item = g_slice_new0(struct tiff_item);
+      item->type = citem.type;
+      item->count = citem.count;
+      item->file_offset = citem.offset;
+      g_hash_table_insert(d->items, GINT_TO_POINTER((int) citem.tag),
+                          item);
+
+      if (citem.count == 0) {
+        // nothing to read later; populate the empty value now
+        uint8_t empty[8] = { 0 };
+        if (!set_item_values(item, empty, NULL)) {
+          goto FAIL;
+        }
+      } else {
+        item->offset = citem.offset;
+      }
+    }
+  }
+
+  g_free(contents);
+  return tl;
+
+FAIL:
+  // a stale or malformed cache file is not an error; fall back to parsing
+  _openslide_tifflike_destroy(tl);
+  g_free(contents);
+  return NULL;
+}
+
+static void index_cache_save(struct _openslide_tifflike *tl,
+                             const char *path) {
+  struct index_cache_header hdr = {
+    .magic = INDEX_CACHE_MAGIC,
+    .version = INDEX_CACHE_VERSION,
+    .big_endian = tl->big_endian,
+    .ndpi = tl->ndpi,
+    .dir_count = tl->directories->len,
+  };
+  if (!index_cache_stat(tl->filename, &hdr.file_size, &hdr.file_mtime)) {
+    return;
+  }
+
+  GByteArray *buf = g_byte_array_new();
+  g_byte_array_append(buf, (const uint8_t *) &hdr, sizeof(hdr));
+
+  for (uint32_t n = 0; n < tl->directories->len; n++) {
+    struct tiff_directory *d = tl->directories->pdata[n];
+    // the cache serializes entry tables, so materialize this directory
+    // if no accessor has touched it yet
+    if (!ensure_directory_parsed(tl, d, NULL)) {
+      g_byte_array_free(buf, true);
+      return;
+    }
+    struct index_cache_dir cdir = {
+      .offset = d->offset,
+      .item_count = g_hash_table_size(d->items),
+    };
+    g_byte_array_append(buf, (const uint8_t *) &cdir, sizeof(cdir));
+
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, d->items);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+      struct tiff_item *item = value;
+      struct index_cache_item citem = {
+        .tag = GPOINTER_TO_INT(key),
+        .type = item->type,
+        .count = item->count,
+        .offset = item->file_offset,
+      };
+      g_byte_array_append(buf, (const uint8_t *) &citem, sizeof(citem));
+    }
+  }
+
+  // best effort; g_file_set_contents() writes through a temp file, so
+  // concurrent workers never see a partial cache entry
+  g_file_set_contents(path, (const char *) buf->data, buf->len, NULL);
+  g_byte_array_free(buf, true);
+}
+
+// parse the entry table of a directory into its items hash.
+// value_lock must be held when called after create time.
+static bool parse_directory_entries(struct tiff_reader *r,
+                                    struct tiff_directory *d,
+                                    struct tiff_directory *first_dir,
+                                    bool bigtiff,
+                                    bool ndpi,
+                                    bool big_endian,
+                                    GError **err) {
+  uint64_t off = d->offset;
+  bool ok = true;
+
+  if (!reader_seek(r, off)) {
     _openslide_io_error(err, "Cannot seek to offset");
     goto FAIL;
   }
 
   // read directory count
-  uint64_t dircount = read_uint(f, bigtiff ? 8 : 2, big_endian, &ok);
+  uint64_t dircount = read_uint(r, bigtiff ? 8 : 2, big_endian, &ok);
   if (!ok) {
     g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
                 "Cannot read dircount");
     goto FAIL;
   }
 
-  //  g_debug("dircount: %"PRIu64, dircount);
-
-
-  // initial checks passed, initialize the directory
-  d = g_slice_new0(struct tiff_directory);
-  d->items = g_hash_table_new_full(g_direct_hash, g_direct_equal,
-                                   NULL, tiff_item_destroy);
-  d->offset = off;
-
   // read all directory entries
   for (uint64_t n = 0; n < dircount; n++) {
-    uint16_t tag = read_uint(f, 2, big_endian, &ok);
-    uint16_t type = read_uint(f, 2, big_endian, &ok);
-    uint64_t count = read_uint(f, bigtiff ? 8 : 4, big_endian, &ok);
+    uint16_t tag = read_uint(r, 2, big_endian, &ok);
+    uint16_t type = read_uint(r, 2, big_endian, &ok);
+    uint64_t count = read_uint(r, bigtiff ? 8 : 4, big_endian, &ok);
 
     if (!ok) {
       g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
@@ -556,7 +831,7 @@ static struct tiff_directory *read_directory(FILE *f, int64_t *diroff,
     uint32_t _size = (bigtiff ? 8 : 4) * sizeof(uint8_t);
     uint8_t value[bigtiff ? 8 : 4];
 #endif
-    if (fread(value, _size, 1, f) != 1) {
+    if (!reader_read(r, value, _size)) {
       g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
                   "Cannot read value/offset");
 #ifdef _MSC_VER
@@ -575,6 +850,10 @@ static struct tiff_directory *read_directory(FILE *f, int64_t *diroff,
 #endif
         goto FAIL;
       }
+      // inline value: record where the value field itself lives so the
+      // reopen cache can reload it lazily
+      item->file_offset = off + (bigtiff ? 8 : 2) +
+        n * (bigtiff ? 20 : 12) + 4 + (bigtiff ? 8 : 4);
 
     } else {
       // no; store offset
@@ -596,21 +875,97 @@ static struct tiff_directory *read_directory(FILE *f, int64_t *diroff,
 
       if (ndpi) {
         // heuristically set high-order bits of offset
-        // if this tag has the same offset in the first IFD, reuse that value
+        // if this tag has the same offset in the first IFD, reuse that value.
+        // compare file_offset, which unlike offset survives value
+        // population in the first directory
         struct tiff_item *first_dir_item = NULL;
         if (first_dir) {
           first_dir_item = g_hash_table_lookup(first_dir->items,
                                                GINT_TO_POINTER(tag));
         }
-        if (!first_dir_item || first_dir_item->offset != item->offset) {
+        if (!first_dir_item || first_dir_item->file_offset != item->offset) {
           item->offset = fix_offset_ndpi(off, item->offset);
         }
       }
+      item->file_offset = item->offset;
     }
   }
 
+  // success
+  d->parsed = true;
+  return true;
+
+FAIL:
+  g_hash_table_remove_all(d->items);
+  return false;
+}
+
+// read only the directory skeleton -- location, entry count, next
+// directory offset -- leaving the entry table to be parsed on first
+// accessor call
+static struct tiff_directory *read_directory(struct tiff_reader *r,
+                                             int64_t *diroff,
+                                             GHashTable *loop_detector,
+                                             bool bigtiff,
+                                             bool ndpi,
+                                             bool big_endian,
+                                             GError **err) {
+  int64_t off = *diroff;
+  *diroff = 0;
+  struct tiff_directory *d = NULL;
+  bool ok = true;
+
+  //  g_debug("diroff: %"PRId64, off);
+
+  if (off <= 0) {
+    g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                "Bad offset");
+    goto FAIL;
+  }
+
+  // loop detection
+  if (g_hash_table_lookup_extended(loop_detector, &off, NULL, NULL)) {
+    // loop
+    g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                "Loop detected");
+    goto FAIL;
+  }
+  int64_t *key = g_slice_new(int64_t);
+  *key = off;
+  g_hash_table_insert(loop_detector, key, NULL);
+
+  // no loop, let's seek
+  if (!reader_seek(r, off)) {
+    _openslide_io_error(err, "Cannot seek to offset");
+    goto FAIL;
+  }
+
+  // read directory count
+  uint64_t dircount = read_uint(r, bigtiff ? 8 : 2, big_endian, &ok);
+  if (!ok) {
+    g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                "Cannot read dircount");
+    goto FAIL;
+  }
+
+  //  g_debug("dircount: %"PRIu64, dircount);
+
+
+  // initial checks passed, initialize the directory
+  d = g_slice_new0(struct tiff_directory);
+  d->items = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                   NULL, tiff_item_destroy);
+  d->offset = off;
+
+  // skip over the entries; they are materialized on first access
+  if (!reader_seek(r, off + (bigtiff ? 8 : 2) +
+                   dircount * (bigtiff ? 20 : 12))) {
+    _openslide_io_error(err, "Cannot seek past directory entries");
+    goto FAIL;
+  }
+
   // read the next dir offset
-  int64_t nextdiroff = read_uint(f, (bigtiff || ndpi) ? 8 : 4,
+  int64_t nextdiroff = read_uint(r, (bigtiff || ndpi) ? 8 : 4,
                                  big_endian, &ok);
   if (!ok) {
     g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
@@ -628,20 +983,81 @@ FAIL:
   return NULL;
 }
 
+// materialize a directory's entry table, memoized; a reader is opened
+// on demand so lazy parses work long after create time
+static bool ensure_directory_parsed(struct _openslide_tifflike *tl,
+                                    struct tiff_directory *d,
+                                    GError **err) {
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_lock(tl->value_lock);
+#else
+  g_mutex_lock(&tl->value_lock);
+#endif
+  bool success = d->parsed;
+  if (!success) {
+    struct tiff_reader reader = { 0 };
+    if (tl->mapped) {
+      reader.map = (const uint8_t *) g_mapped_file_get_contents(tl->mapped);
+      reader.map_len = g_mapped_file_get_length(tl->mapped);
+    } else {
+      reader.f = _openslide_fopen(tl->filename, "rb", err);
+    }
+    if (reader.map || reader.f) {
+      // NDPI offset fixups consult the first directory, which the NDPI
+      // probe parsed at create time
+      struct tiff_directory *first_dir = NULL;
+      if (tl->ndpi && tl->directories->pdata[0] != d) {
+        first_dir = tl->directories->pdata[0];
+      }
+      success = parse_directory_entries(&reader, d, first_dir,
+                                        tl->bigtiff, tl->ndpi,
+                                        tl->big_endian, err);
+      if (reader.f) {
+        fclose(reader.f);
+      }
+    }
+  }
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_unlock(tl->value_lock);
+#else
+  g_mutex_unlock(&tl->value_lock);
+#endif
+  return success;
+}
+
 struct _openslide_tifflike *_openslide_tifflike_create(const char *filename,
                                                        GError **err) {
   struct _openslide_tifflike *tl = NULL;
   GHashTable *loop_detector = NULL;
+  struct tiff_reader reader = { 0 };
+  struct tiff_reader *r = &reader;
+
+  // check the reopen cache first
+  char *cache_path = index_cache_path(filename);
+  if (cache_path) {
+    tl = index_cache_load(filename, cache_path);
+    if (tl) {
+      g_free(cache_path);
+      return tl;
+    }
+  }
 
-  // open file
-  FILE *f = _openslide_fopen(filename, "rb", err);
-  if (!f) {
-    goto FAIL;
+  // map the file; fall back to buffered reads if that fails
+  // (file too large for the address space, exotic filesystem, ...)
+  GMappedFile *mapped = g_mapped_file_new(filename, false, NULL);
+  if (mapped) {
+    reader.map = (const uint8_t *) g_mapped_file_get_contents(mapped);
+    reader.map_len = g_mapped_file_get_length(mapped);
+  } else {
+    reader.f = _openslide_fopen(filename, "rb", err);
+    if (!reader.f) {
+      goto FAIL;
+    }
   }
 
   // read and check magic
   uint16_t magic;
-  if (fread(&magic, sizeof magic, 1, f) != 1) {
+  if (!reader_read(r, &magic, sizeof magic)) {
     g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
                 "Can't read TIFF magic number");
     goto FAIL;
@@ -657,16 +1073,16 @@ struct _openslide_tifflike *_openslide_tifflike_create(const char *filename,
 
   // read rest of header
   bool ok = true;
-  uint16_t version = read_uint(f, 2, big_endian, &ok);
+  uint16_t version = read_uint(r, 2, big_endian, &ok);
   bool bigtiff = (version == TIFF_VERSION_BIG);
   uint16_t offset_size = 0;
   uint16_t pad = 0;
   if (bigtiff) {
-    offset_size = read_uint(f, 2, big_endian, &ok);
-    pad = read_uint(f, 2, big_endian, &ok);
+    offset_size = read_uint(r, 2, big_endian, &ok);
+    pad = read_uint(r, 2, big_endian, &ok);
   }
   // for classic TIFF, will mask off the high bytes after NDPI detection
-  int64_t diroff = read_uint(f, 8, big_endian, &ok);
+  int64_t diroff = read_uint(r, 8, big_endian, &ok);
 
   if (!ok) {
     g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
@@ -693,6 +1109,9 @@ struct _openslide_tifflike *_openslide_tifflike_create(const char *filename,
   tl = g_slice_new0(struct _openslide_tifflike);
   tl->filename = g_strdup(filename);
   tl->big_endian = big_endian;
+  tl->bigtiff = bigtiff;
+  tl->mapped = mapped;
+  mapped = NULL;
   tl->directories = g_ptr_array_new();
 #if !GLIB_CHECK_VERSION(2,31,0)
   tl->value_lock = g_mutex_new();
@@ -705,7 +1124,6 @@ struct _openslide_tifflike *_openslide_tifflike_create(const char *filename,
                                         _openslide_int64_equal,
                                         _openslide_int64_free,
                                         NULL);
-  struct tiff_directory *first_dir = NULL;
 
   // NDPI needs special quirks, since it is classic TIFF pretending to be
   // BigTIFF.  Enable NDPI mode if this is classic TIFF but the offset to
@@ -713,21 +1131,24 @@ struct _openslide_tifflike *_openslide_tifflike_create(const char *filename,
   // valid directory containing the NDPI_TAG.
   if (!bigtiff && diroff != 0) {
     int64_t trial_diroff = diroff;
-    struct tiff_directory *d = read_directory(f, &trial_diroff,
-                                              NULL,
+    struct tiff_directory *d = read_directory(r, &trial_diroff,
                                               loop_detector,
                                               bigtiff, true, big_endian,
                                               NULL);
     if (d) {
-      struct tiff_item *item =
-        g_hash_table_lookup(d->items, GINT_TO_POINTER(NDPI_TAG));
+      // the probe needs the entry table; parse it now, which also
+      // feeds NDPI offset fixups in later directories
+      struct tiff_item *item = NULL;
+      if (parse_directory_entries(r, d, NULL,
+                                  bigtiff, true, big_endian, NULL)) {
+        item = g_hash_table_lookup(d->items, GINT_TO_POINTER(NDPI_TAG));
+      }
       if (item && item->count) {
         // NDPI
         //g_debug("NDPI detected");
         tl->ndpi = true;
         // save the parsed directory rather than reparsing it below
         g_ptr_array_add(tl->directories, d);
-        first_dir = d;
         diroff = trial_diroff;
       } else {
         // correctly parsed the directory in NDPI mode, but didn't find
@@ -744,11 +1165,11 @@ struct _openslide_tifflike *_openslide_tifflike_create(const char *filename,
     }
   }
 
-  // read all the directories
+  // walk the directory chain; entry tables stay unparsed until an
+  // accessor touches them
   while (diroff != 0) {
     // read a directory
-    struct tiff_directory *d = read_directory(f, &diroff,
-                                              first_dir,
+    struct tiff_directory *d = read_directory(r, &diroff,
                                               loop_detector,
                                               bigtiff, tl->ndpi, big_endian,
                                               err);
@@ -760,9 +1181,6 @@ struct _openslide_tifflike *_openslide_tifflike_create(const char *filename,
 
     // store result
     g_ptr_array_add(tl->directories, d);
-    if (!first_dir) {
-      first_dir = d;
-    }
   }
 
   // ensure there are directories
@@ -773,7 +1191,13 @@ struct _openslide_tifflike *_openslide_tifflike_create(const char *filename,
   }
 
   g_hash_table_unref(loop_detector);
-  fclose(f);
+  if (reader.f) {
+    fclose(reader.f);
+  }
+  if (cache_path) {
+    index_cache_save(tl, cache_path);
+    g_free(cache_path);
+  }
   return tl;
 
 FAIL:
@@ -781,9 +1205,13 @@ FAIL:
   if (loop_detector) {
     g_hash_table_unref(loop_detector);
   }
-  if (f) {
-    fclose(f);
+  if (reader.f) {
+    fclose(reader.f);
+  }
+  if (mapped) {
+    g_mapped_file_unref(mapped);
   }
+  g_free(cache_path);
   return NULL;
 }
 
@@ -806,6 +1234,9 @@ void _openslide_tifflike_destroy(struct _openslide_tifflike *tl) {
   g_mutex_unlock(&tl->value_lock);
 #endif
   g_ptr_array_free(tl->directories, true);
+  if (tl->mapped) {
+    g_mapped_file_unref(tl->mapped);
+  }
   g_free(tl->filename);
 #if !GLIB_CHECK_VERSION(2,31,0)
   g_mutex_free(tl->value_lock);
@@ -819,6 +1250,12 @@ static struct tiff_item *get_item(struct _openslide_tifflike *tl,
     return NULL;
   }
   struct tiff_directory *d = tl->directories->pdata[dir];
+  // a directory whose entries can't be parsed reports no values.
+  // the parsed flag is checked under value_lock so a parse on one
+  // thread is fully visible to lookups on another
+  if (!ensure_directory_parsed(tl, d, NULL)) {
+    return NULL;
+  }
   return g_hash_table_lookup(d->items, GINT_TO_POINTER(tag));
 }
 
@@ -909,6 +1346,10 @@ static int tag_compare(gconstpointer a, gconstpointer b) {
 static void print_directory(struct _openslide_tifflike *tl,
                             int64_t dir) {
   struct tiff_directory *d = tl->directories->pdata[dir];
+  if (!ensure_directory_parsed(tl, d, NULL)) {
+    printf(" <unparseable directory>\n\n");
+    return;
+  }
   GList *keys = g_hash_table_get_keys(d->items);
   keys = g_list_sort(keys, tag_compare);
   for (GList *el = keys; el; el = el->next) {
@@ -1047,6 +1488,63 @@ const double *_openslide_tifflike_get_floats(struct _openslide_tifflike *tl,
   return item->floats;
 }
 
+const uint64_t *_openslide_tifflike_get_uint_array(struct _openslide_tifflike *tl,
+                                                   int64_t dir, int32_t tag,
+                                                   int64_t *count,
+                                                   GError **err) {
+  *count = 0;
+  struct tiff_item *item = get_and_check_item(tl, dir, tag, err);
+  if (item == NULL || !populate_item(tl, item, err)) {
+    return NULL;
+  }
+  if (!item->uints) {
+    g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                "Unexpected value type: directory %"PRId64", "
+                "tag %d, type %d", dir, tag, item->type);
+    return NULL;
+  }
+  *count = item->count;
+  return item->uints;
+}
+
+const int64_t *_openslide_tifflike_get_sint_array(struct _openslide_tifflike *tl,
+                                                  int64_t dir, int32_t tag,
+                                                  int64_t *count,
+                                                  GError **err) {
+  *count = 0;
+  struct tiff_item *item = get_and_check_item(tl, dir, tag, err);
+  if (item == NULL || !populate_item(tl, item, err)) {
+    return NULL;
+  }
+  if (!item->sints) {
+    g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                "Unexpected value type: directory %"PRId64", "
+                "tag %d, type %d", dir, tag, item->type);
+    return NULL;
+  }
+  *count = item->count;
+  return item->sints;
+}
+
+const double *_openslide_tifflike_get_float_array(struct _openslide_tifflike *tl,
+                                                  int64_t dir, int32_t tag,
+                                                  int64_t *count,
+                                                  GError **err) {
+  *count = 0;
+  struct tiff_item *item = get_and_check_item(tl, dir, tag, err);
+  if (item == NULL || !populate_item(tl, item, err)) {
+    return NULL;
+  }
+  if (!item->floats) {
+    g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                "Unexpected value type: directory %"PRId64", "
+                "tag %d, type %d", dir, tag, item->type);
+    return NULL;
+  }
+  *count = item->count;
+  return item->floats;
+}
+
 const void *_openslide_tifflike_get_buffer(struct _openslide_tifflike *tl,
                                            int64_t dir, int32_t tag,
                                            GError **err) {
@@ -1205,26 +1703,25 @@ static bool hash_tiff_level(struct _openslide_hash *hash,
     return false;
   }
 
-  // get tile/strip count
-  int64_t count = _openslide_tifflike_get_value_count(tl, dir, offset_tag);
-  if (!count ||
-      count != _openslide_tifflike_get_value_count(tl, dir, length_tag)) {
-    g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
-                "Invalid tile/strip counts for directory %d", dir);
-    return false;
-  }
-
-  // get offset/length arrays
-  const uint64_t *offsets = _openslide_tifflike_get_uints(tl, dir, offset_tag,
-                                                          err);
+  // get offset/length arrays and their counts in one pass
+  int64_t count;
+  const uint64_t *offsets =
+    _openslide_tifflike_get_uint_array(tl, dir, offset_tag, &count, err);
   if (!offsets) {
     return false;
   }
-  const uint64_t *lengths = _openslide_tifflike_get_uints(tl, dir, length_tag,
-                                                          err);
+  int64_t length_count;
+  const uint64_t *lengths =
+    _openslide_tifflike_get_uint_array(tl, dir, length_tag, &length_count,
+                                       err);
   if (!lengths) {
     return false;
   }
+  if (count != length_count) {
+    g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                "Invalid tile/strip counts for directory %d", dir);
+    return false;
+  }
 
   // check total size
   int64_t total = 0;
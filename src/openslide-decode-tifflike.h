@@ -55,6 +55,9 @@ int64_t _openslide_tifflike_get_value_count(struct _openslide_tifflike *tl,
 // accessors
 // element accessor returns first element only
 // array accessor returns pointer to array of elements; do not free
+// bulk accessor additionally returns the element count, doing the
+// lookup and decode in one pass; the array is decoded once and stays
+// valid until the tifflike is destroyed
 
 // TIFF_BYTE, TIFF_SHORT, TIFF_LONG, TIFF_IFD
 uint64_t _openslide_tifflike_get_uint(struct _openslide_tifflike *tl,
@@ -65,6 +68,11 @@ const uint64_t *_openslide_tifflike_get_uints(struct _openslide_tifflike *tl,
                                               int64_t dir, int32_t tag,
                                               GError **err);
 
+const uint64_t *_openslide_tifflike_get_uint_array(struct _openslide_tifflike *tl,
+                                                   int64_t dir, int32_t tag,
+                                                   int64_t *count,
+                                                   GError **err);
+
 // if the file was detected as NDPI, heuristically add high-order bits to
 // the specified offset
 uint64_t _openslide_tifflike_uint_fix_offset_ndpi(struct _openslide_tifflike *tl,
@@ -79,6 +87,11 @@ const int64_t *_openslide_tifflike_get_sints(struct _openslide_tifflike *tl,
                                              int64_t dir, int32_t tag,
                                              GError **err);
 
+const int64_t *_openslide_tifflike_get_sint_array(struct _openslide_tifflike *tl,
+                                                  int64_t dir, int32_t tag,
+                                                  int64_t *count,
+                                                  GError **err);
+
 
 // TIFF_FLOAT, TIFF_DOUBLE, TIFF_RATIONAL, TIFF_SRATIONAL
 double _openslide_tifflike_get_float(struct _openslide_tifflike *tl,
@@ -89,6 +102,11 @@ const double *_openslide_tifflike_get_floats(struct _openslide_tifflike *tl,
                                              int64_t dir, int32_t tag,
                                              GError **err);
 
+const double *_openslide_tifflike_get_float_array(struct _openslide_tifflike *tl,
+                                                  int64_t dir, int32_t tag,
+                                                  int64_t *count,
+                                                  GError **err);
+
 
 // TIFF_ASCII, TIFF_BYTE, TIFF_UNDEFINED
 // guaranteed to be null-terminated
@@ -20,13 +20,16 @@
  */
 
 #include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <glib.h>
 #include <cairo.h>
 #include "openslide-private.h"
 
-#define RANGE_BIN_SIZE_MULTIPLIER 3
+#define RANGE_RTREE_NODE_CAPACITY 16
+// most extents collected for one preload planning pass
+#define PRELOAD_COLLECT_MAX 256
 #define COLOR_TILE 0.6, 0,   0,   0.3
 #define COLOR_BIN  0,   0,   0.6, 0.15
 
@@ -78,6 +81,9 @@ struct _openslide_grid {
 
   double tile_advance_x;
   double tile_advance_y;
+
+  // read_tile callback and its arg may be invoked from worker threads
+  bool concurrent_ok;
 };
 
 struct simple_grid {
@@ -86,6 +92,7 @@ struct simple_grid {
   int64_t tiles_across;
   int64_t tiles_down;
   _openslide_grid_simple_read_fn read_tile;
+  _openslide_grid_simple_extent_fn extent;
 };
 
 struct tilemap_grid {
@@ -94,6 +101,18 @@ struct tilemap_grid {
   GHashTable *tiles;
   _openslide_grid_tilemap_read_fn read_tile;
   GDestroyNotify destroy_tile;
+  _openslide_grid_simple_extent_fn extent;
+
+  // Morton-ordered array of the tiles in the hash table, rebuilt lazily
+  // on the next paint after tiles are added; lookups during paint walk
+  // this array rather than chasing hash buckets
+  GArray *index;
+  gint index_stale;
+#if !GLIB_CHECK_VERSION(2,31,0)
+  GMutex *index_lock;
+#else
+  GMutex index_lock;
+#endif
 
   // outer boundaries of grid
   double top;
@@ -123,15 +142,39 @@ struct tilemap_tile {
   double offset_y;
 };
 
+struct rtree_rect {
+  double x0;
+  double y0;
+  double x1;
+  double y1;
+};
+
+// must start with the rect so STR sorting can handle entries and nodes
+// with the same comparators
+struct range_rtree_entry {
+  struct rtree_rect rect;
+  struct range_tile *tile;
+};
+
+struct range_rtree_node {
+  struct rtree_rect rect;
+  // first child: an entry index for leaf nodes, a node index otherwise
+  int32_t first;
+  int32_t count;
+};
+
 struct range_grid {
   struct _openslide_grid base;
 
-  int bin_width;
-  int bin_height;
-
   GPtrArray *tiles;
-  GHashTable *bins_init;  // address -> GPtrArray<tile>
-  GHashTable *bins_runtime;  // address -> [tile]
+  bool adding;  // true until _openslide_grid_range_finish_adding_tiles()
+
+  // packed R-tree over the tile rects, STR-bulk-loaded at finish time;
+  // leaf nodes come first in the node array, the root is last
+  struct range_rtree_entry *rtree_entries;
+  struct range_rtree_node *rtree_nodes;
+  int32_t rtree_node_count;
+  int32_t rtree_leaf_node_count;
 
   _openslide_grid_range_read_fn read_tile;
   GDestroyNotify destroy_tile;
@@ -143,11 +186,6 @@ struct range_grid {
   double right;
 };
 
-struct range_bin_address {
-  int64_t col;
-  int64_t row;
-};
-
 struct range_tile {
   int64_t id;
   void *data;
@@ -176,6 +214,251 @@ static void compute_region(struct _openslide_grid *grid,
   region->offset_y = y - (region->start_tile_y * grid->tile_advance_y);
 }
 
+static const struct grid_ops simple_grid_ops;
+
+// a batch of concurrently-decoded tiles for one read_tiles() call
+struct tile_batch {
+  struct _openslide_grid *grid;
+  struct region *region;
+  struct _openslide_level *level;
+  int64_t tile_channel;
+  read_tiles_callback_fn callback;
+  void *arg;
+
+  // dimensions of the per-tile scratch surfaces
+  int32_t surface_w;
+  int32_t surface_h;
+
+#if !GLIB_CHECK_VERSION(2,31,0)
+  GMutex *lock;
+  GCond *cond;
+#else
+  GMutex lock;
+  GCond cond;
+#endif
+  int remaining;
+};
+
+struct tile_work {
+  struct tile_batch *batch;
+
+  int64_t tile_col;
+  int64_t tile_row;
+  double translate_x;
+  double translate_y;
+
+  cairo_surface_t *surface;
+  bool success;
+  GError *err;
+};
+
+// set while a pool worker is decoding; nested paints (e.g. rendering a
+// replacement for a missing tile from another level) must stay serial,
+// or a full pool of blocked workers could deadlock waiting on sub-work
+#if !GLIB_CHECK_VERSION(2,31,0)
+static GStaticPrivate in_tile_worker = G_STATIC_PRIVATE_INIT;
+#define tile_worker_thread() (g_static_private_get(&in_tile_worker) != NULL)
+#define tile_worker_mark() g_static_private_set(&in_tile_worker, \
+                                                GINT_TO_POINTER(1), NULL)
+#else
+static GPrivate in_tile_worker;
+#define tile_worker_thread() (g_private_get(&in_tile_worker) != NULL)
+#define tile_worker_mark() g_private_set(&in_tile_worker, GINT_TO_POINTER(1))
+#endif
+
+// runs on a worker thread: decode one tile into a private scratch surface
+static void read_tiles_worker(gpointer data, gpointer user_data G_GNUC_UNUSED) {
+  struct tile_work *work = data;
+  struct tile_batch *batch = work->batch;
+
+  tile_worker_mark();
+  _openslide_perf_set_current(batch->grid->osr);
+
+  work->surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+                                             batch->surface_w,
+                                             batch->surface_h);
+  cairo_t *cr = cairo_create(work->surface);
+  work->success = batch->callback(batch->grid, batch->region, cr,
+                                  batch->level,
+                                  work->tile_col, work->tile_row,
+                                  batch->tile_channel,
+                                  batch->arg, &work->err);
+  cairo_destroy(cr);
+
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_lock(batch->lock);
+  if (!--batch->remaining) {
+    g_cond_signal(batch->cond);
+  }
+  g_mutex_unlock(batch->lock);
+#else
+  g_mutex_lock(&batch->lock);
+  if (!--batch->remaining) {
+    g_cond_signal(&batch->cond);
+  }
+  g_mutex_unlock(&batch->lock);
+#endif
+}
+
+// fan tile decodes out across the shared worker pool, then composite
+// the scratch surfaces serially in the same order as the serial loop
+static bool read_tiles_parallel(cairo_t *cr,
+                                struct _openslide_level *level,
+                                struct _openslide_grid *grid,
+                                struct region *region,
+                                int64_t tile_channel,
+                                read_tiles_callback_fn callback,
+                                void *arg,
+                                GError **err) {
+  int64_t tiles_x = region->end_tile_x - region->start_tile_x;
+  int64_t tiles_y = region->end_tile_y - region->start_tile_y;
+  int64_t count = tiles_x * tiles_y;
+
+  struct tile_batch batch = {
+    .grid = grid,
+    .region = region,
+    .level = level,
+    .tile_channel = tile_channel,
+    .callback = callback,
+    .arg = arg,
+    .surface_w = ceil(grid->tile_advance_x),
+    .surface_h = ceil(grid->tile_advance_y),
+    .remaining = count,
+  };
+#if !GLIB_CHECK_VERSION(2,31,0)
+  batch.lock = g_mutex_new();
+  batch.cond = g_cond_new();
+#else
+  g_mutex_init(&batch.lock);
+  g_cond_init(&batch.cond);
+#endif
+
+  // batch the compressed-byte reads for the whole region into one
+  // submission before fanning out the decodes, so storage round trips
+  // overlap across tiles instead of being paid one worker at a time
+  struct simple_grid *sgrid = (struct simple_grid *) grid;
+  if (sgrid->extent) {
+    struct _openslide_tile_extent *extents =
+      g_new(struct _openslide_tile_extent, count);
+    int32_t n = 0;
+    for (int64_t tile_y = region->start_tile_y;
+         tile_y < region->end_tile_y; tile_y++) {
+      for (int64_t tile_x = region->start_tile_x;
+           tile_x < region->end_tile_x; tile_x++) {
+        if (sgrid->extent(grid->osr, level, tile_x, tile_y, &extents[n])) {
+          n++;
+        }
+      }
+    }
+    if (n) {
+      int64_t perf = _openslide_perf_begin();
+      _openslide_io_preload(extents, n);
+      _openslide_perf_end(_OPENSLIDE_PERF_IO, perf);
+    }
+    g_free(extents);
+  }
+
+  // dispatch
+  struct tile_work *works = g_new0(struct tile_work, count);
+  int64_t i = 0;
+  for (int64_t tile_y = region->end_tile_y - 1;
+       tile_y >= region->start_tile_y; tile_y--) {
+    for (int64_t tile_x = region->end_tile_x - 1;
+         tile_x >= region->start_tile_x; tile_x--) {
+      struct tile_work *work = &works[i++];
+      work->batch = &batch;
+      work->tile_col = tile_x;
+      work->tile_row = tile_y;
+      work->translate_x = ((tile_x - region->start_tile_x) *
+                           grid->tile_advance_x) - region->offset_x;
+      work->translate_y = ((tile_y - region->start_tile_y) *
+                           grid->tile_advance_y) - region->offset_y;
+      g_thread_pool_push(grid->osr->tile_pool, work, NULL);
+    }
+  }
+
+  // wait for completion
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_lock(batch.lock);
+  while (batch.remaining) {
+    g_cond_wait(batch.cond, batch.lock);
+  }
+  g_mutex_unlock(batch.lock);
+#else
+  g_mutex_lock(&batch.lock);
+  while (batch.remaining) {
+    g_cond_wait(&batch.cond, &batch.lock);
+  }
+  g_mutex_unlock(&batch.lock);
+#endif
+
+  // composite
+  int64_t perf = _openslide_perf_begin();
+  bool success = true;
+  cairo_matrix_t matrix;
+  cairo_get_matrix(cr, &matrix);
+  for (i = 0; i < count; i++) {
+    struct tile_work *work = &works[i];
+    if (!work->success) {
+      if (success) {
+        // propagate the first error
+        g_propagate_error(err, work->err);
+        work->err = NULL;
+        success = false;
+      }
+      continue;
+    }
+    if (success) {
+      cairo_translate(cr, work->translate_x, work->translate_y);
+      cairo_set_source_surface(cr, work->surface, 0, 0);
+      cairo_paint(cr);
+      cairo_set_matrix(cr, &matrix);
+    }
+  }
+  _openslide_perf_end(_OPENSLIDE_PERF_COMPOSITE, perf);
+
+  // clean up
+  for (i = 0; i < count; i++) {
+    if (works[i].surface) {
+      cairo_surface_destroy(works[i].surface);
+    }
+    g_clear_error(&works[i].err);
+  }
+  g_free(works);
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_free(batch.lock);
+  g_cond_free(batch.cond);
+#else
+  g_mutex_clear(&batch.lock);
+  g_cond_clear(&batch.cond);
+#endif
+
+  return success;
+}
+
+void _openslide_grid_enable_concurrent_read(struct _openslide_grid *grid) {
+  grid->concurrent_ok = true;
+}
+
+void _openslide_grid_simple_set_extent_lookup(struct _openslide_grid *grid,
+                                              _openslide_grid_simple_extent_fn extent) {
+  g_assert(grid->ops == &simple_grid_ops);
+  struct simple_grid *sgrid = (struct simple_grid *) grid;
+  sgrid->extent = extent;
+}
+
+void _openslide_grid_set_tile_worker_count(openslide_t *osr, int32_t count) {
+  if (osr->tile_pool) {
+    // waits for any queued work
+    g_thread_pool_free(osr->tile_pool, false, true);
+    osr->tile_pool = NULL;
+  }
+  if (count > 0) {
+    osr->tile_pool = g_thread_pool_new(read_tiles_worker, NULL,
+                                       count, true, NULL);
+  }
+}
+
 static bool read_tiles(cairo_t *cr,
                        struct _openslide_level *level,
                        struct _openslide_grid *grid,
@@ -196,6 +479,18 @@ static bool read_tiles(cairo_t *cr,
     return false;
   }
 
+  // decode concurrently when the backend declared its callback
+  // thread-safe and a worker pool is attached; only the simple grid
+  // guarantees tiles fit in advance-sized scratch surfaces
+  if (grid->concurrent_ok && grid->osr->tile_pool &&
+      !tile_worker_thread() &&
+      grid->ops == &simple_grid_ops &&
+      (region->end_tile_x - region->start_tile_x) *
+      (region->end_tile_y - region->start_tile_y) > 1) {
+    return read_tiles_parallel(cr, level, grid, region, tile_channel,
+                               callback, arg, err);
+  }
+
   //  cairo_set_source_rgb(cr, 0, 1, 0);
   //  cairo_paint(cr);
   //g_debug("offset: %d %d", region->offset_x, region->offset_y);
@@ -391,6 +686,105 @@ static void tilemap_tile_hash_destroy_value(gpointer data) {
   g_slice_free(struct tilemap_tile, tile);
 }
 
+struct tilemap_index_entry {
+  uint64_t key;
+  struct tilemap_tile *tile;
+};
+
+// spread the low 32 bits of v across the even bits of the result
+static uint64_t tilemap_morton_spread(uint64_t v) {
+  v &= G_GUINT64_CONSTANT(0xffffffff);
+  v = (v | (v << 16)) & G_GUINT64_CONSTANT(0x0000ffff0000ffff);
+  v = (v | (v << 8))  & G_GUINT64_CONSTANT(0x00ff00ff00ff00ff);
+  v = (v | (v << 4))  & G_GUINT64_CONSTANT(0x0f0f0f0f0f0f0f0f);
+  v = (v | (v << 2))  & G_GUINT64_CONSTANT(0x3333333333333333);
+  v = (v | (v << 1))  & G_GUINT64_CONSTANT(0x5555555555555555);
+  return v;
+}
+
+static uint64_t tilemap_morton_key(int64_t col, int64_t row) {
+  // assume 32-bit coordinates, like the hash function
+  return (tilemap_morton_spread((uint64_t) row) << 1) |
+         tilemap_morton_spread((uint64_t) col);
+}
+
+static gint tilemap_index_entry_compare(gconstpointer a, gconstpointer b) {
+  const struct tilemap_index_entry *e_a = a;
+  const struct tilemap_index_entry *e_b = b;
+
+  if (e_a->key < e_b->key) {
+    return -1;
+  } else if (e_a->key > e_b->key) {
+    return 1;
+  } else {
+    return 0;
+  }
+}
+
+// rebuild the Morton index if tiles have been added since the last paint.
+// Tiles are only added before the grid is first painted (or, for lazily
+// expanded levels, under the backend's lock before the expanding paint
+// proceeds), so the index is immutable while any paint is in flight; the
+// lock only serializes concurrent first paints.
+static void tilemap_index_ensure(struct tilemap_grid *grid) {
+  if (!g_atomic_int_get(&grid->index_stale)) {
+    return;
+  }
+
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_lock(grid->index_lock);
+#else
+  g_mutex_lock(&grid->index_lock);
+#endif
+  if (g_atomic_int_get(&grid->index_stale)) {
+    g_array_set_size(grid->index, 0);
+
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, grid->tiles);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+      struct tilemap_tile *tile = value;
+      struct tilemap_index_entry entry = {
+        .key = tilemap_morton_key(tile->col, tile->row),
+        .tile = tile,
+      };
+      g_array_append_val(grid->index, entry);
+    }
+    g_array_sort(grid->index, tilemap_index_entry_compare);
+
+    g_atomic_int_set(&grid->index_stale, 0);
+  }
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_unlock(grid->index_lock);
+#else
+  g_mutex_unlock(&grid->index_lock);
+#endif
+}
+
+static struct tilemap_tile *tilemap_index_lookup(struct tilemap_grid *grid,
+                                                 int64_t col, int64_t row) {
+  const struct tilemap_index_entry *entries =
+    (const struct tilemap_index_entry *) grid->index->data;
+  uint64_t key = tilemap_morton_key(col, row);
+
+  // binary search; keys are compared in place, so probes for adjacent
+  // tiles stay within a few cache lines of the Morton-sorted array
+  size_t lo = 0;
+  size_t hi = grid->index->len;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (entries[mid].key < key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo < grid->index->len && entries[lo].key == key) {
+    return entries[lo].tile;
+  }
+  return NULL;
+}
+
 static void tilemap_get_bounds(struct _openslide_grid *_grid,
                                struct bounds *bounds) {
   struct tilemap_grid *grid = (struct tilemap_grid *) _grid;
@@ -412,11 +806,7 @@ static bool tilemap_read_tile(struct _openslide_grid *_grid,
                               GError **err) {
   struct tilemap_grid *grid = (struct tilemap_grid *) _grid;
 
-  struct tilemap_tile coords = {
-    .col = tile_col,
-    .row = tile_row,
-  };
-  struct tilemap_tile *tile = g_hash_table_lookup(grid->tiles, &coords);
+  struct tilemap_tile *tile = tilemap_index_lookup(grid, tile_col, tile_row);
   if (tile == NULL) {
     //g_debug("no tile at %"PRId64", %"PRId64, tile_col, tile_row);
     return true;
@@ -463,6 +853,8 @@ static bool tilemap_paint_region(struct _openslide_grid *_grid,
   struct tilemap_grid *grid = (struct tilemap_grid *) _grid;
   struct region region;
 
+  tilemap_index_ensure(grid);
+
   compute_region(_grid, x, y, w, h, &region);
 
   //g_debug("coords: %g %g", x, y);
@@ -482,6 +874,33 @@ static bool tilemap_paint_region(struct _openslide_grid *_grid,
                   -grid->extra_tiles_left * grid->base.tile_advance_x,
                   -grid->extra_tiles_top * grid->base.tile_advance_y);
 
+  // plan the I/O: collect the byte ranges of every tile contributing
+  // to this paint so the preload can sort and coalesce them into a few
+  // sequential reads, instead of one scattered read per tile as the
+  // paint crosses area-of-interest boundaries
+  if (grid->extent) {
+    struct _openslide_tile_extent extents[PRELOAD_COLLECT_MAX];
+    int32_t n = 0;
+    for (int64_t tile_y = region.start_tile_y;
+         tile_y < region.end_tile_y && n < PRELOAD_COLLECT_MAX; tile_y++) {
+      for (int64_t tile_x = region.start_tile_x;
+           tile_x < region.end_tile_x && n < PRELOAD_COLLECT_MAX; tile_x++) {
+        struct tilemap_tile *tile = tilemap_index_lookup(grid,
+                                                         tile_x, tile_y);
+        if (tile &&
+            grid->extent(grid->base.osr, level, tile->col, tile->row,
+                         &extents[n])) {
+          n++;
+        }
+      }
+    }
+    if (n) {
+      int64_t perf = _openslide_perf_begin();
+      _openslide_io_preload(extents, n);
+      _openslide_perf_end(_OPENSLIDE_PERF_IO, perf);
+    }
+  }
+
   // read
   bool result = read_tiles(cr, level, _grid, &region, channel,
                            tilemap_read_tile, arg, err);
@@ -495,6 +914,12 @@ static bool tilemap_paint_region(struct _openslide_grid *_grid,
 static void tilemap_destroy(struct _openslide_grid *_grid) {
   struct tilemap_grid *grid = (struct tilemap_grid *) _grid;
 
+  g_array_free(grid->index, true);
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_free(grid->index_lock);
+#else
+  g_mutex_clear(&grid->index_lock);
+#endif
   g_hash_table_destroy(grid->tiles);
   g_slice_free(struct tilemap_grid, grid);
 }
@@ -524,6 +949,7 @@ void _openslide_grid_tilemap_add_tile(struct _openslide_grid *_grid,
   tile->data = data;
 
   g_hash_table_replace(grid->tiles, tile, tile);
+  g_atomic_int_set(&grid->index_stale, 1);
 
   grid->left = MIN(col * grid->base.tile_advance_x + offset_x,
                    grid->left);
@@ -560,6 +986,13 @@ void _openslide_grid_tilemap_add_tile(struct _openslide_grid *_grid,
   //g_debug("%p: extra_left: %d, extra_right: %d, extra_top: %d, extra_bottom: %d", (void *) grid, grid->extra_tiles_left, grid->extra_tiles_right, grid->extra_tiles_top, grid->extra_tiles_bottom);
 }
 
+void _openslide_grid_tilemap_set_extent_lookup(struct _openslide_grid *_grid,
+                                               _openslide_grid_simple_extent_fn extent) {
+  struct tilemap_grid *grid = (struct tilemap_grid *) _grid;
+  g_assert(grid->base.ops == &tilemap_grid_ops);
+  grid->extent = extent;
+}
+
 struct _openslide_grid *_openslide_grid_create_tilemap(openslide_t *osr,
                                                        double tile_advance_x,
                                                        double tile_advance_y,
@@ -583,32 +1016,121 @@ struct _openslide_grid *_openslide_grid_create_tilemap(openslide_t *osr,
                                       NULL,
                                       tilemap_tile_hash_destroy_value);
 
+  grid->index = g_array_new(false, false,
+                            sizeof(struct tilemap_index_entry));
+#if !GLIB_CHECK_VERSION(2,31,0)
+  grid->index_lock = g_mutex_new();
+#else
+  g_mutex_init(&grid->index_lock);
+#endif
+
   return (struct _openslide_grid *) grid;
 }
 
 
 
-static guint range_bin_address_hash_func(gconstpointer key) {
-  const struct range_bin_address *addr = key;
+static bool rtree_rect_intersects(const struct rtree_rect *a,
+                                  const struct rtree_rect *b) {
+  return a->x0 < b->x1 && a->x1 > b->x0 &&
+         a->y0 < b->y1 && a->y1 > b->y0;
+}
 
-  // assume 32-bit hash
-  return (guint) ((34369 * (uint64_t) addr->row) + ((uint64_t) addr->col));
+static int rtree_rect_compare_center_x(const void *a, const void *b) {
+  const struct rtree_rect *r_a = a;
+  const struct rtree_rect *r_b = b;
+
+  // compare doubled centers; same ordering
+  double c_a = r_a->x0 + r_a->x1;
+  double c_b = r_b->x0 + r_b->x1;
+  if (c_a < c_b) {
+    return -1;
+  } else if (c_a > c_b) {
+    return 1;
+  } else {
+    return 0;
+  }
 }
 
-static gboolean range_bin_address_hash_key_equal(gconstpointer a,
-                                                 gconstpointer b) {
-  const struct range_bin_address *c_a = a;
-  const struct range_bin_address *c_b = b;
+static int rtree_rect_compare_center_y(const void *a, const void *b) {
+  const struct rtree_rect *r_a = a;
+  const struct rtree_rect *r_b = b;
 
-  return (c_a->col == c_b->col) && (c_a->row == c_b->row);
+  double c_a = r_a->y0 + r_a->y1;
+  double c_b = r_b->y0 + r_b->y1;
+  if (c_a < c_b) {
+    return -1;
+  } else if (c_a > c_b) {
+    return 1;
+  } else {
+    return 0;
+  }
 }
 
-static void range_bin_address_free(void *data) {
-  g_slice_free(struct range_bin_address, data);
+// Sort-Tile-Recursive ordering: sort by center x, cut into vertical
+// slices, sort each slice by center y.  Consecutive runs of
+// RANGE_RTREE_NODE_CAPACITY items then form spatially compact nodes.
+// Works on any array whose elements begin with a struct rtree_rect.
+static void range_rtree_str_sort(void *items, int32_t count,
+                                 size_t item_size) {
+  qsort(items, count, item_size, rtree_rect_compare_center_x);
+
+  int32_t node_count = (count + RANGE_RTREE_NODE_CAPACITY - 1) /
+                       RANGE_RTREE_NODE_CAPACITY;
+  int32_t slices = ceil(sqrt((double) node_count));
+  int32_t per_slice = (count + slices - 1) / slices;
+  for (int32_t start = 0; start < count; start += per_slice) {
+    qsort((char *) items + (size_t) start * item_size,
+          MIN(per_slice, count - start), item_size,
+          rtree_rect_compare_center_y);
+  }
 }
 
-static void range_ptr_array_free(void *data) {
-  g_ptr_array_free(data, true);
+struct range_rtree_query {
+  const struct range_grid *grid;
+  struct rtree_rect rect;
+  GList *tiles;
+
+  // for debug labeling of visited leaf nodes
+  cairo_t *cr;
+  const cairo_matrix_t *matrix;
+  double region_x;
+  double region_y;
+};
+
+static void range_rtree_query_node(struct range_rtree_query *query,
+                                   int32_t node_index) {
+  const struct range_grid *grid = query->grid;
+  const struct range_rtree_node *node = &grid->rtree_nodes[node_index];
+
+  if (node_index < grid->rtree_leaf_node_count) {
+    for (int32_t i = 0; i < node->count; i++) {
+      const struct range_rtree_entry *entry =
+        &grid->rtree_entries[node->first + i];
+      if (rtree_rect_intersects(&entry->rect, &query->rect)) {
+        query->tiles = g_list_prepend(query->tiles, entry->tile);
+      }
+    }
+    if (_openslide_debug(OPENSLIDE_DEBUG_TILES)) {
+      char *coordinates = g_strdup_printf("%"PRId32, node_index);
+      cairo_translate(query->cr,
+                      node->rect.x0 - query->region_x,
+                      node->rect.y0 - query->region_y);
+      label_tile(query->cr, COLOR_BIN,
+                 node->rect.x1 - node->rect.x0,
+                 node->rect.y1 - node->rect.y0,
+                 coordinates);
+      cairo_set_matrix(query->cr, (cairo_matrix_t *) query->matrix);
+      g_free(coordinates);
+    }
+  } else {
+    for (int32_t i = 0; i < node->count; i++) {
+      int32_t child = node->first + i;
+      if (rtree_rect_intersects(&grid->rtree_nodes[child].rect,
+                                &query->rect)) {
+        range_rtree_query_node(query, child);
+      }
+    }
+  }
 }
 
 static int range_compare_tiles(gconstpointer a, gconstpointer b) {
@@ -648,66 +1170,40 @@ static bool range_paint_region(struct _openslide_grid *_grid,
                                int32_t w, int32_t h,
                                GError **err) {
   struct range_grid *grid = (struct range_grid *) _grid;
-  GList *tiles = NULL;
   bool result = false;
 
   // ensure _openslide_grid_range_finish_adding_tiles() was called
-  g_assert(grid->bins_runtime);
+  g_assert(!grid->adding);
 
   // save
   cairo_matrix_t matrix;
   cairo_get_matrix(cr, &matrix);
 
-  // accumulate relevant tiles
-  struct range_bin_address addr;
-  for (addr.row = y / grid->bin_height;
-       addr.row < (int64_t) (y + h + grid->bin_height - 1) / grid->bin_height;
-       addr.row++) {
-    for (addr.col = x / grid->bin_width;
-         addr.col < (int64_t) (x + w + grid->bin_width - 1) / grid->bin_width;
-         addr.col++) {
-      struct range_tile **cur = g_hash_table_lookup(grid->bins_runtime,
-                                                    &addr);
-      if (cur) {
-        for (; *cur; cur++) {
-          struct range_tile *tile = *cur;
-          // skip tile if it's outside the requested region
-          if (tile->x + tile->w <= x ||
-              tile->y + tile->h <= y ||
-              tile->x >= x + w ||
-              tile->y >= y + h) {
-            //g_debug("skip x %g w %g y %g h %g, region x %g w %d y %g h %d", tile->x, tile->w, tile->y, tile->h, x, w, y, h);
-            continue;
-          }
-          tiles = g_list_prepend(tiles, tile);
-        }
-      }
-      if (_openslide_debug(OPENSLIDE_DEBUG_TILES)) {
-        char *coordinates = g_strdup_printf("%"PRId64", %"PRId64,
-                                            addr.col, addr.row);
-        cairo_translate(cr,
-                        addr.col * grid->bin_width - x,
-                        addr.row * grid->bin_height - y);
-        label_tile(cr, COLOR_BIN,
-                   grid->bin_width, grid->bin_height,
-                   coordinates);
-        cairo_set_matrix(cr, &matrix);
-        g_free(coordinates);
-      }
-    }
+  // accumulate relevant tiles; one descent from the root visits only
+  // the leaf nodes whose bounding boxes overlap the region
+  struct range_rtree_query query = {
+    .grid = grid,
+    .rect = {
+      .x0 = x,
+      .y0 = y,
+      .x1 = x + w,
+      .y1 = y + h,
+    },
+    .cr = cr,
+    .matrix = &matrix,
+    .region_x = x,
+    .region_y = y,
+  };
+  if (grid->rtree_node_count) {
+    range_rtree_query_node(&query, grid->rtree_node_count - 1);
   }
-  tiles = g_list_sort(tiles, range_compare_tiles);
+  GList *tiles = g_list_sort(query.tiles, range_compare_tiles);
 
-  // draw tiles
-  struct range_tile *prev_tile = NULL;
+  // draw tiles; each tile appears in exactly one leaf entry, so no
+  // duplicate suppression is needed
   for (GList *cur = tiles; cur; cur = cur->next) {
     // get tile struct
     struct range_tile *tile = cur->data;
-    if (tile == prev_tile) {
-      //g_debug("skipping repeated tile");
-      continue;
-    }
-    prev_tile = tile;
 
     // draw
     //g_debug("tile x %g y %g", tile->x, tile->y);
@@ -737,12 +1233,8 @@ DONE:
 static void range_destroy(struct _openslide_grid *_grid) {
   struct range_grid *grid = (struct range_grid *) _grid;
 
-  if (grid->bins_init) {
-    g_hash_table_destroy(grid->bins_init);
-  }
-  if (grid->bins_runtime) {
-    g_hash_table_destroy(grid->bins_runtime);
-  }
+  g_free(grid->rtree_entries);
+  g_free(grid->rtree_nodes);
   for (uint64_t cur = 0; cur < grid->tiles->len; cur++) {
     struct range_tile *tile = grid->tiles->pdata[cur];
     if (grid->destroy_tile && tile->data) {
@@ -766,7 +1258,7 @@ void _openslide_grid_range_add_tile(struct _openslide_grid *_grid,
                                     void *data) {
   struct range_grid *grid = (struct range_grid *) _grid;
   g_assert(grid->base.ops == &range_grid_ops);
-  g_assert(grid->bins_init);
+  g_assert(grid->adding);
 
   struct range_tile *tile = g_slice_new0(struct range_tile);
   tile->id = grid->tiles->len;
@@ -777,62 +1269,98 @@ void _openslide_grid_range_add_tile(struct _openslide_grid *_grid,
   tile->h = h;
   g_ptr_array_add(grid->tiles, tile);
 
-  struct range_bin_address addr;
-  for (addr.row = y / grid->bin_height;
-       addr.row < (int64_t) (y + h + grid->bin_height - 1) / grid->bin_height;
-       addr.row++) {
-    for (addr.col = x / grid->bin_width;
-         addr.col < (int64_t) (x + w + grid->bin_width - 1) / grid->bin_width;
-         addr.col++) {
-      GPtrArray *bin = g_hash_table_lookup(grid->bins_init, &addr);
-      if (!bin) {
-        bin = g_ptr_array_new();
-        struct range_bin_address *addr2 =
-          g_slice_new(struct range_bin_address);
-        addr2->col = addr.col;
-        addr2->row = addr.row;
-        g_hash_table_insert(grid->bins_init, addr2, bin);
-      }
-      g_ptr_array_add(bin, tile);
-    }
-  }
-
   grid->left = MIN(x, grid->left);
   grid->top = MIN(y, grid->top);
   grid->right = MAX(x + w, grid->right);
   grid->bottom = MAX(y + h, grid->bottom);
 }
 
-static void range_postprocess_bin(void *key, void *value, void *data) {
-  struct range_grid *grid = data;
-  GPtrArray *tiles = value;
-
-  struct range_tile **tile_array = g_new(struct range_tile *, tiles->len + 1);
-  memcpy(tile_array, tiles->pdata, tiles->len * sizeof(struct range_tile *));
-  tile_array[tiles->len] = NULL;
-  g_ptr_array_free(tiles, true);
-
-  g_hash_table_replace(grid->bins_runtime, key, tile_array);
-}
-
 void _openslide_grid_range_finish_adding_tiles(struct _openslide_grid *_grid) {
   struct range_grid *grid = (struct range_grid *) _grid;
   g_assert(grid->base.ops == &range_grid_ops);
-  g_assert(grid->bins_init);
+  g_assert(grid->adding);
+  grid->adding = false;
+
+  int32_t count = grid->tiles->len;
+  if (!count) {
+    return;
+  }
+
+  // leaf entries in STR order
+  struct range_rtree_entry *entries =
+    g_new(struct range_rtree_entry, count);
+  for (int32_t i = 0; i < count; i++) {
+    struct range_tile *tile = grid->tiles->pdata[i];
+    entries[i].rect.x0 = tile->x;
+    entries[i].rect.y0 = tile->y;
+    entries[i].rect.x1 = tile->x + tile->w;
+    entries[i].rect.y1 = tile->y + tile->h;
+    entries[i].tile = tile;
+  }
+  range_rtree_str_sort(entries, count, sizeof(*entries));
+
+  // pack levels bottom-up into one contiguous array; children are
+  // referenced by index, so nodes within a level can be re-sorted into
+  // STR order before their parents are packed
+  GArray *nodes = g_array_new(false, false,
+                              sizeof(struct range_rtree_node));
+  for (int32_t start = 0; start < count;
+       start += RANGE_RTREE_NODE_CAPACITY) {
+    struct range_rtree_node node = {
+      .rect = entries[start].rect,
+      .first = start,
+      .count = MIN(RANGE_RTREE_NODE_CAPACITY, count - start),
+    };
+    for (int32_t i = 1; i < node.count; i++) {
+      const struct rtree_rect *r = &entries[start + i].rect;
+      node.rect.x0 = MIN(node.rect.x0, r->x0);
+      node.rect.y0 = MIN(node.rect.y0, r->y0);
+      node.rect.x1 = MAX(node.rect.x1, r->x1);
+      node.rect.y1 = MAX(node.rect.y1, r->y1);
+    }
+    g_array_append_val(nodes, node);
+  }
+  grid->rtree_leaf_node_count = nodes->len;
+
+  int32_t level_first = 0;
+  int32_t level_count = nodes->len;
+  while (level_count > 1) {
+    range_rtree_str_sort(&g_array_index(nodes, struct range_rtree_node,
+                                        level_first),
+                         level_count, sizeof(struct range_rtree_node));
+    int32_t next_first = nodes->len;
+    for (int32_t start = 0; start < level_count;
+         start += RANGE_RTREE_NODE_CAPACITY) {
+      struct range_rtree_node node = {
+        .first = level_first + start,
+        .count = MIN(RANGE_RTREE_NODE_CAPACITY, level_count - start),
+      };
+      node.rect = g_array_index(nodes, struct range_rtree_node,
+                                node.first).rect;
+      for (int32_t i = 1; i < node.count; i++) {
+        const struct rtree_rect *r =
+          &g_array_index(nodes, struct range_rtree_node,
+                         node.first + i).rect;
+        node.rect.x0 = MIN(node.rect.x0, r->x0);
+        node.rect.y0 = MIN(node.rect.y0, r->y0);
+        node.rect.x1 = MAX(node.rect.x1, r->x1);
+        node.rect.y1 = MAX(node.rect.y1, r->y1);
+      }
+      g_array_append_val(nodes, node);
+    }
+    level_first = next_first;
+    level_count = nodes->len - next_first;
+  }
 
-  grid->bins_runtime = g_hash_table_new_full(range_bin_address_hash_func,
-                                             range_bin_address_hash_key_equal,
-                                             range_bin_address_free,
-                                             g_free);
-  g_hash_table_foreach(grid->bins_init, range_postprocess_bin, grid);
-  g_hash_table_steal_all(grid->bins_init);
-  g_hash_table_destroy(grid->bins_init);
-  grid->bins_init = NULL;
+  grid->rtree_entries = entries;
+  grid->rtree_node_count = nodes->len;
+  grid->rtree_nodes =
+    (struct range_rtree_node *) g_array_free(nodes, false);
 }
 
 struct _openslide_grid *_openslide_grid_create_range(openslide_t *osr,
-                                                     int typical_tile_width,
-                                                     int typical_tile_height,
+                                                     int typical_tile_width G_GNUC_UNUSED,
+                                                     int typical_tile_height G_GNUC_UNUSED,
                                                      _openslide_grid_range_read_fn read_tile,
                                                      GDestroyNotify destroy_tile) {
   struct range_grid *grid = g_slice_new0(struct range_grid);
@@ -840,13 +1368,8 @@ struct _openslide_grid *_openslide_grid_create_range(openslide_t *osr,
   grid->base.ops = &range_grid_ops;
   grid->base.tile_advance_x = NAN;  // unused
   grid->base.tile_advance_y = NAN;  // unused
-  grid->bin_width = typical_tile_width * RANGE_BIN_SIZE_MULTIPLIER;
-  grid->bin_height = typical_tile_height * RANGE_BIN_SIZE_MULTIPLIER;
   grid->tiles = g_ptr_array_new();
-  grid->bins_init = g_hash_table_new_full(range_bin_address_hash_func,
-                                          range_bin_address_hash_key_equal,
-                                          range_bin_address_free,
-                                          range_ptr_array_free);
+  grid->adding = true;
   grid->read_tile = read_tile;
   grid->destroy_tile = destroy_tile;
 
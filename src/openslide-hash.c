@@ -31,23 +31,128 @@
 #include <string.h>
 #include <glib.h>
 
+// When set, the SHA256 is not run at open time; hash inputs are
+// journaled in order and replayed on first access to the
+// openslide.quickhash-1 property, so interactive open isn't gated on
+// hashing the whole lowest-resolution level.
+#define DEFER_QUICKHASH_ENV "OPENSLIDE_DEFER_QUICKHASH"
+
+// When set, the hash is computed as a tree instead of one sequential
+// SHA256: each input is split into fixed-size leaves, the leaves of a
+// file segment are read and hashed by one thread per core, and the
+// root hashes the leaf digests in input order.  The result is a
+// different value from quickhash-1, so it is published as the
+// openslide.quickhash-2 property instead.
+#define TREE_QUICKHASH_ENV "OPENSLIDE_TREE_QUICKHASH"
+
+// leaf size for tree mode; large enough that per-leaf overhead
+// vanishes, small enough to spread one level across all cores
+#define TREE_CHUNK_SIZE (4 << 20)
+
+// SHA256 digest size
+#define TREE_DIGEST_SIZE 32
+
+// one journaled hash input: an owned copy of a metadata buffer, or a
+// segment of a file to be read at resolve time
+struct hash_op {
+  void *data;  // NULL for a file segment
+  int32_t datalen;
+
+  char *filename;
+  int64_t offset;
+  int64_t size;
+};
+
 struct _openslide_hash {
-  GChecksum *checksum;
+  GChecksum *checksum;  // the root context in tree mode
   bool enabled;
+  bool tree;    // hash tree mode (quickhash-2)
+  GQueue *ops;  // journaled inputs; NULL when hashing eagerly
+  int64_t elapsed_us;  // wall time spent reading and hashing inputs
 };
 
+static int64_t hash_now_us(void) {
+#if GLIB_CHECK_VERSION(2,28,0)
+  return g_get_monotonic_time();
+#else
+  GTimeVal tv;
+  g_get_current_time(&tv);
+  return (int64_t) tv.tv_sec * G_USEC_PER_SEC + tv.tv_usec;
+#endif
+}
+
+static void hash_op_free(gpointer data) {
+  struct hash_op *op = data;
+  g_free(op->data);
+  g_free(op->filename);
+  g_slice_free(struct hash_op, op);
+}
+
+static void hash_op_free_func(gpointer data,
+                              gpointer user_data G_GNUC_UNUSED) {
+  hash_op_free(data);
+}
+
+static void hash_ops_free(GQueue *ops) {
+  g_queue_foreach(ops, hash_op_free_func, NULL);
+  g_queue_free(ops);
+}
+
 struct _openslide_hash *_openslide_hash_quickhash1_create(void) {
   struct _openslide_hash *hash = g_slice_new(struct _openslide_hash);
   hash->checksum = g_checksum_new(G_CHECKSUM_SHA256);
   hash->enabled = true;
+  hash->tree = g_getenv(TREE_QUICKHASH_ENV) != NULL;
+  hash->ops = g_getenv(DEFER_QUICKHASH_ENV) ? g_queue_new() : NULL;
+  hash->elapsed_us = 0;
 
   return hash;
 }
 
+bool _openslide_hash_is_tree(struct _openslide_hash *hash) {
+  return hash->tree;
+}
+
+// fold one input into the hash.  In tree mode each input becomes one
+// or more fixed-size leaves whose digests feed the root context; leaf
+// boundaries are relative to the start of the input, matching the
+// chunk indexing of the parallel file reader
+static void hash_update(struct _openslide_hash *hash,
+                        const void *data, int64_t len) {
+  if (!hash->tree) {
+    g_checksum_update(hash->checksum, data, len);
+    return;
+  }
+
+  const uint8_t *p = data;
+  while (len > 0) {
+    int64_t n = MIN(len, (int64_t) TREE_CHUNK_SIZE);
+    GChecksum *leaf = g_checksum_new(G_CHECKSUM_SHA256);
+    g_checksum_update(leaf, p, n);
+    uint8_t digest[TREE_DIGEST_SIZE];
+    gsize digest_len = sizeof(digest);
+    g_checksum_get_digest(leaf, digest, &digest_len);
+    g_checksum_free(leaf);
+    g_checksum_update(hash->checksum, digest, digest_len);
+    p += n;
+    len -= n;
+  }
+}
+
 void _openslide_hash_data(struct _openslide_hash *hash, const void *data,
                           int32_t datalen) {
   if (hash && hash->enabled && data && datalen) {
-    g_checksum_update(hash->checksum, data, datalen);
+    int64_t begin = hash_now_us();
+    if (hash->ops) {
+      struct hash_op *op = g_slice_new0(struct hash_op);
+      op->data = g_malloc(datalen);
+      memcpy(op->data, data, datalen);
+      op->datalen = datalen;
+      g_queue_push_tail(hash->ops, op);
+    } else {
+      hash_update(hash, data, datalen);
+    }
+    hash->elapsed_us += hash_now_us() - begin;
   }
 }
 
@@ -61,11 +166,120 @@ bool _openslide_hash_file(struct _openslide_hash *hash, const char *filename,
   return _openslide_hash_file_part(hash, filename, 0, -1, err);
 }
 
-bool _openslide_hash_file_part(struct _openslide_hash *hash,
-			       const char *filename,
-			       int64_t offset, int64_t size,
-			       GError **err) {
+// one worker of the parallel tree reader: hashes every stride'th leaf
+// of the segment through a private file handle, so reads from
+// different workers overlap in the I/O queue
+struct tree_chunk_job {
+  const char *filename;
+  int64_t offset;    // segment start in the file
+  int64_t size;      // segment size
+  int64_t first;     // first leaf index for this worker
+  int64_t stride;    // total worker count
+  uint8_t *digests;  // shared output, TREE_DIGEST_SIZE bytes per leaf
+  GThread *thread;
+  bool success;
+  GError *err;
+};
+
+static gpointer tree_chunk_thread(gpointer data) {
+  struct tree_chunk_job *job = data;
+
+  FILE *f = _openslide_fopen(job->filename, "rb", &job->err);
+  if (f == NULL) {
+    return NULL;
+  }
+  uint8_t *buf = g_malloc(TREE_CHUNK_SIZE);
+
+  int64_t leaves = (job->size + TREE_CHUNK_SIZE - 1) / TREE_CHUNK_SIZE;
+  for (int64_t i = job->first; i < leaves; i += job->stride) {
+    int64_t leaf_off = i * (int64_t) TREE_CHUNK_SIZE;
+    int64_t leaf_len = MIN((int64_t) TREE_CHUNK_SIZE, job->size - leaf_off);
+    if (fseeko(f, job->offset + leaf_off, SEEK_SET) ||
+        (int64_t) fread(buf, 1, leaf_len, f) != leaf_len) {
+      g_set_error(&job->err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                  "Can't read from %s", job->filename);
+      goto DONE;
+    }
+    GChecksum *leaf = g_checksum_new(G_CHECKSUM_SHA256);
+    g_checksum_update(leaf, buf, leaf_len);
+    gsize digest_len = TREE_DIGEST_SIZE;
+    g_checksum_get_digest(leaf, job->digests + i * TREE_DIGEST_SIZE,
+                          &digest_len);
+    g_checksum_free(leaf);
+  }
+  job->success = true;
+
+DONE:
+  g_free(buf);
+  fclose(f);
+  return NULL;
+}
+
+// read and hash a file segment as tree leaves, one thread per core
+static bool tree_file_part(struct _openslide_hash *hash,
+                           const char *filename,
+                           int64_t offset, int64_t size,
+                           GError **err) {
+  int64_t leaves = (size + TREE_CHUNK_SIZE - 1) / TREE_CHUNK_SIZE;
+  if (leaves == 0) {
+    return true;
+  }
+  int64_t workers = MIN((int64_t) g_get_num_processors(), leaves);
+  uint8_t *digests = g_malloc(leaves * TREE_DIGEST_SIZE);
+  struct tree_chunk_job *jobs = g_new0(struct tree_chunk_job, workers);
+
+  for (int64_t i = 0; i < workers; i++) {
+    struct tree_chunk_job *job = &jobs[i];
+    job->filename = filename;
+    job->offset = offset;
+    job->size = size;
+    job->first = i;
+    job->stride = workers;
+    job->digests = digests;
+#if !GLIB_CHECK_VERSION(2,31,0)
+    job->thread = g_thread_create(tree_chunk_thread, job, TRUE, NULL);
+#else
+    job->thread = g_thread_new("quickhash", tree_chunk_thread, job);
+#endif
+    if (job->thread == NULL) {
+      // couldn't start the thread; hash these leaves ourselves
+      tree_chunk_thread(job);
+    }
+  }
+
+  bool success = true;
+  for (int64_t i = 0; i < workers; i++) {
+    struct tree_chunk_job *job = &jobs[i];
+    if (job->thread) {
+      g_thread_join(job->thread);
+    }
+    if (!job->success) {
+      if (success && err) {
+        g_propagate_error(err, job->err);
+        job->err = NULL;
+      }
+      g_clear_error(&job->err);
+      success = false;
+    }
+  }
+
+  if (success) {
+    // fold the leaf digests into the root in input order
+    g_checksum_update(hash->checksum, digests, leaves * TREE_DIGEST_SIZE);
+  }
+
+  g_free(jobs);
+  g_free(digests);
+  return success;
+}
+
+// read and hash a file segment right now, bypassing the journal
+static bool hash_file_part_now(struct _openslide_hash *hash,
+                               const char *filename,
+                               int64_t offset, int64_t size,
+                               GError **err) {
   bool success = false;
+  uint8_t *buf = NULL;
 
   FILE *f = _openslide_fopen(filename, "rb", err);
   if (f == NULL) {
@@ -86,7 +300,18 @@ bool _openslide_hash_file_part(struct _openslide_hash *hash,
     size = len - offset;
   }
 
-  uint8_t buf[4096];
+  if (hash && hash->enabled && hash->tree) {
+    // hand the segment to the parallel tree reader, which opens its
+    // own handles
+    fclose(f);
+    return tree_file_part(hash, filename, offset, size, err);
+  }
+
+  // stream in large sequential chunks; hash input segments are often
+  // whole levels, and tile-sized reads waste the drive's sequential
+  // bandwidth (especially with several slides hashing concurrently)
+  const int64_t bufsize = 1 << 20;
+  buf = g_malloc(bufsize);
 
   if (fseeko(f, offset, SEEK_SET) == -1) {
     _openslide_io_error(err, "Can't seek in %s", filename);
@@ -95,7 +320,7 @@ bool _openslide_hash_file_part(struct _openslide_hash *hash,
 
   int64_t bytes_left = size;
   while (bytes_left > 0) {
-    int64_t bytes_to_read = MIN((int64_t) sizeof buf, bytes_left);
+    int64_t bytes_to_read = MIN(bufsize, bytes_left);
     int64_t bytes_read = fread(buf, 1, bytes_to_read, f);
 
     if (bytes_read != bytes_to_read) {
@@ -108,25 +333,123 @@ bool _openslide_hash_file_part(struct _openslide_hash *hash,
 
     bytes_left -= bytes_read;
 
-    _openslide_hash_data(hash, buf, bytes_read);
+    if (hash && hash->enabled) {
+      g_checksum_update(hash->checksum, buf, bytes_read);
+    }
   }
 
   success = true;
 
 DONE:
+  g_free(buf);
   fclose(f);
   return success;
 }
 
+static bool hash_file_part(struct _openslide_hash *hash,
+                           const char *filename,
+                           int64_t offset, int64_t size,
+                           GError **err) {
+  if (hash && hash->enabled && hash->ops) {
+    // validate the segment so missing or truncated files still fail at
+    // open, but defer the read and the SHA256 to resolve time
+    FILE *f = _openslide_fopen(filename, "rb", err);
+    if (f == NULL) {
+      return false;
+    }
+    bool ok = !fseeko(f, 0, SEEK_END);
+    int64_t len = ok ? ftello(f) : -1;
+    fclose(f);
+    if (len == -1) {
+      _openslide_io_error(err, "Couldn't get size of %s", filename);
+      return false;
+    }
+    if (size == -1) {
+      size = len - offset;
+    }
+    if (offset < 0 || size < 0 || offset + size > len) {
+      g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                  "Hash segment out of range in %s", filename);
+      return false;
+    }
+
+    struct hash_op *op = g_slice_new0(struct hash_op);
+    op->filename = g_strdup(filename);
+    op->offset = offset;
+    op->size = size;
+    g_queue_push_tail(hash->ops, op);
+    return true;
+  }
+
+  return hash_file_part_now(hash, filename, offset, size, err);
+}
+
+bool _openslide_hash_file_part(struct _openslide_hash *hash,
+			       const char *filename,
+			       int64_t offset, int64_t size,
+			       GError **err) {
+  int64_t begin = hash_now_us();
+  bool success = hash_file_part(hash, filename, offset, size, err);
+  if (hash && hash->enabled) {
+    hash->elapsed_us += hash_now_us() - begin;
+  }
+  return success;
+}
+
 // Invalidate this hash.  Use if this slide is unhashable for some reason.
 void _openslide_hash_disable(struct _openslide_hash *hash) {
   if (hash) {
     hash->enabled = false;
+    if (hash->ops) {
+      // journaled inputs will never be replayed
+      hash_ops_free(hash->ops);
+      hash->ops = NULL;
+    }
   }
 }
 
+// true if hashing was deferred and the journal hasn't been replayed yet
+bool _openslide_hash_has_pending(struct _openslide_hash *hash) {
+  return hash->enabled && hash->ops != NULL;
+}
+
+// replay the journal through the checksum, in the order the inputs
+// were recorded at open time
+bool _openslide_hash_resolve(struct _openslide_hash *hash, GError **err) {
+  if (!hash->ops) {
+    return true;
+  }
+
+  while (hash->ops->length) {
+    struct hash_op *op = g_queue_pop_head(hash->ops);
+    bool success = true;
+    if (op->data) {
+      hash_update(hash, op->data, op->datalen);
+    } else {
+      success = hash_file_part_now(hash, op->filename,
+                                   op->offset, op->size, err);
+    }
+    hash_op_free(op);
+    if (!success) {
+      _openslide_hash_disable(hash);
+      return false;
+    }
+  }
+
+  g_queue_free(hash->ops);
+  hash->ops = NULL;
+  return true;
+}
+
+// wall time spent so far reading and hashing inputs, in microseconds;
+// with deferred hashing this covers only the open-time journaling
+int64_t _openslide_hash_get_elapsed(struct _openslide_hash *hash) {
+  return hash->elapsed_us;
+}
+
 const char *_openslide_hash_get_string(struct _openslide_hash *hash) {
   if (hash->enabled) {
+    g_assert(hash->ops == NULL);
     return g_checksum_get_string(hash->checksum);
   } else {
     return NULL;
@@ -134,6 +457,9 @@ const char *_openslide_hash_get_string(struct _openslide_hash *hash) {
 }
 
 void _openslide_hash_destroy(struct _openslide_hash *hash) {
+  if (hash->ops) {
+    hash_ops_free(hash->ops);
+  }
   g_checksum_free(hash->checksum);
   g_slice_free(struct _openslide_hash, hash);
 }
@@ -52,8 +52,17 @@ bool _openslide_hash_file_part(struct _openslide_hash *hash,
 // lockout
 void _openslide_hash_disable(struct _openslide_hash *hash);
 
-// accessor
+// deferred hashing (OPENSLIDE_DEFER_QUICKHASH)
+bool _openslide_hash_has_pending(struct _openslide_hash *hash);
+bool _openslide_hash_resolve(struct _openslide_hash *hash, GError **err);
+
+// accessors
 const char *_openslide_hash_get_string(struct _openslide_hash *hash);
+int64_t _openslide_hash_get_elapsed(struct _openslide_hash *hash);
+
+// true in hash tree mode (OPENSLIDE_TREE_QUICKHASH); the value is then
+// published as openslide.quickhash-2
+bool _openslide_hash_is_tree(struct _openslide_hash *hash);
 
 // destructor
 void _openslide_hash_destroy(struct _openslide_hash *hash);
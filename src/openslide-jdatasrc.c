@@ -38,12 +38,40 @@ typedef struct {
 
   FILE * infile;		/* source stream */
   JOCTET * buffer;		/* start of buffer */
+  size_t buffer_size;		/* allocated size of buffer */
   boolean start_of_file;	/* have we gotten any data yet? */
 } my_source_mgr;
 
 typedef my_source_mgr * my_src_ptr;
 
-#define INPUT_BUF_SIZE  4096	/* choose an efficiently fread'able size */
+#define MIN_INPUT_BUF_SIZE      4096
+#define DEFAULT_INPUT_BUF_SIZE  (64 * 1024)
+#define MAX_INPUT_BUF_SIZE      (16 * 1024 * 1024)
+
+#define INPUT_BUF_SIZE_ENV "OPENSLIDE_JPEG_BUFFER_SIZE"
+
+/* Readahead buffer size for the stdio source.  Streaming large JPEGs
+ * out of NDPI and VMS files issues one fread per buffer fill, so the
+ * default is well above the traditional 4 KB; it can be overridden
+ * through the environment for benchmarking.
+ */
+static size_t get_input_buf_size (void)
+{
+  static gsize size;
+
+  if (g_once_init_enter(&size)) {
+    gsize computed = DEFAULT_INPUT_BUF_SIZE;
+    const char *str = g_getenv(INPUT_BUF_SIZE_ENV);
+    if (str) {
+      int64_t requested = g_ascii_strtoll(str, NULL, 10);
+      if (requested > 0) {
+        computed = CLAMP(requested, MIN_INPUT_BUF_SIZE, MAX_INPUT_BUF_SIZE);
+      }
+    }
+    g_once_init_leave(&size, computed);
+  }
+  return size;
+}
 
 
 /*
@@ -106,7 +134,7 @@ static boolean fill_input_buffer (j_decompress_ptr cinfo)
   my_src_ptr src = (my_src_ptr) cinfo->src;
   size_t nbytes;
 
-  nbytes = fread(src->buffer, 1, INPUT_BUF_SIZE, src->infile);
+  nbytes = fread(src->buffer, 1, src->buffer_size, src->infile);
 
   if (nbytes <= 0) {
     if (src->start_of_file)	/* Treat empty input file as fatal error */
@@ -218,20 +246,25 @@ void _openslide_jpeg_stdio_src (j_decompress_ptr cinfo, FILE * infile)
    * of JPEG images can be read from the same file by calling jpeg_stdio_src
    * only before the first one.  (If we discarded the buffer at the end of
    * one image, we'd likely lose the start of the next one.)
-   * This makes it unsafe to use this manager and a different source
-   * manager serially with the same JPEG object.  Caveat programmer.
+   * We always allocate the larger stdio-style object so that a reused
+   * JPEG object can alternate between this source manager and the memory
+   * source manager below.
    */
   if (cinfo->src == NULL) {	/* first time for this JPEG object? */
     cinfo->src = (struct jpeg_source_mgr *)
       (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_PERMANENT,
 				  sizeof(my_source_mgr));
     src = (my_src_ptr) cinfo->src;
-    src->buffer = (JOCTET *)
-      (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_PERMANENT,
-				  INPUT_BUF_SIZE * sizeof(JOCTET));
+    src->buffer = NULL;
   }
 
   src = (my_src_ptr) cinfo->src;
+  if (src->buffer == NULL) {	/* previously set up by jpeg_mem_src? */
+    src->buffer_size = get_input_buf_size();
+    src->buffer = (JOCTET *)
+      (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_PERMANENT,
+				  src->buffer_size * sizeof(JOCTET));
+  }
   src->pub.init_source = init_source;
   src->pub.fill_input_buffer = fill_input_buffer;
   src->pub.skip_input_data = skip_input_data;
@@ -258,12 +291,14 @@ void _openslide_jpeg_mem_src (j_decompress_ptr cinfo,
 
   /* The source object is made permanent so that a series of JPEG images
    * can be read from the same buffer by calling jpeg_mem_src only before
-   * the first one.
+   * the first one.  Allocate the larger stdio-style object so that a
+   * reused JPEG object can alternate between the two source managers.
    */
   if (cinfo->src == NULL) {	/* first time for this JPEG object? */
     cinfo->src = (struct jpeg_source_mgr *)
       (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_PERMANENT,
-				  sizeof(struct jpeg_source_mgr));
+				  sizeof(my_source_mgr));
+    ((my_src_ptr) cinfo->src)->buffer = NULL;
   }
 
   src = cinfo->src;
@@ -53,6 +53,21 @@ struct _openslide_associated_image_ops {
   void (*destroy)(struct _openslide_associated_image *img);
 };
 
+/* flags for struct _openslide.property_kinds */
+#define _OPENSLIDE_PROP_DOUBLE 0x1
+#define _OPENSLIDE_PROP_INT64  0x2
+
+/* read pipeline stages timed when OPENSLIDE_DEBUG=timing */
+enum _openslide_perf_stage {
+  _OPENSLIDE_PERF_IO,         // raw file reads
+  _OPENSLIDE_PERF_DECODE,     // entropy decode
+  _OPENSLIDE_PERF_CONVERT,    // color conversion and pixel unpacking
+  _OPENSLIDE_PERF_COMPOSITE,  // cairo compositing of decoded tiles
+  _OPENSLIDE_PERF_CACHE_LOCK,      // waiting on tile cache shard mutexes
+  _OPENSLIDE_PERF_TIFFCACHE_LOCK,  // waiting on the TIFF handle pool mutex
+  _OPENSLIDE_PERF_STAGE_COUNT
+};
+
 /* the main structure */
 struct _openslide {
   const struct _openslide_ops *ops;
@@ -69,9 +84,65 @@ struct _openslide {
   GHashTable *properties; // created automatically
   const char **property_names; // filled in automatically from hashtable
 
+  // frozen property table, filled in automatically after open: values
+  // parallel to the sorted property_names, with numeric values
+  // pre-parsed for the typed accessors.  the strings stay owned by the
+  // properties hashtable
+  int32_t property_count;
+  const char **property_values;
+  double *property_doubles;
+  int64_t *property_int64s;
+  uint8_t *property_kinds;  // _OPENSLIDE_PROP_* flags
+
   // cache
   struct _openslide_cache_binding *cache;
 
+  // shared tile decode worker pool, NULL when disabled
+  GThreadPool *tile_pool;
+
+  // background prefetch engine, created on first hint
+  GThreadPool *prefetch_pool;
+  GHashTable *prefetch_hints;  // id -> struct prefetch_hint
+  int next_prefetch_id;
+  int next_warm_id;  // cache warm jobs; each spans many hints
+
+  // asynchronous read executor, created on first request
+  GThreadPool *async_pool;
+
+  // quickhash1 journal awaiting first property access, NULL otherwise
+  struct _openslide_hash *quickhash1_pending;
+
+  // sequential access detector, guarded by the readahead lock in
+  // openslide.c
+  struct _openslide_readahead {
+    int64_t x;
+    int64_t y;
+    int64_t plane;
+    int32_t level;
+    int64_t w;
+    int64_t h;
+    int64_t dx;
+    int64_t dy;
+    int run;    // consecutive reads matching the stride
+    int ahead;  // regions already scheduled past the last read
+  } readahead;
+
+  // synthesized intermediate levels, NULL unless the pyramid had gaps
+  struct _openslide_synth *synth;
+
+  // handle-pool support: a clone shares the parsed structures of its
+  // origin handle and owns only the mutable per-handle state (error
+  // pointer, readahead detector, worker pools, perf counters).
+  // clone_origin is NULL on an original handle; shared_handles counts
+  // the origin plus its live clones (atomic ops only), and the shared
+  // structures are torn down by whichever handle closes last
+  openslide_t *clone_origin;
+  gint shared_handles;
+
+  // per-stage nanosecond counters, accumulated under the perf lock
+  // when OPENSLIDE_DEBUG=timing
+  gint64 perf_ns[_OPENSLIDE_PERF_STAGE_COUNT];
+
   // error handling, NULL if no error
   gpointer error; // must use g_atomic_pointer!
 };
@@ -96,6 +167,13 @@ struct _openslide_ops {
 		       int32_t w, int32_t h,
 		       GError **err);
   void (*destroy)(openslide_t *osr);
+  // return a standalone compressed bitstream for one tile, or NULL.
+  // optional; leave NULL if the backend can't supply raw tiles
+  uint8_t *(*read_raw_tile)(openslide_t *osr,
+                            struct _openslide_level *level,
+                            int64_t tile_col, int64_t tile_row,
+                            int64_t *len, const char **codec,
+                            GError **err);
 };
 
 struct _openslide_tifflike;
@@ -147,9 +225,18 @@ void _openslide_int64_free(gpointer data);
 GKeyFile *_openslide_read_key_file(const char *filename, int32_t max_size,
                                    GKeyFileFlags flags, GError **err);
 
-/* fopen() wrapper which properly sets FD_CLOEXEC */
+/* fopen() wrapper which properly sets FD_CLOEXEC and applies the
+   thread's I/O policy */
 FILE *_openslide_fopen(const char *path, const char *mode, GError **err);
 
+/* per-thread I/O policy (openslide_open_flags_t bits), set around
+   openslide_open_with_options() and captured by backends that read from
+   worker threads.  advise/drop_cache are no-ops without posix_fadvise(). */
+void _openslide_io_policy_set(int32_t flags);
+int32_t _openslide_io_policy_get(void);
+void _openslide_io_advise(FILE *f, int32_t flags);
+void _openslide_io_drop_cache(FILE *f, int64_t offset, int64_t length);
+
 /* Parse string to double, returning NAN on failure.  Accept both comma
    and period as decimal separator. */
 double _openslide_parse_double(const char *value);
@@ -248,8 +335,51 @@ void _openslide_grid_draw_tile_info(cairo_t *cr, const char *fmt, ...) G_GNUC_PR
 
 void _openslide_grid_destroy(struct _openslide_grid *grid);
 
+// backends whose read_tile callback (and its arg) is thread-safe can
+// opt into concurrent decode through the shared worker pool
+void _openslide_grid_enable_concurrent_read(struct _openslide_grid *grid);
+
+void _openslide_grid_set_tile_worker_count(openslide_t *osr, int32_t count);
+
+// where a tile's compressed bytes live on disk
+struct _openslide_tile_extent {
+  const char *path;
+  int64_t offset;
+  int64_t length;
+};
+
+typedef bool (*_openslide_grid_simple_extent_fn)(openslide_t *osr,
+                                                 struct _openslide_level *level,
+                                                 int64_t tile_col,
+                                                 int64_t tile_row,
+                                                 struct _openslide_tile_extent *extent);
+
+// backends that know their tile extents can opt into the batched
+// preload of compressed bytes ahead of concurrent decode; the lookup
+// must be cheap and may fail for tiles whose extent isn't known yet
+void _openslide_grid_simple_set_extent_lookup(struct _openslide_grid *grid,
+                                              _openslide_grid_simple_extent_fn extent);
+
+// same opt-in for tilemap grids; the lookup receives the tile's
+// col/row as passed to _openslide_grid_tilemap_add_tile
+void _openslide_grid_tilemap_set_extent_lookup(struct _openslide_grid *grid,
+                                               _openslide_grid_simple_extent_fn extent);
+
+
+/* Batched I/O preload (openslide-uring.c) */
+void _openslide_io_preload(const struct _openslide_tile_extent *extents,
+                           int32_t count);
+
+/* Synthesized pyramid levels (openslide-synth.c) */
+struct _openslide_synth;
+void _openslide_synth_add_levels(openslide_t *osr);
+
+
+/* Bounds properties helpers */
+void _openslide_set_bounds_props(openslide_t *osr,
+                                 double x, double y,
+                                 double w, double h);
 
-/* Bounds properties helper */
 void _openslide_set_bounds_props_from_grid(openslide_t *osr,
                                            struct _openslide_grid *grid);
 
@@ -259,8 +389,20 @@ void _openslide_set_bounds_props_from_grid(openslide_t *osr,
 struct _openslide_cache_binding;
 struct _openslide_cache_entry;
 
+// back tile buffers with a preallocated arena that is mlock'd and/or
+// huge-page-mapped; both best-effort, Linux only
+enum {
+  _OPENSLIDE_CACHE_PINNED   = 1 << 0,
+  _OPENSLIDE_CACHE_HUGEPAGE = 1 << 1,
+};
+
 // create/release
 openslide_cache_t *_openslide_cache_create(uint64_t capacity_in_bytes);
+openslide_cache_t *_openslide_cache_create_with_policy(uint64_t capacity_in_bytes,
+                                                       openslide_cache_policy_t policy);
+openslide_cache_t *_openslide_cache_create_with_flags(uint64_t capacity_in_bytes,
+                                                      openslide_cache_policy_t policy,
+                                                      int flags);
 void _openslide_cache_release(openslide_cache_t *cache);
 
 // binding a cache to an openslide_t
@@ -271,6 +413,15 @@ void _openslide_cache_binding_set(struct _openslide_cache_binding *cb,
 
 void _openslide_cache_binding_destroy(struct _openslide_cache_binding *cb);
 
+// tile buffer allocation; draws from the cache's slab pool of recycled
+// buffers.  Data passed to _openslide_cache_put() must be allocated
+// here; buffers never handed to the cache are returned with
+// _openslide_cache_tile_free().  Buffers are not zeroed.
+void *_openslide_cache_tile_alloc(struct _openslide_cache_binding *cb,
+                                  uint64_t size);
+void _openslide_cache_tile_free(struct _openslide_cache_binding *cb,
+                                uint64_t size, void *data);
+
 // put and get
 void _openslide_cache_put(struct _openslide_cache_binding *cb,
 			  void *plane,  // coordinate plane (level or grid)
@@ -291,6 +442,48 @@ void *_openslide_cache_get(struct _openslide_cache_binding *cb,
 // value unref
 void _openslide_cache_entry_unref(struct _openslide_cache_entry *entry);
 
+// compressed second tier, enabled by setting the
+// OPENSLIDE_CACHE_COMPRESSED_MB environment variable to a byte budget
+// in megabytes: holds original tile bitstreams so tiles aged out of
+// the decoded tier can be re-decoded from RAM instead of re-read from
+// storage.  put takes ownership of a g_malloc'd buffer; get returns a
+// copy the caller frees, with *codec interned
+bool _openslide_cache_has_compressed_tier(struct _openslide_cache_binding *cb);
+void _openslide_cache_put_compressed(struct _openslide_cache_binding *cb,
+                                     void *plane,
+                                     int64_t x,
+                                     int64_t y,
+                                     int64_t channel,
+                                     uint8_t *data,
+                                     int64_t len,
+                                     const char *codec);
+uint8_t *_openslide_cache_get_compressed(struct _openslide_cache_binding *cb,
+                                         void *plane,
+                                         int64_t x,
+                                         int64_t y,
+                                         int64_t channel,
+                                         int64_t *len,
+                                         const char **codec);
+
+// tile capture, for the tile iterator: while armed, the first entry
+// passing through get or put on this binding is recorded
+void _openslide_cache_binding_arm_capture(struct _openslide_cache_binding *cb);
+struct _openslide_cache_entry *_openslide_cache_binding_take_capture(struct _openslide_cache_binding *cb,
+                                                                     void **data,
+                                                                     uint64_t *size);
+
+// statistics; any out-parameter may be NULL
+void _openslide_cache_get_stats(openslide_cache_t *cache,
+                                uint64_t *hits, uint64_t *misses,
+                                uint64_t *insertions, uint64_t *evictions,
+                                uint64_t *bytes, uint64_t *entries);
+
+void _openslide_cache_binding_set_quota(struct _openslide_cache_binding *cb,
+                                        uint64_t quota);
+uint64_t _openslide_cache_binding_get_usage(struct _openslide_cache_binding *cb);
+void _openslide_cache_binding_get_stats(struct _openslide_cache_binding *cb,
+                                        uint64_t *hits, uint64_t *misses);
+
 
 /* Internal error propagation */
 enum OpenSlideError {
@@ -314,6 +507,7 @@ enum _openslide_debug_flag {
   OPENSLIDE_DEBUG_JPEG_MARKERS,
   OPENSLIDE_DEBUG_PERFORMANCE,
   OPENSLIDE_DEBUG_TILES,
+  OPENSLIDE_DEBUG_TIMING,
 };
 
 void _openslide_debug_init(void);
@@ -327,6 +521,16 @@ void _openslide_performance_warn_once(gint *warned_flag,
                                       const char *str, ...)
                                       G_GNUC_PRINTF(2, 3);
 
+/* Per-stage timing.  Elapsed time between a begin/end pair is credited
+   to the openslide_t the calling thread last announced with
+   set_current.  begin returns 0 while timing is disabled, so the
+   disabled cost of a pair is one predictable branch. */
+void _openslide_perf_set_current(openslide_t *osr);
+int64_t _openslide_perf_begin(void);
+void _openslide_perf_end(enum _openslide_perf_stage stage, int64_t begin);
+int64_t _openslide_perf_read(openslide_t *osr,
+                             enum _openslide_perf_stage stage);
+
 // private properties, for now
 #define _OPENSLIDE_PROPERTY_NAME_LEVEL_COUNT "openslide.level-count"
 #define _OPENSLIDE_PROPERTY_NAME_TEMPLATE_LEVEL_WIDTH "openslide.level[%d].width"
@@ -334,6 +538,13 @@ void _openslide_performance_warn_once(gint *warned_flag,
 #define _OPENSLIDE_PROPERTY_NAME_TEMPLATE_LEVEL_DOWNSAMPLE "openslide.level[%d].downsample"
 #define _OPENSLIDE_PROPERTY_NAME_TEMPLATE_LEVEL_TILE_WIDTH "openslide.level[%d].tile-width"
 #define _OPENSLIDE_PROPERTY_NAME_TEMPLATE_LEVEL_TILE_HEIGHT "openslide.level[%d].tile-height"
+// per-phase open-time profiling, wall-clock microseconds
+#define _OPENSLIDE_PROPERTY_NAME_OPEN_TIFFLIKE "openslide.open.tifflike-us"
+#define _OPENSLIDE_PROPERTY_NAME_OPEN_DETECT "openslide.open.detect-us"
+#define _OPENSLIDE_PROPERTY_NAME_OPEN_VENDOR "openslide.open.vendor-us"
+#define _OPENSLIDE_PROPERTY_NAME_OPEN_QUICKHASH "openslide.open.quickhash-us"
+#define _OPENSLIDE_PROPERTY_NAME_OPEN_TOTAL "openslide.open.total-us"
+#define _OPENSLIDE_PROPERTY_NAME_OPEN_CPU "openslide.open.cpu-us"
 #define _OPENSLIDE_PROPERTY_NAME_TEMPLATE_REGION_X "openslide.region[%d].x"
 #define _OPENSLIDE_PROPERTY_NAME_TEMPLATE_REGION_Y "openslide.region[%d].y"
 #define _OPENSLIDE_PROPERTY_NAME_TEMPLATE_REGION_WIDTH "openslide.region[%d].width"
@@ -346,19 +557,6 @@ extern const int32_t _openslide_G_Cb[256];
 extern const int32_t _openslide_G_Cr[256];
 extern const int16_t _openslide_B_Cb[256];
 
-// deprecated prefetch stuff (maybe we'll undeprecate it someday),
-// still needs these declarations for ABI compat
-// TODO: remove if soname bump
-#undef openslide_give_prefetch_hint
-OPENSLIDE_PUBLIC()
-int openslide_give_prefetch_hint(openslide_t *osr,
-				 int64_t x, int64_t y,
-				 int32_t level,
-				 int64_t w, int64_t h);
-#undef openslide_cancel_prefetch_hint
-OPENSLIDE_PUBLIC()
-void openslide_cancel_prefetch_hint(openslide_t *osr, int prefetch_id);
-
 /* Prevent use of dangerous functions and functions with mandatory wrappers.
    Every @p replacement must be unique to avoid conflicting-type errors. */
 #define _OPENSLIDE_POISON(replacement) error__use_ ## replacement ## _instead
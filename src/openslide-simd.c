@@ -0,0 +1,1020 @@
+/*
+ *  OpenSlide, a library for reading whole slide image files
+ *
+ *  Copyright (c) 2007-2015 Carnegie Mellon University
+ *  All rights reserved.
+ *
+ *  OpenSlide is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, version 2.1.
+ *
+ *  OpenSlide is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with OpenSlide. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "openslide-simd.h"
+
+#include <string.h>
+
+/*
+ * Chroma coefficients in Q15 fixed point.  The SIMD instruction sets
+ * provide a rounding high multiply (PMULHRSW / SQRDMULH) that computes
+ * round(a * b / 32768), so factors >= 1 are split into an integer part
+ * handled with plain adds and a fractional Q15 part:
+ *
+ *   R = Y + 1.402 Cr'           = Y + Cr' + 0.402 Cr'
+ *   G = Y - 0.34414 Cb' - 0.71414 Cr'
+ *   B = Y + 1.772 Cb'           = Y + 2 Cb' - 0.228 Cb'
+ *
+ * where Cb' = Cb - 128, Cr' = Cr - 128.  The scalar fallback uses the
+ * same fixed-point products so that results do not depend on the CPU.
+ */
+#define F_0_402 13173  // 1.402 - 1
+#define F_0_344 11278  // 0.34414
+#define F_0_714 23401  // 0.71414
+#define F_0_228  7471  // 2 - 1.772
+
+// round(a * b / 32768), the scalar equivalent of PMULHRSW/SQRDMULH
+static inline int32_t q15_mulhrs(int32_t a, int32_t b) {
+  return (a * b + 16384) >> 15;
+}
+
+static inline uint32_t pack_argb(int32_t r, int32_t g, int32_t b) {
+  r = r < 0 ? 0 : (r > 255 ? 255 : r);
+  g = g < 0 ? 0 : (g > 255 ? 255 : g);
+  b = b < 0 ? 0 : (b > 255 ? 255 : b);
+  return 0xff000000 | (uint32_t) r << 16 | (uint32_t) g << 8 | (uint32_t) b;
+}
+
+static inline uint32_t ycbcr_pixel(int32_t y, int32_t dcb, int32_t dcr) {
+  int32_t rc = dcr + q15_mulhrs(dcr, F_0_402);
+  int32_t gc = q15_mulhrs(dcb, -F_0_344) + q15_mulhrs(dcr, -F_0_714);
+  int32_t bc = dcb + dcb - q15_mulhrs(dcb, F_0_228);
+  return pack_argb(y + rc, y + gc, y + bc);
+}
+
+static void ycbcr422_to_argb_scalar(uint32_t *dest,
+                                    const int32_t *y,
+                                    const int32_t *cb,
+                                    const int32_t *cr,
+                                    int32_t w) {
+  int32_t x;
+  for (x = 0; x < w - 1; x += 2) {
+    int32_t dcb = (uint8_t) cb[x / 2] - 128;
+    int32_t dcr = (uint8_t) cr[x / 2] - 128;
+    *dest++ = ycbcr_pixel((uint8_t) y[x], dcb, dcr);
+    *dest++ = ycbcr_pixel((uint8_t) y[x + 1], dcb, dcr);
+  }
+  if (x < w) {
+    int32_t dcb = (uint8_t) cb[x / 2] - 128;
+    int32_t dcr = (uint8_t) cr[x / 2] - 128;
+    *dest++ = ycbcr_pixel((uint8_t) y[x], dcb, dcr);
+  }
+}
+
+static void rgb_to_argb_scalar(uint32_t *dest,
+                               const int32_t *r,
+                               const int32_t *g,
+                               const int32_t *b,
+                               int32_t w) {
+  for (int32_t x = 0; x < w; x++) {
+    *dest++ = 0xff000000 |
+              (uint32_t) (uint8_t) r[x] << 16 |
+              (uint32_t) (uint8_t) g[x] << 8 |
+              (uint32_t) (uint8_t) b[x];
+  }
+}
+
+static void argb_to_rgba_scalar(uint8_t *buf, uint32_t len) {
+  for (uint32_t cur = 0; cur + 4 <= len; cur += 4) {
+    uint32_t px;
+    memcpy(&px, buf + cur, 4);
+    uint8_t a = px >> 24;
+    uint8_t r = px >> 16;
+    uint8_t g = px >> 8;
+    uint8_t b = px;
+
+    if (a != 0 && a != 255) {
+      r = r * 255 / a;
+      g = g * 255 / a;
+      b = b * 255 / a;
+    }
+
+    buf[cur + 0] = r;
+    buf[cur + 1] = g;
+    buf[cur + 2] = b;
+    buf[cur + 3] = a;
+  }
+}
+
+static void argb_row_sum_scalar(uint32_t *acc,
+                                const uint32_t *row,
+                                int32_t w) {
+  const uint8_t *bytes = (const uint8_t *) row;
+  for (int32_t i = 0; i < 4 * w; i++) {
+    acc[i] += bytes[i];
+  }
+}
+
+// blend two ARGB pixels per channel: (p0 * (256 - w) + p1 * w + 128) >> 8
+static inline uint32_t lerp_px(uint32_t p0, uint32_t p1, uint32_t w) {
+  uint32_t iw = 256 - w;
+  uint32_t b = ((p0 & 0xff) * iw + (p1 & 0xff) * w + 128) >> 8;
+  uint32_t g = (((p0 >> 8) & 0xff) * iw + ((p1 >> 8) & 0xff) * w + 128) >> 8;
+  uint32_t r = (((p0 >> 16) & 0xff) * iw + ((p1 >> 16) & 0xff) * w + 128) >> 8;
+  uint32_t a = ((p0 >> 24) * iw + (p1 >> 24) * w + 128) >> 8;
+  return a << 24 | r << 16 | g << 8 | b;
+}
+
+static void argb_scale_row_scalar(uint32_t *dest,
+                                  const uint32_t *src,
+                                  const int32_t *sx,
+                                  const uint16_t *wx,
+                                  int32_t w) {
+  for (int32_t i = 0; i < w; i++) {
+    dest[i] = lerp_px(src[sx[i]], src[sx[i] + 1], wx[i]);
+  }
+}
+
+static void argb_lerp_rows_scalar(uint32_t *dest,
+                                  const uint32_t *row0,
+                                  const uint32_t *row1,
+                                  uint16_t wy,
+                                  int32_t w) {
+  for (int32_t i = 0; i < w; i++) {
+    dest[i] = lerp_px(row0[i], row1[i], wy);
+  }
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_DISPATCH_X86 1
+
+#include <immintrin.h>
+
+__attribute__((target("sse4.1")))
+static void ycbcr422_to_argb_sse41(uint32_t *dest,
+                                   const int32_t *y,
+                                   const int32_t *cb,
+                                   const int32_t *cr,
+                                   int32_t w) {
+  const __m128i c128 = _mm_set1_epi16(128);
+  const __m128i alpha = _mm_set1_epi8((char) 0xff);
+  int32_t x = 0;
+  for (; x + 8 <= w; x += 8) {
+    __m128i y16 =
+      _mm_packs_epi32(_mm_loadu_si128((const __m128i *) (y + x)),
+                      _mm_loadu_si128((const __m128i *) (y + x + 4)));
+    // narrow 4 chroma samples and duplicate each for its luma pair
+    __m128i cb16 =
+      _mm_packs_epi32(_mm_loadu_si128((const __m128i *) (cb + x / 2)),
+                      _mm_setzero_si128());
+    __m128i cr16 =
+      _mm_packs_epi32(_mm_loadu_si128((const __m128i *) (cr + x / 2)),
+                      _mm_setzero_si128());
+    __m128i dcb = _mm_sub_epi16(_mm_unpacklo_epi16(cb16, cb16), c128);
+    __m128i dcr = _mm_sub_epi16(_mm_unpacklo_epi16(cr16, cr16), c128);
+
+    __m128i rc = _mm_add_epi16(dcr,
+      _mm_mulhrs_epi16(dcr, _mm_set1_epi16(F_0_402)));
+    __m128i gc = _mm_add_epi16(
+      _mm_mulhrs_epi16(dcb, _mm_set1_epi16(-F_0_344)),
+      _mm_mulhrs_epi16(dcr, _mm_set1_epi16(-F_0_714)));
+    __m128i bc = _mm_sub_epi16(_mm_add_epi16(dcb, dcb),
+      _mm_mulhrs_epi16(dcb, _mm_set1_epi16(F_0_228)));
+
+    __m128i r8 = _mm_packus_epi16(_mm_add_epi16(y16, rc), y16);
+    __m128i g8 = _mm_packus_epi16(_mm_add_epi16(y16, gc), y16);
+    __m128i b8 = _mm_packus_epi16(_mm_add_epi16(y16, bc), y16);
+
+    // interleave to B,G,R,A memory order
+    __m128i bg = _mm_unpacklo_epi8(b8, g8);
+    __m128i ra = _mm_unpacklo_epi8(r8, alpha);
+    _mm_storeu_si128((__m128i *) (dest + x),
+                     _mm_unpacklo_epi16(bg, ra));
+    _mm_storeu_si128((__m128i *) (dest + x + 4),
+                     _mm_unpackhi_epi16(bg, ra));
+  }
+  if (x < w) {
+    ycbcr422_to_argb_scalar(dest + x, y + x, cb + x / 2, cr + x / 2, w - x);
+  }
+}
+
+__attribute__((target("avx2")))
+static void ycbcr422_to_argb_avx2(uint32_t *dest,
+                                  const int32_t *y,
+                                  const int32_t *cb,
+                                  const int32_t *cr,
+                                  int32_t w) {
+  const __m256i c128 = _mm256_set1_epi16(128);
+  const __m256i alpha = _mm256_set1_epi8((char) 0xff);
+  int32_t x = 0;
+  for (; x + 16 <= w; x += 16) {
+    // pack 16 luma samples to 16-bit, restoring order across lanes
+    __m256i y16 = _mm256_permute4x64_epi64(
+      _mm256_packs_epi32(_mm256_loadu_si256((const __m256i *) (y + x)),
+                         _mm256_loadu_si256((const __m256i *) (y + x + 8))),
+      0xd8);
+    // narrow 8 chroma samples and duplicate each for its luma pair;
+    // packing against zero leaves samples 0-3 in the low lane and 4-7 in
+    // the high lane, which the in-lane unpack then matches to y16
+    __m256i cb16 = _mm256_packs_epi32(
+      _mm256_loadu_si256((const __m256i *) (cb + x / 2)),
+      _mm256_setzero_si256());
+    __m256i cr16 = _mm256_packs_epi32(
+      _mm256_loadu_si256((const __m256i *) (cr + x / 2)),
+      _mm256_setzero_si256());
+    __m256i dcb = _mm256_sub_epi16(_mm256_unpacklo_epi16(cb16, cb16), c128);
+    __m256i dcr = _mm256_sub_epi16(_mm256_unpacklo_epi16(cr16, cr16), c128);
+
+    __m256i rc = _mm256_add_epi16(dcr,
+      _mm256_mulhrs_epi16(dcr, _mm256_set1_epi16(F_0_402)));
+    __m256i gc = _mm256_add_epi16(
+      _mm256_mulhrs_epi16(dcb, _mm256_set1_epi16(-F_0_344)),
+      _mm256_mulhrs_epi16(dcr, _mm256_set1_epi16(-F_0_714)));
+    __m256i bc = _mm256_sub_epi16(_mm256_add_epi16(dcb, dcb),
+      _mm256_mulhrs_epi16(dcb, _mm256_set1_epi16(F_0_228)));
+
+    __m256i r8 = _mm256_packus_epi16(_mm256_add_epi16(y16, rc), y16);
+    __m256i g8 = _mm256_packus_epi16(_mm256_add_epi16(y16, gc), y16);
+    __m256i b8 = _mm256_packus_epi16(_mm256_add_epi16(y16, bc), y16);
+
+    __m256i bg = _mm256_unpacklo_epi8(b8, g8);
+    __m256i ra = _mm256_unpacklo_epi8(r8, alpha);
+    __m256i px_lo = _mm256_unpacklo_epi16(bg, ra);  // px 0-3 | 8-11
+    __m256i px_hi = _mm256_unpackhi_epi16(bg, ra);  // px 4-7 | 12-15
+    _mm256_storeu_si256((__m256i *) (dest + x),
+                        _mm256_permute2x128_si256(px_lo, px_hi, 0x20));
+    _mm256_storeu_si256((__m256i *) (dest + x + 8),
+                        _mm256_permute2x128_si256(px_lo, px_hi, 0x31));
+  }
+  if (x < w) {
+    ycbcr422_to_argb_scalar(dest + x, y + x, cb + x / 2, cr + x / 2, w - x);
+  }
+}
+
+__attribute__((target("sse4.1")))
+static void rgb_to_argb_sse41(uint32_t *dest,
+                              const int32_t *r,
+                              const int32_t *g,
+                              const int32_t *b,
+                              int32_t w) {
+  const __m128i mask = _mm_set1_epi32(0xff);
+  const __m128i alpha = _mm_set1_epi32(0xff000000);
+  int32_t x = 0;
+  for (; x + 4 <= w; x += 4) {
+    __m128i pr = _mm_and_si128(_mm_loadu_si128((const __m128i *) (r + x)),
+                               mask);
+    __m128i pg = _mm_and_si128(_mm_loadu_si128((const __m128i *) (g + x)),
+                               mask);
+    __m128i pb = _mm_and_si128(_mm_loadu_si128((const __m128i *) (b + x)),
+                               mask);
+    __m128i px = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(pr, 16),
+                                           _mm_slli_epi32(pg, 8)),
+                              _mm_or_si128(pb, alpha));
+    _mm_storeu_si128((__m128i *) (dest + x), px);
+  }
+  if (x < w) {
+    rgb_to_argb_scalar(dest + x, r + x, g + x, b + x, w - x);
+  }
+}
+
+__attribute__((target("avx2")))
+static void rgb_to_argb_avx2(uint32_t *dest,
+                             const int32_t *r,
+                             const int32_t *g,
+                             const int32_t *b,
+                             int32_t w) {
+  const __m256i mask = _mm256_set1_epi32(0xff);
+  const __m256i alpha = _mm256_set1_epi32(0xff000000);
+  int32_t x = 0;
+  for (; x + 8 <= w; x += 8) {
+    __m256i pr = _mm256_and_si256(
+      _mm256_loadu_si256((const __m256i *) (r + x)), mask);
+    __m256i pg = _mm256_and_si256(
+      _mm256_loadu_si256((const __m256i *) (g + x)), mask);
+    __m256i pb = _mm256_and_si256(
+      _mm256_loadu_si256((const __m256i *) (b + x)), mask);
+    __m256i px = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(pr, 16),
+                                                 _mm256_slli_epi32(pg, 8)),
+                                 _mm256_or_si256(pb, alpha));
+    _mm256_storeu_si256((__m256i *) (dest + x), px);
+  }
+  if (x < w) {
+    rgb_to_argb_scalar(dest + x, r + x, g + x, b + x, w - x);
+  }
+}
+
+__attribute__((target("sse4.1")))
+static void argb_to_rgba_sse41(uint8_t *buf, uint32_t len) {
+  const __m128i swap_rb = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7,
+                                        10, 9, 8, 11, 14, 13, 12, 15);
+  const __m128i mask = _mm_set1_epi32(0xff);
+  const __m128i c255 = _mm_set1_epi32(255);
+  uint32_t cur = 0;
+  for (; cur + 16 <= len; cur += 16) {
+    __m128i px = _mm_loadu_si128((const __m128i *) (buf + cur));
+    __m128i a = _mm_srli_epi32(px, 24);
+
+    // fully opaque pixels only need the R/B swap
+    __m128i opaque = _mm_cmpeq_epi32(a, c255);
+    if (_mm_movemask_epi8(opaque) == 0xffff) {
+      _mm_storeu_si128((__m128i *) (buf + cur),
+                       _mm_shuffle_epi8(px, swap_rb));
+      continue;
+    }
+
+    __m128i r = _mm_and_si128(_mm_srli_epi32(px, 16), mask);
+    __m128i g = _mm_and_si128(_mm_srli_epi32(px, 8), mask);
+    __m128i b = _mm_and_si128(px, mask);
+
+    // un-premultiply: trunc(c * 255 / a); exact because c * 255 * a is
+    // far below the point where float division could misround across an
+    // integer boundary
+    __m128 af = _mm_cvtepi32_ps(a);
+    __m128i qr = _mm_cvttps_epi32(_mm_div_ps(
+      _mm_cvtepi32_ps(_mm_mullo_epi32(r, c255)), af));
+    __m128i qg = _mm_cvttps_epi32(_mm_div_ps(
+      _mm_cvtepi32_ps(_mm_mullo_epi32(g, c255)), af));
+    __m128i qb = _mm_cvttps_epi32(_mm_div_ps(
+      _mm_cvtepi32_ps(_mm_mullo_epi32(b, c255)), af));
+
+    // keep the original color for a == 0 and a == 255
+    __m128i keep = _mm_or_si128(_mm_cmpeq_epi32(a, _mm_setzero_si128()),
+                                opaque);
+    r = _mm_blendv_epi8(qr, r, keep);
+    g = _mm_blendv_epi8(qg, g, keep);
+    b = _mm_blendv_epi8(qb, b, keep);
+
+    __m128i out = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)),
+                               _mm_or_si128(_mm_slli_epi32(b, 16),
+                                            _mm_slli_epi32(a, 24)));
+    _mm_storeu_si128((__m128i *) (buf + cur), out);
+  }
+  if (cur < len) {
+    argb_to_rgba_scalar(buf + cur, len - cur);
+  }
+}
+
+__attribute__((target("avx2")))
+static void argb_to_rgba_avx2(uint8_t *buf, uint32_t len) {
+  const __m256i swap_rb = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7,
+                                           10, 9, 8, 11, 14, 13, 12, 15,
+                                           2, 1, 0, 3, 6, 5, 4, 7,
+                                           10, 9, 8, 11, 14, 13, 12, 15);
+  const __m256i mask = _mm256_set1_epi32(0xff);
+  const __m256i c255 = _mm256_set1_epi32(255);
+  uint32_t cur = 0;
+  for (; cur + 32 <= len; cur += 32) {
+    __m256i px = _mm256_loadu_si256((const __m256i *) (buf + cur));
+    __m256i a = _mm256_srli_epi32(px, 24);
+
+    __m256i opaque = _mm256_cmpeq_epi32(a, c255);
+    if ((uint32_t) _mm256_movemask_epi8(opaque) == 0xffffffffu) {
+      _mm256_storeu_si256((__m256i *) (buf + cur),
+                          _mm256_shuffle_epi8(px, swap_rb));
+      continue;
+    }
+
+    __m256i r = _mm256_and_si256(_mm256_srli_epi32(px, 16), mask);
+    __m256i g = _mm256_and_si256(_mm256_srli_epi32(px, 8), mask);
+    __m256i b = _mm256_and_si256(px, mask);
+
+    __m256 af = _mm256_cvtepi32_ps(a);
+    __m256i qr = _mm256_cvttps_epi32(_mm256_div_ps(
+      _mm256_cvtepi32_ps(_mm256_mullo_epi32(r, c255)), af));
+    __m256i qg = _mm256_cvttps_epi32(_mm256_div_ps(
+      _mm256_cvtepi32_ps(_mm256_mullo_epi32(g, c255)), af));
+    __m256i qb = _mm256_cvttps_epi32(_mm256_div_ps(
+      _mm256_cvtepi32_ps(_mm256_mullo_epi32(b, c255)), af));
+
+    __m256i keep = _mm256_or_si256(
+      _mm256_cmpeq_epi32(a, _mm256_setzero_si256()), opaque);
+    r = _mm256_blendv_epi8(qr, r, keep);
+    g = _mm256_blendv_epi8(qg, g, keep);
+    b = _mm256_blendv_epi8(qb, b, keep);
+
+    __m256i out = _mm256_or_si256(
+      _mm256_or_si256(r, _mm256_slli_epi32(g, 8)),
+      _mm256_or_si256(_mm256_slli_epi32(b, 16), _mm256_slli_epi32(a, 24)));
+    _mm256_storeu_si256((__m256i *) (buf + cur), out);
+  }
+  if (cur < len) {
+    argb_to_rgba_scalar(buf + cur, len - cur);
+  }
+}
+
+__attribute__((target("sse4.1")))
+static void argb_row_sum_sse41(uint32_t *acc,
+                               const uint32_t *row,
+                               int32_t w) {
+  int32_t x = 0;
+  for (; x + 4 <= w; x += 4) {
+    __m128i px = _mm_loadu_si128((const __m128i *) (row + x));
+    uint32_t *a = acc + 4 * x;
+    // widen one pixel's 4 bytes to 4 uint32 lanes per step
+    _mm_storeu_si128((__m128i *) a,
+      _mm_add_epi32(_mm_loadu_si128((const __m128i *) a),
+                    _mm_cvtepu8_epi32(px)));
+    _mm_storeu_si128((__m128i *) (a + 4),
+      _mm_add_epi32(_mm_loadu_si128((const __m128i *) (a + 4)),
+                    _mm_cvtepu8_epi32(_mm_srli_si128(px, 4))));
+    _mm_storeu_si128((__m128i *) (a + 8),
+      _mm_add_epi32(_mm_loadu_si128((const __m128i *) (a + 8)),
+                    _mm_cvtepu8_epi32(_mm_srli_si128(px, 8))));
+    _mm_storeu_si128((__m128i *) (a + 12),
+      _mm_add_epi32(_mm_loadu_si128((const __m128i *) (a + 12)),
+                    _mm_cvtepu8_epi32(_mm_srli_si128(px, 12))));
+  }
+  if (x < w) {
+    argb_row_sum_scalar(acc + 4 * x, row + x, w - x);
+  }
+}
+
+__attribute__((target("avx2")))
+static void argb_row_sum_avx2(uint32_t *acc,
+                              const uint32_t *row,
+                              int32_t w) {
+  int32_t x = 0;
+  for (; x + 4 <= w; x += 4) {
+    __m128i px = _mm_loadu_si128((const __m128i *) (row + x));
+    uint32_t *a = acc + 4 * x;
+    // widen two pixels' bytes to 8 uint32 lanes per step
+    _mm256_storeu_si256((__m256i *) a,
+      _mm256_add_epi32(_mm256_loadu_si256((const __m256i *) a),
+                       _mm256_cvtepu8_epi32(px)));
+    _mm256_storeu_si256((__m256i *) (a + 8),
+      _mm256_add_epi32(_mm256_loadu_si256((const __m256i *) (a + 8)),
+                       _mm256_cvtepu8_epi32(_mm_srli_si128(px, 8))));
+  }
+  if (x < w) {
+    argb_row_sum_scalar(acc + 4 * x, row + x, w - x);
+  }
+}
+
+__attribute__((target("sse4.1")))
+static void argb_scale_row_sse41(uint32_t *dest,
+                                 const uint32_t *src,
+                                 const int32_t *sx,
+                                 const uint16_t *wx,
+                                 int32_t w) {
+  const __m128i c256 = _mm_set1_epi16(256);
+  const __m128i c128 = _mm_set1_epi16(128);
+  const __m128i zero = _mm_setzero_si128();
+  int32_t i = 0;
+  for (; i + 4 <= w; i += 4) {
+    // the taps are at arbitrary offsets, so gather them one at a time
+    __m128i p0 = _mm_setr_epi32(src[sx[i]], src[sx[i + 1]],
+                                src[sx[i + 2]], src[sx[i + 3]]);
+    __m128i p1 = _mm_setr_epi32(src[sx[i] + 1], src[sx[i + 1] + 1],
+                                src[sx[i + 2] + 1], src[sx[i + 3] + 1]);
+
+    // duplicate each tap's weight across its four channel lanes
+    __m128i wv = _mm_loadl_epi64((const __m128i *) (wx + i));
+    __m128i wp = _mm_unpacklo_epi16(wv, wv);
+    __m128i w_lo = _mm_unpacklo_epi32(wp, wp);
+    __m128i w_hi = _mm_unpackhi_epi32(wp, wp);
+
+    // (p0 * (256 - w) + p1 * w + 128) >> 8; the products and their sum
+    // stay within 16 bits
+    __m128i lo = _mm_srli_epi16(
+      _mm_add_epi16(_mm_add_epi16(
+        _mm_mullo_epi16(_mm_unpacklo_epi8(p0, zero),
+                        _mm_sub_epi16(c256, w_lo)),
+        _mm_mullo_epi16(_mm_unpacklo_epi8(p1, zero), w_lo)), c128), 8);
+    __m128i hi = _mm_srli_epi16(
+      _mm_add_epi16(_mm_add_epi16(
+        _mm_mullo_epi16(_mm_unpackhi_epi8(p0, zero),
+                        _mm_sub_epi16(c256, w_hi)),
+        _mm_mullo_epi16(_mm_unpackhi_epi8(p1, zero), w_hi)), c128), 8);
+    _mm_storeu_si128((__m128i *) (dest + i), _mm_packus_epi16(lo, hi));
+  }
+  if (i < w) {
+    argb_scale_row_scalar(dest + i, src, sx + i, wx + i, w - i);
+  }
+}
+
+__attribute__((target("avx2")))
+static void argb_scale_row_avx2(uint32_t *dest,
+                                const uint32_t *src,
+                                const int32_t *sx,
+                                const uint16_t *wx,
+                                int32_t w) {
+  const __m256i c256 = _mm256_set1_epi16(256);
+  const __m256i c128 = _mm256_set1_epi16(128);
+  const __m256i ones = _mm256_set1_epi32(1);
+  const __m256i zero = _mm256_setzero_si256();
+  // duplicate each tap's weight across its four channel lanes, in the
+  // order the byte unpacks leave the pixels (0-1/4-5 low, 2-3/6-7 high)
+  const __m256i wctl_lo = _mm256_setr_epi8(0, 1, 0, 1, 0, 1, 0, 1,
+                                           4, 5, 4, 5, 4, 5, 4, 5,
+                                           0, 1, 0, 1, 0, 1, 0, 1,
+                                           4, 5, 4, 5, 4, 5, 4, 5);
+  const __m256i wctl_hi = _mm256_setr_epi8(8, 9, 8, 9, 8, 9, 8, 9,
+                                           12, 13, 12, 13, 12, 13, 12, 13,
+                                           8, 9, 8, 9, 8, 9, 8, 9,
+                                           12, 13, 12, 13, 12, 13, 12, 13);
+  int32_t i = 0;
+  for (; i + 8 <= w; i += 8) {
+    __m256i idx = _mm256_loadu_si256((const __m256i *) (sx + i));
+    __m256i p0 = _mm256_i32gather_epi32((const int *) src, idx, 4);
+    __m256i p1 = _mm256_i32gather_epi32((const int *) src,
+                                        _mm256_add_epi32(idx, ones), 4);
+
+    __m256i wv = _mm256_cvtepu16_epi32(
+      _mm_loadu_si128((const __m128i *) (wx + i)));
+    __m256i w_lo = _mm256_shuffle_epi8(wv, wctl_lo);
+    __m256i w_hi = _mm256_shuffle_epi8(wv, wctl_hi);
+
+    __m256i lo = _mm256_srli_epi16(
+      _mm256_add_epi16(_mm256_add_epi16(
+        _mm256_mullo_epi16(_mm256_unpacklo_epi8(p0, zero),
+                           _mm256_sub_epi16(c256, w_lo)),
+        _mm256_mullo_epi16(_mm256_unpacklo_epi8(p1, zero), w_lo)),
+        c128), 8);
+    __m256i hi = _mm256_srli_epi16(
+      _mm256_add_epi16(_mm256_add_epi16(
+        _mm256_mullo_epi16(_mm256_unpackhi_epi8(p0, zero),
+                           _mm256_sub_epi16(c256, w_hi)),
+        _mm256_mullo_epi16(_mm256_unpackhi_epi8(p1, zero), w_hi)),
+        c128), 8);
+    // the in-lane pack restores pixel order: 0-3 low lane, 4-7 high
+    _mm256_storeu_si256((__m256i *) (dest + i),
+                        _mm256_packus_epi16(lo, hi));
+  }
+  if (i < w) {
+    argb_scale_row_scalar(dest + i, src, sx + i, wx + i, w - i);
+  }
+}
+
+__attribute__((target("sse4.1")))
+static void argb_lerp_rows_sse41(uint32_t *dest,
+                                 const uint32_t *row0,
+                                 const uint32_t *row1,
+                                 uint16_t wy,
+                                 int32_t w) {
+  const __m128i wv = _mm_set1_epi16(wy);
+  const __m128i iwv = _mm_set1_epi16(256 - wy);
+  const __m128i c128 = _mm_set1_epi16(128);
+  const __m128i zero = _mm_setzero_si128();
+  int32_t i = 0;
+  for (; i + 4 <= w; i += 4) {
+    __m128i p0 = _mm_loadu_si128((const __m128i *) (row0 + i));
+    __m128i p1 = _mm_loadu_si128((const __m128i *) (row1 + i));
+    __m128i lo = _mm_srli_epi16(
+      _mm_add_epi16(_mm_add_epi16(
+        _mm_mullo_epi16(_mm_unpacklo_epi8(p0, zero), iwv),
+        _mm_mullo_epi16(_mm_unpacklo_epi8(p1, zero), wv)), c128), 8);
+    __m128i hi = _mm_srli_epi16(
+      _mm_add_epi16(_mm_add_epi16(
+        _mm_mullo_epi16(_mm_unpackhi_epi8(p0, zero), iwv),
+        _mm_mullo_epi16(_mm_unpackhi_epi8(p1, zero), wv)), c128), 8);
+    _mm_storeu_si128((__m128i *) (dest + i), _mm_packus_epi16(lo, hi));
+  }
+  if (i < w) {
+    argb_lerp_rows_scalar(dest + i, row0 + i, row1 + i, wy, w - i);
+  }
+}
+
+__attribute__((target("avx2")))
+static void argb_lerp_rows_avx2(uint32_t *dest,
+                                const uint32_t *row0,
+                                const uint32_t *row1,
+                                uint16_t wy,
+                                int32_t w) {
+  const __m256i wv = _mm256_set1_epi16(wy);
+  const __m256i iwv = _mm256_set1_epi16(256 - wy);
+  const __m256i c128 = _mm256_set1_epi16(128);
+  const __m256i zero = _mm256_setzero_si256();
+  int32_t i = 0;
+  for (; i + 8 <= w; i += 8) {
+    __m256i p0 = _mm256_loadu_si256((const __m256i *) (row0 + i));
+    __m256i p1 = _mm256_loadu_si256((const __m256i *) (row1 + i));
+    __m256i lo = _mm256_srli_epi16(
+      _mm256_add_epi16(_mm256_add_epi16(
+        _mm256_mullo_epi16(_mm256_unpacklo_epi8(p0, zero), iwv),
+        _mm256_mullo_epi16(_mm256_unpacklo_epi8(p1, zero), wv)), c128), 8);
+    __m256i hi = _mm256_srli_epi16(
+      _mm256_add_epi16(_mm256_add_epi16(
+        _mm256_mullo_epi16(_mm256_unpackhi_epi8(p0, zero), iwv),
+        _mm256_mullo_epi16(_mm256_unpackhi_epi8(p1, zero), wv)), c128), 8);
+    _mm256_storeu_si256((__m256i *) (dest + i),
+                        _mm256_packus_epi16(lo, hi));
+  }
+  if (i < w) {
+    argb_lerp_rows_scalar(dest + i, row0 + i, row1 + i, wy, w - i);
+  }
+}
+
+#elif defined(__aarch64__)
+#define SIMD_DISPATCH_NEON 1
+
+#include <arm_neon.h>
+
+static void ycbcr422_to_argb_neon(uint32_t *dest,
+                                  const int32_t *y,
+                                  const int32_t *cb,
+                                  const int32_t *cr,
+                                  int32_t w) {
+  const int16x8_t c128 = vdupq_n_s16(128);
+  int32_t x = 0;
+  for (; x + 8 <= w; x += 8) {
+    int16x8_t y16 = vcombine_s16(vmovn_s32(vld1q_s32(y + x)),
+                                 vmovn_s32(vld1q_s32(y + x + 4)));
+    // narrow 4 chroma samples and duplicate each for its luma pair
+    int16x4_t cb4 = vmovn_s32(vld1q_s32(cb + x / 2));
+    int16x4_t cr4 = vmovn_s32(vld1q_s32(cr + x / 2));
+    int16x4x2_t cbz = vzip_s16(cb4, cb4);
+    int16x4x2_t crz = vzip_s16(cr4, cr4);
+    int16x8_t dcb = vsubq_s16(vcombine_s16(cbz.val[0], cbz.val[1]), c128);
+    int16x8_t dcr = vsubq_s16(vcombine_s16(crz.val[0], crz.val[1]), c128);
+
+    int16x8_t rc = vaddq_s16(dcr, vqrdmulhq_n_s16(dcr, F_0_402));
+    int16x8_t gc = vaddq_s16(vqrdmulhq_n_s16(dcb, -F_0_344),
+                             vqrdmulhq_n_s16(dcr, -F_0_714));
+    int16x8_t bc = vsubq_s16(vaddq_s16(dcb, dcb),
+                             vqrdmulhq_n_s16(dcb, F_0_228));
+
+    uint8x8x4_t px;
+    px.val[0] = vqmovun_s16(vaddq_s16(y16, bc));
+    px.val[1] = vqmovun_s16(vaddq_s16(y16, gc));
+    px.val[2] = vqmovun_s16(vaddq_s16(y16, rc));
+    px.val[3] = vdup_n_u8(0xff);
+    vst4_u8((uint8_t *) (dest + x), px);
+  }
+  if (x < w) {
+    ycbcr422_to_argb_scalar(dest + x, y + x, cb + x / 2, cr + x / 2, w - x);
+  }
+}
+
+static void rgb_to_argb_neon(uint32_t *dest,
+                             const int32_t *r,
+                             const int32_t *g,
+                             const int32_t *b,
+                             int32_t w) {
+  const uint32x4_t mask = vdupq_n_u32(0xff);
+  const uint32x4_t alpha = vdupq_n_u32(0xff000000);
+  int32_t x = 0;
+  for (; x + 4 <= w; x += 4) {
+    uint32x4_t pr = vandq_u32(vreinterpretq_u32_s32(vld1q_s32(r + x)), mask);
+    uint32x4_t pg = vandq_u32(vreinterpretq_u32_s32(vld1q_s32(g + x)), mask);
+    uint32x4_t pb = vandq_u32(vreinterpretq_u32_s32(vld1q_s32(b + x)), mask);
+    uint32x4_t px = vorrq_u32(vorrq_u32(vshlq_n_u32(pr, 16),
+                                        vshlq_n_u32(pg, 8)),
+                              vorrq_u32(pb, alpha));
+    vst1q_u32(dest + x, px);
+  }
+  if (x < w) {
+    rgb_to_argb_scalar(dest + x, r + x, g + x, b + x, w - x);
+  }
+}
+
+// un-premultiply 8 channel bytes against 8 alpha bytes: trunc(c * 255 / a)
+static inline uint8x8_t unmul_neon(uint8x8_t c, uint8x8_t a) {
+  uint16x8_t c255 = vmull_u8(c, vdup_n_u8(255));
+  uint16x8_t a16 = vmovl_u8(a);
+  float32x4_t q_lo =
+    vdivq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(c255))),
+              vcvtq_f32_u32(vmovl_u16(vget_low_u16(a16))));
+  float32x4_t q_hi =
+    vdivq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(c255))),
+              vcvtq_f32_u32(vmovl_u16(vget_high_u16(a16))));
+  uint16x8_t q16 = vcombine_u16(vmovn_u32(vcvtq_u32_f32(q_lo)),
+                                vmovn_u32(vcvtq_u32_f32(q_hi)));
+  return vqmovn_u16(q16);
+}
+
+static void argb_to_rgba_neon(uint8_t *buf, uint32_t len) {
+  uint32_t cur = 0;
+  for (; cur + 32 <= len; cur += 32) {
+    uint8x8x4_t px = vld4_u8(buf + cur);  // B,G,R,A planes
+    uint8x8_t a = px.val[3];
+
+    uint8x8x4_t out;
+    out.val[3] = a;
+    if (vminv_u8(a) == 255) {
+      // fully opaque pixels only need the R/B swap
+      out.val[0] = px.val[2];
+      out.val[1] = px.val[1];
+      out.val[2] = px.val[0];
+    } else {
+      // keep the original color for a == 0 and a == 255
+      uint8x8_t keep = vorr_u8(vceq_u8(a, vdup_n_u8(0)),
+                               vceq_u8(a, vdup_n_u8(255)));
+      out.val[0] = vbsl_u8(keep, px.val[2], unmul_neon(px.val[2], a));
+      out.val[1] = vbsl_u8(keep, px.val[1], unmul_neon(px.val[1], a));
+      out.val[2] = vbsl_u8(keep, px.val[0], unmul_neon(px.val[0], a));
+    }
+    vst4_u8(buf + cur, out);
+  }
+  if (cur < len) {
+    argb_to_rgba_scalar(buf + cur, len - cur);
+  }
+}
+
+static void argb_row_sum_neon(uint32_t *acc,
+                              const uint32_t *row,
+                              int32_t w) {
+  int32_t x = 0;
+  for (; x + 4 <= w; x += 4) {
+    uint8x16_t px = vld1q_u8((const uint8_t *) (row + x));
+    uint16x8_t lo = vmovl_u8(vget_low_u8(px));
+    uint16x8_t hi = vmovl_u8(vget_high_u8(px));
+    uint32_t *a = acc + 4 * x;
+    vst1q_u32(a, vaddw_u16(vld1q_u32(a), vget_low_u16(lo)));
+    vst1q_u32(a + 4, vaddw_u16(vld1q_u32(a + 4), vget_high_u16(lo)));
+    vst1q_u32(a + 8, vaddw_u16(vld1q_u32(a + 8), vget_low_u16(hi)));
+    vst1q_u32(a + 12, vaddw_u16(vld1q_u32(a + 12), vget_high_u16(hi)));
+  }
+  if (x < w) {
+    argb_row_sum_scalar(acc + 4 * x, row + x, w - x);
+  }
+}
+
+// blend 8 u16 channel lanes: (p0 * (256 - w) + p1 * w + 128) >> 8; the
+// products and their sum stay within 16 bits
+static inline uint16x8_t lerp_u16_neon(uint16x8_t p0, uint16x8_t p1,
+                                       uint16x8_t w) {
+  uint16x8_t acc = vmulq_u16(p0, vsubq_u16(vdupq_n_u16(256), w));
+  acc = vaddq_u16(acc, vmulq_u16(p1, w));
+  return vshrq_n_u16(vaddq_u16(acc, vdupq_n_u16(128)), 8);
+}
+
+static void argb_scale_row_neon(uint32_t *dest,
+                                const uint32_t *src,
+                                const int32_t *sx,
+                                const uint16_t *wx,
+                                int32_t w) {
+  int32_t i = 0;
+  for (; i + 4 <= w; i += 4) {
+    // the taps are at arbitrary offsets, so gather them one at a time
+    uint32_t t0[4] = { src[sx[i]], src[sx[i + 1]],
+                       src[sx[i + 2]], src[sx[i + 3]] };
+    uint32_t t1[4] = { src[sx[i] + 1], src[sx[i + 1] + 1],
+                       src[sx[i + 2] + 1], src[sx[i + 3] + 1] };
+    uint8x16_t p0 = vreinterpretq_u8_u32(vld1q_u32(t0));
+    uint8x16_t p1 = vreinterpretq_u8_u32(vld1q_u32(t1));
+
+    // duplicate each tap's weight across its four channel lanes
+    uint16x4_t w4 = vld1_u16(wx + i);
+    uint16x4x2_t wz = vzip_u16(w4, w4);
+    uint16x4x2_t wz0 = vzip_u16(wz.val[0], wz.val[0]);
+    uint16x4x2_t wz1 = vzip_u16(wz.val[1], wz.val[1]);
+    uint16x8_t w_lo = vcombine_u16(wz0.val[0], wz0.val[1]);
+    uint16x8_t w_hi = vcombine_u16(wz1.val[0], wz1.val[1]);
+
+    uint16x8_t lo = lerp_u16_neon(vmovl_u8(vget_low_u8(p0)),
+                                  vmovl_u8(vget_low_u8(p1)), w_lo);
+    uint16x8_t hi = lerp_u16_neon(vmovl_u8(vget_high_u8(p0)),
+                                  vmovl_u8(vget_high_u8(p1)), w_hi);
+    vst1q_u32(dest + i, vreinterpretq_u32_u8(
+      vcombine_u8(vmovn_u16(lo), vmovn_u16(hi))));
+  }
+  if (i < w) {
+    argb_scale_row_scalar(dest + i, src, sx + i, wx + i, w - i);
+  }
+}
+
+static void argb_lerp_rows_neon(uint32_t *dest,
+                                const uint32_t *row0,
+                                const uint32_t *row1,
+                                uint16_t wy,
+                                int32_t w) {
+  const uint16x8_t wv = vdupq_n_u16(wy);
+  int32_t i = 0;
+  for (; i + 4 <= w; i += 4) {
+    uint8x16_t p0 = vld1q_u8((const uint8_t *) (row0 + i));
+    uint8x16_t p1 = vld1q_u8((const uint8_t *) (row1 + i));
+    uint16x8_t lo = lerp_u16_neon(vmovl_u8(vget_low_u8(p0)),
+                                  vmovl_u8(vget_low_u8(p1)), wv);
+    uint16x8_t hi = lerp_u16_neon(vmovl_u8(vget_high_u8(p0)),
+                                  vmovl_u8(vget_high_u8(p1)), wv);
+    vst1q_u32(dest + i, vreinterpretq_u32_u8(
+      vcombine_u8(vmovn_u16(lo), vmovn_u16(hi))));
+  }
+  if (i < w) {
+    argb_lerp_rows_scalar(dest + i, row0 + i, row1 + i, wy, w - i);
+  }
+}
+
+#elif defined(__wasm_simd128__)
+#define SIMD_DISPATCH_WASM 1
+
+#include <wasm_simd128.h>
+
+static void argb_to_rgba_wasm(uint8_t *buf, uint32_t len) {
+  const v128_t c255 = wasm_i32x4_splat(255);
+  const v128_t mask = wasm_i32x4_splat(0xff);
+  uint32_t cur = 0;
+  for (; cur + 16 <= len; cur += 16) {
+    v128_t px = wasm_v128_load(buf + cur);
+    v128_t a = wasm_u32x4_shr(px, 24);
+
+    // fully opaque pixels only need the R/B swap
+    v128_t opaque = wasm_i32x4_eq(a, c255);
+    if (wasm_i32x4_all_true(opaque)) {
+      wasm_v128_store(buf + cur,
+                      wasm_i8x16_shuffle(px, px, 2, 1, 0, 3, 6, 5, 4, 7,
+                                         10, 9, 8, 11, 14, 13, 12, 15));
+      continue;
+    }
+
+    v128_t r = wasm_v128_and(wasm_u32x4_shr(px, 16), mask);
+    v128_t g = wasm_v128_and(wasm_u32x4_shr(px, 8), mask);
+    v128_t b = wasm_v128_and(px, mask);
+
+    // un-premultiply: trunc(c * 255 / a), exact for the same reason as
+    // the x86 kernels
+    v128_t af = wasm_f32x4_convert_i32x4(a);
+    v128_t qr = wasm_i32x4_trunc_sat_f32x4(
+      wasm_f32x4_div(wasm_f32x4_convert_i32x4(wasm_i32x4_mul(r, c255)), af));
+    v128_t qg = wasm_i32x4_trunc_sat_f32x4(
+      wasm_f32x4_div(wasm_f32x4_convert_i32x4(wasm_i32x4_mul(g, c255)), af));
+    v128_t qb = wasm_i32x4_trunc_sat_f32x4(
+      wasm_f32x4_div(wasm_f32x4_convert_i32x4(wasm_i32x4_mul(b, c255)), af));
+
+    // keep the original color for a == 0 and a == 255
+    v128_t keep = wasm_v128_or(wasm_i32x4_eq(a, wasm_i32x4_splat(0)),
+                               opaque);
+    r = wasm_v128_bitselect(r, qr, keep);
+    g = wasm_v128_bitselect(g, qg, keep);
+    b = wasm_v128_bitselect(b, qb, keep);
+
+    v128_t out = wasm_v128_or(wasm_v128_or(r, wasm_i32x4_shl(g, 8)),
+                              wasm_v128_or(wasm_i32x4_shl(b, 16),
+                                           wasm_i32x4_shl(a, 24)));
+    wasm_v128_store(buf + cur, out);
+  }
+  if (cur < len) {
+    argb_to_rgba_scalar(buf + cur, len - cur);
+  }
+}
+
+#endif
+
+typedef void (*ycbcr422_fn)(uint32_t *, const int32_t *, const int32_t *,
+                            const int32_t *, int32_t);
+typedef void (*rgb_fn)(uint32_t *, const int32_t *, const int32_t *,
+                       const int32_t *, int32_t);
+typedef void (*argb_fn)(uint8_t *, uint32_t);
+typedef void (*rowsum_fn)(uint32_t *, const uint32_t *, int32_t);
+typedef void (*scalerow_fn)(uint32_t *, const uint32_t *, const int32_t *,
+                            const uint16_t *, int32_t);
+typedef void (*lerprows_fn)(uint32_t *, const uint32_t *, const uint32_t *,
+                            uint16_t, int32_t);
+
+static void ycbcr422_to_argb_boot(uint32_t *dest, const int32_t *y,
+                                  const int32_t *cb, const int32_t *cr,
+                                  int32_t w);
+static void rgb_to_argb_boot(uint32_t *dest, const int32_t *r,
+                             const int32_t *g, const int32_t *b, int32_t w);
+static void argb_to_rgba_boot(uint8_t *buf, uint32_t len);
+static void argb_row_sum_boot(uint32_t *acc, const uint32_t *row, int32_t w);
+static void argb_scale_row_boot(uint32_t *dest, const uint32_t *src,
+                                const int32_t *sx, const uint16_t *wx,
+                                int32_t w);
+static void argb_lerp_rows_boot(uint32_t *dest, const uint32_t *row0,
+                                const uint32_t *row1, uint16_t wy, int32_t w);
+
+// The boot functions select implementations on first use.  The race on
+// these pointers is benign: every thread writes the same values, and the
+// boot path remains correct if run more than once.
+static ycbcr422_fn ycbcr422_to_argb_impl = ycbcr422_to_argb_boot;
+static rgb_fn rgb_to_argb_impl = rgb_to_argb_boot;
+static argb_fn argb_to_rgba_impl = argb_to_rgba_boot;
+static rowsum_fn argb_row_sum_impl = argb_row_sum_boot;
+static scalerow_fn argb_scale_row_impl = argb_scale_row_boot;
+static lerprows_fn argb_lerp_rows_impl = argb_lerp_rows_boot;
+
+static void simd_resolve(void) {
+  ycbcr422_fn ycbcr422 = ycbcr422_to_argb_scalar;
+  rgb_fn rgb = rgb_to_argb_scalar;
+  argb_fn argb = argb_to_rgba_scalar;
+  rowsum_fn rowsum = argb_row_sum_scalar;
+  scalerow_fn scalerow = argb_scale_row_scalar;
+  lerprows_fn lerprows = argb_lerp_rows_scalar;
+
+#if defined(SIMD_DISPATCH_X86)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.1")) {
+    ycbcr422 = ycbcr422_to_argb_sse41;
+    rgb = rgb_to_argb_sse41;
+    argb = argb_to_rgba_sse41;
+    rowsum = argb_row_sum_sse41;
+    scalerow = argb_scale_row_sse41;
+    lerprows = argb_lerp_rows_sse41;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    ycbcr422 = ycbcr422_to_argb_avx2;
+    rgb = rgb_to_argb_avx2;
+    argb = argb_to_rgba_avx2;
+    rowsum = argb_row_sum_avx2;
+    scalerow = argb_scale_row_avx2;
+    lerprows = argb_lerp_rows_avx2;
+  }
+#elif defined(SIMD_DISPATCH_NEON)
+  // NEON is architectural on AArch64
+  ycbcr422 = ycbcr422_to_argb_neon;
+  rgb = rgb_to_argb_neon;
+  argb = argb_to_rgba_neon;
+  rowsum = argb_row_sum_neon;
+  scalerow = argb_scale_row_neon;
+  lerprows = argb_lerp_rows_neon;
+#elif defined(SIMD_DISPATCH_WASM)
+  // SIMD128 support is fixed at compile time
+  argb = argb_to_rgba_wasm;
+#endif
+
+  ycbcr422_to_argb_impl = ycbcr422;
+  rgb_to_argb_impl = rgb;
+  argb_to_rgba_impl = argb;
+  argb_row_sum_impl = rowsum;
+  argb_scale_row_impl = scalerow;
+  argb_lerp_rows_impl = lerprows;
+}
+
+static void ycbcr422_to_argb_boot(uint32_t *dest, const int32_t *y,
+                                  const int32_t *cb, const int32_t *cr,
+                                  int32_t w) {
+  simd_resolve();
+  ycbcr422_to_argb_impl(dest, y, cb, cr, w);
+}
+
+static void rgb_to_argb_boot(uint32_t *dest, const int32_t *r,
+                             const int32_t *g, const int32_t *b, int32_t w) {
+  simd_resolve();
+  rgb_to_argb_impl(dest, r, g, b, w);
+}
+
+static void argb_to_rgba_boot(uint8_t *buf, uint32_t len) {
+  simd_resolve();
+  argb_to_rgba_impl(buf, len);
+}
+
+static void argb_row_sum_boot(uint32_t *acc, const uint32_t *row,
+                              int32_t w) {
+  simd_resolve();
+  argb_row_sum_impl(acc, row, w);
+}
+
+static void argb_scale_row_boot(uint32_t *dest, const uint32_t *src,
+                                const int32_t *sx, const uint16_t *wx,
+                                int32_t w) {
+  simd_resolve();
+  argb_scale_row_impl(dest, src, sx, wx, w);
+}
+
+static void argb_lerp_rows_boot(uint32_t *dest, const uint32_t *row0,
+                                const uint32_t *row1, uint16_t wy,
+                                int32_t w) {
+  simd_resolve();
+  argb_lerp_rows_impl(dest, row0, row1, wy, w);
+}
+
+void _openslide_simd_ycbcr422_to_argb(uint32_t *dest,
+                                      const int32_t *y,
+                                      const int32_t *cb,
+                                      const int32_t *cr,
+                                      int32_t w) {
+  ycbcr422_to_argb_impl(dest, y, cb, cr, w);
+}
+
+void _openslide_simd_rgb_to_argb(uint32_t *dest,
+                                 const int32_t *r,
+                                 const int32_t *g,
+                                 const int32_t *b,
+                                 int32_t w) {
+  rgb_to_argb_impl(dest, r, g, b, w);
+}
+
+void _openslide_simd_argb_to_rgba(uint8_t *buf, uint32_t len) {
+  argb_to_rgba_impl(buf, len);
+}
+
+void _openslide_simd_argb_row_sum(uint32_t *acc,
+                                  const uint32_t *row,
+                                  int32_t w) {
+  argb_row_sum_impl(acc, row, w);
+}
+
+void _openslide_simd_argb_scale_row(uint32_t *dest,
+                                    const uint32_t *src,
+                                    const int32_t *sx,
+                                    const uint16_t *wx,
+                                    int32_t w) {
+  argb_scale_row_impl(dest, src, sx, wx, w);
+}
+
+void _openslide_simd_argb_lerp_rows(uint32_t *dest,
+                                    const uint32_t *row0,
+                                    const uint32_t *row1,
+                                    uint16_t wy,
+                                    int32_t w) {
+  argb_lerp_rows_impl(dest, row0, row1, wy, w);
+}
@@ -0,0 +1,83 @@
+/*
+ *  OpenSlide, a library for reading whole slide image files
+ *
+ *  Copyright (c) 2007-2015 Carnegie Mellon University
+ *  All rights reserved.
+ *
+ *  OpenSlide is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, version 2.1.
+ *
+ *  OpenSlide is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with OpenSlide. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef OPENSLIDE_OPENSLIDE_SIMD_H_
+#define OPENSLIDE_OPENSLIDE_SIMD_H_
+
+#include <stdint.h>
+
+/*
+ * Runtime-dispatched pixel conversion kernels.
+ *
+ * Each entry point selects an SSE4.1/AVX2/NEON implementation on first
+ * use, depending on the host CPU, and otherwise runs a scalar loop that
+ * computes exactly the same result.  This header is deliberately free of
+ * library dependencies so the kernels can also be used from the Python
+ * helper sources.
+ */
+
+// Convert one row of 4:2:2 subsampled YCbCr samples (one chroma pair per
+// two luma samples, as decoded by OpenJPEG into one int32 per sample) to
+// premultiplied ARGB32.
+void _openslide_simd_ycbcr422_to_argb(uint32_t *dest,
+                                      const int32_t *y,
+                                      const int32_t *cb,
+                                      const int32_t *cr,
+                                      int32_t w);
+
+// Convert one row of planar 8-bit RGB samples (one int32 per sample) to
+// premultiplied ARGB32.
+void _openslide_simd_rgb_to_argb(uint32_t *dest,
+                                 const int32_t *r,
+                                 const int32_t *g,
+                                 const int32_t *b,
+                                 int32_t w);
+
+// Convert a buffer of premultiplied ARGB32 pixels to non-premultiplied
+// RGBA bytes, in place.  len is in bytes.
+void _openslide_simd_argb_to_rgba(uint8_t *buf, uint32_t len);
+
+// Add one row of premultiplied ARGB32 pixels to per-channel uint32
+// accumulators, 4 accumulators per pixel in memory byte order.  This is
+// the vertical pass of a box downscale; the caller sums the
+// accumulators horizontally and divides by the box area.
+void _openslide_simd_argb_row_sum(uint32_t *acc,
+                                  const uint32_t *row,
+                                  int32_t w);
+
+// Resample one row of premultiplied ARGB32 pixels with horizontal
+// bilinear taps: dest[i] blends src[sx[i]] and src[sx[i] + 1], taking
+// wx[i]/256 of the second sample.  Weights run 0-256 inclusive.
+void _openslide_simd_argb_scale_row(uint32_t *dest,
+                                    const uint32_t *src,
+                                    const int32_t *sx,
+                                    const uint16_t *wx,
+                                    int32_t w);
+
+// Blend two rows of premultiplied ARGB32 pixels, taking wy/256 of the
+// second row.  This is the vertical tap of the bilinear resampler.
+void _openslide_simd_argb_lerp_rows(uint32_t *dest,
+                                    const uint32_t *row0,
+                                    const uint32_t *row1,
+                                    uint16_t wy,
+                                    int32_t w);
+
+#endif
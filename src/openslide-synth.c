@@ -0,0 +1,302 @@
+/*
+ *  OpenSlide, a library for reading whole slide image files
+ *
+ *  Copyright (c) 2007-2015 Carnegie Mellon University
+ *  All rights reserved.
+ *
+ *  OpenSlide is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, version 2.1.
+ *
+ *  OpenSlide is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with OpenSlide. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Synthesized pyramid levels
+ *
+ * Some slides ship pyramids with large downsample gaps, so
+ * openslide_get_best_level_for_downsample() has to pick a level several
+ * times finer than requested and the caller decodes far more pixels than
+ * it needs.  After a backend opens, we fill power-of-two gaps with
+ * synthetic levels: each one is rendered lazily, tile by tile, by
+ * painting the nearest finer real level into a scratch surface and
+ * box-filtering it down.  Synthesized tiles go through the ordinary
+ * tile cache, and the levels appear to the API as ordinary levels.
+ *
+ * The backend's ops and level array are saved and restored around the
+ * backend's destroy(), since backends walk osr->levels casting each
+ * entry to their private level struct.
+ */
+
+#ifndef CMAKE_BUILD
+  #include <config.h>
+#endif
+
+#include "openslide-private.h"
+
+#include <glib.h>
+#include <string.h>
+#include <cairo.h>
+
+// only synthesize when the next level is at least this much coarser
+#define SYNTH_GAP_MIN 4.0
+
+#define SYNTH_TILE_SIZE 512
+
+struct synth_level {
+  struct _openslide_level base;
+  struct _openslide_level *src;  // nearest finer real level
+  int32_t factor;                // power-of-two downsample from src
+  struct _openslide_grid *grid;
+};
+
+struct _openslide_synth {
+  const struct _openslide_ops *real_ops;
+  struct _openslide_level **real_levels;
+  int32_t real_level_count;
+  struct synth_level **levels;
+  int32_t level_count;
+};
+
+static struct synth_level *find_synth_level(openslide_t *osr,
+                                            struct _openslide_level *level) {
+  struct _openslide_synth *synth = osr->synth;
+  for (int32_t i = 0; i < synth->level_count; i++) {
+    if ((struct _openslide_level *) synth->levels[i] == level) {
+      return synth->levels[i];
+    }
+  }
+  return NULL;
+}
+
+// average factor x factor blocks of premultiplied ARGB; averaging is
+// linear, so premultiplication is preserved
+static void box_filter(const uint8_t *src, int32_t stride,
+                       uint32_t *dest, int64_t tw, int64_t th,
+                       int32_t factor) {
+  uint32_t n = factor * factor;
+  for (int64_t y = 0; y < th; y++) {
+    for (int64_t x = 0; x < tw; x++) {
+      uint32_t a = 0, r = 0, g = 0, b = 0;
+      for (int32_t fy = 0; fy < factor; fy++) {
+        const uint32_t *row =
+          (const uint32_t *) (src + (y * factor + fy) * stride);
+        for (int32_t fx = 0; fx < factor; fx++) {
+          uint32_t p = row[x * factor + fx];
+          a += p >> 24;
+          r += (p >> 16) & 0xff;
+          g += (p >> 8) & 0xff;
+          b += p & 0xff;
+        }
+      }
+      dest[y * tw + x] = (a / n) << 24 | (r / n) << 16 | (g / n) << 8 | (b / n);
+    }
+  }
+}
+
+static bool synth_read_tile(openslide_t *osr,
+                            cairo_t *cr,
+                            struct _openslide_level *level,
+                            int64_t tile_col, int64_t tile_row, int64_t channel,
+                            void *arg G_GNUC_UNUSED,
+                            GError **err) {
+  struct synth_level *l = (struct synth_level *) level;
+  struct _openslide_synth *synth = osr->synth;
+  int64_t tw = SYNTH_TILE_SIZE;
+  int64_t th = SYNTH_TILE_SIZE;
+
+  // cache
+  struct _openslide_cache_entry *cache_entry;
+  uint32_t *tiledata = _openslide_cache_get(osr->cache,
+                                            level, tile_col, tile_row, channel,
+                                            &cache_entry);
+  if (!tiledata) {
+    // render the corresponding region of the source level
+    int64_t sw = tw * l->factor;
+    int64_t sh = th * l->factor;
+    cairo_surface_t *scratch =
+      cairo_image_surface_create(CAIRO_FORMAT_ARGB32, sw, sh);
+    cairo_t *cr2 = cairo_create(scratch);
+    bool success = synth->real_ops->paint_region(osr, cr2,
+                                                 (int64_t) (tile_col * tw *
+                                                            l->base.downsample),
+                                                 (int64_t) (tile_row * th *
+                                                            l->base.downsample),
+                                                 channel, l->src,
+                                                 sw, sh, err);
+    if (success) {
+      success = _openslide_check_cairo_status(cr2, err);
+    }
+    cairo_destroy(cr2);
+    if (!success) {
+      cairo_surface_destroy(scratch);
+      return false;
+    }
+
+    // downsample into the tile
+    cairo_surface_flush(scratch);
+    tiledata = _openslide_cache_tile_alloc(osr->cache, tw * th * 4);
+    int64_t perf = _openslide_perf_begin();
+    box_filter(cairo_image_surface_get_data(scratch),
+               cairo_image_surface_get_stride(scratch),
+               tiledata, tw, th, l->factor);
+    _openslide_perf_end(_OPENSLIDE_PERF_CONVERT, perf);
+    cairo_surface_destroy(scratch);
+
+    // put it in the cache
+    _openslide_cache_put(osr->cache, level, tile_col, tile_row, channel,
+                         tiledata, tw * th * 4,
+                         &cache_entry);
+  }
+
+  // draw it
+  cairo_surface_t *surface =
+    cairo_image_surface_create_for_data((unsigned char *) tiledata,
+                                        CAIRO_FORMAT_ARGB32,
+                                        tw, th, tw * 4);
+  cairo_set_source_surface(cr, surface, 0, 0);
+  cairo_surface_destroy(surface);
+  cairo_paint(cr);
+
+  // done with the cache entry, release it
+  _openslide_cache_entry_unref(cache_entry);
+
+  return true;
+}
+
+static bool synth_paint_region(openslide_t *osr, cairo_t *cr,
+                               int64_t x, int64_t y, int64_t channel,
+                               struct _openslide_level *level,
+                               int32_t w, int32_t h,
+                               GError **err) {
+  struct _openslide_synth *synth = osr->synth;
+  struct synth_level *l = find_synth_level(osr, level);
+  if (!l) {
+    return synth->real_ops->paint_region(osr, cr, x, y, channel, level,
+                                         w, h, err);
+  }
+  return _openslide_grid_paint_region(l->grid, cr, NULL,
+                                      x / l->base.downsample,
+                                      y / l->base.downsample,
+                                      channel, level, w, h,
+                                      err);
+}
+
+static void synth_destroy(openslide_t *osr) {
+  struct _openslide_synth *synth = osr->synth;
+
+  for (int32_t i = 0; i < synth->level_count; i++) {
+    _openslide_grid_destroy(synth->levels[i]->grid);
+    g_slice_free(struct synth_level, synth->levels[i]);
+  }
+  g_free(synth->levels);
+  g_free(osr->levels);
+
+  // hand the backend back its own level array
+  osr->levels = synth->real_levels;
+  osr->level_count = synth->real_level_count;
+  osr->ops = synth->real_ops;
+  osr->synth = NULL;
+  g_slice_free(struct _openslide_synth, synth);
+
+  (osr->ops->destroy)(osr);
+}
+
+static uint8_t *synth_read_raw_tile(openslide_t *osr,
+                                    struct _openslide_level *level,
+                                    int64_t tile_col, int64_t tile_row,
+                                    int64_t *len, const char **codec,
+                                    GError **err) {
+  struct _openslide_synth *synth = osr->synth;
+  if (find_synth_level(osr, level) || !synth->real_ops->read_raw_tile) {
+    // synthesized tiles have no stored bitstream
+    g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                "No raw tiles for this level");
+    return NULL;
+  }
+  return synth->real_ops->read_raw_tile(osr, level, tile_col, tile_row,
+                                        len, codec, err);
+}
+
+static const struct _openslide_ops synth_ops = {
+  .paint_region = synth_paint_region,
+  .destroy = synth_destroy,
+  .read_raw_tile = synth_read_raw_tile,
+};
+
+// called after the backend opens, once downsamples are filled in
+void _openslide_synth_add_levels(openslide_t *osr) {
+  if (osr->level_count < 2) {
+    return;
+  }
+
+  // keep "all levels set tile geometry, or none" true
+  int64_t tile_hint = osr->levels[0]->tile_w > 0 ? SYNTH_TILE_SIZE : 0;
+
+  GPtrArray *merged = g_ptr_array_new();
+  GPtrArray *synths = g_ptr_array_new();
+
+  for (int32_t i = 0; i < osr->level_count; i++) {
+    struct _openslide_level *cur = osr->levels[i];
+    g_ptr_array_add(merged, cur);
+
+    if (i + 1 >= osr->level_count) {
+      break;
+    }
+    double a = cur->downsample;
+    double b = osr->levels[i + 1]->downsample;
+    if (b / a < SYNTH_GAP_MIN) {
+      continue;
+    }
+
+    // fill the gap with power-of-two steps from the finer level,
+    // stopping while still at least 2x finer than the coarser one
+    for (int32_t f = 2; b / (a * f) >= 2.0; f *= 2) {
+      struct synth_level *l = g_slice_new0(struct synth_level);
+      l->src = cur;
+      l->factor = f;
+      l->base.downsample = a * f;
+      l->base.w = cur->w / f;
+      l->base.h = cur->h / f;
+      l->base.tile_w = tile_hint;
+      l->base.tile_h = tile_hint;
+      int64_t tiles_across =
+        (l->base.w + SYNTH_TILE_SIZE - 1) / SYNTH_TILE_SIZE;
+      int64_t tiles_down =
+        (l->base.h + SYNTH_TILE_SIZE - 1) / SYNTH_TILE_SIZE;
+      l->grid = _openslide_grid_create_simple(osr,
+                                              tiles_across, tiles_down,
+                                              SYNTH_TILE_SIZE,
+                                              SYNTH_TILE_SIZE,
+                                              synth_read_tile);
+      g_ptr_array_add(merged, l);
+      g_ptr_array_add(synths, l);
+    }
+  }
+
+  if (!synths->len) {
+    g_ptr_array_free(merged, true);
+    g_ptr_array_free(synths, true);
+    return;
+  }
+
+  struct _openslide_synth *synth = g_slice_new0(struct _openslide_synth);
+  synth->real_ops = osr->ops;
+  synth->real_levels = osr->levels;
+  synth->real_level_count = osr->level_count;
+  synth->level_count = synths->len;
+  synth->levels = (struct synth_level **) g_ptr_array_free(synths, false);
+
+  osr->level_count = merged->len;
+  osr->levels = (struct _openslide_level **) g_ptr_array_free(merged, false);
+  osr->ops = &synth_ops;
+  osr->synth = synth;
+}
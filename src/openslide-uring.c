@@ -0,0 +1,270 @@
+/*
+ *  OpenSlide, a library for reading whole slide image files
+ *
+ *  Copyright (c) 2007-2015 Carnegie Mellon University
+ *  All rights reserved.
+ *
+ *  OpenSlide is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, version 2.1.
+ *
+ *  OpenSlide is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with OpenSlide. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Batched I/O preload
+ *
+ * All tile decoding goes through buffered FILE* access, so every tile
+ * of a paint region pays a synchronous storage round trip, one at a
+ * time.  When a backend can report where a tile's compressed bytes
+ * live, _openslide_io_preload() issues the reads for the whole batch
+ * in one io_uring submission before the decodes start, overlapping
+ * the round trips; the bytes are discarded and the decoders then hit
+ * the warm page cache.  On kernels without io_uring this degrades to
+ * a readahead hint per extent, and off Linux it is a no-op --
+ * preloading is advisory and never reports errors.
+ */
+
+#ifndef CMAKE_BUILD
+  #include <config.h>
+#endif
+
+#include "openslide-private.h"
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#endif
+#endif
+
+// enough for any sane paint region; extents beyond these are skipped
+#define PRELOAD_MAX_READS 64
+#define PRELOAD_MAX_READ_LEN (4 << 20)
+
+// ranges closer than this merge into one sequential read; cheaper to
+// read the gap than to seek over it on rotating storage
+#define PRELOAD_COALESCE_GAP (256 << 10)
+
+#ifdef __linux__
+
+#if defined(HAVE_IO_URING) && defined(__NR_io_uring_setup)
+
+static int uring_setup(unsigned entries, struct io_uring_params *p) {
+  return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                       unsigned flags) {
+  return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                 flags, NULL, 0);
+}
+
+// submit one read per extent and wait for all of them; the destination
+// buffer is scratch, reads only run to populate the page cache
+static bool uring_preload(int *fds, const struct _openslide_tile_extent *extents,
+                          int32_t count) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+
+  unsigned entries = 1;
+  while (entries < (unsigned) count) {
+    entries <<= 1;
+  }
+
+  int ring_fd = uring_setup(entries, &params);
+  if (ring_fd == -1) {
+    // ENOSYS on old kernels, EPERM under seccomp
+    return false;
+  }
+
+  bool success = false;
+  size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(guint32);
+  size_t cq_size = params.cq_off.cqes +
+                   params.cq_entries * sizeof(struct io_uring_cqe);
+  size_t sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+  void *sq_ring = mmap(NULL, sq_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+  void *cq_ring = mmap(NULL, cq_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+  struct io_uring_sqe *sqes = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE,
+                                   MAP_SHARED | MAP_POPULATE, ring_fd,
+                                   IORING_OFF_SQES);
+  if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED) {
+    goto DONE;
+  }
+
+  guint32 *sq_tail = (guint32 *) ((char *) sq_ring + params.sq_off.tail);
+  guint32 *sq_mask = (guint32 *) ((char *) sq_ring + params.sq_off.ring_mask);
+  guint32 *sq_array = (guint32 *) ((char *) sq_ring + params.sq_off.array);
+
+  // all reads share one scratch destination; the kernel may interleave
+  // writes into it, which is fine because the contents are never read
+  char *scratch = g_malloc(PRELOAD_MAX_READ_LEN);
+
+  guint32 tail = *sq_tail;
+  for (int32_t i = 0; i < count; i++) {
+    guint32 index = tail & *sq_mask;
+    struct io_uring_sqe *sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fds[i];
+    sqe->off = extents[i].offset;
+    sqe->addr = (guint64) (uintptr_t) scratch;
+    sqe->len = MIN(extents[i].length, PRELOAD_MAX_READ_LEN);
+    sq_array[index] = index;
+    tail++;
+  }
+  __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+
+  // one syscall for the whole batch; wait so the decoders see warm pages
+  success = uring_enter(ring_fd, count, count, IORING_ENTER_GETEVENTS) >= 0;
+
+  g_free(scratch);
+
+DONE:
+  if (sq_ring != MAP_FAILED) {
+    munmap(sq_ring, sq_size);
+  }
+  if (cq_ring != MAP_FAILED) {
+    munmap(cq_ring, cq_size);
+  }
+  if (sqes != MAP_FAILED) {
+    munmap(sqes, sqes_size);
+  }
+  close(ring_fd);
+  return success;
+}
+
+#else
+
+static bool uring_preload(int *fds G_GNUC_UNUSED,
+                          const struct _openslide_tile_extent *extents G_GNUC_UNUSED,
+                          int32_t count G_GNUC_UNUSED) {
+  return false;
+}
+
+#endif
+
+static void fadvise_preload(int *fds, const struct _openslide_tile_extent *extents,
+                            int32_t count) {
+  for (int32_t i = 0; i < count; i++) {
+    posix_fadvise(fds[i], extents[i].offset,
+                  MIN(extents[i].length, PRELOAD_MAX_READ_LEN),
+                  POSIX_FADV_WILLNEED);
+  }
+}
+
+// sort by file then offset, so the plan visits each file in one
+// forward sweep
+static int extent_compare(const void *a, const void *b) {
+  const struct _openslide_tile_extent *ea = a;
+  const struct _openslide_tile_extent *eb = b;
+  int cmp = strcmp(ea->path, eb->path);
+  if (cmp) {
+    return cmp;
+  }
+  if (ea->offset != eb->offset) {
+    return ea->offset < eb->offset ? -1 : 1;
+  }
+  return 0;
+}
+
+// I/O planning pass: sort the extents and coalesce adjacent or nearly
+// adjacent ranges into large sequential reads, so a paint that touches
+// many scattered tiles costs a few seeks instead of one per tile.
+// Returns the planned extent count.
+static int32_t plan_reads(struct _openslide_tile_extent *plan,
+                          int32_t count) {
+  qsort(plan, count, sizeof(*plan), extent_compare);
+
+  int32_t merged = 0;
+  for (int32_t i = 1; i < count; i++) {
+    struct _openslide_tile_extent *cur = &plan[merged];
+    struct _openslide_tile_extent *next = &plan[i];
+    int64_t cur_end = cur->offset + cur->length;
+    if (!strcmp(cur->path, next->path) &&
+        next->offset <= cur_end + PRELOAD_COALESCE_GAP &&
+        next->offset + next->length - cur->offset <= PRELOAD_MAX_READ_LEN) {
+      cur->length = MAX(cur_end, next->offset + next->length) - cur->offset;
+    } else {
+      plan[++merged] = *next;
+    }
+  }
+  return merged + 1;
+}
+
+void _openslide_io_preload(const struct _openslide_tile_extent *extents,
+                           int32_t count) {
+  if (count <= 0) {
+    return;
+  }
+
+  struct _openslide_tile_extent *plan = g_new(struct _openslide_tile_extent,
+                                              count);
+  memcpy(plan, extents, count * sizeof(*plan));
+  count = MIN(plan_reads(plan, count), PRELOAD_MAX_READS);
+  extents = plan;
+
+  // open each distinct path once; extents from one batch overwhelmingly
+  // point into a handful of data files
+  const char *paths[PRELOAD_MAX_READS];
+  int path_fds[PRELOAD_MAX_READS];
+  int path_count = 0;
+  int fds[PRELOAD_MAX_READS];
+
+  for (int32_t i = 0; i < count; i++) {
+    int fd = -1;
+    for (int j = 0; j < path_count; j++) {
+      if (!strcmp(paths[j], extents[i].path)) {
+        fd = path_fds[j];
+        break;
+      }
+    }
+    if (fd == -1) {
+      fd = open(extents[i].path, O_RDONLY | O_CLOEXEC);
+      if (fd == -1) {
+        // give up quietly; the decoder will report the real error
+        goto DONE;
+      }
+      paths[path_count] = extents[i].path;
+      path_fds[path_count++] = fd;
+    }
+    fds[i] = fd;
+  }
+
+  if (!uring_preload(fds, extents, count)) {
+    fadvise_preload(fds, extents, count);
+  }
+
+DONE:
+  for (int j = 0; j < path_count; j++) {
+    close(path_fds[j]);
+  }
+  g_free(plan);
+}
+
+#else
+
+void _openslide_io_preload(const struct _openslide_tile_extent *extents G_GNUC_UNUSED,
+                           int32_t count G_GNUC_UNUSED) {
+  // no batched-read or readahead primitive to lean on here
+}
+
+#endif
@@ -59,6 +59,8 @@ static const struct debug_option {
   {"performance", OPENSLIDE_DEBUG_PERFORMANCE,
    "log conditions causing poor performance"},
   {"tiles", OPENSLIDE_DEBUG_TILES, "render tile outlines"},
+  {"timing", OPENSLIDE_DEBUG_TIMING,
+   "collect per-stage read timings (see openslide_get_timing())"},
   {NULL, 0, NULL}
 };
 
@@ -233,9 +235,72 @@ FILE *_openslide_fopen(const char *path, const char *mode, GError **err)
   }
 #endif
 
+  // apply the caller's I/O policy, if any; set for the duration of
+  // openslide_open_with_options() so every file touched while opening
+  // inherits the caller's flags
+  int32_t policy = _openslide_io_policy_get();
+  if (policy) {
+    _openslide_io_advise(f, policy);
+  }
+
   return f;
 }
 
+// thread-local so the policy reaches do_fopen() without threading a
+// parameter through every open path; worker threads spawned later
+// capture it explicitly where they need it
+#if !GLIB_CHECK_VERSION(2,31,0)
+static GStaticPrivate io_policy_key = G_STATIC_PRIVATE_INIT;
+#define io_policy_raw_get() g_static_private_get(&io_policy_key)
+#define io_policy_raw_set(v) g_static_private_set(&io_policy_key, (v), NULL)
+#else
+static GPrivate io_policy_key;
+#define io_policy_raw_get() g_private_get(&io_policy_key)
+#define io_policy_raw_set(v) g_private_set(&io_policy_key, (v))
+#endif
+
+void _openslide_io_policy_set(int32_t flags) {
+  io_policy_raw_set(GINT_TO_POINTER(flags));
+}
+
+int32_t _openslide_io_policy_get(void) {
+  return GPOINTER_TO_INT(io_policy_raw_get());
+}
+
+#if defined(HAVE_FCNTL) && defined(POSIX_FADV_SEQUENTIAL)
+void _openslide_io_advise(FILE *f, int32_t flags) {
+  int fd = fileno(f);
+  if (fd == -1) {
+    return;
+  }
+  // best-effort; the advice cannot affect correctness, so failures
+  // (e.g. ESPIPE) are deliberately ignored
+  if (flags & OPENSLIDE_OPEN_SEQUENTIAL) {
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+  if (flags & OPENSLIDE_OPEN_NO_CACHE) {
+    posix_fadvise(fd, 0, 0, POSIX_FADV_NOREUSE);
+  }
+}
+
+void _openslide_io_drop_cache(FILE *f, int64_t offset, int64_t length) {
+  int fd = fileno(f);
+  if (fd == -1) {
+    return;
+  }
+  // only whole pages fully inside the range are dropped, and dirty
+  // pages are left alone, so slides we merely read are safe; length 0
+  // means to end of file
+  posix_fadvise(fd, offset, length, POSIX_FADV_DONTNEED);
+}
+#else
+void _openslide_io_advise(FILE *f G_GNUC_UNUSED,
+                          int32_t flags G_GNUC_UNUSED) {}
+void _openslide_io_drop_cache(FILE *f G_GNUC_UNUSED,
+                              int64_t offset G_GNUC_UNUSED,
+                              int64_t length G_GNUC_UNUSED) {}
+#endif
+
 #undef g_ascii_strtod
 double _openslide_parse_double(const char *value) {
   // Canonicalize comma to decimal point, since the locale of the
@@ -306,14 +371,12 @@ void _openslide_set_background_color_prop(openslide_t *osr,
                       g_strdup_printf("%.02X%.02X%.02X", r, g, b));
 }
 
-void _openslide_set_bounds_props_from_grid(openslide_t *osr,
-                                           struct _openslide_grid *grid) {
+void _openslide_set_bounds_props(openslide_t *osr,
+                                 double x, double y,
+                                 double w, double h) {
   g_return_if_fail(g_hash_table_lookup(osr->properties,
                                        OPENSLIDE_PROPERTY_NAME_BOUNDS_X) == NULL);
 
-  double x, y, w, h;
-  _openslide_grid_get_bounds(grid, &x, &y, &w, &h);
-
   g_hash_table_insert(osr->properties,
                       g_strdup(OPENSLIDE_PROPERTY_NAME_BOUNDS_X),
                       g_strdup_printf("%"PRId64,
@@ -332,34 +395,37 @@ void _openslide_set_bounds_props_from_grid(openslide_t *osr,
                                       (int64_t) (ceil(y + h) - floor(y))));
 }
 
+void _openslide_set_bounds_props_from_grid(openslide_t *osr,
+                                           struct _openslide_grid *grid) {
+  double x, y, w, h;
+  _openslide_grid_get_bounds(grid, &x, &y, &w, &h);
+  _openslide_set_bounds_props(osr, x, y, w, h);
+}
+
 bool _openslide_clip_tile(uint32_t *tiledata,
                           int64_t tile_w, int64_t tile_h,
                           int64_t clip_w, int64_t clip_h,
-                          GError **err) {
+                          GError **err G_GNUC_UNUSED) {
   if (clip_w >= tile_w && clip_h >= tile_h) {
     return true;
   }
+  clip_w = MAX(clip_w, (int64_t) 0);
+  clip_h = MAX(clip_h, (int64_t) 0);
+
+  // this runs on every border tile of every decode, so clear the
+  // margins directly rather than through a throwaway cairo context
+  if (clip_w < tile_w) {
+    // right margin, row by row
+    for (int64_t row = 0; row < MIN(clip_h, tile_h); row++) {
+      memset(tiledata + row * tile_w + clip_w, 0, (tile_w - clip_w) * 4);
+    }
+  }
+  if (clip_h < tile_h) {
+    // trailing rows in one span
+    memset(tiledata + clip_h * tile_w, 0, (tile_h - clip_h) * tile_w * 4);
+  }
 
-  cairo_surface_t *surface =
-    cairo_image_surface_create_for_data((unsigned char *) tiledata,
-                                        CAIRO_FORMAT_ARGB32,
-                                        tile_w, tile_h,
-                                        tile_w * 4);
-  cairo_t *cr = cairo_create(surface);
-  cairo_surface_destroy(surface);
-
-  cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
-
-  cairo_rectangle(cr, clip_w, 0, tile_w - clip_w, tile_h);
-  cairo_fill(cr);
-
-  cairo_rectangle(cr, 0, clip_h, tile_w, tile_h - clip_h);
-  cairo_fill(cr);
-
-  bool success = _openslide_check_cairo_status(cr, err);
-  cairo_destroy(cr);
-
-  return success;
+  return true;
 }
 
 // note: g_getenv() is not reentrant
@@ -408,3 +474,66 @@ void _openslide_performance_warn_once(gint *warned_flag,
     }
   }
 }
+
+
+// per-stage timing
+
+// the openslide_t the calling thread is currently reading for; decode
+// helpers deep in the pipeline have no osr argument, so samples are
+// attributed through this thread-local
+#if !GLIB_CHECK_VERSION(2,31,0)
+static GStaticPrivate perf_current = G_STATIC_PRIVATE_INIT;
+#define perf_current_get() g_static_private_get(&perf_current)
+#define perf_current_set(v) g_static_private_set(&perf_current, v, NULL)
+#else
+static GPrivate perf_current;
+#define perf_current_get() g_private_get(&perf_current)
+#define perf_current_set(v) g_private_set(&perf_current, v)
+#endif
+
+G_LOCK_DEFINE_STATIC(perf);
+
+static int64_t perf_now_ns(void) {
+#if GLIB_CHECK_VERSION(2,28,0)
+  return g_get_monotonic_time() * 1000;
+#else
+  GTimeVal tv;
+  g_get_current_time(&tv);
+  return ((int64_t) tv.tv_sec * G_USEC_PER_SEC + tv.tv_usec) * 1000;
+#endif
+}
+
+void _openslide_perf_set_current(openslide_t *osr) {
+  if (G_UNLIKELY(_openslide_debug(OPENSLIDE_DEBUG_TIMING))) {
+    perf_current_set(osr);
+  }
+}
+
+int64_t _openslide_perf_begin(void) {
+  if (G_LIKELY(!_openslide_debug(OPENSLIDE_DEBUG_TIMING))) {
+    return 0;
+  }
+  return perf_now_ns();
+}
+
+void _openslide_perf_end(enum _openslide_perf_stage stage, int64_t begin) {
+  if (G_LIKELY(begin == 0)) {
+    return;
+  }
+  openslide_t *osr = perf_current_get();
+  if (osr == NULL) {
+    return;
+  }
+  int64_t elapsed = perf_now_ns() - begin;
+  G_LOCK(perf);
+  osr->perf_ns[stage] += elapsed;
+  G_UNLOCK(perf);
+}
+
+int64_t _openslide_perf_read(openslide_t *osr,
+                             enum _openslide_perf_stage stage) {
+  G_LOCK(perf);
+  int64_t ns = osr->perf_ns[stage];
+  G_UNLOCK(perf);
+  return ns;
+}
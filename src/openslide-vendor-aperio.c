@@ -89,7 +89,7 @@ static void destroy(openslide_t *osr) {
 }
 
 static bool render_missing_tile(struct level *l,
-                                TIFF *tiff,
+                                struct _openslide_tiffcache *tc,
                                 uint32_t *dest,
                                 int64_t tile_col, int64_t tile_row,
                                 GError **err) {
@@ -119,7 +119,7 @@ static bool render_missing_tile(struct level *l,
     // level, extend the region by one pixel in each direction to ensure we
     // paint the surrounding tiles.  This reduces the visible seam that
     // would otherwise occur with non-integer downsamples.
-    success = _openslide_grid_paint_region(l->prev->grid, cr, tiff,
+    success = _openslide_grid_paint_region(l->prev->grid, cr, tc,
                                            (tile_col * tw - 1) / relative_ds,
                                            (tile_row * th - 1) / relative_ds,
                                            0, // CHANNEL FOR FLUORESCENCE
@@ -136,10 +136,21 @@ static bool render_missing_tile(struct level *l,
   return success;
 }
 
+static enum _openslide_jp2k_colorspace jp2k_colorspace(uint16_t compression) {
+  return compression == APERIO_COMPRESSION_JP2K_RGB ? OPENSLIDE_JP2K_RGB
+                                                    : OPENSLIDE_JP2K_YCBCR;
+}
+
+// if raw is non-NULL, also try to hand back the tile's standalone
+// bitstream for the compressed cache tier; tiles the raw path can't
+// produce just leave *raw NULL
 static bool decode_tile(struct level *l,
+                        struct _openslide_tiffcache *tc,
                         TIFF *tiff,
                         uint32_t *dest,
                         int64_t tile_col, int64_t tile_row,
+                        uint8_t **raw, int64_t *rawlen,
+                        const char **raw_codec,
                         GError **err) {
   struct _openslide_tiff_level *tiffl = &l->tiffl;
 
@@ -147,7 +158,7 @@ static bool decode_tile(struct level *l,
   int64_t tile_no = tile_row * tiffl->tiles_across + tile_col;
   if (g_hash_table_lookup_extended(l->missing_tiles, &tile_no, NULL, NULL)) {
     //g_debug("missing tile in level %p: (%"PRId64", %"PRId64")", (void *) l, tile_col, tile_row);
-    return render_missing_tile(l, tiff, dest,
+    return render_missing_tile(l, tc, dest,
                                tile_col, tile_row, err);
   }
 
@@ -161,6 +172,27 @@ static bool decode_tile(struct level *l,
     space = OPENSLIDE_JP2K_RGB;
     break;
   default:
+    if (raw) {
+      // decode from a standalone bitstream so it can feed the tier
+      GError *tmp_err = NULL;
+      int64_t len;
+      const char *codec;
+      uint8_t *buf = _openslide_tiff_read_raw_tile(tiffl, tiff,
+                                                   tile_col, tile_row,
+                                                   &len, &codec, &tmp_err);
+      if (buf) {
+        if (_openslide_tiff_decode_raw_tile(tiffl, buf, len, codec,
+                                            jp2k_colorspace(l->compression),
+                                            dest, &tmp_err)) {
+          *raw = buf;
+          *rawlen = len;
+          *raw_codec = codec;
+          return true;
+        }
+        g_free(buf);
+      }
+      g_clear_error(&tmp_err);
+    }
     // not for us? fallback
     return _openslide_tiff_read_tile(tiffl, tiff, dest,
                                      tile_col, tile_row,
@@ -185,7 +217,14 @@ static bool decode_tile(struct level *l,
                                                err);
 
   // clean up
-  g_free(buf);
+  if (success && raw) {
+    // the codestream is already standalone; hand it to the tier
+    *raw = buf;
+    *rawlen = buflen;
+    *raw_codec = "jp2k";
+  } else {
+    g_free(buf);
+  }
 
   return success;
 }
@@ -198,7 +237,7 @@ static bool read_tile(openslide_t *osr,
 		      GError **err) {
   struct level *l = (struct level *) level;
   struct _openslide_tiff_level *tiffl = &l->tiffl;
-  TIFF *tiff = arg;
+  struct _openslide_tiffcache *tc = arg;
 
   // tile size
   int64_t tw = tiffl->tile_w;
@@ -210,21 +249,73 @@ static bool read_tile(openslide_t *osr,
                                             level, tile_col, tile_row, channel,
                                             &cache_entry);
   if (!tiledata) {
-    tiledata = g_slice_alloc(tw * th * 4);
-    if (!decode_tile(l, tiff, tiledata, tile_col, tile_row, err)) {
-      g_slice_free1(tw * th * 4, tiledata);
+    // promote from the compressed tier, if the bitstream is resident:
+    // re-decoding from RAM beats re-reading the slide
+    int64_t rawlen;
+    const char *raw_codec;
+    uint8_t *raw = _openslide_cache_get_compressed(osr->cache, level,
+                                                   tile_col, tile_row, channel,
+                                                   &rawlen, &raw_codec);
+    if (raw) {
+      uint32_t *buf = _openslide_cache_tile_alloc(osr->cache, tw * th * 4);
+      GError *tmp_err = NULL;
+      if (_openslide_tiff_decode_raw_tile(tiffl, raw, rawlen, raw_codec,
+                                          jp2k_colorspace(l->compression),
+                                          buf, &tmp_err) &&
+          _openslide_tiff_clip_tile(tiffl, buf,
+                                    tile_col, tile_row,
+                                    &tmp_err)) {
+        tiledata = buf;
+        _openslide_cache_put(osr->cache, level, tile_col, tile_row, channel,
+                             tiledata, tw * th * 4,
+                             &cache_entry);
+      } else {
+        // fall through to the normal read path
+        g_clear_error(&tmp_err);
+        _openslide_cache_tile_free(osr->cache, tw * th * 4, buf);
+      }
+      g_free(raw);
+    }
+  }
+
+  if (!tiledata) {
+    // take a private TIFF handle so concurrent tile decodes don't
+    // share libtiff state or opj codec instances
+    TIFF *tiff = _openslide_tiffcache_get(tc, err);
+    if (tiff == NULL) {
       return false;
     }
 
+    // capture the bitstream alongside the pixels when the compressed
+    // tier wants it
+    uint8_t *raw = NULL;
+    int64_t rawlen = 0;
+    const char *raw_codec = NULL;
+    bool tier = _openslide_cache_has_compressed_tier(osr->cache);
+
+    tiledata = _openslide_cache_tile_alloc(osr->cache, tw * th * 4);
+    if (!decode_tile(l, tc, tiff, tiledata, tile_col, tile_row,
+                     tier ? &raw : NULL, &rawlen, &raw_codec, err)) {
+      _openslide_cache_tile_free(osr->cache, tw * th * 4, tiledata);
+      _openslide_tiffcache_put(tc, tiff);
+      return false;
+    }
+    _openslide_tiffcache_put(tc, tiff);
+
     // clip, if necessary
     if (!_openslide_tiff_clip_tile(tiffl, tiledata,
                                    tile_col, tile_row,
                                    err)) {
-      g_slice_free1(tw * th * 4, tiledata);
+      _openslide_cache_tile_free(osr->cache, tw * th * 4, tiledata);
+      g_free(raw);
       return false;
     }
 
     // put it in the cache
+    if (raw) {
+      _openslide_cache_put_compressed(osr->cache, level, tile_col, tile_row,
+                                      channel, raw, rawlen, raw_codec);
+    }
     _openslide_cache_put(osr->cache, level, tile_col, tile_row, channel,
 			 tiledata, tw * th * 4,
 			 &cache_entry);
@@ -253,25 +344,37 @@ static bool paint_region(openslide_t *osr, cairo_t *cr,
   struct aperio_ops_data *data = osr->data;
   struct level *l = (struct level *) level;
 
+  return _openslide_grid_paint_region(l->grid, cr, data->tc,
+                                      x / l->base.downsample,
+                                      y / l->base.downsample,
+                                      channel, // CHANNEL FOR FLUORESCENCE
+                                      level, w, h,
+                                      err);
+}
+
+static uint8_t *read_raw_tile(openslide_t *osr,
+                              struct _openslide_level *level,
+                              int64_t tile_col, int64_t tile_row,
+                              int64_t *len, const char **codec,
+                              GError **err) {
+  struct aperio_ops_data *data = osr->data;
+  struct level *l = (struct level *) level;
+
   TIFF *tiff = _openslide_tiffcache_get(data->tc, err);
   if (tiff == NULL) {
-    return false;
+    return NULL;
   }
-
-  bool success = _openslide_grid_paint_region(l->grid, cr, tiff,
-                                              x / l->base.downsample,
-                                              y / l->base.downsample,
-                                              channel, // CHANNEL FOR FLUORESCENCE
-                                              level, w, h,
-                                              err);
+  uint8_t *buf = _openslide_tiff_read_raw_tile(&l->tiffl, tiff,
+                                               tile_col, tile_row,
+                                               len, codec, err);
   _openslide_tiffcache_put(data->tc, tiff);
-
-  return success;
+  return buf;
 }
 
 static const struct _openslide_ops aperio_ops = {
   .paint_region = paint_region,
   .destroy = destroy,
+  .read_raw_tile = read_raw_tile,
 };
 
 static bool aperio_detect(const char *filename G_GNUC_UNUSED,
@@ -533,6 +636,8 @@ static bool aperio_open(openslide_t *osr,
                                               tiffl->tile_w,
                                               tiffl->tile_h,
                                               read_tile);
+      // read_tile takes a private handle from the tiffcache per miss
+      _openslide_grid_enable_concurrent_read(l->grid);
 
       // get compression
       if (!TIFFGetField(tiff, TIFFTAG_COMPRESSION, &l->compression)) {
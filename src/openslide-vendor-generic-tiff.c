@@ -71,7 +71,7 @@ static bool read_tile(openslide_t *osr,
                       GError **err) {
   struct level *l = (struct level *) level;
   struct _openslide_tiff_level *tiffl = &l->tiffl;
-  TIFF *tiff = arg;
+  struct _openslide_tiffcache *tc = arg;
 
   // tile size
   int64_t tw = tiffl->tile_w;
@@ -83,23 +83,94 @@ static bool read_tile(openslide_t *osr,
                                             level, tile_col, tile_row, channel,
                                             &cache_entry);
   if (!tiledata) {
-    tiledata = g_slice_alloc(tw * th * 4);
-    if (!_openslide_tiff_read_tile(tiffl, tiff,
+    // promote from the compressed tier, if the bitstream is resident:
+    // re-decoding from RAM beats re-reading the slide
+    int64_t rawlen;
+    const char *raw_codec;
+    uint8_t *raw = _openslide_cache_get_compressed(osr->cache, level,
+                                                   tile_col, tile_row, channel,
+                                                   &rawlen, &raw_codec);
+    if (raw) {
+      uint32_t *buf = _openslide_cache_tile_alloc(osr->cache, tw * th * 4);
+      GError *tmp_err = NULL;
+      if (_openslide_tiff_decode_raw_tile(tiffl, raw, rawlen, raw_codec,
+                                          OPENSLIDE_JP2K_YCBCR,
+                                          buf, &tmp_err) &&
+          _openslide_tiff_clip_tile(tiffl, buf,
+                                    tile_col, tile_row,
+                                    &tmp_err)) {
+        tiledata = buf;
+        _openslide_cache_put(osr->cache, level, tile_col, tile_row, channel,
+                             tiledata, tw * th * 4,
+                             &cache_entry);
+      } else {
+        // fall through to the normal read path
+        g_clear_error(&tmp_err);
+        _openslide_cache_tile_free(osr->cache, tw * th * 4, buf);
+      }
+      g_free(raw);
+    }
+  }
+
+  if (!tiledata) {
+    // take a handle per miss; libtiff handles are not thread-safe and
+    // this callback may run on a decode worker thread
+    TIFF *tiff = _openslide_tiffcache_get(tc, err);
+    if (tiff == NULL) {
+      return false;
+    }
+
+    tiledata = _openslide_cache_tile_alloc(osr->cache, tw * th * 4);
+
+    // when the compressed tier is active, decode from a standalone
+    // bitstream so it can feed the tier; tiles the raw path can't
+    // produce fall back to libtiff without one
+    uint8_t *raw = NULL;
+    int64_t rawlen = 0;
+    const char *raw_codec = NULL;
+    bool decoded = false;
+    if (_openslide_cache_has_compressed_tier(osr->cache)) {
+      GError *tmp_err = NULL;
+      raw = _openslide_tiff_read_raw_tile(tiffl, tiff,
+                                          tile_col, tile_row,
+                                          &rawlen, &raw_codec, &tmp_err);
+      if (raw) {
+        decoded = _openslide_tiff_decode_raw_tile(tiffl, raw, rawlen,
+                                                  raw_codec,
+                                                  OPENSLIDE_JP2K_YCBCR,
+                                                  tiledata, &tmp_err);
+        if (!decoded) {
+          g_free(raw);
+          raw = NULL;
+        }
+      }
+      g_clear_error(&tmp_err);
+    }
+
+    if (!decoded &&
+        !_openslide_tiff_read_tile(tiffl, tiff,
                                    tiledata, tile_col, tile_row,
                                    err)) {
-      g_slice_free1(tw * th * 4, tiledata);
+      _openslide_cache_tile_free(osr->cache, tw * th * 4, tiledata);
+      _openslide_tiffcache_put(tc, tiff);
       return false;
     }
+    _openslide_tiffcache_put(tc, tiff);
 
     // clip, if necessary
     if (!_openslide_tiff_clip_tile(tiffl, tiledata,
                                    tile_col, tile_row,
                                    err)) {
-      g_slice_free1(tw * th * 4, tiledata);
+      _openslide_cache_tile_free(osr->cache, tw * th * 4, tiledata);
+      g_free(raw);
       return false;
     }
 
     // put it in the cache
+    if (raw) {
+      _openslide_cache_put_compressed(osr->cache, level, tile_col, tile_row,
+                                      channel, raw, rawlen, raw_codec);
+    }
     _openslide_cache_put(osr->cache, level, tile_col, tile_row, channel,
                          tiledata, tw * th * 4,
                          &cache_entry);
@@ -128,25 +199,37 @@ static bool paint_region(openslide_t *osr, cairo_t *cr,
   struct generic_tiff_ops_data *data = osr->data;
   struct level *l = (struct level *) level;
 
+  return _openslide_grid_paint_region(l->grid, cr, data->tc,
+                                      x / l->base.downsample,
+                                      y / l->base.downsample,
+                                      channel, // CHANNEL FOR FLUORESCENCE
+                                      level, w, h,
+                                      err);
+}
+
+static uint8_t *read_raw_tile(openslide_t *osr,
+                              struct _openslide_level *level,
+                              int64_t tile_col, int64_t tile_row,
+                              int64_t *len, const char **codec,
+                              GError **err) {
+  struct generic_tiff_ops_data *data = osr->data;
+  struct level *l = (struct level *) level;
+
   TIFF *tiff = _openslide_tiffcache_get(data->tc, err);
   if (tiff == NULL) {
-    return false;
+    return NULL;
   }
-
-  bool success = _openslide_grid_paint_region(l->grid, cr, tiff,
-                                              x / l->base.downsample,
-                                              y / l->base.downsample,
-                                              channel, // CHANNEL FOR FLUORESCENCE
-                                              level, w, h,
-                                              err);
+  uint8_t *buf = _openslide_tiff_read_raw_tile(&l->tiffl, tiff,
+                                               tile_col, tile_row,
+                                               len, codec, err);
   _openslide_tiffcache_put(data->tc, tiff);
-
-  return success;
+  return buf;
 }
 
 static const struct _openslide_ops generic_tiff_ops = {
   .paint_region = paint_region,
   .destroy = destroy,
+  .read_raw_tile = read_raw_tile,
 };
 
 static bool generic_tiff_detect(const char *filename G_GNUC_UNUSED,
@@ -245,6 +328,8 @@ static bool generic_tiff_open(openslide_t *osr,
                                             tiffl->tile_w,
                                             tiffl->tile_h,
                                             read_tile);
+    // read_tile takes a private handle from the tiffcache per miss
+    _openslide_grid_enable_concurrent_read(l->grid);
 
     // add to array
     g_ptr_array_add(level_array, l);
@@ -46,6 +46,7 @@
 #include "openslide-decode-tifflike.h"
 
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <setjmp.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -138,6 +139,9 @@ struct hamamatsu_jpeg_ops_data {
   int32_t jpeg_count;
   struct jpeg **all_jpegs;
 
+  // sidecar index caching discovered restart marker offsets across opens
+  char *marker_index_path;
+
   // thread stuff, for background search of restart markers
   GTimer *restart_marker_timer;
 #if !GLIB_CHECK_VERSION(2,31,0)
@@ -708,13 +712,13 @@ static bool read_jpeg_tile(openslide_t *osr,
                                             &cache_entry);
 
   if (!tiledata) {
-    tiledata = g_slice_alloc(tw * th * 4);
+    tiledata = _openslide_cache_tile_alloc(osr->cache, tw * th * 4);
     if (!read_from_jpeg(osr,
                         jp, tileno,
                         l->scale_denom,
                         tiledata, tw, th,
                         err)) {
-      g_slice_free1(tw * th * 4, tiledata);
+      _openslide_cache_tile_free(osr->cache, tw * th * 4, tiledata);
       return false;
     }
 
@@ -741,6 +745,74 @@ static bool read_jpeg_tile(openslide_t *osr,
   return true;
 }
 
+// advisory extent lookup for the batched preload: report where a tile's
+// compressed bytes live, using only marker positions that are already
+// known -- scanning the file here would serialize the batch behind the
+// very I/O it is trying to overlap
+static bool jpeg_tile_extent(openslide_t *osr,
+                             struct _openslide_level *level,
+                             int64_t tile_col, int64_t tile_row,
+                             struct _openslide_tile_extent *extent) {
+  struct hamamatsu_jpeg_ops_data *data = osr->data;
+  struct jpeg_level *l = (struct jpeg_level *) level;
+
+  int32_t jpeg_col = tile_col / l->jpegs[0]->tiles_across;
+  int32_t jpeg_row = tile_row / l->jpegs[0]->tiles_down;
+  int32_t local_tile_col = tile_col % l->jpegs[0]->tiles_across;
+  int32_t local_tile_row = tile_row % l->jpegs[0]->tiles_down;
+  if (jpeg_col < 0 || jpeg_col >= l->jpegs_across ||
+      jpeg_row < 0 || jpeg_row >= l->jpegs_down) {
+    return false;
+  }
+
+  struct jpeg *jp = l->jpegs[jpeg_row * l->jpegs_across + jpeg_col];
+  int32_t tileno = local_tile_row * jp->tiles_across + local_tile_col;
+  if (tileno < 0 || tileno >= jp->tile_count) {
+    return false;
+  }
+
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_lock(data->restart_marker_mutex);
+#else
+  g_mutex_lock(&data->restart_marker_mutex);
+#endif
+
+  int64_t start = jp->mcu_starts[tileno];
+  if (start == -1 && tileno == 0) {
+    start = jp->header_stop_position;
+  }
+  int64_t stop;
+  if (tileno + 1 == jp->tile_count) {
+    stop = jp->end_in_file;
+  } else {
+    stop = jp->mcu_starts[tileno + 1];
+  }
+  if (jp->unreliable_mcu_starts != NULL) {
+    // unvalidated positions from the optimisation file are fine for a
+    // cache warm; read_from_jpeg() will still validate before decoding
+    if (start == -1) {
+      start = jp->unreliable_mcu_starts[tileno];
+    }
+    if (stop == -1) {
+      stop = jp->unreliable_mcu_starts[tileno + 1];
+    }
+  }
+
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_unlock(data->restart_marker_mutex);
+#else
+  g_mutex_unlock(&data->restart_marker_mutex);
+#endif
+
+  if (start == -1 || stop == -1 || stop <= start) {
+    return false;
+  }
+  extent->path = jp->filename;
+  extent->offset = start;
+  extent->length = stop - start;
+  return true;
+}
+
 
 static bool jpeg_paint_region(openslide_t *osr, cairo_t *cr,
                               int64_t x, int64_t y, int64_t channel,
@@ -856,6 +928,7 @@ static void jpeg_do_destroy(openslide_t *osr) {
   g_cond_free(data->restart_marker_cond);
   g_mutex_free(data->restart_marker_cond_mutex);
 #endif
+  g_free(data->marker_index_path);
   // the structure
   g_slice_free(struct hamamatsu_jpeg_ops_data, data);
 }
@@ -964,6 +1037,149 @@ static bool verify_mcu_starts(int32_t num_jpegs, struct jpeg **jpegs,
   return true;
 }
 
+// marker offset sidecar
+//
+// Scanning every constituent JPEG for restart markers is why large VMS
+// slides take seconds to open.  Once a scan has completed, the offset
+// tables are serialized to a sidecar next to the slide and restored on
+// the next open, validated per JPEG by file size and mtime; a valid
+// sidecar means no marker scanning at all.  Offsets are copied into the
+// per-JPEG tables rather than aliased into a mapping because
+// _compute_mcu_start() may still rewrite entries.  Saving is
+// best-effort: slides on read-only archives just rescan every time.
+
+static const char MARKER_INDEX_SUFFIX[] = ".markers";
+static const char MARKER_INDEX_MAGIC[] = "HVMSIDX1";  // 8 bytes
+
+static bool marker_index_stat(const char *filename,
+                              int64_t *size, int64_t *mtime) {
+  GStatBuf st;
+  if (g_stat(filename, &st)) {
+    return false;
+  }
+  *size = st.st_size;
+  *mtime = st.st_mtime;
+  return true;
+}
+
+static void marker_index_append_int64(GByteArray *buf, int64_t val) {
+  int64_t le = GINT64_TO_LE(val);
+  g_byte_array_append(buf, (guint8 *) &le, sizeof(le));
+}
+
+static bool marker_index_read_int64(const char *contents, gsize len,
+                                    gsize *pos, int64_t *val) {
+  if (len - *pos < sizeof(int64_t)) {
+    return false;
+  }
+  int64_t le;
+  memcpy(&le, contents + *pos, sizeof(le));
+  *pos += sizeof(le);
+  *val = GINT64_FROM_LE(le);
+  return true;
+}
+
+// returns true if every JPEG's offset table was restored, making a
+// marker scan unnecessary
+static bool marker_index_load(struct hamamatsu_jpeg_ops_data *data) {
+  char *contents = NULL;
+  gsize len;
+  if (!data->marker_index_path ||
+      !g_file_get_contents(data->marker_index_path, &contents, &len, NULL)) {
+    return false;
+  }
+
+  bool complete = false;
+  gsize pos = strlen(MARKER_INDEX_MAGIC);
+  int64_t jpeg_count;
+  if (len < pos ||
+      memcmp(contents, MARKER_INDEX_MAGIC, pos) ||
+      !marker_index_read_int64(contents, len, &pos, &jpeg_count) ||
+      jpeg_count != data->jpeg_count) {
+    goto OUT;
+  }
+
+  for (int32_t i = 0; i < data->jpeg_count; i++) {
+    struct jpeg *jp = data->all_jpegs[i];
+    int64_t size, mtime, tile_count;
+    if (!marker_index_read_int64(contents, len, &pos, &size) ||
+        !marker_index_read_int64(contents, len, &pos, &mtime) ||
+        !marker_index_read_int64(contents, len, &pos, &tile_count)) {
+      goto OUT;
+    }
+    int64_t cur_size, cur_mtime;
+    if (tile_count != jp->tile_count ||
+        !marker_index_stat(jp->filename, &cur_size, &cur_mtime) ||
+        size != cur_size || mtime != cur_mtime) {
+      // stale entry; offsets would be garbage
+      goto OUT;
+    }
+    if (len - pos < (gsize) tile_count * sizeof(int64_t)) {
+      goto OUT;
+    }
+    for (int32_t j = 0; j < jp->tile_count; j++) {
+      int64_t offset;
+      marker_index_read_int64(contents, len, &pos, &offset);
+      if (offset < 0) {
+        goto OUT;
+      }
+      jp->mcu_starts[j] = offset;
+    }
+  }
+  complete = true;
+
+OUT:
+  g_free(contents);
+  return complete;
+}
+
+static void marker_index_save(struct hamamatsu_jpeg_ops_data *data) {
+  if (!data->marker_index_path) {
+    return;
+  }
+
+  // concurrent paints may still be validating entries
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_lock(data->restart_marker_mutex);
+#else
+  g_mutex_lock(&data->restart_marker_mutex);
+#endif
+
+  GByteArray *buf = g_byte_array_new();
+  g_byte_array_append(buf, (const guint8 *) MARKER_INDEX_MAGIC,
+                      strlen(MARKER_INDEX_MAGIC));
+  marker_index_append_int64(buf, data->jpeg_count);
+  for (int32_t i = 0; i < data->jpeg_count; i++) {
+    struct jpeg *jp = data->all_jpegs[i];
+    int64_t size, mtime;
+    if (!marker_index_stat(jp->filename, &size, &mtime)) {
+      goto OUT;
+    }
+    marker_index_append_int64(buf, size);
+    marker_index_append_int64(buf, mtime);
+    marker_index_append_int64(buf, jp->tile_count);
+    for (int32_t j = 0; j < jp->tile_count; j++) {
+      if (jp->mcu_starts[j] == -1) {
+        // incomplete scan; don't persist a partial table
+        goto OUT;
+      }
+      marker_index_append_int64(buf, jp->mcu_starts[j]);
+    }
+  }
+
+  // atomic via rename; failure just means the next open rescans
+  g_file_set_contents(data->marker_index_path,
+                      (const char *) buf->data, buf->len, NULL);
+
+OUT:
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_unlock(data->restart_marker_mutex);
+#else
+  g_mutex_unlock(&data->restart_marker_mutex);
+#endif
+  g_byte_array_free(buf, true);
+}
+
 static gpointer restart_marker_thread_func(gpointer d) {
   openslide_t *osr = d;
   struct hamamatsu_jpeg_ops_data *data = osr->data;
@@ -1084,6 +1300,11 @@ static gpointer restart_marker_thread_func(gpointer d) {
     }
   }
 
+  // the full table is only known here; persist it for the next open
+  if (current_jpeg == data->jpeg_count && !tmp_err) {
+    marker_index_save(data);
+  }
+
   // store error, if any
   if (tmp_err) {
     //g_debug("restart_marker_thread_func failed: %s", tmp_err->message);
@@ -1371,6 +1592,9 @@ static void create_scaled_jpeg_levels(openslide_t *osr,
                                                  sd_l->tile_width,
                                                  sd_l->tile_height,
                                                  read_jpeg_tile);
+      // each tile is an independently-decodable restart interval
+      _openslide_grid_enable_concurrent_read(sd_l->grid);
+      _openslide_grid_simple_set_extent_lookup(sd_l->grid, jpeg_tile_extent);
 
       key = g_slice_new(int64_t);
       *key = sd_l->base.w;
@@ -1415,6 +1639,7 @@ static void create_scaled_jpeg_levels(openslide_t *osr,
 
 // consumes levels/jpegs, even on failure
 static bool init_jpeg_ops(openslide_t *osr,
+                          const char *filename,
                           int32_t level_count, struct jpeg_level **levels,
                           int32_t num_jpegs, struct jpeg **jpegs,
                           bool background_thread,
@@ -1425,8 +1650,16 @@ static bool init_jpeg_ops(openslide_t *osr,
     g_slice_new0(struct hamamatsu_jpeg_ops_data);
   data->jpeg_count = num_jpegs;
   data->all_jpegs = jpegs;
+  data->marker_index_path = g_strdup_printf("%s%s", filename,
+                                            MARKER_INDEX_SUFFIX);
   osr->data = data;
 
+  // restore marker offsets discovered by a previous open; a complete
+  // restore leaves nothing for the background scan to do
+  if (marker_index_load(data)) {
+    background_thread = false;
+  }
+
   // create scale_denom levels
   create_scaled_jpeg_levels(osr, &level_count, &levels);
 
@@ -1549,11 +1782,17 @@ static struct jpeg_level *create_jpeg_level(openslide_t *osr,
                                           l->tiles_across, l->tiles_down,
                                           l->tile_width, l->tile_height,
                                           read_jpeg_tile);
+  // each tile is an independently-decodable restart interval, read with
+  // a private FILE and libjpeg context; marker lookups are serialized by
+  // restart_marker_mutex
+  _openslide_grid_enable_concurrent_read(l->grid);
+  _openslide_grid_simple_set_extent_lookup(l->grid, jpeg_tile_extent);
 
   return l;
 }
 
 static bool hamamatsu_vms_part2(openslide_t *osr,
+        const char *filename,
         int num_jpegs, char **image_filenames,
         int num_jpeg_cols, int num_jpeg_rows,
         FILE *optimisation_file,
@@ -1701,7 +1940,7 @@ static bool hamamatsu_vms_part2(openslide_t *osr,
   */
 
   // init ops
-  return init_jpeg_ops(osr,
+  return init_jpeg_ops(osr, filename,
                        level_count, levels,
                        num_jpegs, jpegs,
                        true, err);
@@ -1769,7 +2008,7 @@ static bool ngr_read_tile(openslide_t *osr,
     fclose(f);
 
     // got the data, now convert to 8-bit xRGB
-    tiledata = g_slice_alloc(tilesize);
+    tiledata = _openslide_cache_tile_alloc(osr->cache, tilesize);
     for (int i = 0; i < tw * th; i++) {
       // scale down from 12 bits
       uint8_t r = GINT16_FROM_LE(buf[(i * 3)]) >> 4;
@@ -1905,6 +2144,8 @@ static bool hamamatsu_vmu_part2(openslide_t *osr,
                                             l->column_width,
                                             NGR_TILE_HEIGHT,
                                             ngr_read_tile);
+    // tile reads are self-contained, each with a private FILE
+    _openslide_grid_enable_concurrent_read(l->grid);
 
     // tile size hints
     l->base.tile_w = l->column_width;
@@ -2171,7 +2412,7 @@ static bool hamamatsu_vms_vmu_open(openslide_t *osr, const char *filename,
     }
 
     // do all the jpeg stuff
-    success = hamamatsu_vms_part2(osr,
+    success = hamamatsu_vms_part2(osr, filename,
                                   num_images, image_filenames,
                                   num_cols, num_rows,
                                   optimisation_file,
@@ -2496,22 +2737,17 @@ static bool hamamatsu_ndpi_open(openslide_t *osr, const char *filename,
 
       // read MCU starts, if this directory is tiled
       if (jp->tile_count > 1) {
-        int64_t mcu_start_count =
-          _openslide_tifflike_get_value_count(tl, dir, NDPI_MCU_STARTS);
-
-        if (mcu_start_count == jp->tile_count) {
-          //g_debug("loading MCU starts for directory %"PRId64, dir);
-          const uint64_t *unreliable_mcu_starts =
-            _openslide_tifflike_get_uints(tl, dir, NDPI_MCU_STARTS, NULL);
-          if (unreliable_mcu_starts) {
-            jp->unreliable_mcu_starts = g_new(int64_t, mcu_start_count);
-            for (int64_t tile = 0; tile < mcu_start_count; tile++) {
-              jp->unreliable_mcu_starts[tile] =
-                jp->start_in_file + unreliable_mcu_starts[tile];
-              //g_debug("mcu start at %"PRId64, jp->unreliable_mcu_starts[tile]);
-            }
-          } else {
-            //g_debug("failed to load MCU starts for directory %"PRId64, dir);
+        //g_debug("loading MCU starts for directory %"PRId64, dir);
+        int64_t mcu_start_count;
+        const uint64_t *unreliable_mcu_starts =
+          _openslide_tifflike_get_uint_array(tl, dir, NDPI_MCU_STARTS,
+                                             &mcu_start_count, NULL);
+        if (unreliable_mcu_starts && mcu_start_count == jp->tile_count) {
+          jp->unreliable_mcu_starts = g_new(int64_t, mcu_start_count);
+          for (int64_t tile = 0; tile < mcu_start_count; tile++) {
+            jp->unreliable_mcu_starts[tile] =
+              jp->start_in_file + unreliable_mcu_starts[tile];
+            //g_debug("mcu start at %"PRId64, jp->unreliable_mcu_starts[tile]);
           }
         }
 
@@ -2579,7 +2815,7 @@ FAIL:
   }
 
   // init ops
-  return init_jpeg_ops(osr,
+  return init_jpeg_ops(osr, filename,
                        level_count, levels,
                        num_jpegs, jpegs,
                        restart_marker_scan, err);
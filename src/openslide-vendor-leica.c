@@ -164,11 +164,11 @@ static bool read_tile(openslide_t *osr,
                                             args->area, tile_col, tile_row, channel,
                                             &cache_entry);
   if (!tiledata) {
-    tiledata = g_slice_alloc(tw * th * 4);
+    tiledata = _openslide_cache_tile_alloc(osr->cache, tw * th * 4);
     if (!_openslide_tiff_read_tile(tiffl, args->tiff,
                                    tiledata, tile_col, tile_row,
                                    err)) {
-      g_slice_free1(tw * th * 4, tiledata);
+      _openslide_cache_tile_free(osr->cache, tw * th * 4, tiledata);
       return false;
     }
 
@@ -176,7 +176,7 @@ static bool read_tile(openslide_t *osr,
     if (!_openslide_tiff_clip_tile(tiffl, tiledata,
                                    tile_col, tile_row,
                                    err)) {
-      g_slice_free1(tw * th * 4, tiledata);
+      _openslide_cache_tile_free(osr->cache, tw * th * 4, tiledata);
       return false;
     }
 
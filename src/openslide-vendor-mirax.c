@@ -33,7 +33,7 @@
 #endif
 
 #include "openslide-private.h"
-#include "openslide-decode-gdkpixbuf.h"
+#include "openslide-decode-bmp.h"
 #include "openslide-decode-jpeg.h"
 #include "openslide-decode-png.h"
 
@@ -84,6 +84,10 @@ static const char VALUE_SLIDE_ZOOM_LEVEL[] = "Slide zoom level";
 
 static const int SLIDE_POSITION_RECORD_SIZE = 9;
 
+#if !GLIB_CHECK_VERSION(2,22,0)
+#define g_mapped_file_unref g_mapped_file_free
+#endif
+
 static const char GROUP_DATAFILE[] = "DATAFILE";
 static const char KEY_FILE_COUNT[] = "FILE_COUNT";
 static const char KEY_d_FILE[] = "FILE_%d";
@@ -191,6 +195,17 @@ struct tile {
   double src_y;
 };
 
+// raw image record from the index file, validated at open and expanded
+// into grid tiles on first paint of its level
+struct index_entry {
+  int32_t x;
+  int32_t y;
+  int32_t offset;
+  int32_t length;
+  int32_t fileno;
+  int32_t imageno;
+};
+
 struct level {
   struct _openslide_level base;
   struct _openslide_grid *grid;
@@ -201,10 +216,37 @@ struct level {
 
   double tile_w;
   double tile_h;
+
+  // parameters needed for deferred tile expansion
+  struct slide_zoom_level_params lp;
+  int zoom_level;
+
+  // index entries not yet expanded into the grid; NULL once expanded
+  GArray *pending_entries;
 };
 
 struct mirax_ops_data {
   gchar **datafile_paths;
+
+  // state for deferred tile expansion
+#if !GLIB_CHECK_VERSION(2,31,0)
+  GMutex *expand_mutex;
+#else
+  GMutex expand_mutex;
+#endif
+  int32_t *slide_positions;
+  GHashTable *active_positions;
+  int images_across;
+  int images_down;
+  int image_divisions;
+};
+
+// memory-mapped view of the index file, falling back to an in-memory
+// copy on filesystems that cannot be mapped
+struct index_buffer {
+  GMappedFile *mapped;
+  uint8_t *data;   // owned iff mapped == NULL
+  int64_t len;
 };
 
 static void image_unref(struct image *image) {
@@ -227,7 +269,7 @@ static uint32_t *read_image(openslide_t *osr,
   struct mirax_ops_data *data = osr->data;
   bool result = false;
 
-  uint32_t *dest = g_slice_alloc(w * h * 4);
+  uint32_t *dest = _openslide_cache_tile_alloc(osr->cache, w * h * 4);
 
   switch (format) {
   case FORMAT_JPEG:
@@ -243,23 +285,24 @@ static uint32_t *read_image(openslide_t *osr,
                                  err);
     break;
   case FORMAT_BMP:
-    result = _openslide_gdkpixbuf_read("bmp",
-                                       data->datafile_paths[image->fileno],
-                                       image->start_in_file, image->length,
-                                       dest, w, h,
-                                       err);
+    result = _openslide_bmp_read(data->datafile_paths[image->fileno],
+                                 image->start_in_file, image->length,
+                                 dest, w, h,
+                                 err);
     break;
   default:
     g_assert_not_reached();
   }
 
   if (!result) {
-    g_slice_free1(w * h * 4, dest);
+    _openslide_cache_tile_free(osr->cache, w * h * 4, dest);
     return NULL;
   }
   return dest;
 }
 
+static void expand_pending_tiles(openslide_t *osr, struct level *l);
+
 static bool read_tile(openslide_t *osr,
                       cairo_t *cr,
                       struct _openslide_level *level,
@@ -338,13 +381,116 @@ static bool read_tile(openslide_t *osr,
   return success;
 }
 
-static bool paint_region(openslide_t *osr G_GNUC_UNUSED, cairo_t *cr,
+// edge length of a cached composited block, in level pixels
+#define COMPOSITE_BLOCK_SIZE 512
+
+// paint one block-aligned square of the level, reusing the blended
+// result of its overlapping camera positions from the cache when
+// possible.  Blocks use the grid pointer as their plane cookie so they
+// can't collide with the per-image entries keyed on the level.
+static bool paint_composited_block(openslide_t *osr, cairo_t *cr,
+                                   struct level *l, int64_t channel,
+                                   int64_t bx, int64_t by,
+                                   double tx, double ty,
+                                   GError **err) {
+  const int32_t bs = COMPOSITE_BLOCK_SIZE;
+
+  struct _openslide_cache_entry *cache_entry;
+  uint32_t *blockdata = _openslide_cache_get(osr->cache,
+                                             l->grid, bx, by, channel,
+                                             &cache_entry);
+  if (!blockdata) {
+    blockdata = _openslide_cache_tile_alloc(osr->cache, bs * bs * 4);
+    // areas no tile covers must stay transparent so the background
+    // shows through
+    memset(blockdata, 0, bs * bs * 4);
+    cairo_surface_t *surface =
+      cairo_image_surface_create_for_data((unsigned char *) blockdata,
+                                          CAIRO_FORMAT_ARGB32,
+                                          bs, bs, bs * 4);
+    cairo_t *cr2 = cairo_create(surface);
+    bool success = _openslide_grid_paint_region(l->grid, cr2, NULL,
+                                                bx * bs, by * bs,
+                                                channel,
+                                                &l->base, bs, bs,
+                                                err);
+    if (success) {
+      success = _openslide_check_cairo_status(cr2, err);
+    }
+    cairo_destroy(cr2);
+    cairo_surface_destroy(surface);
+    if (!success) {
+      _openslide_cache_tile_free(osr->cache, bs * bs * 4, blockdata);
+      return false;
+    }
+
+    _openslide_cache_put(osr->cache,
+                         l->grid, bx, by, channel,
+                         blockdata,
+                         bs * bs * 4,
+                         &cache_entry);
+  }
+
+  cairo_surface_t *surface =
+    cairo_image_surface_create_for_data((unsigned char *) blockdata,
+                                        CAIRO_FORMAT_ARGB32,
+                                        bs, bs, bs * 4);
+  cairo_matrix_t matrix;
+  cairo_get_matrix(cr, &matrix);
+  cairo_translate(cr, tx, ty);
+  cairo_set_source_surface(cr, surface, 0, 0);
+  cairo_surface_destroy(surface);
+  cairo_paint(cr);
+  cairo_set_matrix(cr, &matrix);
+
+  _openslide_cache_entry_unref(cache_entry);
+
+  return _openslide_check_cairo_status(cr, err);
+}
+
+static bool paint_region_composited(openslide_t *osr, cairo_t *cr,
+                                    struct level *l,
+                                    double x, double y, int64_t channel,
+                                    int32_t w, int32_t h,
+                                    GError **err) {
+  const int32_t bs = COMPOSITE_BLOCK_SIZE;
+  int64_t start_bx = (int64_t) floor(x / bs);
+  int64_t end_bx = (int64_t) ceil((x + w) / bs);
+  int64_t start_by = (int64_t) floor(y / bs);
+  int64_t end_by = (int64_t) ceil((y + h) / bs);
+
+  for (int64_t by = start_by; by < end_by; by++) {
+    for (int64_t bx = start_bx; bx < end_bx; bx++) {
+      if (!paint_composited_block(osr, cr, l, channel, bx, by,
+                                  bx * bs - x, by * bs - y, err)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static bool paint_region(openslide_t *osr, cairo_t *cr,
                          int64_t x, int64_t y, int64_t channel,
                          struct _openslide_level *level,
                          int32_t w, int32_t h,
                          GError **err) {
   struct level *l = (struct level *) level;
 
+  // build this level's tiles on first use
+  expand_pending_tiles(osr, l);
+
+  // when camera positions overlap, every paint of the same area redoes
+  // the multi-tile alpha blend; cache the composited result instead so
+  // repeated pans over stitched seams come straight from memory
+  if ((l->image_width > l->tile_w) ||
+      (l->image_height > l->tile_h)) {
+    return paint_region_composited(osr, cr, l,
+                                   x / level->downsample,
+                                   y / level->downsample,
+                                   channel, w, h, err);
+  }
+
   return _openslide_grid_paint_region(l->grid, cr, NULL,
                                       x / level->downsample,
                                       y / level->downsample,
@@ -360,6 +506,9 @@ static void destroy(openslide_t *osr) {
   for (int32_t i = 0; i < osr->level_count; i++) {
     struct level *l = (struct level *) osr->levels[i];
     _openslide_grid_destroy(l->grid);
+    if (l->pending_entries) {
+      g_array_free(l->pending_entries, true);
+    }
     g_slice_free(struct level, l);
   }
 
@@ -368,6 +517,13 @@ static void destroy(openslide_t *osr) {
 
   // the ops data
   g_strfreev(data->datafile_paths);
+  g_free(data->slide_positions);
+  g_hash_table_unref(data->active_positions);
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_free(data->expand_mutex);
+#else
+  g_mutex_clear(&data->expand_mutex);
+#endif
   g_slice_free(struct mirax_ops_data, data);
 }
 
@@ -447,6 +603,51 @@ static int32_t read_le_int32_from_file(FILE *f) {
   return i;
 }
 
+static bool index_buffer_load(const char *path,
+                              struct index_buffer *ib,
+                              GError **err) {
+  ib->mapped = g_mapped_file_new(path, false, NULL);
+  if (ib->mapped) {
+    ib->data = (uint8_t *) g_mapped_file_get_contents(ib->mapped);
+    ib->len = g_mapped_file_get_length(ib->mapped);
+    return true;
+  }
+
+  // mapping can fail on unusual filesystems; fall back to reading the
+  // whole file
+  gsize len;
+  if (!g_file_get_contents(path, (gchar **) &ib->data, &len, err)) {
+    return false;
+  }
+  ib->len = len;
+  return true;
+}
+
+static void index_buffer_clear(struct index_buffer *ib) {
+  if (ib->mapped) {
+    g_mapped_file_unref(ib->mapped);
+  } else {
+    g_free(ib->data);
+  }
+  ib->mapped = NULL;
+  ib->data = NULL;
+  ib->len = 0;
+}
+
+static int32_t read_le_int32_from_buffer(const struct index_buffer *ib,
+                                         int64_t *pos) {
+  int32_t i;
+
+  if (*pos < 0 || *pos + 4 > ib->len) {
+    // -1 means error
+    return -1;
+  }
+  memcpy(&i, ib->data + *pos, 4);
+  *pos += 4;
+
+  return GINT32_FROM_LE(i);
+}
+
 
 static bool read_nonhier_record(FILE *f,
         int64_t nonhier_root_position,
@@ -616,16 +817,13 @@ static void insert_tile(struct level *l,
 // return false if none of the camera positions within the tile are active.
 static bool get_tile_position(int32_t *slide_positions,
                               GHashTable *active_positions,
-                              const struct slide_zoom_level_params *slide_zoom_level_params,
+                              const struct slide_zoom_level_params *lp,
                               struct level **levels,
                               int images_across,
                               int image_divisions,
                               int zoom_level, int xx, int yy,
                               int *pos0_x, int *pos0_y)
 {
-  const struct slide_zoom_level_params *lp = slide_zoom_level_params +
-      zoom_level;
-
   const int image0_w = levels[0]->image_width;
   const int image0_h = levels[0]->image_height;
 
@@ -680,7 +878,141 @@ static bool get_tile_position(int32_t *slide_positions,
   }
 }
 
-static bool process_hier_data_pages_from_indexfile(FILE *f,
+// expand one index entry into its tiles.  During the open-time scan
+// (image == NULL) this only records active camera positions, clears
+// tile size hints, and accumulates level 0 bounds; during deferred
+// expansion it inserts the tiles into the grid.
+static void expand_index_entry(struct level **levels,
+                               int zoom_level,
+                               const struct index_entry *e,
+                               struct image *image,
+                               int32_t *slide_positions,
+                               GHashTable *active_positions,
+                               int images_across,
+                               int images_down,
+                               int image_divisions,
+                               double *bounds) {
+  struct level *l = levels[zoom_level];
+  const struct slide_zoom_level_params *lp = &l->lp;
+
+  // process 1 image into tiles_per_image^2 tiles
+  for (int yi = 0; yi < lp->tiles_per_image; yi++) {
+    int yy = e->y + (yi * image_divisions);
+    if (yy >= images_down) {
+      break;
+    }
+
+    for (int xi = 0; xi < lp->tiles_per_image; xi++) {
+      int xx = e->x + (xi * image_divisions);
+      if (xx >= images_across) {
+        break;
+      }
+
+      // xx and yy are the image coordinates in level0 space
+
+      // position in level 0
+      int pos0_x;
+      int pos0_y;
+      if (!get_tile_position(slide_positions,
+                             active_positions,
+                             lp,
+                             levels,
+                             images_across,
+                             image_divisions,
+                             zoom_level,
+                             xx, yy,
+                             &pos0_x, &pos0_y)) {
+        // no such position
+        continue;
+      }
+
+      // position in this level
+      const double pos_x = ((double) pos0_x) / lp->image_concat;
+      const double pos_y = ((double) pos0_y) / lp->image_concat;
+
+      //g_debug("pos0: %d %d, pos: %g %g", pos0_x, pos0_y, pos_x, pos_y);
+
+      if (image) {
+        insert_tile(l, lp,
+                    image,
+                    pos_x, pos_y,
+                    l->tile_w * xi, l->tile_h * yi,
+                    e->x / lp->tile_count_divisor + xi,
+                    e->y / lp->tile_count_divisor + yi,
+                    zoom_level);
+      } else {
+        // open-time scan: compute what insert_tile would, without
+        // allocating anything
+        const int tile_x = e->x / lp->tile_count_divisor + xi;
+        const int tile_y = e->y / lp->tile_count_divisor + yi;
+        const double offset_x = pos_x - (tile_x * lp->tile_advance_x);
+        const double offset_y = pos_y - (tile_y * lp->tile_advance_y);
+        if (offset_x || offset_y) {
+          l->base.tile_w = 0;
+          l->base.tile_h = 0;
+        }
+        if (zoom_level == 0) {
+          bounds[0] = MIN(bounds[0], pos_x);
+          bounds[1] = MIN(bounds[1], pos_y);
+          bounds[2] = MAX(bounds[2], pos_x + l->tile_w);
+          bounds[3] = MAX(bounds[3], pos_y + l->tile_h);
+        }
+      }
+    }
+  }
+}
+
+// expand a level's pending index entries into grid tiles on first
+// paint.  Cannot fail; all entries were validated at open.
+static void expand_pending_tiles(openslide_t *osr, struct level *l) {
+  struct mirax_ops_data *data = osr->data;
+
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_lock(data->expand_mutex);
+#else
+  g_mutex_lock(&data->expand_mutex);
+#endif
+
+  GArray *entries = l->pending_entries;
+  if (entries) {
+    struct level **levels = (struct level **) osr->levels;
+
+    for (guint i = 0; i < entries->len; i++) {
+      const struct index_entry *e = &g_array_index(entries,
+                                                   struct index_entry, i);
+
+      // populate the image structure
+      struct image *image = g_slice_new0(struct image);
+      image->fileno = e->fileno;
+      image->start_in_file = e->offset;
+      image->length = e->length;
+      image->imageno = e->imageno;
+      image->refcount = 1;
+
+      expand_index_entry(levels, l->zoom_level, e, image,
+                         data->slide_positions,
+                         data->active_positions,
+                         data->images_across,
+                         data->images_down,
+                         data->image_divisions,
+                         NULL);
+
+      // drop initial reference, possibly free
+      image_unref(image);
+    }
+
+    g_array_free(entries, true);
+    l->pending_entries = NULL;
+  }
+
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_unlock(data->expand_mutex);
+#else
+  g_mutex_unlock(&data->expand_mutex);
+#endif
+}
+
+static bool process_hier_data_pages_from_indexfile(const struct index_buffer *ib,
                int64_t seek_location,
                int datafile_count,
                char **datafile_paths,
@@ -689,53 +1021,40 @@ static bool process_hier_data_pages_from_indexfile(FILE *f,
                int images_across,
                int images_down,
                int image_divisions,
-               const struct slide_zoom_level_params *slide_zoom_level_params,
                int32_t *slide_positions,
+               GHashTable *active_positions,
+               double *bounds,
                struct _openslide_hash *quickhash1,
                GError **err) {
   int32_t image_number = 0;
 
   bool success = false;
 
-  // used for storing which positions actually have data
-  GHashTable *active_positions = g_hash_table_new_full(g_int_hash, g_int_equal,
-                   g_free, NULL);
-
   for (int zoom_level = 0; zoom_level < zoom_levels; zoom_level++) {
     struct level *l = levels[zoom_level];
-    const struct slide_zoom_level_params *lp = slide_zoom_level_params +
-        zoom_level;
+    const struct slide_zoom_level_params *lp = &l->lp;
     int32_t ptr;
 
     //    g_debug("reading zoom_level %d", zoom_level);
 
-    if (fseeko(f, seek_location, SEEK_SET) == -1) {
-      g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
-                  "Cannot seek to zoom level pointer %d", zoom_level);
-      goto DONE;
-    }
-
-    ptr = read_le_int32_from_file(f);
+    int64_t pos = seek_location;
+    ptr = read_le_int32_from_buffer(ib, &pos);
     if (ptr == -1) {
       g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
                   "Can't read zoom level pointer");
       goto DONE;
     }
-    if (fseeko(f, ptr, SEEK_SET) == -1) {
-      g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
-                  "Cannot seek to start of data pages");
-      goto DONE;
-    }
+    pos = ptr;
 
     // read initial 0
-    if (read_le_int32_from_file(f) != 0) {
+    if (read_le_int32_from_buffer(ib, &pos) != 0) {
       g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
                   "Expected 0 value at beginning of data page");
       goto DONE;
     }
 
     // read pointer
-    ptr = read_le_int32_from_file(f);
+    ptr = read_le_int32_from_buffer(ib, &pos);
     if (ptr == -1) {
       g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
                   "Can't read initial data page pointer");
@@ -743,16 +1062,12 @@ static bool process_hier_data_pages_from_indexfile(FILE *f,
     }
 
     // seek to offset
-    if (fseeko(f, ptr, SEEK_SET) == -1) {
-      g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
-                  "Can't seek to initial data page");
-      goto DONE;
-    }
+    pos = ptr;
 
     int32_t next_ptr;
     do {
       // read length
-      int32_t page_len = read_le_int32_from_file(f);
+      int32_t page_len = read_le_int32_from_buffer(ib, &pos);
       if (page_len == -1) {
         g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
                     "Can't read page length");
@@ -762,7 +1077,7 @@ static bool process_hier_data_pages_from_indexfile(FILE *f,
       //    g_debug("page_len: %d", page_len);
 
       // read "next" pointer
-      next_ptr = read_le_int32_from_file(f);
+      next_ptr = read_le_int32_from_buffer(ib, &pos);
       if (next_ptr == -1) {
         g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
                     "Cannot read \"next\" pointer");
@@ -771,10 +1086,10 @@ static bool process_hier_data_pages_from_indexfile(FILE *f,
 
       // read all the data into the list
       for (int i = 0; i < page_len; i++) {
-  int32_t image_index = read_le_int32_from_file(f);
-  int32_t offset = read_le_int32_from_file(f);
-  int32_t length = read_le_int32_from_file(f);
-  int32_t fileno = read_le_int32_from_file(f);
+  int32_t image_index = read_le_int32_from_buffer(ib, &pos);
+  int32_t offset = read_le_int32_from_buffer(ib, &pos);
+  int32_t length = read_le_int32_from_buffer(ib, &pos);
+  int32_t fileno = read_le_int32_from_buffer(ib, &pos);
 
   if (image_index < 0) {
           g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
@@ -839,70 +1154,23 @@ static bool process_hier_data_pages_from_indexfile(FILE *f,
     }
   }
 
-  // populate the image structure
-  struct image *image = g_slice_new0(struct image);
-  image->fileno = fileno;
-  image->start_in_file = offset;
-  image->length = length;
-  image->imageno = image_number++;
-  image->refcount = 1;
-
-  /*
-  g_debug("image_concat: %d, tiles_per_image: %d",
-    lp->image_concat, lp->tiles_per_image);
-  g_debug("found %d %d from file", x, y);
-  */
-
-
-  // start processing 1 image into tiles_per_image^2 tiles
-  for (int yi = 0; yi < lp->tiles_per_image; yi++) {
-    int yy = y + (yi * image_divisions);
-    if (yy >= images_down) {
-      break;
-    }
-
-    for (int xi = 0; xi < lp->tiles_per_image; xi++) {
-      int xx = x + (xi * image_divisions);
-      if (xx >= images_across) {
-        break;
-      }
-
-      // xx and yy are the image coordinates in level0 space
-
-      // position in level 0
-            int pos0_x;
-            int pos0_y;
-            if (!get_tile_position(slide_positions,
-                                   active_positions,
-                                   slide_zoom_level_params,
-                                   levels,
-                                   images_across,
-                                   image_divisions,
-                                   zoom_level,
-                                   xx, yy,
-                                   &pos0_x, &pos0_y)) {
-              // no such position
-              continue;
-            }
-
-      // position in this level
-      const double pos_x = ((double) pos0_x) / lp->image_concat;
-      const double pos_y = ((double) pos0_y) / lp->image_concat;
-
-      //g_debug("pos0: %d %d, pos: %g %g", pos0_x, pos0_y, pos_x, pos_y);
-
-      insert_tile(l, lp,
-                        image,
-                        pos_x, pos_y,
-                        l->tile_w * xi, l->tile_h * yi,
-                        x / lp->tile_count_divisor + xi,
-                        y / lp->tile_count_divisor + yi,
-                        zoom_level);
-    }
-  }
-
-  // drop initial reference, possibly free
-  image_unref(image);
+  // record the entry for deferred tile expansion
+  struct index_entry entry = {
+    .x = x,
+    .y = y,
+    .offset = offset,
+    .length = length,
+    .fileno = fileno,
+    .imageno = image_number++,
+  };
+  g_array_append_val(l->pending_entries, entry);
+
+  // scan pass: record active positions, clear tile size hints,
+  // accumulate level 0 bounds
+  expand_index_entry(levels, zoom_level, &entry, NULL,
+                     slide_positions, active_positions,
+                     images_across, images_down, image_divisions,
+                     bounds);
       }
     } while (next_ptr != 0);
 
@@ -913,8 +1181,6 @@ static bool process_hier_data_pages_from_indexfile(FILE *f,
   success = true;
 
  DONE:
-  g_hash_table_unref(active_positions);
-
   return success;
 }
 
@@ -1100,8 +1366,12 @@ static bool process_indexfile(openslide_t *osr,
             int image_divisions,
             const struct slide_zoom_level_params *slide_zoom_level_params,
             FILE *indexfile,
+            const struct index_buffer *ib,
             struct level **levels,
             struct _openslide_hash *quickhash1,
+            int32_t **slide_positions_OUT,
+            GHashTable **active_positions_OUT,
+            double *bounds,
             GError **err) {
   char *teststr = NULL;
   bool match;
@@ -1119,6 +1389,10 @@ static bool process_indexfile(openslide_t *osr,
 
   int32_t *slide_positions = NULL;
 
+  // used for storing which positions actually have data
+  GHashTable *active_positions = g_hash_table_new_full(g_int_hash, g_int_equal,
+                   g_free, NULL);
+
   rewind(indexfile);
 
   // save root positions
@@ -1261,21 +1535,16 @@ static bool process_indexfile(openslide_t *osr,
   }
 
   // read hierarchical sections
-  if (fseeko(indexfile, hier_root, SEEK_SET) == -1) {
-    g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
-                "Cannot seek to hier sections root");
-    goto DONE;
-  }
-
-  ptr = read_le_int32_from_file(indexfile);
+  int64_t hier_pos = hier_root;
+  ptr = read_le_int32_from_buffer(ib, &hier_pos);
   if (ptr == -1) {
     g_set_error(err, OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
                 "Can't read initial pointer");
     goto DONE;
   }
 
-  // read these pages in
-  if (!process_hier_data_pages_from_indexfile(indexfile,
+  // scan the data pages, recording entries for deferred expansion
+  if (!process_hier_data_pages_from_indexfile(ib,
                 ptr,
                 datafile_count,
                 datafile_paths,
@@ -1284,8 +1553,9 @@ static bool process_indexfile(openslide_t *osr,
                 images_x,
                 images_y,
                 image_divisions,
-                slide_zoom_level_params,
                 slide_positions,
+                active_positions,
+                bounds,
                 quickhash1,
                 err)) {
     goto DONE;
@@ -1294,8 +1564,15 @@ static bool process_indexfile(openslide_t *osr,
   success = true;
 
  DONE:
-  // deallocate
-  g_free(slide_positions);
+  if (success) {
+    // transfer to caller for deferred tile expansion
+    *slide_positions_OUT = slide_positions;
+    *active_positions_OUT = active_positions;
+  } else {
+    // deallocate
+    g_free(slide_positions);
+    g_hash_table_unref(active_positions);
+  }
 
   return success;
 }
@@ -1528,6 +1805,11 @@ static bool mirax_open(openslide_t *osr, const char *filename,
   char **datafile_paths = NULL;
 
   FILE *indexfile = NULL;
+  struct index_buffer index_buf = { NULL, NULL, 0 };
+
+  int32_t *slide_positions = NULL;
+  GHashTable *active_positions = NULL;
+  double bounds[4] = { INFINITY, INFINITY, -INFINITY, -INFINITY };
 
   int64_t base_w = 0;
   int64_t base_h = 0;
@@ -1784,13 +2066,21 @@ static bool mirax_open(openslide_t *osr, const char *filename,
   // read indexfile
   tmp = g_build_filename(dirname, index_filename, NULL);
   indexfile = _openslide_fopen(tmp, "rb", err);
-  g_free(tmp);
-  tmp = NULL;
-
   if (!indexfile) {
+    g_free(tmp);
+    tmp = NULL;
     goto FAIL;
   }
 
+  // map the indexfile; the data page scan reads it in place
+  if (!index_buffer_load(tmp, &index_buf, err)) {
+    g_free(tmp);
+    tmp = NULL;
+    goto FAIL;
+  }
+  g_free(tmp);
+  tmp = NULL;
+
   // The camera on MIRAX takes a photo and records a position.
   // Then, the photo is split into image_divisions^2 image tiles.
   // So, if image_divisions=2, you'll get 4 images per photo.
@@ -1937,10 +2227,16 @@ static bool mirax_open(openslide_t *osr, const char *filename,
                                              lp->tile_advance_y,
                                              read_tile, tile_free);
 
+    // save parameters for deferred tile expansion
+    l->lp = *lp;
+    l->zoom_level = i;
+    l->pending_entries = g_array_new(false, false,
+                                     sizeof(struct index_entry));
+
     //g_debug("level %d tile advance %.10g %.10g, dim %"PRId64" %"PRId64", image size %d %d, tile %g %g, image_concat %d, tile_count_divisor %d, positions_per_tile %d", i, lp->tile_advance_x, lp->tile_advance_y, l->base.w, l->base.h, l->image_width, l->image_height, l->tile_w, l->tile_h, lp->image_concat, lp->tile_count_divisor, lp->positions_per_tile);
   }
 
-  // load the position map and build up the tiles
+  // load the position map and scan the tile index
   if (!process_indexfile(osr,
        slide_id,
        datafile_count, datafile_paths,
@@ -1956,14 +2252,25 @@ static bool mirax_open(openslide_t *osr, const char *filename,
        image_divisions,
        slide_zoom_level_params,
        indexfile,
+       &index_buf,
        levels,
        quickhash1,
+       &slide_positions,
+       &active_positions,
+       bounds,
        err)) {
     goto FAIL;
   }
 
   // set properties
-  _openslide_set_bounds_props_from_grid(osr, levels[0]->grid);
+  if (isinf(bounds[0])) {
+    // no tiles
+    _openslide_set_bounds_props(osr, 0, 0, 0, 0);
+  } else {
+    _openslide_set_bounds_props(osr, bounds[0], bounds[1],
+                                bounds[2] - bounds[0],
+                                bounds[3] - bounds[1]);
+  }
   uint32_t fill = slide_zoom_level_sections[0].fill_rgb;
   _openslide_set_background_color_prop(osr,
                                        (fill >> 16) & 0xFF,
@@ -2015,6 +2322,18 @@ static bool mirax_open(openslide_t *osr, const char *filename,
   struct mirax_ops_data *data = g_slice_new0(struct mirax_ops_data);
   data->datafile_paths = datafile_paths;
   datafile_paths = NULL;
+#if !GLIB_CHECK_VERSION(2,31,0)
+  data->expand_mutex = g_mutex_new();
+#else
+  g_mutex_init(&data->expand_mutex);
+#endif
+  data->slide_positions = slide_positions;
+  slide_positions = NULL;
+  data->active_positions = active_positions;
+  active_positions = NULL;
+  data->images_across = images_x;
+  data->images_down = images_y;
+  data->image_divisions = image_divisions;
   osr->data = data;
 
   // set ops
@@ -2029,6 +2348,9 @@ static bool mirax_open(openslide_t *osr, const char *filename,
       struct level *l = levels[i];
       if (l) {
         _openslide_grid_destroy(l->grid);
+        if (l->pending_entries) {
+          g_array_free(l->pending_entries, true);
+        }
         g_slice_free(struct level, l);
       }
     }
@@ -2056,6 +2378,11 @@ static bool mirax_open(openslide_t *osr, const char *filename,
   if (indexfile) {
     fclose(indexfile);
   }
+  index_buffer_clear(&index_buf);
+  g_free(slide_positions);
+  if (active_positions) {
+    g_hash_table_unref(active_positions);
+  }
 
   return success;
 }
@@ -38,7 +38,6 @@
 #include "openslide-decode-xml.h"
 #include "openslide-decode-tiff.h"
 #include "openslide-decode-tifflike.h"
-#include "openslide-decode-gdkpixbuf.h"
 
 #include <png.h>
 #include <glib.h>
@@ -47,7 +46,6 @@
 #include <math.h>
 #include <tiffio.h>
 #include <setjmp.h>
-#include <gdk-pixbuf/gdk-pixbuf.h>
 
 static const char ETS_EXT[] = ".ets";
 static const char TIF_EXT[] = ".tif";
@@ -155,13 +153,6 @@ struct tile {
   uint32_t dummy2;
 };
 
-struct load_state {
-  int32_t w;
-  int32_t h;
-  GdkPixbuf *pixbuf;  // NULL until validated, then a borrowed ref
-  GError *err;
-};
-
 struct level {
   struct _openslide_level base;
   struct _openslide_tiff_level *tiffl;
@@ -623,15 +614,50 @@ static bool ets_header_read(struct ets_header * self, FILE * stream) {
   return true;
 }
 
-static void tile_read(struct tile * self, FILE * stream) {
-  int check G_GNUC_UNUSED = 0;
+// on-disk size of one tile directory record; the struct has padding
+// after numbytes, so we can't fread records directly into it
+#define ETS_TILE_RECORD_SIZE (4 + 12 + 4 + 8 + 4 + 4)
+
+// don't bother spawning parse threads below this directory size
+#define ETS_PARSE_MIN_TILES 4096
+#define ETS_PARSE_MAX_THREADS 8
+
+static void tile_parse(struct tile * self, const uint8_t * rec) {
+  memcpy(&self->dummy1, rec, sizeof(self->dummy1));
+  rec += sizeof(self->dummy1);
+  memcpy(self->coord, rec, sizeof(self->coord));
+  rec += sizeof(self->coord);
+  memcpy(&self->level, rec, sizeof(self->level));
+  rec += sizeof(self->level);
+  memcpy(&self->offset, rec, sizeof(self->offset));
+  rec += sizeof(self->offset);
+  memcpy(&self->numbytes, rec, sizeof(self->numbytes));
+  rec += sizeof(self->numbytes);
+  memcpy(&self->dummy2, rec, sizeof(self->dummy2));
+}
 
-  check = fread((char*)&self->dummy1, 1, sizeof(self->dummy1), stream);
-  check = fread((char*)self->coord, 1, sizeof(self->coord), stream);
-  check = fread((char*)&self->level, 1, sizeof(self->level), stream);
-  check = fread((char*)&self->offset, 1, sizeof(self->offset), stream);
-  check = fread((char*)&self->numbytes, 1, sizeof(self->numbytes), stream);
-  check = fread((char*)&self->dummy2, 1, sizeof(self->dummy2), stream);
+// The tile directory used to be parsed with six small freads per tile,
+// which made open latency proportional to the tile count.  It is now
+// read with a single bulk fread and decoded from memory, split across a
+// few worker threads on large slides.
+struct tile_parse_slice {
+  const uint8_t *records;
+  struct tile *tiles;
+  uint32_t count;
+  uint32_t level_max;
+  uint32_t channel_max;
+  GThread *thread;
+};
+
+static gpointer tile_parse_thread(gpointer d) {
+  struct tile_parse_slice *slice = d;
+  for (uint32_t i = 0; i < slice->count; ++i) {
+    struct tile *t = slice->tiles + i;
+    tile_parse(t, slice->records + (size_t) i * ETS_TILE_RECORD_SIZE);
+    slice->level_max = MAX(slice->level_max, t->level);
+    slice->channel_max = MAX(slice->channel_max, t->coord[2]);
+  }
+  return NULL;
 }
 
 static struct tile *findtile(struct tile *tiles, uint32_t ntiles, uint32_t x, uint32_t y, uint32_t channel, uint32_t lvl) {
@@ -662,7 +688,9 @@ static uint32_t *read_ets_image(openslide_t *osr,
 
   //int32_t num_tiles = data->num_tiles;
 
-  uint32_t *dest = g_slice_alloc0(w * h * sizeof(uint32_t));
+  uint32_t *dest = _openslide_cache_tile_alloc(osr->cache,
+                                               w * h * sizeof(uint32_t));
+  memset(dest, 0, w * h * sizeof(uint32_t));
 
   FILE *f = _openslide_fopen(filename, "rb", err);
 
@@ -697,12 +725,6 @@ static uint32_t *read_ets_image(openslide_t *osr,
   //                                        w, h,
   //                                        err);
   //  break;
-  //case FORMAT_BMP:
-  //  result = _openslide_gdkpixbuf_decode_buffer(buffer, buflen,
-  //                                              dest,
-  //                                              w, h,
-  //                                              err);
-  //  break;
   default:
     g_assert_not_reached();
   }
@@ -717,7 +739,7 @@ static uint32_t *read_ets_image(openslide_t *osr,
 
 FAIL:
 
-  g_slice_free1(w * h * 4, dest);
+  _openslide_cache_tile_free(osr->cache, w * h * 4, dest);
   return NULL;
 }
 
@@ -879,17 +901,51 @@ static bool olympus_open_ets(openslide_t *osr, const char *filename,
     goto FAIL;
   }
 
-  // computes tiles dims
+  // bulk-read the packed tile directory, then decode it in parallel
+  uint8_t *records = g_malloc((size_t) sh->ntiles * ETS_TILE_RECORD_SIZE);
+  if (fread(records, ETS_TILE_RECORD_SIZE, sh->ntiles, f) != sh->ntiles) {
+    g_free(records);
+    _openslide_io_error(err, "Couldn't read tile directory");
+    goto FAIL;
+  }
   tiles = g_new0(struct tile, sh->ntiles);
-  for (uint32_t i = 0; i < sh->ntiles; ++i) {
-    struct tile t;
-    // read tile images
-    tile_read(&t, f);
-    tiles[i] = t;
 
-    level_count = t.level > level_count ? t.level : level_count;
-    channels = t.coord[2] > channels ? t.coord[2] : channels;
+  uint32_t nslices = 1;
+#if GLIB_CHECK_VERSION(2,36,0)
+  if (sh->ntiles >= ETS_PARSE_MIN_TILES) {
+    nslices = MIN((uint32_t) g_get_num_processors(), ETS_PARSE_MAX_THREADS);
+  }
+#endif
+  struct tile_parse_slice *slices = g_new0(struct tile_parse_slice, nslices);
+  uint32_t per_slice = (sh->ntiles + nslices - 1) / nslices;
+  uint32_t start = 0;
+  for (uint32_t s = 0; s < nslices; ++s) {
+    struct tile_parse_slice *slice = slices + s;
+    slice->records = records + (size_t) start * ETS_TILE_RECORD_SIZE;
+    slice->tiles = tiles + start;
+    slice->count = MIN(per_slice, sh->ntiles - start);
+    start += slice->count;
+    if (s < nslices - 1) {
+#if !GLIB_CHECK_VERSION(2,31,0)
+      slice->thread = g_thread_create(tile_parse_thread, slice, TRUE, NULL);
+#else
+      slice->thread = g_thread_new("ets-parse", tile_parse_thread, slice);
+#endif
+    }
+    if (!slice->thread) {
+      // last slice, or couldn't start the thread; parse on this one
+      tile_parse_thread(slice);
+    }
+  }
+  for (uint32_t s = 0; s < nslices; ++s) {
+    if (slices[s].thread) {
+      g_thread_join(slices[s].thread);
+    }
+    level_count = MAX(level_count, slices[s].level_max);
+    channels = MAX(channels, slices[s].channel_max);
   }
+  g_free(slices);
+  g_free(records);
 
   ++level_count;
   channels = channels != 0 ? channels + 1 : channels;
@@ -1066,11 +1122,11 @@ static bool read_tif_tile(openslide_t *osr,
                                             level, tile_col, tile_row, tile_channel,
                                             &cache_entry);
   if (!tiledata) {
-    tiledata = g_slice_alloc(tw * th * 4);
+    tiledata = _openslide_cache_tile_alloc(osr->cache, tw * th * 4);
     if (!_openslide_tiff_read_tile(tiffl, tiff,
                                    tiledata, tile_col, tile_row,
                                    err)) {
-      g_slice_free1(tw * th * 4, tiledata);
+      _openslide_cache_tile_free(osr->cache, tw * th * 4, tiledata);
       return false;
     }
 
@@ -1078,7 +1134,7 @@ static bool read_tif_tile(openslide_t *osr,
     if (!_openslide_tiff_clip_tile(tiffl, tiledata,
                                    tile_col, tile_row,
                                    err)) {
-      g_slice_free1(tw * th * 4, tiledata);
+      _openslide_cache_tile_free(osr->cache, tw * th * 4, tiledata);
       return false;
     }
 
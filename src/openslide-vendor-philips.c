@@ -124,14 +124,15 @@ static bool read_tile(openslide_t *osr,
 
     if (is_missing) {
       // fill with transparent
-      tiledata = g_slice_alloc0(tw * th * 4);
+      tiledata = _openslide_cache_tile_alloc(osr->cache, tw * th * 4);
+      memset(tiledata, 0, tw * th * 4);
 
     } else {
-      tiledata = g_slice_alloc(tw * th * 4);
+      tiledata = _openslide_cache_tile_alloc(osr->cache, tw * th * 4);
       if (!_openslide_tiff_read_tile(tiffl, tiff,
                                      tiledata, tile_col, tile_row,
                                      err)) {
-        g_slice_free1(tw * th * 4, tiledata);
+        _openslide_cache_tile_free(osr->cache, tw * th * 4, tiledata);
         return false;
       }
 
@@ -141,7 +142,7 @@ static bool read_tile(openslide_t *osr,
                                 l->base.w - tile_col * tw,
                                 l->base.h - tile_row * th,
                                 err)) {
-        g_slice_free1(tw * th * 4, tiledata);
+        _openslide_cache_tile_free(osr->cache, tw * th * 4, tiledata);
         return false;
       }
     }
@@ -94,6 +94,7 @@ struct sakura_ops_data {
   char *data_sql;
   int32_t tile_size;
   int32_t focal_plane;
+  struct _openslide_sqlite_pool *pool;
 };
 
 struct level {
@@ -184,6 +185,7 @@ static void destroy_level(struct level *l) {
 
 static void destroy(openslide_t *osr) {
   struct sakura_ops_data *data = osr->data;
+  _openslide_sqlite_pool_destroy(data->pool);
   g_free(data->filename);
   g_free(data->data_sql);
   g_slice_free(struct sakura_ops_data, data);
@@ -379,7 +381,8 @@ static bool read_tile(openslide_t *osr,
                                             level, tile_col, tile_row, channel,
                                             &cache_entry);
   if (!tiledata) {
-    tiledata = g_slice_alloc(tile_size * tile_size * 4);
+    tiledata = _openslide_cache_tile_alloc(osr->cache,
+                                           tile_size * tile_size * 4);
 
     // read tile
     if (!read_image(tiledata, tile_col, tile_row, l->base.downsample,
@@ -391,7 +394,8 @@ static bool read_tile(openslide_t *osr,
         return true;
       } else {
         g_propagate_error(err, tmp_err);
-        g_slice_free1(tile_size * tile_size * 4, tiledata);
+        _openslide_cache_tile_free(osr->cache, tile_size * tile_size * 4,
+                                 tiledata);
         return false;
       }
     }
@@ -402,7 +406,8 @@ static bool read_tile(openslide_t *osr,
                               l->base.w - tile_col * tile_size,
                               l->base.h - tile_row * tile_size,
                               err)) {
-      g_slice_free1(tile_size * tile_size * 4, tiledata);
+      _openslide_cache_tile_free(osr->cache, tile_size * tile_size * 4,
+                                 tiledata);
       return false;
     }
 
@@ -435,14 +440,20 @@ static bool paint_region(openslide_t *osr, cairo_t *cr,
                          GError **err) {
   struct sakura_ops_data *data = osr->data;
   struct level *l = (struct level *) level;
-  sqlite3_stmt *stmt = NULL;
   bool success = false;
 
-  sqlite3 *db = _openslide_sqlite_open(data->filename, err);
-  if (!db) {
+  // pooled connection with a cached tile query; the statement is owned
+  // by the connection, so no finalize here
+  struct _openslide_sqlite_conn *conn =
+    _openslide_sqlite_pool_get(data->pool, err);
+  if (!conn) {
     return false;
   }
-  PREPARE_OR_FAIL(stmt, db, data->data_sql);
+  sqlite3_stmt *stmt = _openslide_sqlite_conn_prepare(conn, data->data_sql,
+                                                      err);
+  if (!stmt) {
+    goto FAIL;
+  }
 
   success = _openslide_grid_paint_region(l->grid, cr, stmt,
                                          x / l->base.downsample,
@@ -452,8 +463,7 @@ static bool paint_region(openslide_t *osr, cairo_t *cr,
                                          err);
 
 FAIL:
-  sqlite3_finalize(stmt);
-  _openslide_sqlite_close(db);
+  _openslide_sqlite_pool_put(data->pool, conn);
   return success;
 }
 
@@ -998,6 +1008,7 @@ static bool sakura_open(openslide_t *osr, const char *filename,
     g_strdup_printf("SELECT data FROM %s WHERE id=?", unique_table_name);
   data->tile_size = tile_size;
   data->focal_plane = chosen_focal_plane;
+  data->pool = _openslide_sqlite_pool_create(filename);
 
   // commit
   g_assert(osr->data == NULL);
@@ -54,6 +54,8 @@ struct level {
   struct _openslide_level base;
   struct _openslide_tiff_level tiffl;
   struct _openslide_grid *grid;
+  int32_t overlap_x;
+  int32_t overlap_y;
 };
 
 static void destroy_data(struct trestle_ops_data *data,
@@ -96,39 +98,59 @@ static bool read_tile(openslide_t *osr,
   int64_t tw = tiffl->tile_w;
   int64_t th = tiffl->tile_h;
 
-  // cache
+  // displayable size: the overlap pixels belong to the next tile over,
+  // except on the last column/row where there is no next tile
+  int64_t cw = tw;
+  int64_t ch = th;
+  if (tile_col < tiffl->tiles_across - 1) {
+    cw -= l->overlap_x;
+  }
+  if (tile_row < tiffl->tiles_down - 1) {
+    ch -= l->overlap_y;
+  }
+
+  // cache the post-crop pixels, so the crop copy happens once per tile
+  // per cache lifetime; key on the grid pointer to keep these in a
+  // distinct plane from full-tile entries keyed on the level
   struct _openslide_cache_entry *cache_entry;
   uint32_t *tiledata = _openslide_cache_get(osr->cache,
-                                            level, tile_col, tile_row, channel,
+                                            l->grid, tile_col, tile_row, channel,
                                             &cache_entry);
   if (!tiledata) {
-    tiledata = g_slice_alloc(tw * th * 4);
+    uint32_t *fulldata = g_malloc(tw * th * 4);
     if (!_openslide_tiff_read_tile(tiffl, tiff,
-                                   tiledata, tile_col, tile_row,
+                                   fulldata, tile_col, tile_row,
                                    err)) {
-      g_slice_free1(tw * th * 4, tiledata);
+      g_free(fulldata);
       return false;
     }
 
     // clip, if necessary
-    if (!_openslide_tiff_clip_tile(tiffl, tiledata,
+    if (!_openslide_tiff_clip_tile(tiffl, fulldata,
                                    tile_col, tile_row,
                                    err)) {
-      g_slice_free1(tw * th * 4, tiledata);
+      g_free(fulldata);
       return false;
     }
 
+    // crop out the overlap
+    tiledata = _openslide_cache_tile_alloc(osr->cache, cw * ch * 4);
+    for (int64_t row = 0; row < ch; row++) {
+      memcpy(tiledata + row * cw, fulldata + row * tw, cw * 4);
+    }
+    g_free(fulldata);
+
     // put it in the cache
-    _openslide_cache_put(osr->cache, level, tile_col, tile_row, channel,
-                         tiledata, tw * th * 4,
+    _openslide_cache_put(osr->cache, l->grid, tile_col, tile_row, channel,
+                         tiledata, cw * ch * 4,
                          &cache_entry);
   }
 
   // draw it
   cairo_surface_t *surface = cairo_image_surface_create_for_data((unsigned char *) tiledata,
                                                                  CAIRO_FORMAT_ARGB32,
-                                                                 tw, th,
-                                                                 tw * 4);
+                                                                 cw, ch,
+                                                                 cw * 4);
   cairo_set_source_surface(cr, surface, 0, 0);
   cairo_surface_destroy(surface);
   cairo_paint(cr);
@@ -379,6 +401,9 @@ static bool trestle_open(openslide_t *osr, const char *filename,
       l->base.h -= (tiffl->tiles_down - 1) * overlap_y;
     }
 
+    l->overlap_x = overlap_x;
+    l->overlap_y = overlap_y;
+
     // create grid
     l->grid = _openslide_grid_create_tilemap(osr,
                                              tiffl->tile_w - overlap_x,
@@ -101,6 +101,11 @@ struct level {
   struct _openslide_tiff_level tiffl;
   struct _openslide_grid *grid;
   int64_t subtiles_per_tile;
+
+  // tile byte ranges, for the batched I/O preload; NULL if unavailable
+  uint64_t *tile_offsets;
+  uint64_t *tile_byte_counts;
+  int64_t tile_extent_count;
 };
 
 // structs used during BIF open
@@ -142,6 +147,8 @@ static void destroy(openslide_t *osr) {
   for (int32_t i = 0; i < osr->level_count; i++) {
     struct level *l = (struct level *) osr->levels[i];
     _openslide_grid_destroy(l->grid);
+    g_free(l->tile_offsets);
+    g_free(l->tile_byte_counts);
     g_slice_free(struct level, l);
   }
   g_free(osr->levels);
@@ -176,11 +183,11 @@ static bool read_subtile(openslide_t *osr,
                                             level, tile_col, tile_row, channel,
                                             &cache_entry);
   if (!tiledata) {
-    tiledata = g_slice_alloc(tw * th * 4);
+    tiledata = _openslide_cache_tile_alloc(osr->cache, tw * th * 4);
     if (!_openslide_tiff_read_tile(tiffl, tiff,
                                    tiledata, tile_col, tile_row,
                                    err)) {
-      g_slice_free1(tw * th * 4, tiledata);
+      _openslide_cache_tile_free(osr->cache, tw * th * 4, tiledata);
       return false;
     }
 
@@ -188,7 +195,7 @@ static bool read_subtile(openslide_t *osr,
     if (!_openslide_tiff_clip_tile(tiffl, tiledata,
                                    tile_col, tile_row,
                                    err)) {
-      g_slice_free1(tw * th * 4, tiledata);
+      _openslide_cache_tile_free(osr->cache, tw * th * 4, tiledata);
       return false;
     }
 
@@ -235,6 +242,34 @@ static bool read_subtile(openslide_t *osr,
   return success;
 }
 
+// report where a subtile's compressed bytes live, so paints can batch
+// the reads; subtiles of one TIFF tile map to the same byte range and
+// the preload coalesces the duplicates
+static bool subtile_extent(openslide_t *osr,
+                           struct _openslide_level *level,
+                           int64_t subtile_col, int64_t subtile_row,
+                           struct _openslide_tile_extent *extent) {
+  struct ventana_ops_data *data = osr->data;
+  struct level *l = (struct level *) level;
+
+  if (!l->tile_offsets) {
+    return false;
+  }
+
+  int64_t tile_col = subtile_col / l->subtiles_per_tile;
+  int64_t tile_row = subtile_row / l->subtiles_per_tile;
+  int64_t tile_no = tile_row * l->tiffl.tiles_across + tile_col;
+  if (tile_no < 0 || tile_no >= l->tile_extent_count ||
+      !l->tile_byte_counts[tile_no]) {
+    return false;
+  }
+
+  extent->path = _openslide_tiffcache_get_filename(data->tc);
+  extent->offset = l->tile_offsets[tile_no];
+  extent->length = l->tile_byte_counts[tile_no];
+  return true;
+}
+
 // read_subtile wrapper for BIF that drops the extra argument passed by
 // the tilemap grid
 static bool read_subtile_tilemap(openslide_t *osr,
@@ -906,6 +941,12 @@ static bool ventana_open(openslide_t *osr, const char *filename,
         g_slice_free(struct level, l);
         goto FAIL;
       }
+      // snapshot tile byte ranges for the I/O preload; failure just
+      // disables preloading for this level
+      _openslide_tiff_get_tile_extents(tiff, dir,
+                                       &l->tile_offsets,
+                                       &l->tile_byte_counts,
+                                       &l->tile_extent_count);
       struct level *level0 = l;
       if (level > 0) {
         level0 = level_array->pdata[0];
@@ -915,6 +956,7 @@ static bool ventana_open(openslide_t *osr, const char *filename,
         l->grid = create_bif_grid(osr, bif,
                                   downsample,
                                   tiffl->tile_w, tiffl->tile_h);
+        _openslide_grid_tilemap_set_extent_lookup(l->grid, subtile_extent);
         l->subtiles_per_tile = downsample;
         // the format doesn't seem to record the level size, so make it
         // large enough for all the pixels
@@ -932,6 +974,7 @@ static bool ventana_open(openslide_t *osr, const char *filename,
                                                 tiffl->tile_w,
                                                 tiffl->tile_h,
                                                 read_subtile);
+        _openslide_grid_simple_set_extent_lookup(l->grid, subtile_extent);
         l->subtiles_per_tile = 1;
       }
       //g_debug("level %"PRId64": magnification %g, downsample %g, size %"PRId64" %"PRId64, level, magnification, downsample, l->base.w, l->base.h);
@@ -1027,6 +1070,8 @@ FAIL:
     for (uint32_t n = 0; n < level_array->len; n++) {
       struct level *l = level_array->pdata[n];
       _openslide_grid_destroy(l->grid);
+      g_free(l->tile_offsets);
+      g_free(l->tile_byte_counts);
       g_slice_free(struct level, l);
     }
     g_ptr_array_free(level_array, true);
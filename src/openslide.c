@@ -32,6 +32,8 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <time.h>
 
 #include <glib.h>
 #include <glib-object.h>
@@ -39,6 +41,7 @@
 
 #include "openslide-cairo.h"
 #include "openslide-error.h"
+#include "openslide-simd.h"
 
 #if defined _WIN32 || defined _WIN64
 #define WIN32_LEAN_AND_MEAN
@@ -162,15 +165,176 @@ static openslide_t *create_osr(void) {
   osr->associated_images = g_hash_table_new_full(g_str_hash, g_str_equal,
                                                  g_free,
                                                  destroy_associated_image);
+  osr->shared_handles = 1;
   return osr;
 }
 
+// the handle owning the shared parsed structures; the handle itself
+// unless it is a clone
+static openslide_t *get_origin(openslide_t *osr) {
+  return osr->clone_origin ? osr->clone_origin : osr;
+}
+
+// fast-tier detection hints: a filename with one of these extensions
+// gets the mapped format's detect() first.  The detect callbacks stay
+// authoritative -- each checks its own vendor signature -- so a hint
+// only reorders the probes, it can't misclassify a slide.
+static const struct format_hint {
+  const char *extension;
+  const struct _openslide_format *format;
+} format_hints[] = {
+  { ".mrxs", &_openslide_format_mirax },
+  { ".vms", &_openslide_format_hamamatsu_vms_vmu },
+  { ".vmu", &_openslide_format_hamamatsu_vms_vmu },
+  { ".ndpi", &_openslide_format_hamamatsu_ndpi },
+  { ".svslide", &_openslide_format_sakura },
+  { ".svs", &_openslide_format_aperio },
+  { ".scn", &_openslide_format_leica },
+  { ".bif", &_openslide_format_ventana },
+  { ".vsi", &_openslide_format_olympus },
+  { NULL, NULL },
+};
+
+// run the remaining detect() probes concurrently, since several do
+// real I/O; only worthwhile for bulk scanning, so opt-in
+#define PARALLEL_DETECT_ENV "OPENSLIDE_PARALLEL_DETECT"
+
+// open-time profiling; always on, since the cost is a few clock reads
+// per open
+static int64_t now_us(void) {
+#if GLIB_CHECK_VERSION(2,28,0)
+  return g_get_monotonic_time();
+#else
+  GTimeVal tv;
+  g_get_current_time(&tv);
+  return (int64_t) tv.tv_sec * G_USEC_PER_SEC + tv.tv_usec;
+#endif
+}
+
+// CPU time of the opening thread, or -1 where unavailable
+static int64_t thread_cpu_us(void) {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+  struct timespec ts;
+  if (!clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts)) {
+    return (int64_t) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+  }
+#endif
+  return -1;
+}
+
+// the property the hash publishes to: quickhash-1, or quickhash-2 in
+// hash tree mode
+static const char *quickhash_property_name(struct _openslide_hash *hash) {
+  return _openslide_hash_is_tree(hash) ? OPENSLIDE_PROPERTY_NAME_QUICKHASH2
+                                       : OPENSLIDE_PROPERTY_NAME_QUICKHASH1;
+}
+
+static const struct _openslide_format *hinted_format(const char *filename) {
+  char *lower = g_ascii_strdown(filename, -1);
+  const struct _openslide_format *format = NULL;
+  for (const struct format_hint *hint = format_hints; hint->extension;
+       hint++) {
+    if (g_str_has_suffix(lower, hint->extension)) {
+      format = hint->format;
+      break;
+    }
+  }
+  g_free(lower);
+  return format;
+}
+
+static bool try_format(const struct _openslide_format *format,
+                       const char *filename,
+                       struct _openslide_tifflike *tl) {
+  GError *tmp_err = NULL;
+
+  g_assert(format->name && format->vendor &&
+           format->detect && format->open);
+  if (format->detect(filename, tl, &tmp_err)) {
+    return true;
+  }
+  if (_openslide_debug(OPENSLIDE_DEBUG_DETECTION)) {
+    g_message("%s: %s", format->name, tmp_err->message);
+  }
+  g_clear_error(&tmp_err);
+  return false;
+}
+
+struct detect_probe {
+  const struct _openslide_format *format;
+  const char *filename;
+  struct _openslide_tifflike *tl;
+  GThread *thread;
+  bool success;
+  GError *err;
+};
+
+static gpointer detect_probe_thread(gpointer data) {
+  struct detect_probe *probe = data;
+  probe->success = probe->format->detect(probe->filename, probe->tl,
+                                         &probe->err);
+  return NULL;
+}
+
+// probe all formats except skip concurrently; the lowest-priority-order
+// success wins, so the result matches the sequential scan
+static const struct _openslide_format *detect_parallel(const char *filename,
+                                                       struct _openslide_tifflike *tl,
+                                                       const struct _openslide_format *skip) {
+  struct detect_probe probes[G_N_ELEMENTS(formats)] = { { 0 } };
+  int count = 0;
+
+  for (const struct _openslide_format **cur = formats; *cur; cur++) {
+    if (*cur == skip) {
+      continue;
+    }
+    struct detect_probe *probe = &probes[count++];
+    probe->format = *cur;
+    probe->filename = filename;
+    probe->tl = tl;
+    g_assert(probe->format->name && probe->format->vendor &&
+             probe->format->detect && probe->format->open);
+#if !GLIB_CHECK_VERSION(2,31,0)
+    probe->thread = g_thread_create(detect_probe_thread, probe, TRUE,
+                                    NULL);
+#else
+    probe->thread = g_thread_new("detect", detect_probe_thread, probe);
+#endif
+    if (probe->thread == NULL) {
+      // couldn't start the thread; probe on this one
+      detect_probe_thread(probe);
+    }
+  }
+
+  const struct _openslide_format *result = NULL;
+  for (int i = 0; i < count; i++) {
+    struct detect_probe *probe = &probes[i];
+    if (probe->thread) {
+      g_thread_join(probe->thread);
+    }
+    if (probe->success) {
+      if (!result) {
+        result = probe->format;
+      }
+    } else if (_openslide_debug(OPENSLIDE_DEBUG_DETECTION)) {
+      g_message("%s: %s", probe->format->name, probe->err->message);
+    }
+    g_clear_error(&probe->err);
+  }
+  return result;
+}
+
 static const struct _openslide_format *detect_format(const char *filename,
-                                                     struct _openslide_tifflike **tl_OUT) {
+                                                     struct _openslide_tifflike **tl_OUT,
+                                                     int64_t *tifflike_us) {
   GError *tmp_err = NULL;
 
+  int64_t begin = now_us();
   struct _openslide_tifflike *tl = _openslide_tifflike_create(filename,
                                                               &tmp_err);
+  if (tifflike_us) {
+    *tifflike_us = now_us() - begin;
+  }
   if (!tl) {
     if (_openslide_debug(OPENSLIDE_DEBUG_DETECTION)) {
       g_message("tifflike: %s", tmp_err->message);
@@ -178,26 +342,33 @@ static const struct _openslide_format *detect_format(const char *filename,
     g_clear_error(&tmp_err);
   }
 
-  for (const struct _openslide_format **cur = formats; *cur; cur++) {
-    const struct _openslide_format *format = *cur;
-
-    g_assert(format->name && format->vendor &&
-             format->detect && format->open);
-    if (format->detect(filename, tl, &tmp_err)) {
-      // success!
-      if (tl_OUT) {
-        *tl_OUT = tl;
-      } else {
-        _openslide_tifflike_destroy(tl);
+  // fast tier: short-circuit to the format the extension suggests
+  const struct _openslide_format *hinted = hinted_format(filename);
+  const struct _openslide_format *match = NULL;
+  if (hinted && try_format(hinted, filename, tl)) {
+    match = hinted;
+  } else if (g_getenv(PARALLEL_DETECT_ENV)) {
+    match = detect_parallel(filename, tl, hinted);
+  } else {
+    for (const struct _openslide_format **cur = formats; *cur; cur++) {
+      if (*cur == hinted) {
+        // already probed
+        continue;
+      }
+      if (try_format(*cur, filename, tl)) {
+        match = *cur;
+        break;
       }
-      return format;
     }
+  }
 
-    // reset for next format
-    if (_openslide_debug(OPENSLIDE_DEBUG_DETECTION)) {
-      g_message("%s: %s", format->name, tmp_err->message);
+  if (match) {
+    if (tl_OUT) {
+      *tl_OUT = tl;
+    } else {
+      _openslide_tifflike_destroy(tl);
     }
-    g_clear_error(&tmp_err);
+    return match;
   }
 
   // no match
@@ -242,7 +413,7 @@ static bool open_backend(openslide_t *osr,
 const char *openslide_detect_vendor(const char *filename) {
   g_assert(openslide_was_dynamically_loaded);
 
-  const struct _openslide_format *format = detect_format(filename, NULL);
+  const struct _openslide_format *format = detect_format(filename, NULL, NULL);
   if (!format) {
     return NULL;
   }
@@ -254,7 +425,7 @@ bool openslide_can_open(const char *filename) {
 
   // detect format
   struct _openslide_tifflike *tl;
-  const struct _openslide_format *format = detect_format(filename, &tl);
+  const struct _openslide_format *format = detect_format(filename, &tl, NULL);
   if (!format) {
     return false;
   }
@@ -279,26 +450,84 @@ static const char **strv_from_hashtable_keys(GHashTable *h) {
   return result;
 }
 
-openslide_t *openslide_open(const char *filename) {
+// freeze the properties into arrays parallel to the sorted name list,
+// pre-parsing numeric values, so the per-call lookup is a binary
+// search with no hashing and the typed accessors never re-parse
+static void freeze_properties(openslide_t *osr) {
+  int32_t count = 0;
+  while (osr->property_names[count]) {
+    count++;
+  }
+  osr->property_count = count;
+  osr->property_values = g_new(const char *, count);
+  osr->property_doubles = g_new0(double, count);
+  osr->property_int64s = g_new0(int64_t, count);
+  osr->property_kinds = g_new0(uint8_t, count);
+
+  for (int32_t i = 0; i < count; i++) {
+    const char *value = g_hash_table_lookup(osr->properties,
+                                            osr->property_names[i]);
+    osr->property_values[i] = value;
+
+    // rejects trailing text itself, returning NAN
+    double d = _openslide_parse_double(value);
+    if (!isnan(d)) {
+      osr->property_doubles[i] = d;
+      osr->property_kinds[i] |= _OPENSLIDE_PROP_DOUBLE;
+    }
+    char *endptr;
+    int64_t i64 = g_ascii_strtoll(value, &endptr, 10);
+    if (value[0] && !*endptr) {
+      osr->property_int64s[i] = i64;
+      osr->property_kinds[i] |= _OPENSLIDE_PROP_INT64;
+    }
+  }
+}
+
+// binary search the frozen name list; -1 if absent
+static int32_t property_index(openslide_t *osr, const char *name) {
+  int32_t lo = 0;
+  int32_t hi = osr->property_count - 1;
+  while (lo <= hi) {
+    int32_t mid = lo + (hi - lo) / 2;
+    int cmp = strcmp(name, osr->property_names[mid]);
+    if (cmp == 0) {
+      return mid;
+    } else if (cmp < 0) {
+      hi = mid - 1;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return -1;
+}
+
+static openslide_t *do_open(const char *filename) {
   GError *tmp_err = NULL;
 
-  g_assert(openslide_was_dynamically_loaded);
+  int64_t open_begin = now_us();
+  int64_t cpu_begin = thread_cpu_us();
 
   // detect format
   struct _openslide_tifflike *tl;
-  const struct _openslide_format *format = detect_format(filename, &tl);
+  int64_t tifflike_us = 0;
+  const struct _openslide_format *format = detect_format(filename, &tl,
+                                                         &tifflike_us);
   if (!format) {
     // not a slide file
     return NULL;
   }
+  int64_t detect_us = now_us() - open_begin - tifflike_us;
 
   // alloc memory
   openslide_t *osr = create_osr();
 
   // open backend
   struct _openslide_hash *quickhash1 = NULL;
+  int64_t vendor_begin = now_us();
   bool success = open_backend(osr, format, filename, tl, &quickhash1,
                               &tmp_err);
+  int64_t vendor_us = now_us() - vendor_begin;
   _openslide_tifflike_destroy(tl);
   if (!success) {
     // failed to read slide
@@ -336,14 +565,32 @@ openslide_t *openslide_open(const char *filename) {
     }
   }
 
+  // fill large downsample gaps with lazily-rendered levels
+  _openslide_synth_add_levels(osr);
+
+  // the hash ran inside the vendor open; report it separately and
+  // charge the vendor phase with the remainder
+  int64_t quickhash_us = _openslide_hash_get_elapsed(quickhash1);
+  vendor_us = MAX(vendor_us - quickhash_us, 0);
+
   // set hash property
-  const char *hash_str = _openslide_hash_get_string(quickhash1);
-  if (hash_str != NULL) {
+  const char *hash_prop = quickhash_property_name(quickhash1);
+  if (_openslide_hash_has_pending(quickhash1)) {
+    // deferred mode: register the property with a placeholder so it
+    // appears in the name list; the journal is replayed on first access
     g_hash_table_insert(osr->properties,
-                        g_strdup(OPENSLIDE_PROPERTY_NAME_QUICKHASH1),
-                        g_strdup(hash_str));
+                        g_strdup(hash_prop),
+                        g_strdup(""));
+    osr->quickhash1_pending = quickhash1;
+  } else {
+    const char *hash_str = _openslide_hash_get_string(quickhash1);
+    if (hash_str != NULL) {
+      g_hash_table_insert(osr->properties,
+                          g_strdup(hash_prop),
+                          g_strdup(hash_str));
+    }
+    _openslide_hash_destroy(quickhash1);
   }
-  _openslide_hash_destroy(quickhash1);
 
   // set other properties
   g_hash_table_insert(osr->properties,
@@ -384,9 +631,36 @@ openslide_t *openslide_open(const char *filename) {
     }
   }
 
+  // per-phase open profiling, so ingest pipelines can attribute slow
+  // opens without external profilers.  Wall-clock microseconds; the
+  // total runs through property assembly, and cpu is the opening
+  // thread's CPU time over the same span
+  g_hash_table_insert(osr->properties,
+                      g_strdup(_OPENSLIDE_PROPERTY_NAME_OPEN_TIFFLIKE),
+                      g_strdup_printf("%"PRId64, tifflike_us));
+  g_hash_table_insert(osr->properties,
+                      g_strdup(_OPENSLIDE_PROPERTY_NAME_OPEN_DETECT),
+                      g_strdup_printf("%"PRId64, detect_us));
+  g_hash_table_insert(osr->properties,
+                      g_strdup(_OPENSLIDE_PROPERTY_NAME_OPEN_VENDOR),
+                      g_strdup_printf("%"PRId64, vendor_us));
+  g_hash_table_insert(osr->properties,
+                      g_strdup(_OPENSLIDE_PROPERTY_NAME_OPEN_QUICKHASH),
+                      g_strdup_printf("%"PRId64, quickhash_us));
+  g_hash_table_insert(osr->properties,
+                      g_strdup(_OPENSLIDE_PROPERTY_NAME_OPEN_TOTAL),
+                      g_strdup_printf("%"PRId64, now_us() - open_begin));
+  int64_t cpu_end = thread_cpu_us();
+  if (cpu_begin >= 0 && cpu_end >= 0) {
+    g_hash_table_insert(osr->properties,
+                        g_strdup(_OPENSLIDE_PROPERTY_NAME_OPEN_CPU),
+                        g_strdup_printf("%"PRId64, cpu_end - cpu_begin));
+  }
+
   // fill in names
   osr->associated_image_names = strv_from_hashtable_keys(osr->associated_images);
   osr->property_names = strv_from_hashtable_keys(osr->properties);
+  freeze_properties(osr);
 
   // start cache
   osr->cache = _openslide_cache_binding_create();
@@ -394,8 +668,93 @@ openslide_t *openslide_open(const char *filename) {
   return osr;
 }
 
+openslide_t *openslide_open(const char *filename) {
+  g_assert(openslide_was_dynamically_loaded);
+
+  return do_open(filename);
+}
+
+openslide_t *openslide_open_with_options(const char *filename,
+                                         openslide_open_flags_t flags) {
+  g_assert(openslide_was_dynamically_loaded);
+
+  // set the policy for the opening thread; files opened while parsing
+  // inherit it through _openslide_fopen(), and backends that read from
+  // worker threads capture it for later
+  _openslide_io_policy_set(flags);
+  openslide_t *osr = do_open(filename);
+  _openslide_io_policy_set(0);
+
+  if (flags & OPENSLIDE_OPEN_NO_CACHE) {
+    // parsing pulled headers, directories, and possibly the quickhash
+    // inputs through the page cache; evict them now that open is done.
+    // Only the main file is swept; sibling files of multi-file formats
+    // were read with NOREUSE set and are left to the kernel
+    FILE *f = _openslide_fopen(filename, "rb", NULL);
+    if (f) {
+      _openslide_io_drop_cache(f, 0, 0);
+      fclose(f);
+    }
+  }
+
+  return osr;
+}
+
+
+// background prefetch engine
+
+#define PREFETCH_POOL_SIZE 2
+
+G_LOCK_DEFINE_STATIC(prefetch);
+
+struct prefetch_hint {
+  openslide_t *osr;
+  int64_t x;
+  int64_t y;
+  int64_t plane;
+  int32_t level;
+  int64_t w;
+  int64_t h;
+  int id;
+  int warm_id;     // nonzero if part of a cache warm job
+  int priority;    // higher runs first
+  gint cancelled;  // atomic ops only
+};
+
+static void prefetch_hint_free(gpointer data) {
+  g_slice_free(struct prefetch_hint, data);
+}
+
+// shut down the pools and hints owned by one handle; the shared parsed
+// structures stay up for any other handles still reading through them
+static void close_handle_state(openslide_t *osr) {
+  // finish asynchronous reads; their dest buffers and callbacks belong
+  // to the caller, so run them to completion rather than dropping them
+  if (osr->async_pool) {
+    g_thread_pool_free(osr->async_pool, false, true);
+    osr->async_pool = NULL;
+  }
+
+  // stop prefetching; drop queued hints, wait for the running ones
+  if (osr->prefetch_pool) {
+    g_thread_pool_free(osr->prefetch_pool, true, true);
+    osr->prefetch_pool = NULL;
+    G_LOCK(prefetch);
+    GHashTable *hints = osr->prefetch_hints;
+    osr->prefetch_hints = NULL;
+    G_UNLOCK(prefetch);
+    GList *remaining = g_hash_table_get_values(hints);
+    g_list_free_full(remaining, prefetch_hint_free);
+    g_hash_table_destroy(hints);
+  }
+}
+
+// tear down the shared parsed structures; runs on the origin handle,
+// once, after the last handle sharing them has closed
+static void destroy_shared(openslide_t *osr) {
+  // tear down the worker pool before the backend it reads through
+  _openslide_grid_set_tile_worker_count(osr, 0);
 
-void openslide_close(openslide_t *osr) {
   if (osr->ops) {
     (osr->ops->destroy)(osr);
   }
@@ -405,16 +764,74 @@ void openslide_close(openslide_t *osr) {
 
   g_free(osr->associated_image_names);
   g_free(osr->property_names);
+  g_free(osr->property_values);
+  g_free(osr->property_doubles);
+  g_free(osr->property_int64s);
+  g_free(osr->property_kinds);
 
   if (osr->cache) {
     _openslide_cache_binding_destroy(osr->cache);
   }
 
+  if (osr->quickhash1_pending) {
+    _openslide_hash_destroy(osr->quickhash1_pending);
+  }
+
   g_free(g_atomic_pointer_get(&osr->error));
 
   g_slice_free(openslide_t, osr);
 }
 
+void openslide_close(openslide_t *osr) {
+  close_handle_state(osr);
+
+  openslide_t *origin = get_origin(osr);
+  if (osr != origin) {
+    g_free(g_atomic_pointer_get(&osr->error));
+    g_slice_free(openslide_t, osr);
+  }
+
+  // the origin's struct outlives its own close while clones remain,
+  // since the shared structures live inside it
+  if (g_atomic_int_dec_and_test(&origin->shared_handles)) {
+    destroy_shared(origin);
+  }
+}
+
+openslide_t *openslide_clone(openslide_t *osr) {
+  g_assert(openslide_was_dynamically_loaded);
+
+  if (openslide_get_error(osr)) {
+    return NULL;
+  }
+
+  openslide_t *origin = get_origin(osr);
+  g_atomic_int_inc(&origin->shared_handles);
+
+  // share the parsed structures; tile reads already funnel through the
+  // origin via the grids, so the cache, worker pool, and backend state
+  // exist once per slide no matter how many handles read it
+  openslide_t *clone = g_slice_new0(openslide_t);
+  clone->ops = origin->ops;
+  clone->levels = origin->levels;
+  clone->data = origin->data;
+  clone->level_count = origin->level_count;
+  clone->plane_count = origin->plane_count;
+  clone->associated_images = origin->associated_images;
+  clone->associated_image_names = origin->associated_image_names;
+  clone->properties = origin->properties;
+  clone->property_names = origin->property_names;
+  clone->property_count = origin->property_count;
+  clone->property_values = origin->property_values;
+  clone->property_doubles = origin->property_doubles;
+  clone->property_int64s = origin->property_int64s;
+  clone->property_kinds = origin->property_kinds;
+  clone->cache = origin->cache;
+  clone->synth = origin->synth;
+  clone->clone_origin = origin;
+  return clone;
+}
+
 
 void openslide_get_level0_dimensions(openslide_t *osr,
                                      int64_t *w, int64_t *h) {
@@ -516,19 +933,297 @@ double openslide_get_layer_downsample(openslide_t *osr, int32_t level) {
 }
 
 
-int openslide_give_prefetch_hint(openslide_t *osr G_GNUC_UNUSED,
-				 int64_t x G_GNUC_UNUSED,
-				 int64_t y G_GNUC_UNUSED,
-				 int32_t level G_GNUC_UNUSED,
-				 int64_t w G_GNUC_UNUSED,
-				 int64_t h G_GNUC_UNUSED) {
-  g_warning("openslide_give_prefetch_hint has never been implemented and should not be called");
-  return 0;
+static void read_region_propagate(openslide_t *osr,
+                                  uint32_t *dest,
+                                  int64_t x, int64_t y, int64_t channel,
+                                  int32_t level,
+                                  int64_t w, int64_t h);
+
+static void prefetch_worker(gpointer data, gpointer user_data G_GNUC_UNUSED) {
+  struct prefetch_hint *hint = data;
+  openslide_t *osr = hint->osr;
+
+  if (!g_atomic_int_get(&hint->cancelled)) {
+    // decode into the cache; a NULL dest paints to a nil surface but
+    // still runs the tile decodes through _openslide_cache_put().
+    // bypass the sequential detector so prefetch reads can't trigger
+    // further prefetches
+    read_region_propagate(osr, NULL,
+                          hint->x, hint->y, hint->plane, hint->level,
+                          hint->w, hint->h);
+  }
+
+  G_LOCK(prefetch);
+  g_hash_table_remove(osr->prefetch_hints, GINT_TO_POINTER(hint->id));
+  G_UNLOCK(prefetch);
+  g_slice_free(struct prefetch_hint, hint);
+}
+
+// higher priority first, then submission order
+static gint prefetch_hint_compare(gconstpointer a, gconstpointer b,
+                                  gpointer user_data G_GNUC_UNUSED) {
+  const struct prefetch_hint *ha = a;
+  const struct prefetch_hint *hb = b;
+  if (ha->priority != hb->priority) {
+    return ha->priority > hb->priority ? -1 : 1;
+  }
+  return ha->id - hb->id;
+}
+
+static int queue_prefetch_hint(openslide_t *osr,
+                               int64_t x, int64_t y, int64_t plane,
+                               int32_t level,
+                               int64_t w, int64_t h,
+                               int priority, int warm_id) {
+  if (openslide_get_error(osr) || w < 0 || h < 0) {
+    return 0;
+  }
+
+  struct prefetch_hint *hint = g_slice_new0(struct prefetch_hint);
+  hint->osr = osr;
+  hint->x = x;
+  hint->y = y;
+  hint->plane = plane;
+  hint->level = level;
+  hint->w = w;
+  hint->h = h;
+  hint->priority = priority;
+  hint->warm_id = warm_id;
+
+  G_LOCK(prefetch);
+  if (osr->prefetch_pool == NULL) {
+    osr->prefetch_pool = g_thread_pool_new(prefetch_worker, NULL,
+                                           PREFETCH_POOL_SIZE, true, NULL);
+    g_thread_pool_set_sort_function(osr->prefetch_pool,
+                                    prefetch_hint_compare, NULL);
+    osr->prefetch_hints = g_hash_table_new(g_direct_hash, g_direct_equal);
+    osr->next_prefetch_id = 1;
+  }
+  int id = osr->next_prefetch_id++;
+  hint->id = id;
+  g_hash_table_insert(osr->prefetch_hints, GINT_TO_POINTER(id), hint);
+  G_UNLOCK(prefetch);
+
+  // the worker frees the hint on completion, so it must not be touched
+  // once pushed
+  g_thread_pool_push(osr->prefetch_pool, hint, NULL);
+  return id;
+}
+
+int openslide_give_prefetch_hint(openslide_t *osr,
+				 int64_t x, int64_t y,
+				 int32_t level,
+				 int64_t w, int64_t h) {
+  return queue_prefetch_hint(osr, x, y, 0, level, w, h, G_MAXINT, 0);
+}
+
+/* Cache warming.  A warm job enqueues one low-priority prefetch hint
+   per tile row of the level, so the whole level lands in the bound
+   cache band by band while foreground reads and explicit prefetch
+   hints keep jumping the queue. */
+
+int openslide_cache_warm(openslide_t *osr, int32_t level, int32_t priority) {
+  if (openslide_get_error(osr)) {
+    return 0;
+  }
+  if (level < 0 || level >= osr->level_count) {
+    return 0;
+  }
+
+  struct _openslide_level *l = osr->levels[level];
+  int64_t band_h = l->tile_h > 0 ? l->tile_h : 256;
+
+  G_LOCK(prefetch);
+  if (osr->next_warm_id == 0) {
+    osr->next_warm_id = 1;
+  }
+  int warm_id = osr->next_warm_id++;
+  G_UNLOCK(prefetch);
+
+  for (int64_t y = 0; y < l->h; y += band_h) {
+    queue_prefetch_hint(osr, 0, (int64_t) (y * l->downsample), 0, level,
+                        l->w, MIN(band_h, l->h - y),
+                        priority, warm_id);
+  }
+  return warm_id;
+}
+
+void openslide_cache_warm_cancel(openslide_t *osr, int warm_id) {
+  if (warm_id <= 0) {
+    return;
+  }
+  G_LOCK(prefetch);
+  if (osr->prefetch_hints) {
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, osr->prefetch_hints);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+      struct prefetch_hint *hint = value;
+      if (hint->warm_id == warm_id) {
+        g_atomic_int_set(&hint->cancelled, 1);
+      }
+    }
+  }
+  G_UNLOCK(prefetch);
+}
+
+// Whole-slide inference walks a slide in raster order with a fixed
+// region size.  Once the last few reads follow a constant stride,
+// schedule background decodes of the next regions along it, so the
+// steady-state foreground read finds its tiles already cached.  The
+// detector resets whenever the stride breaks (e.g. at a row wrap) and
+// re-locks after READAHEAD_MIN_RUN strided reads.
+
+#define READAHEAD_MIN_RUN 3
+#define READAHEAD_DEPTH 2
+// bigger regions already amortize their decode cost; don't double it
+#define READAHEAD_MAX_PIXELS (1024 * 1024)
+
+G_LOCK_DEFINE_STATIC(readahead);
+
+static void readahead_observe(openslide_t *osr,
+                              int64_t x, int64_t y, int64_t plane,
+                              int32_t level, int64_t w, int64_t h) {
+  if (w <= 0 || h <= 0 || w * h > READAHEAD_MAX_PIXELS) {
+    return;
+  }
+
+  int64_t px[READAHEAD_DEPTH];
+  int64_t py[READAHEAD_DEPTH];
+  int to_schedule = 0;
+
+  G_LOCK(readahead);
+  struct _openslide_readahead *ra = &osr->readahead;
+  if (ra->level == level && ra->plane == plane &&
+      ra->w == w && ra->h == h) {
+    int64_t dx = x - ra->x;
+    int64_t dy = y - ra->y;
+    if ((dx || dy) && dx == ra->dx && dy == ra->dy) {
+      if (ra->run < READAHEAD_MIN_RUN) {
+        ra->run++;
+      }
+      // the frontier is now one step closer
+      if (ra->ahead > 0) {
+        ra->ahead--;
+      }
+    } else if (dx || dy) {
+      ra->dx = dx;
+      ra->dy = dy;
+      ra->run = 1;
+      ra->ahead = 0;
+    }
+    // a repeated read of the same region leaves the state alone
+    if (ra->run >= READAHEAD_MIN_RUN) {
+      while (ra->ahead < READAHEAD_DEPTH) {
+        ra->ahead++;
+        px[to_schedule] = x + ra->dx * ra->ahead;
+        py[to_schedule] = y + ra->dy * ra->ahead;
+        to_schedule++;
+      }
+    }
+  } else {
+    ra->level = level;
+    ra->plane = plane;
+    ra->w = w;
+    ra->h = h;
+    ra->dx = 0;
+    ra->dy = 0;
+    ra->run = 0;
+    ra->ahead = 0;
+  }
+  ra->x = x;
+  ra->y = y;
+  G_UNLOCK(readahead);
+
+  for (int i = 0; i < to_schedule; i++) {
+    queue_prefetch_hint(osr, px[i], py[i], plane, level, w, h,
+                        G_MAXINT, 0);
+  }
+}
+
+void openslide_cancel_prefetch_hint(openslide_t *osr, int prefetch_id) {
+  G_LOCK(prefetch);
+  struct prefetch_hint *hint = NULL;
+  if (osr->prefetch_hints) {
+    hint = g_hash_table_lookup(osr->prefetch_hints,
+                               GINT_TO_POINTER(prefetch_id));
+  }
+  if (hint) {
+    g_atomic_int_set(&hint->cancelled, 1);
+  }
+  G_UNLOCK(prefetch);
+}
+
+
+// asynchronous read engine
+
+G_LOCK_DEFINE_STATIC(async_read);
+
+struct async_read {
+  openslide_t *osr;
+  uint32_t *dest;
+  int64_t x;
+  int64_t y;
+  int64_t channel;
+  int32_t level;
+  int64_t w;
+  int64_t h;
+  openslide_read_region_done_fn done;
+  void *user_data;
+};
+
+static void async_read_worker(gpointer data,
+                              gpointer user_data G_GNUC_UNUSED) {
+  struct async_read *req = data;
+
+  openslide_read_region(req->osr, req->dest,
+                        req->x, req->y, req->channel, req->level,
+                        req->w, req->h);
+  if (req->done) {
+    req->done(req->osr, req->dest, req->user_data);
+  }
+  g_slice_free(struct async_read, req);
 }
 
-void openslide_cancel_prefetch_hint(openslide_t *osr G_GNUC_UNUSED,
-				    int prefetch_id G_GNUC_UNUSED) {
-  g_warning("openslide_cancel_prefetch_hint has never been implemented and should not be called");
+int openslide_read_region_async(openslide_t *osr,
+                                uint32_t *dest,
+                                int64_t x, int64_t y, int64_t channel,
+                                int32_t level,
+                                int64_t w, int64_t h,
+                                openslide_read_region_done_fn done,
+                                void *user_data) {
+  if (openslide_get_error(osr) || w < 0 || h < 0) {
+    return 0;
+  }
+
+  struct async_read *req = g_slice_new0(struct async_read);
+  req->osr = osr;
+  req->dest = dest;
+  req->x = x;
+  req->y = y;
+  req->channel = channel;
+  req->level = level;
+  req->w = w;
+  req->h = h;
+  req->done = done;
+  req->user_data = user_data;
+
+  G_LOCK(async_read);
+  if (osr->async_pool == NULL) {
+    // one executor thread per core; each request additionally fans its
+    // tile decodes across the shared tile pool when one is configured
+#if GLIB_CHECK_VERSION(2,36,0)
+    int threads = g_get_num_processors();
+#else
+    int threads = 2;
+#endif
+    osr->async_pool = g_thread_pool_new(async_read_worker, NULL,
+                                        threads, true, NULL);
+  }
+  G_UNLOCK(async_read);
+
+  g_thread_pool_push(osr->async_pool, req, NULL);
+  return 1;
 }
 
 static bool read_region(openslide_t *osr,
@@ -536,15 +1231,36 @@ static bool read_region(openslide_t *osr,
 			int64_t x, int64_t y, int64_t channel,
 			int32_t level,
 			int64_t w, int64_t h,
+			bool allow_direct,
 			GError **err) {
   bool success = true;
 
-  // save the old pattern, it's the only thing push/pop won't restore
-  cairo_pattern_t *old_source = cairo_get_source(cr);
-  cairo_pattern_reference(old_source);
-
-  // push, so that saturate works with all sorts of backends
-  cairo_push_group(cr);
+  // attribute timing samples from this thread to this object
+  _openslide_perf_set_current(osr);
+
+  // If the target is a plain ARGB32 image surface and the caller discards
+  // the output on failure, paint straight into it.  The image backend
+  // handles SATURATE natively, so the intermediate group -- a full-region
+  // scratch surface, a clear, and an extra composite -- buys nothing.
+  // With an identity transform, Pixman then blits decoded tile rows
+  // directly into the destination buffer.  This is the common unscaled
+  // patch-extraction path through openslide_read_region().
+  cairo_surface_t *target = cairo_get_target(cr);
+  bool direct = allow_direct &&
+    cairo_surface_get_type(target) == CAIRO_SURFACE_TYPE_IMAGE &&
+    cairo_image_surface_get_format(target) == CAIRO_FORMAT_ARGB32;
+
+  cairo_pattern_t *old_source = NULL;
+  if (direct) {
+    cairo_save(cr);
+  } else {
+    // save the old pattern, it's the only thing push/pop won't restore
+    old_source = cairo_get_source(cr);
+    cairo_pattern_reference(old_source);
+
+    // push, so that saturate works with all sorts of backends
+    cairo_push_group(cr);
+  }
 
   // clear to set the bounds of the group (seems to be a recent cairo bug)
   cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
@@ -579,6 +1295,11 @@ static bool read_region(openslide_t *osr,
     }
   }
 
+  if (direct) {
+    cairo_restore(cr);
+    return success;
+  }
+
   cairo_pop_group_to_source(cr);
 
   if (success) {
@@ -605,27 +1326,17 @@ static bool ensure_nonnegative_dimensions(openslide_t *osr, int64_t w, int64_t h
   return true;
 }
 
-void openslide_read_region(openslide_t *osr,
-			   uint32_t *dest,
-			   int64_t x, int64_t y, int64_t channel,
-			   int32_t level,
-			   int64_t w, int64_t h) {
+// the tiled read loop shared by openslide_read_region() and
+// openslide_read_region_status(); reports failure through err without
+// touching the handle's error state
+static bool read_complete_region(openslide_t *osr,
+                                 uint32_t *dest,
+                                 int64_t x, int64_t y, int64_t channel,
+                                 int32_t level,
+                                 int64_t w, int64_t h,
+                                 GError **err) {
   GError *tmp_err = NULL;
 
-  if (!ensure_nonnegative_dimensions(osr, w, h)) {
-    return;
-  }
-
-  // clear the dest
-  if (dest) {
-    memset(dest, 0, w * h * 4);
-  }
-
-  // now that it's cleared, return if an error occurred
-  if (openslide_get_error(osr)) {
-    return;
-  }
-
   // Break the work into smaller pieces if the region is large, because:
   // 1. Cairo will not allow surfaces larger than 32767 pixels on a side.
   // 2. cairo_push_group() creates an intermediate surface backed by a
@@ -659,7 +1370,9 @@ void openslide_read_region(openslide_t *osr,
       cairo_surface_destroy(surface);
 
       // paint
-      if (!read_region(osr, cr, sx, sy, channel, level, sw, sh, &tmp_err)) {
+      // dest is wiped on failure, so the direct path is safe here
+      if (!read_region(osr, cr, sx, sy, channel, level, sw, sh, true,
+                       &tmp_err)) {
         cairo_destroy(cr);
         goto Exit;
       }
@@ -676,46 +1389,776 @@ void openslide_read_region(openslide_t *osr,
 
 Exit:
   if (tmp_err) {
-    _openslide_propagate_error(osr, tmp_err);
-    if (dest) {
-      // ensure we don't return a partial result
-      memset(dest, 0, w * h * 4);
-    }
+    g_propagate_error(err, tmp_err);
+    return false;
   }
+  return true;
 }
 
-
-void openslide_cairo_read_region(openslide_t *osr,
-				 cairo_t *cr,
-				 int64_t x, int64_t y, int64_t channel,
-				 int32_t level,
-				 int64_t w, int64_t h) {
+static void read_region_propagate(openslide_t *osr,
+                                  uint32_t *dest,
+                                  int64_t x, int64_t y, int64_t channel,
+                                  int32_t level,
+                                  int64_t w, int64_t h) {
   GError *tmp_err = NULL;
 
   if (!ensure_nonnegative_dimensions(osr, w, h)) {
     return;
   }
 
-  if (openslide_get_error(osr)) {
-    return;
+  // clear the dest
+  if (dest) {
+    memset(dest, 0, w * h * 4);
   }
 
-  if (read_region(osr, cr, x, y, channel, level, w, h, &tmp_err)) {
-    _openslide_check_cairo_status(cr, &tmp_err);
+  // now that it's cleared, return if an error occurred
+  if (openslide_get_error(osr)) {
+    return;
   }
 
-  if (tmp_err) {
+  if (!read_complete_region(osr, dest, x, y, channel, level, w, h,
+                            &tmp_err)) {
     _openslide_propagate_error(osr, tmp_err);
+    if (dest) {
+      // ensure we don't return a partial result
+      memset(dest, 0, w * h * 4);
+    }
   }
 }
 
+void openslide_read_region(openslide_t *osr,
+			   uint32_t *dest,
+			   int64_t x, int64_t y, int64_t channel,
+			   int32_t level,
+			   int64_t w, int64_t h) {
+  read_region_propagate(osr, dest, x, y, channel, level, w, h);
 
-const char * const *openslide_get_property_names(openslide_t *osr) {
-  if (openslide_get_error(osr)) {
-    return EMPTY_STRING_ARRAY;
+  // after the synchronous read, so background decodes don't contend
+  // with it
+  if (!openslide_get_error(osr)) {
+    readahead_observe(osr, x, y, channel, level, w, h);
   }
-
-  return osr->property_names;
+}
+
+int openslide_read_region_status(openslide_t *osr,
+                                 uint32_t *dest,
+                                 int64_t x, int64_t y, int64_t channel,
+                                 int32_t level,
+                                 int64_t w, int64_t h,
+                                 char **error_OUT) {
+  GError *tmp_err = NULL;
+
+  if (error_OUT) {
+    *error_OUT = NULL;
+  }
+
+  if (w < 0 || h < 0) {
+    if (error_OUT) {
+      *error_OUT = g_strdup_printf("negative width (%"PRId64") "
+                                   "or negative height (%"PRId64") "
+                                   "not allowed", w, h);
+    }
+    return 0;
+  }
+
+  // clear the dest
+  if (dest) {
+    memset(dest, 0, w * h * 4);
+  }
+
+  // a handle already in the error state stays dead
+  const char *fatal = openslide_get_error(osr);
+  if (fatal) {
+    if (error_OUT) {
+      *error_OUT = g_strdup(fatal);
+    }
+    return 0;
+  }
+
+  if (!read_complete_region(osr, dest, x, y, channel, level, w, h,
+                            &tmp_err)) {
+    // report per call; a corrupt tile shouldn't poison the handle
+    if (dest) {
+      // ensure we don't return a partial result
+      memset(dest, 0, w * h * 4);
+    }
+    if (error_OUT) {
+      *error_OUT = g_strdup(tmp_err->message);
+    }
+    g_error_free(tmp_err);
+    return 0;
+  }
+  return 1;
+}
+
+// cap on the scratch buffer used for one band of a scaled read
+#define SCALED_READ_MAX_PIXELS (8 << 20)
+
+// below this scale, resample bilinearly instead of box filtering; the
+// boxes would span only one or two source pixels, while a 2x2 bilinear
+// footprint still covers the source
+#define SCALED_READ_BILINEAR_MAX 2.0
+
+// box boundaries for the downscale: n + 1 monotonically increasing
+// source offsets, at least one source pixel per output pixel
+static int64_t *scaled_read_boundaries(int64_t n, double scale) {
+  int64_t *bounds = g_new(int64_t, n + 1);
+  bounds[0] = 0;
+  for (int64_t i = 1; i <= n; i++) {
+    bounds[i] = MAX((int64_t) (i * scale), bounds[i - 1] + 1);
+  }
+  return bounds;
+}
+
+// bilinear tap for output index i: returns the source offset of the
+// first sample, clamped so the second stays in range, and optionally
+// the Q8 fractional weight of the second sample
+static int64_t bilinear_coord(int64_t i, double scale, int64_t limit,
+                              uint16_t *weight) {
+  double c = MAX((i + 0.5) * scale - 0.5, 0.0);
+  int64_t pos = MIN((int64_t) c, limit);
+  if (weight) {
+    *weight = (uint16_t) (MIN(c - pos, 1.0) * 256 + 0.5);
+  }
+  return pos;
+}
+
+// resample a region whose scale is slightly above a stored level,
+// separably and through the SIMD row kernels; bilinear interpolation on
+// premultiplied channels is linear, so premultiplication is preserved
+static bool scaled_read_bilinear(openslide_t *osr,
+                                 uint32_t *dest,
+                                 int64_t x, int64_t y, int64_t channel,
+                                 int32_t level,
+                                 int64_t w, int64_t h,
+                                 double scale,
+                                 GError **err) {
+  double ds = osr->levels[level]->downsample;
+  // one extra column/row for the second tap
+  int64_t src_w = (int64_t) (w * scale) + 2;
+  int64_t src_h = (int64_t) (h * scale) + 2;
+  bool success = false;
+
+  // horizontal taps, one per output column
+  int32_t *sx = g_new(int32_t, w);
+  uint16_t *wx = g_new(uint16_t, w);
+  for (int64_t ox = 0; ox < w; ox++) {
+    sx[ox] = bilinear_coord(ox, scale, src_w - 2, &wx[ox]);
+  }
+
+  uint32_t *hrow0 = g_new(uint32_t, w);
+  uint32_t *hrow1 = g_new(uint32_t, w);
+  uint32_t *scratch = NULL;
+
+  // band of output rows whose source rows fit the scratch buffer
+  int64_t band = (int64_t) (SCALED_READ_MAX_PIXELS / (src_w * scale));
+  band = MAX(band, (int64_t) 1);
+
+  for (int64_t oy = 0; oy < h; oy += band) {
+    int64_t oy_end = MIN(h, oy + band);
+    int64_t sy_lo = bilinear_coord(oy, scale, src_h - 2, NULL);
+    int64_t rows = bilinear_coord(oy_end - 1, scale, src_h - 2, NULL) +
+      2 - sy_lo;
+
+    // decode the source band; tiles stream through the scratch buffer
+    // instead of materializing the whole source region
+    g_free(scratch);
+    scratch = g_malloc(src_w * rows * 4);
+    if (!read_complete_region(osr, scratch, x,
+                              y + (int64_t) (sy_lo * ds),
+                              channel, level, src_w, rows, err)) {
+      goto DONE;
+    }
+
+    for (int64_t row = oy; row < oy_end; row++) {
+      uint16_t wy;
+      int64_t sy = bilinear_coord(row, scale, src_h - 2, &wy);
+      const uint32_t *src = scratch + (sy - sy_lo) * src_w;
+      _openslide_simd_argb_scale_row(hrow0, src, sx, wx, w);
+      if (wy) {
+        _openslide_simd_argb_scale_row(hrow1, src + src_w, sx, wx, w);
+        _openslide_simd_argb_lerp_rows(dest + row * w, hrow0, hrow1, wy, w);
+      } else {
+        // the output row lands exactly on a source row
+        memcpy(dest + row * w, hrow0, w * 4);
+      }
+    }
+  }
+  success = true;
+
+DONE:
+  g_free(scratch);
+  g_free(hrow0);
+  g_free(hrow1);
+  g_free(sx);
+  g_free(wx);
+  return success;
+}
+
+void openslide_read_region_scaled(openslide_t *osr,
+                                  uint32_t *dest,
+                                  int64_t x, int64_t y, int64_t channel,
+                                  int64_t w, int64_t h,
+                                  double downsample) {
+  GError *tmp_err = NULL;
+
+  if (!ensure_nonnegative_dimensions(osr, w, h)) {
+    return;
+  }
+
+  // clear the dest
+  if (dest) {
+    memset(dest, 0, w * h * 4);
+  }
+
+  // now that it's cleared, return if an error occurred
+  if (openslide_get_error(osr)) {
+    return;
+  }
+
+  if (downsample < 1) {
+    _openslide_propagate_error(osr,
+        g_error_new(OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                    "downsample (%g) must be >= 1", downsample));
+    return;
+  }
+
+  if (!dest || !w || !h) {
+    return;
+  }
+
+  // read from the finest level not finer than the target
+  int32_t level = openslide_get_best_level_for_downsample(osr, downsample);
+  if (level < 0) {
+    return;
+  }
+  double scale = downsample / osr->levels[level]->downsample;
+
+  if (scale <= 1) {
+    // the target downsample is a stored level; no resampling needed
+    if (!read_complete_region(osr, dest, x, y, channel, level, w, h,
+                              &tmp_err)) {
+      goto FAIL;
+    }
+    return;
+  }
+
+  if (scale < SCALED_READ_BILINEAR_MAX) {
+    // scales just above a stored level are the common fit-to-window
+    // case; resample them through the SIMD bilinear kernels
+    if (!scaled_read_bilinear(osr, dest, x, y, channel, level, w, h, scale,
+                              &tmp_err)) {
+      goto FAIL;
+    }
+    return;
+  }
+
+  // per-output-pixel source boxes in the source level
+  int64_t *bx = scaled_read_boundaries(w, scale);
+  int64_t *by = scaled_read_boundaries(h, scale);
+  int64_t src_w = bx[w];
+
+  // band of output rows whose source rows fit the scratch buffer
+  int64_t band = (int64_t) (SCALED_READ_MAX_PIXELS / (src_w * scale));
+  band = MAX(band, (int64_t) 1);
+  uint32_t *scratch = NULL;
+  uint32_t *acc = g_new(uint32_t, src_w * 4);
+
+  for (int64_t oy = 0; oy < h; oy += band) {
+    int64_t oy_end = MIN(h, oy + band);
+    int64_t src_y = by[oy];
+    int64_t src_h = by[oy_end] - src_y;
+
+    // decode the source band; tiles stream through the scratch buffer
+    // instead of materializing the whole source region
+    g_free(scratch);
+    scratch = g_malloc(src_w * src_h * 4);
+    if (!read_complete_region(osr, scratch, x,
+                              y + (int64_t) (src_y *
+                                             osr->levels[level]->downsample),
+                              channel, level, src_w, src_h, &tmp_err)) {
+      goto FAIL_FREE;
+    }
+
+    for (int64_t row = oy; row < oy_end; row++) {
+      // vertical pass: sum the source rows of this output row
+      memset(acc, 0, src_w * 4 * sizeof(uint32_t));
+      for (int64_t sy = by[row]; sy < by[row + 1]; sy++) {
+        _openslide_simd_argb_row_sum(acc, scratch + (sy - src_y) * src_w,
+                                     src_w);
+      }
+
+      // horizontal pass: average each box; premultiplied channels are
+      // linear, so a plain mean is correct
+      int64_t rows = by[row + 1] - by[row];
+      uint32_t *out = dest + row * w;
+      for (int64_t ox = 0; ox < w; ox++) {
+        uint64_t b = 0, g = 0, r = 0, a = 0;
+        for (int64_t sx = bx[ox]; sx < bx[ox + 1]; sx++) {
+          b += acc[4 * sx];
+          g += acc[4 * sx + 1];
+          r += acc[4 * sx + 2];
+          a += acc[4 * sx + 3];
+        }
+        uint64_t count = rows * (bx[ox + 1] - bx[ox]);
+        b = (b + count / 2) / count;
+        g = (g + count / 2) / count;
+        r = (r + count / 2) / count;
+        a = (a + count / 2) / count;
+        out[ox] = (uint32_t) (a << 24 | r << 16 | g << 8 | b);
+      }
+    }
+  }
+
+  g_free(scratch);
+  g_free(acc);
+  g_free(bx);
+  g_free(by);
+  return;
+
+FAIL_FREE:
+  g_free(scratch);
+  g_free(acc);
+  g_free(bx);
+  g_free(by);
+FAIL:
+  _openslide_propagate_error(osr, tmp_err);
+  // ensure we don't return a partial result
+  memset(dest, 0, w * h * 4);
+}
+
+void openslide_get_thumbnail(openslide_t *osr,
+                             uint32_t *dest,
+                             int64_t max_w, int64_t max_h,
+                             int64_t *w_OUT, int64_t *h_OUT) {
+  if (w_OUT) {
+    *w_OUT = 0;
+  }
+  if (h_OUT) {
+    *h_OUT = 0;
+  }
+
+  if (openslide_get_error(osr)) {
+    return;
+  }
+
+  if (max_w <= 0 || max_h <= 0) {
+    _openslide_propagate_error(osr,
+        g_error_new(OPENSLIDE_ERROR, OPENSLIDE_ERROR_FAILED,
+                    "non-positive thumbnail bound (%"PRId64"x%"PRId64") "
+                    "not allowed", max_w, max_h));
+    return;
+  }
+
+  int64_t w0, h0;
+  openslide_get_level0_dimensions(osr, &w0, &h0);
+  if (w0 <= 0 || h0 <= 0) {
+    return;
+  }
+
+  // largest aspect-preserving size fitting the bounds
+  double downsample = MAX((double) w0 / max_w, (double) h0 / max_h);
+  downsample = MAX(downsample, 1.0);
+  int64_t w = MIN(max_w, MAX((int64_t) (w0 / downsample), (int64_t) 1));
+  int64_t h = MIN(max_h, MAX((int64_t) (h0 / downsample), (int64_t) 1));
+
+  // the scaled read decodes only the smallest sufficient level and box
+  // filters it straight into dest
+  openslide_read_region_scaled(osr, dest, 0, 0, 0, w, h, downsample);
+  if (openslide_get_error(osr)) {
+    return;
+  }
+
+  if (w_OUT) {
+    *w_OUT = w;
+  }
+  if (h_OUT) {
+    *h_OUT = h;
+  }
+}
+
+
+int openslide_get_tile_geometry(openslide_t *osr, int32_t level,
+                                int64_t *tiles_across_OUT,
+                                int64_t *tiles_down_OUT,
+                                int64_t *tile_w_OUT,
+                                int64_t *tile_h_OUT) {
+  if (openslide_get_error(osr) || !level_in_range(osr, level)) {
+    return 0;
+  }
+  struct _openslide_level *l = osr->levels[level];
+  if (l->tile_w <= 0 || l->tile_h <= 0) {
+    return 0;
+  }
+  if (tiles_across_OUT) {
+    *tiles_across_OUT = (l->w + l->tile_w - 1) / l->tile_w;
+  }
+  if (tiles_down_OUT) {
+    *tiles_down_OUT = (l->h + l->tile_h - 1) / l->tile_h;
+  }
+  if (tile_w_OUT) {
+    *tile_w_OUT = l->tile_w;
+  }
+  if (tile_h_OUT) {
+    *tile_h_OUT = l->tile_h;
+  }
+  return 1;
+}
+
+unsigned char *openslide_read_raw_tile(openslide_t *osr, int32_t level,
+                                       int64_t tile_col, int64_t tile_row,
+                                       int64_t *size_OUT,
+                                       const char **codec_OUT) {
+  if (openslide_get_error(osr) || !level_in_range(osr, level) ||
+      size_OUT == NULL) {
+    return NULL;
+  }
+  if (osr->ops->read_raw_tile == NULL) {
+    // backend can't supply raw tiles
+    return NULL;
+  }
+
+  GError *tmp_err = NULL;
+  int64_t len = 0;
+  const char *codec = NULL;
+  uint8_t *buf = osr->ops->read_raw_tile(osr, osr->levels[level],
+                                         tile_col, tile_row,
+                                         &len, &codec, &tmp_err);
+  if (buf == NULL) {
+    // per-call failure; don't move the object into the error state
+    g_clear_error(&tmp_err);
+    return NULL;
+  }
+  *size_OUT = len;
+  if (codec_OUT) {
+    *codec_OUT = codec;
+  }
+  return buf;
+}
+
+void openslide_raw_tile_free(unsigned char *data) {
+  g_free(data);
+}
+
+// prefetching a pending small region overlaps its decode with the
+// compositing of the current one; larger regions would just duplicate
+// decode work against the foreground read
+#define BATCH_PREFETCH_MAX_PIXELS (512 * 512)
+
+void openslide_read_regions(openslide_t *osr,
+                            int32_t count,
+                            uint32_t *const *dests,
+                            const int64_t *x, const int64_t *y,
+                            const int64_t *plane,
+                            const int32_t *level,
+                            const int64_t *w, const int64_t *h) {
+  for (int32_t i = 0; i < count; i++) {
+    if (i + 1 < count &&
+        w[i + 1] > 0 && h[i + 1] > 0 &&
+        w[i + 1] * h[i + 1] <= BATCH_PREFETCH_MAX_PIXELS) {
+      openslide_give_prefetch_hint(osr, x[i + 1], y[i + 1], level[i + 1],
+                                   w[i + 1], h[i + 1]);
+    }
+    openslide_read_region(osr, dests[i], x[i], y[i],
+                          plane ? plane[i] : 0,
+                          level[i], w[i], h[i]);
+    if (openslide_get_error(osr)) {
+      // remaining dests were not cleared by a read; do it here so the
+      // error contract matches openslide_read_region()
+      for (int32_t j = i + 1; j < count; j++) {
+        if (dests[j] && w[j] > 0 && h[j] > 0) {
+          memset(dests[j], 0, w[j] * h[j] * 4);
+        }
+      }
+      return;
+    }
+  }
+}
+
+// one plane of a multi-plane read, run on its own thread
+struct channel_read {
+  openslide_t *osr;
+  uint32_t *dest;
+  int64_t x;
+  int64_t y;
+  int64_t channel;
+  int32_t level;
+  int64_t w;
+  int64_t h;
+  GThread *thread;
+};
+
+static gpointer channel_read_thread(gpointer data) {
+  struct channel_read *read = data;
+  openslide_read_region(read->osr, read->dest, read->x, read->y,
+                        read->channel, read->level, read->w, read->h);
+  return NULL;
+}
+
+void openslide_read_region_channels(openslide_t *osr,
+                                    uint32_t *const *dests,
+                                    int64_t x, int64_t y,
+                                    const int64_t *planes,
+                                    int32_t plane_count,
+                                    int32_t level,
+                                    int64_t w, int64_t h) {
+  if (plane_count <= 0) {
+    return;
+  }
+
+  if (plane_count == 1 || openslide_get_error(osr) || w < 0 || h < 0) {
+    // let the single read apply the usual validation and error contract
+    for (int32_t i = 0; i < plane_count; i++) {
+      openslide_read_region(osr, dests[i], x, y, planes[i], level, w, h);
+    }
+    return;
+  }
+
+  // fan out: the grid traversal and decodes of the other planes run
+  // concurrently with the first; the tile cache and the per-thread TIFF
+  // handle cache are shared, so the file blocks common to the planes
+  // are only read once
+  struct channel_read *reads = g_new0(struct channel_read, plane_count);
+  for (int32_t i = 1; i < plane_count; i++) {
+    struct channel_read *read = &reads[i];
+    read->osr = osr;
+    read->dest = dests[i];
+    read->x = x;
+    read->y = y;
+    read->channel = planes[i];
+    read->level = level;
+    read->w = w;
+    read->h = h;
+#if !GLIB_CHECK_VERSION(2,31,0)
+    read->thread = g_thread_create(channel_read_thread, read, TRUE, NULL);
+#else
+    read->thread = g_thread_new("channel-read", channel_read_thread, read);
+#endif
+    if (read->thread == NULL) {
+      // couldn't start the thread; read on this one
+      channel_read_thread(read);
+    }
+  }
+
+  openslide_read_region(osr, dests[0], x, y, planes[0], level, w, h);
+
+  for (int32_t i = 1; i < plane_count; i++) {
+    if (reads[i].thread) {
+      g_thread_join(reads[i].thread);
+    }
+  }
+  g_free(reads);
+}
+
+
+// fallback tile size for levels without native tile geometry
+#define TILE_ITERATOR_DEFAULT_SIZE 512
+
+struct _openslide_tile_iterator {
+  openslide_t *osr;
+  int32_t level;
+  int64_t plane;
+
+  int64_t tile_w;
+  int64_t tile_h;
+  int64_t cols;
+  int64_t rows;
+  int64_t cur;  // linear tile index of the next tile
+
+  // the cache entry backing the current tile, if it came straight out
+  // of the cache
+  struct _openslide_cache_entry *entry;
+  // lazily-allocated buffer for tiles that need a copy
+  uint32_t *buf;
+};
+
+openslide_tile_iterator_t *openslide_tile_iterator_create(openslide_t *osr,
+                                                          int32_t level,
+                                                          int64_t plane) {
+  if (openslide_get_error(osr) || !level_in_range(osr, level)) {
+    return NULL;
+  }
+  struct _openslide_level *l = osr->levels[level];
+
+  struct _openslide_tile_iterator *it =
+    g_slice_new0(struct _openslide_tile_iterator);
+  it->osr = osr;
+  it->level = level;
+  it->plane = plane;
+  it->tile_w = l->tile_w > 0 ? l->tile_w : TILE_ITERATOR_DEFAULT_SIZE;
+  it->tile_h = l->tile_h > 0 ? l->tile_h : TILE_ITERATOR_DEFAULT_SIZE;
+  it->cols = (l->w + it->tile_w - 1) / it->tile_w;
+  it->rows = (l->h + it->tile_h - 1) / it->tile_h;
+  return it;
+}
+
+static void tile_iterator_release(struct _openslide_tile_iterator *it) {
+  if (it->entry) {
+    _openslide_cache_entry_unref(it->entry);
+    it->entry = NULL;
+  }
+}
+
+int openslide_tile_iterator_next(openslide_tile_iterator_t *it,
+                                 int64_t *col_OUT, int64_t *row_OUT,
+                                 int64_t *w_OUT, int64_t *h_OUT,
+                                 const uint32_t **data_OUT) {
+  openslide_t *osr = it->osr;
+
+  tile_iterator_release(it);
+
+  if (it->cur >= it->cols * it->rows || openslide_get_error(osr)) {
+    return 0;
+  }
+
+  int64_t col = it->cur % it->cols;
+  int64_t row = it->cur / it->cols;
+  it->cur++;
+
+  double downsample = osr->levels[it->level]->downsample;
+  int64_t x = (int64_t) (col * it->tile_w * downsample);
+  int64_t y = (int64_t) (row * it->tile_h * downsample);
+  uint64_t tile_size = (uint64_t) it->tile_w * it->tile_h * 4;
+
+  // decode through the normal paint path without copying the output;
+  // the capture hook records the cache entry the tile's pixels land in
+  _openslide_cache_binding_arm_capture(osr->cache);
+  openslide_read_region(osr, NULL, x, y, it->plane, it->level,
+                        it->tile_w, it->tile_h);
+  void *data;
+  uint64_t size;
+  struct _openslide_cache_entry *entry =
+    _openslide_cache_binding_take_capture(osr->cache, &data, &size);
+
+  if (openslide_get_error(osr)) {
+    if (entry) {
+      _openslide_cache_entry_unref(entry);
+    }
+    return 0;
+  }
+
+  if (entry && size == tile_size) {
+    // the backend's tile is exactly one iterator tile; hand its pixels
+    // to the caller, keeping the cache entry alive
+    it->entry = entry;
+    *data_OUT = data;
+  } else {
+    // nothing was captured (cache disabled, or another thread took
+    // the capture) or the backend's buffers aren't one full tile
+    // (overlapping tiles, differing geometry); fall back to one copy
+    if (entry) {
+      _openslide_cache_entry_unref(entry);
+    }
+    if (it->buf == NULL) {
+      it->buf = g_malloc(tile_size);
+    }
+    openslide_read_region(osr, it->buf, x, y, it->plane, it->level,
+                          it->tile_w, it->tile_h);
+    if (openslide_get_error(osr)) {
+      return 0;
+    }
+    *data_OUT = it->buf;
+  }
+
+  // overlap the next tile's decode with the caller's processing
+  if (it->cur < it->cols * it->rows && it->plane == 0) {
+    int64_t ncol = it->cur % it->cols;
+    int64_t nrow = it->cur / it->cols;
+    openslide_give_prefetch_hint(osr,
+                                 (int64_t) (ncol * it->tile_w * downsample),
+                                 (int64_t) (nrow * it->tile_h * downsample),
+                                 it->level, it->tile_w, it->tile_h);
+  }
+
+  if (col_OUT) {
+    *col_OUT = col;
+  }
+  if (row_OUT) {
+    *row_OUT = row;
+  }
+  if (w_OUT) {
+    *w_OUT = it->tile_w;
+  }
+  if (h_OUT) {
+    *h_OUT = it->tile_h;
+  }
+  return 1;
+}
+
+void openslide_tile_iterator_destroy(openslide_tile_iterator_t *it) {
+  if (it == NULL) {
+    return;
+  }
+  tile_iterator_release(it);
+  g_free(it->buf);
+  g_slice_free(struct _openslide_tile_iterator, it);
+}
+
+void openslide_cairo_read_region(openslide_t *osr,
+				 cairo_t *cr,
+				 int64_t x, int64_t y, int64_t channel,
+				 int32_t level,
+				 int64_t w, int64_t h) {
+  GError *tmp_err = NULL;
+
+  if (!ensure_nonnegative_dimensions(osr, w, h)) {
+    return;
+  }
+
+  if (openslide_get_error(osr)) {
+    return;
+  }
+
+  // no direct path: a partial paint would be visible on the caller's
+  // surface if an error occurs partway through
+  if (read_region(osr, cr, x, y, channel, level, w, h, false, &tmp_err)) {
+    _openslide_check_cairo_status(cr, &tmp_err);
+  }
+
+  if (tmp_err) {
+    _openslide_propagate_error(osr, tmp_err);
+  }
+}
+
+
+const char * const *openslide_get_property_names(openslide_t *osr) {
+  if (openslide_get_error(osr)) {
+    return EMPTY_STRING_ARRAY;
+  }
+
+  return osr->property_names;
+}
+
+G_LOCK_DEFINE_STATIC(quickhash1_pending);
+
+// replay a deferred quickhash1 journal and replace the placeholder
+// property value; on failure the slide moves into the error state,
+// matching how a hashing I/O error at open would have been reported
+static void resolve_pending_quickhash1(openslide_t *osr) {
+  GError *tmp_err = NULL;
+
+  G_LOCK(quickhash1_pending);
+  struct _openslide_hash *quickhash1 = osr->quickhash1_pending;
+  if (quickhash1) {
+    const char *hash_prop = quickhash_property_name(quickhash1);
+    if (_openslide_hash_resolve(quickhash1, &tmp_err)) {
+      // the existing key is kept, so the cached name array stays valid
+      g_hash_table_insert(osr->properties,
+                          g_strdup(hash_prop),
+                          g_strdup(_openslide_hash_get_string(quickhash1)));
+      // the placeholder value was replaced; refresh the frozen table
+      int32_t idx = property_index(osr, hash_prop);
+      if (idx >= 0) {
+        osr->property_values[idx] =
+          g_hash_table_lookup(osr->properties, hash_prop);
+      }
+    } else {
+      _openslide_propagate_error(osr, tmp_err);
+    }
+    _openslide_hash_destroy(quickhash1);
+    osr->quickhash1_pending = NULL;
+  }
+  G_UNLOCK(quickhash1_pending);
 }
 
 const char *openslide_get_property_value(openslide_t *osr, const char *name) {
@@ -723,7 +2166,54 @@ const char *openslide_get_property_value(openslide_t *osr, const char *name) {
     return NULL;
   }
 
-  return g_hash_table_lookup(osr->properties, name);
+  // the deferred hash journal lives on the origin handle; resolving it
+  // updates the shared frozen table in place, so clones see the result
+  openslide_t *origin = get_origin(osr);
+  if (origin->quickhash1_pending &&
+      !strcmp(name, quickhash_property_name(origin->quickhash1_pending))) {
+    resolve_pending_quickhash1(origin);
+    if (openslide_get_error(origin)) {
+      return NULL;
+    }
+  }
+
+  int32_t idx = property_index(osr, name);
+  if (idx < 0) {
+    return NULL;
+  }
+  return osr->property_values[idx];
+}
+
+int openslide_get_property_double(openslide_t *osr, const char *name,
+                                  double *value_OUT) {
+  *value_OUT = 0;
+
+  if (openslide_get_error(osr)) {
+    return 0;
+  }
+
+  int32_t idx = property_index(osr, name);
+  if (idx < 0 || !(osr->property_kinds[idx] & _OPENSLIDE_PROP_DOUBLE)) {
+    return 0;
+  }
+  *value_OUT = osr->property_doubles[idx];
+  return 1;
+}
+
+int openslide_get_property_int64(openslide_t *osr, const char *name,
+                                 int64_t *value_OUT) {
+  *value_OUT = 0;
+
+  if (openslide_get_error(osr)) {
+    return 0;
+  }
+
+  int32_t idx = property_index(osr, name);
+  if (idx < 0 || !(osr->property_kinds[idx] & _OPENSLIDE_PROP_INT64)) {
+    return 0;
+  }
+  *value_OUT = osr->property_int64s[idx];
+  return 1;
 }
 
 const char * const *openslide_get_associated_image_names(openslide_t *osr) {
@@ -763,27 +2253,61 @@ void openslide_read_associated_image(openslide_t *osr,
   struct _openslide_associated_image *img = g_hash_table_lookup(osr->associated_images,
 								name);
   if (img) {
-    // this function is documented to do nothing on failure, so we need an
-    // extra memcpy
-    size_t pixels = img->w * img->h;
-    uint32_t *buf = g_new(uint32_t, pixels);
-
-    if (img->ops->get_argb_data(img, buf, &tmp_err)) {
-      if (dest) {
-        memcpy(dest, buf, pixels * sizeof(uint32_t));
+    uint64_t size = (uint64_t) img->w * img->h * sizeof(uint32_t);
+
+    // decoded associated images go through the tile cache, keyed on the
+    // image structure as the coordinate plane, so repeat reads of the
+    // label/macro/thumbnail are memory hits with the same eviction
+    // accounting as tiles
+    struct _openslide_cache_entry *entry;
+    uint32_t *buf = _openslide_cache_get(osr->cache, img, 0, 0, 0, &entry);
+    if (!buf) {
+      buf = _openslide_cache_tile_alloc(osr->cache, size);
+
+      // this function is documented to do nothing on failure, so decode
+      // into the cache buffer and copy out afterward
+      if (!img->ops->get_argb_data(img, buf, &tmp_err)) {
+        _openslide_cache_tile_free(osr->cache, size, buf);
+        _openslide_propagate_error(osr, tmp_err);
+        return;
       }
-    } else {
-      _openslide_propagate_error(osr, tmp_err);
+
+      _openslide_cache_put(osr->cache, img, 0, 0, 0, buf, size, &entry);
     }
 
-    g_free(buf);
+    if (dest) {
+      memcpy(dest, buf, size);
+    }
+    _openslide_cache_entry_unref(entry);
   }
 }
 
+int64_t openslide_get_timing(openslide_t *osr,
+                             openslide_timing_stage_t stage) {
+  if (stage < 0 || stage >= _OPENSLIDE_PERF_STAGE_COUNT) {
+    return 0;
+  }
+  // the public enum mirrors the internal stage order
+  return _openslide_perf_read(osr, (enum _openslide_perf_stage) stage);
+}
+
+void openslide_set_tile_worker_count(openslide_t *osr, int32_t count) {
+  if (openslide_get_error(osr)) {
+    return;
+  }
+  // the grids decode through the origin handle's pool
+  _openslide_grid_set_tile_worker_count(get_origin(osr), count);
+}
+
 openslide_cache_t *openslide_cache_create(size_t capacity) {
   return _openslide_cache_create(capacity);
 }
 
+openslide_cache_t *openslide_cache_create_with_policy(size_t capacity,
+                                                      openslide_cache_policy_t policy) {
+  return _openslide_cache_create_with_policy(capacity, policy);
+}
+
 void openslide_set_cache(openslide_t *osr, openslide_cache_t *cache) {
   if (openslide_get_error(osr)) {
     return;
@@ -795,6 +2319,27 @@ void openslide_cache_release(openslide_cache_t *cache) {
   _openslide_cache_release(cache);
 }
 
+void openslide_cache_get_stats(openslide_cache_t *cache,
+                               uint64_t *hits, uint64_t *misses,
+                               uint64_t *insertions, uint64_t *evictions,
+                               uint64_t *bytes, uint64_t *entries) {
+  _openslide_cache_get_stats(cache, hits, misses, insertions, evictions,
+                             bytes, entries);
+}
+
+void openslide_get_cache_stats(openslide_t *osr,
+                               uint64_t *hits, uint64_t *misses) {
+  _openslide_cache_binding_get_stats(osr->cache, hits, misses);
+}
+
+void openslide_set_cache_quota(openslide_t *osr, uint64_t bytes) {
+  _openslide_cache_binding_set_quota(osr->cache, bytes);
+}
+
+uint64_t openslide_get_cache_usage(openslide_t *osr) {
+  return _openslide_cache_binding_get_usage(osr->cache);
+}
+
 const char *openslide_get_version(void) {
   return SUFFIXED_VERSION;
 }
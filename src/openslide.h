@@ -55,6 +55,51 @@ typedef struct _openslide openslide_t;
  */
 typedef struct _openslide_cache openslide_cache_t;
 
+/**
+ * Replacement policies for a tile cache.
+ *
+ * @since 3.5.0
+ */
+typedef enum {
+  /**
+   * Plain least-recently-used replacement.
+   */
+  OPENSLIDE_CACHE_LRU = 0,
+
+  /**
+   * Segmented LRU.  Tiles are promoted to a protected segment on their
+   * second access, so a one-shot sequential scan of a slide cannot flush
+   * the working set of concurrent readers sharing the cache.
+   */
+  OPENSLIDE_CACHE_SLRU = 1,
+} openslide_cache_policy_t;
+
+/**
+ * Per-open I/O policy flags for openslide_open_with_options().
+ *
+ * @since 3.5.0
+ */
+typedef enum {
+  /**
+   * Default buffered I/O.
+   */
+  OPENSLIDE_OPEN_DEFAULT = 0,
+
+  /**
+   * Advise the kernel that the slide will be read once, roughly in
+   * order, so readahead can be enlarged.
+   */
+  OPENSLIDE_OPEN_SEQUENTIAL = 1 << 0,
+
+  /**
+   * Advise the kernel not to retain slide data in the page cache, so
+   * batch jobs scanning many slides don't evict the working set of
+   * interactive viewers on the same machine.  Re-reading data already
+   * read once becomes slower.
+   */
+  OPENSLIDE_OPEN_NO_CACHE = 1 << 1,
+} openslide_open_flags_t;
+
 /**
  * @name Basic Usage
  * Opening, reading, and closing.
@@ -100,6 +145,51 @@ OPENSLIDE_PUBLIC()
 openslide_t *openslide_open(const char *filename);
 
 
+/**
+ * Open a whole slide image with an I/O policy.
+ *
+ * Like openslide_open(), but applies the given ::openslide_open_flags_t
+ * to the files backing the slide, both while opening and for subsequent
+ * region reads.  The policy is advisory: it is applied on a best-effort
+ * basis and has no effect on platforms without posix_fadvise().
+ * openslide_open() is equivalent to passing #OPENSLIDE_OPEN_DEFAULT.
+ *
+ * @param filename The filename to open.  On Windows, this must be in UTF-8.
+ * @param flags A bitwise OR of ::openslide_open_flags_t values.
+ * @return
+ *         On success, a new OpenSlide object.
+ *         If the file is not recognized by OpenSlide, NULL.
+ *         If the file is recognized but an error occurred, an OpenSlide
+ *         object in error state.
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+openslide_t *openslide_open_with_options(const char *filename,
+                                         openslide_open_flags_t flags);
+
+
+/**
+ * Create an additional handle to an open whole slide image.
+ *
+ * The returned handle shares the parsed slide structure, properties,
+ * and tile cache of @p osr, so cloning costs almost nothing and the
+ * per-slide metadata exists only once no matter how many handles read
+ * the slide.  Each handle keeps its own error state and sequential
+ * access detector, so a multithreaded server can hand one handle to
+ * each worker instead of opening the same slide repeatedly.
+ *
+ * Handles are closed individually with openslide_close(), in any
+ * order; the shared structure is freed when the last handle sharing
+ * it is closed.
+ *
+ * @param osr The OpenSlide object.
+ * @return A new OpenSlide object, or NULL if @p osr is in error state.
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+openslide_t *openslide_clone(openslide_t *osr);
+
+
 /**
  * Get the number of levels in the whole slide image.
  *
@@ -202,6 +292,344 @@ void openslide_read_region(openslide_t *osr,
                            int64_t w, int64_t h);
 
 
+/**
+ * Copy pre-multiplied ARGB data for a batch of regions.
+ *
+ * Equivalent to calling openslide_read_region() once per region, but
+ * amortizes per-call setup and overlaps the decode of the next region
+ * with the current one when a prefetch worker is available.  Intended
+ * for pipelines reading many small patches from one slide.
+ *
+ * On error, all remaining destination buffers are cleared, matching
+ * the openslide_read_region() contract.
+ *
+ * @param osr The OpenSlide object.
+ * @param count The number of regions.
+ * @param dests Destination buffers, one per region.
+ * @param x Top left x-coordinates, in the level 0 reference frame.
+ * @param y Top left y-coordinates, in the level 0 reference frame.
+ * @param plane Image planes to read, or NULL for plane 0 throughout.
+ * @param level The desired level of each region.
+ * @param w The width of each region. Must be non-negative.
+ * @param h The height of each region. Must be non-negative.
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+void openslide_read_regions(openslide_t *osr,
+                            int32_t count,
+                            uint32_t *const *dests,
+                            const int64_t *x, const int64_t *y,
+                            const int64_t *plane,
+                            const int32_t *level,
+                            const int64_t *w, const int64_t *h);
+
+/**
+ * Copy pre-multiplied ARGB data for one region in several image planes.
+ *
+ * Equivalent to calling openslide_read_region() once per entry of
+ * @p planes with the same region, but the reads run concurrently and
+ * share the tile cache and per-thread file handles, so file data common
+ * to the planes is read once.  Intended for fluorescence pipelines that
+ * read every channel of each patch.
+ *
+ * Each destination buffer follows the openslide_read_region() contract:
+ * it must hold at least (@p w * @p h * 4) bytes and is cleared on error.
+ *
+ * @param osr The OpenSlide object.
+ * @param dests Destination buffers, one per plane.
+ * @param x The top left x-coordinate, in the level 0 reference frame.
+ * @param y The top left y-coordinate, in the level 0 reference frame.
+ * @param planes The image planes to read.
+ * @param plane_count The number of planes.
+ * @param level The desired level.
+ * @param w The width of the region. Must be non-negative.
+ * @param h The height of the region. Must be non-negative.
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+void openslide_read_region_channels(openslide_t *osr,
+                                    uint32_t *const *dests,
+                                    int64_t x, int64_t y,
+                                    const int64_t *planes,
+                                    int32_t plane_count,
+                                    int32_t level,
+                                    int64_t w, int64_t h);
+
+/**
+ * An iterator over the tiles of one level of a whole slide image.
+ *
+ * @since 3.5.0
+ */
+typedef struct _openslide_tile_iterator openslide_tile_iterator_t;
+
+/**
+ * Create an iterator over the tiles of one level.
+ *
+ * The iterator visits the level in row-major tile order.  The tile size
+ * is the slide's native tile geometry when the format exposes one, so a
+ * tile's pixels can usually be handed to the caller directly out of the
+ * tile cache without an intermediate copy; the pixels of the current
+ * tile stay valid until the next call to openslide_tile_iterator_next()
+ * or openslide_tile_iterator_destroy().
+ *
+ * The iterator itself is not thread-safe, and reads of the same object
+ * on other threads may force the iterator onto its internal copying
+ * path; neither affects correctness.
+ *
+ * @param osr The OpenSlide object.
+ * @param level The desired level.
+ * @param plane Image plane to read (0 for brightfield; >= 0 for fluorescence).
+ * @return An iterator, or NULL if the level is out of range or the
+ *         object is in an error state.  Free with
+ *         openslide_tile_iterator_destroy().
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+openslide_tile_iterator_t *openslide_tile_iterator_create(openslide_t *osr,
+                                                          int32_t level,
+                                                          int64_t plane);
+
+/**
+ * Yield the next tile.
+ *
+ * Every tile has the iterator's full tile dimensions; tiles on the
+ * right and bottom edges of the level are padded with transparent
+ * pixels beyond the level bounds.  The returned pixels are
+ * pre-multiplied ARGB and belong to the iterator -- they are valid only
+ * until the next call on the iterator.  While the caller processes a
+ * tile the iterator prefetches the next one in the background.
+ *
+ * @param it The iterator.
+ * @param col_OUT The tile column, or NULL.
+ * @param row_OUT The tile row, or NULL.
+ * @param w_OUT The tile width in pixels, or NULL.
+ * @param h_OUT The tile height in pixels, or NULL.
+ * @param data_OUT The tile pixels.
+ * @return 1 if a tile was produced, 0 when the level is exhausted or
+ *         the object has entered the error state.
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+int openslide_tile_iterator_next(openslide_tile_iterator_t *it,
+                                 int64_t *col_OUT, int64_t *row_OUT,
+                                 int64_t *w_OUT, int64_t *h_OUT,
+                                 const uint32_t **data_OUT);
+
+/**
+ * Destroy a tile iterator.
+ *
+ * @param it The iterator.
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+void openslide_tile_iterator_destroy(openslide_tile_iterator_t *it);
+
+/**
+ * Completion callback for openslide_read_region_async().
+ *
+ * Invoked on an internal worker thread once the region has been read
+ * into @p dest.  Check openslide_get_error() to detect a failed read;
+ * on failure @p dest has been cleared, matching the
+ * openslide_read_region() contract.
+ *
+ * @param osr The OpenSlide object.
+ * @param dest The destination buffer passed to
+ *             openslide_read_region_async().
+ * @param user_data The user data passed to
+ *                  openslide_read_region_async().
+ * @since 3.5.0
+ */
+typedef void (*openslide_read_region_done_fn)(openslide_t *osr,
+                                              uint32_t *dest,
+                                              void *user_data);
+
+/**
+ * Copy pre-multiplied ARGB data from a whole slide image, asynchronously.
+ *
+ * Queues the read on an internal executor and returns immediately; the
+ * decode runs on a worker thread and @p done is invoked from that
+ * thread when the region is complete.  The caller must keep @p dest
+ * valid until the callback runs.  openslide_close() waits for all
+ * outstanding asynchronous reads, so every accepted request receives
+ * its callback before the object is destroyed.
+ *
+ * @param osr The OpenSlide object.
+ * @param dest The destination buffer for the ARGB data.
+ * @param x The top left x-coordinate, in the level 0 reference frame.
+ * @param y The top left y-coordinate, in the level 0 reference frame.
+ * @param plane Image plane to read (0 for brightfield; >= 0 for fluorescence).
+ * @param level The desired level.
+ * @param w The width of the region. Must be non-negative.
+ * @param h The height of the region. Must be non-negative.
+ * @param done Completion callback, or NULL for fire-and-forget.
+ * @param user_data Opaque pointer passed through to @p done.
+ * @return 1 if the read was queued, 0 if the object is in an error
+ *         state or the dimensions are negative.
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+int openslide_read_region_async(openslide_t *osr,
+                                uint32_t *dest,
+                                int64_t x, int64_t y, int64_t plane,
+                                int32_t level,
+                                int64_t w, int64_t h,
+                                openslide_read_region_done_fn done,
+                                void *user_data);
+
+/**
+ * Copy pre-multiplied ARGB data from a whole slide image, reporting
+ * errors per call.
+ *
+ * Behaves like openslide_read_region(), except that a failed read --
+ * a corrupt or unreadable tile, for example -- is reported through the
+ * return value and @p error_OUT instead of moving the object into the
+ * permanent error state, so the object remains usable for subsequent
+ * reads of other regions.  An object already in the error state stays
+ * there; this function then fails and returns its message.
+ *
+ * On failure the memory pointed to by @p dest is cleared, matching the
+ * openslide_read_region() contract.
+ *
+ * @param osr The OpenSlide object.
+ * @param dest The destination buffer for the ARGB data.
+ * @param x The top left x-coordinate, in the level 0 reference frame.
+ * @param y The top left y-coordinate, in the level 0 reference frame.
+ * @param plane Image plane to read (0 for brightfield; >= 0 for fluorescence).
+ * @param level The desired level.
+ * @param w The width of the region. Must be non-negative.
+ * @param h The height of the region. Must be non-negative.
+ * @param error_OUT On failure, set to a description of the error, or
+ *                  NULL to discard it.  Free with free().
+ * @return 1 on success, 0 on failure.
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+int openslide_read_region_status(openslide_t *osr,
+                                 uint32_t *dest,
+                                 int64_t x, int64_t y, int64_t plane,
+                                 int32_t level,
+                                 int64_t w, int64_t h,
+                                 char **error_OUT);
+
+/**
+ * Copy pre-multiplied ARGB data at an arbitrary downsample factor.
+ *
+ * Reads the region of @p w * @p downsample by @p h * @p downsample
+ * level 0 pixels whose top left corner is (@p x, @p y), scaled to a
+ * @p w by @p h result.  The source level is chosen with
+ * openslide_get_best_level_for_downsample() and the remaining scale
+ * factor is applied with a box filter as tiles stream through, so only
+ * the optimal level is decoded and memory use stays bounded regardless
+ * of the region size.  When @p downsample matches a stored level this
+ * is equivalent to openslide_read_region() on that level.
+ *
+ * @p dest must hold at least (@p w * @p h * 4) bytes.  If an error
+ * occurs or has occurred, the memory pointed to by @p dest is cleared.
+ *
+ * @param osr The OpenSlide object.
+ * @param dest The destination buffer for the ARGB data.
+ * @param x The top left x-coordinate, in the level 0 reference frame.
+ * @param y The top left y-coordinate, in the level 0 reference frame.
+ * @param plane Image plane to read (0 for brightfield; >= 0 for fluorescence).
+ * @param w The width of the result. Must be non-negative.
+ * @param h The height of the result. Must be non-negative.
+ * @param downsample The downsample factor. Must be >= 1.
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+void openslide_read_region_scaled(openslide_t *osr,
+                                  uint32_t *dest,
+                                  int64_t x, int64_t y, int64_t plane,
+                                  int64_t w, int64_t h,
+                                  double downsample);
+
+/**
+ * Read a whole-slide thumbnail.
+ *
+ * Renders the entire slide at the largest aspect-preserving size that
+ * fits within @p max_w by @p max_h, decoding only the smallest
+ * sufficient pyramid level and box-filtering it directly into @p dest
+ * without an intermediate full-level surface.  The resulting size is
+ * returned through @p w_OUT and @p h_OUT, which are set to 0 if an
+ * error occurs or has occurred.
+ *
+ * @p dest must hold at least (@p max_w * @p max_h * 4) bytes.
+ *
+ * @param osr The OpenSlide object.
+ * @param dest The destination buffer for the ARGB data.
+ * @param max_w The maximum thumbnail width. Must be positive.
+ * @param max_h The maximum thumbnail height. Must be positive.
+ * @param w_OUT The actual thumbnail width, or NULL.
+ * @param h_OUT The actual thumbnail height, or NULL.
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+void openslide_get_thumbnail(openslide_t *osr,
+                             uint32_t *dest,
+                             int64_t max_w, int64_t max_h,
+                             int64_t *w_OUT, int64_t *h_OUT);
+
+/**
+ * Get the tile layout of a level.
+ *
+ * Reports the tile grid used by openslide_read_raw_tile().  Fails if
+ * the slide does not expose tile geometry.
+ *
+ * @param osr The OpenSlide object.
+ * @param level The desired level.
+ * @param tiles_across_OUT The number of tile columns, or NULL.
+ * @param tiles_down_OUT The number of tile rows, or NULL.
+ * @param tile_w_OUT The tile width in pixels, or NULL.
+ * @param tile_h_OUT The tile height in pixels, or NULL.
+ * @return 1 on success, 0 if unavailable or an error has occurred.
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+int openslide_get_tile_geometry(openslide_t *osr, int32_t level,
+                                int64_t *tiles_across_OUT,
+                                int64_t *tiles_down_OUT,
+                                int64_t *tile_w_OUT,
+                                int64_t *tile_h_OUT);
+
+/**
+ * Read one tile's compressed bitstream without decoding it.
+ *
+ * For slide formats that store independently-compressed tiles, returns
+ * the stored bytes as a standalone bitstream -- JPEG tiles that share a
+ * tables segment have it spliced in -- so transcoding pipelines can
+ * repack tiles without a decode/re-encode round trip.  The codec is
+ * reported as a short static string such as "jpeg" or "jp2k".
+ *
+ * Failure to extract a tile does not put the object into the error
+ * state; unsupported formats and levels simply return NULL.  Note that
+ * the bitstream is the stored tile: edge tiles are not clipped to the
+ * level dimensions and pixel data is in the codec's native color space.
+ *
+ * @param osr The OpenSlide object.
+ * @param level The desired level.
+ * @param tile_col The column of the tile, from openslide_get_tile_geometry().
+ * @param tile_row The row of the tile.
+ * @param size_OUT The size of the returned buffer in bytes.
+ * @param codec_OUT The codec name (static string), or NULL to discard.
+ * @return The compressed bytes, to be freed with
+ *         openslide_raw_tile_free(), or NULL on failure.
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+unsigned char *openslide_read_raw_tile(openslide_t *osr, int32_t level,
+                                       int64_t tile_col, int64_t tile_row,
+                                       int64_t *size_OUT,
+                                       const char **codec_OUT);
+
+/**
+ * Free a buffer returned by openslide_read_raw_tile().
+ *
+ * @param data The buffer to free, may be NULL.
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+void openslide_raw_tile_free(unsigned char *data);
+
 /**
  * Close an OpenSlide object.
  * No other threads may be using the object.
@@ -279,6 +707,16 @@ const char *openslide_get_error(openslide_t *osr);
  */
 #define OPENSLIDE_PROPERTY_NAME_QUICKHASH1 "openslide.quickhash-1"
 
+/**
+ * The name of the property containing the "quickhash-2" sum, a hash
+ * tree over the same inputs as "quickhash-1" that is computed in
+ * parallel.  Present instead of "quickhash-1" when tree hashing is
+ * enabled with the OPENSLIDE_TREE_QUICKHASH environment variable.
+ *
+ * @since 3.5.0
+ */
+#define OPENSLIDE_PROPERTY_NAME_QUICKHASH2 "openslide.quickhash-2"
+
 /**
  * The name of the property containing a slide's background color, if any.
  * It is represented as an RGB hex triplet.
@@ -382,6 +820,43 @@ const char * const *openslide_get_property_names(openslide_t *osr);
 OPENSLIDE_PUBLIC()
 const char *openslide_get_property_value(openslide_t *osr, const char *name);
 
+/**
+ * Get the value of a single property as a double.
+ *
+ * Numeric property values are parsed once when the slide is opened, so
+ * repeated calls for hot properties such as
+ * #OPENSLIDE_PROPERTY_NAME_MPP_X do not re-parse the string.
+ *
+ * @param osr The OpenSlide object.
+ * @param name The name of the desired property. Must be
+               a valid name as given by openslide_get_property_names().
+ * @param value_OUT The parsed value; 0 on failure.
+ * @return 1 if the property exists and its entire value parses as a
+ *         number, 0 otherwise.
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+int openslide_get_property_double(openslide_t *osr, const char *name,
+                                  double *value_OUT);
+
+/**
+ * Get the value of a single property as an int64.
+ *
+ * Numeric property values are parsed once when the slide is opened, so
+ * repeated calls for hot properties do not re-parse the string.
+ *
+ * @param osr The OpenSlide object.
+ * @param name The name of the desired property. Must be
+               a valid name as given by openslide_get_property_names().
+ * @param value_OUT The parsed value; 0 on failure.
+ * @return 1 if the property exists and its entire value parses as an
+ *         integer, 0 otherwise.
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+int openslide_get_property_int64(openslide_t *osr, const char *name,
+                                 int64_t *value_OUT);
+
 //@}
 
 /**
@@ -468,6 +943,20 @@ void openslide_read_associated_image(openslide_t *osr,
 OPENSLIDE_PUBLIC()
 openslide_cache_t *openslide_cache_create(size_t capacity);
 
+/**
+ * Create a new tile cache with an explicit replacement policy.
+ * Equivalent to openslide_cache_create() except for the policy;
+ * openslide_cache_create() uses #OPENSLIDE_CACHE_LRU.
+ *
+ * @param capacity The capacity of the cache, in bytes.
+ * @param policy The replacement policy.
+ * @return A new cache.
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+openslide_cache_t *openslide_cache_create_with_policy(size_t capacity,
+                                                      openslide_cache_policy_t policy);
+
 /**
  * Attach a cache to the specified OpenSlide object, replacing the
  * current cache.
@@ -490,6 +979,206 @@ void openslide_set_cache(openslide_t *osr, openslide_cache_t *cache);
 OPENSLIDE_PUBLIC()
 void openslide_cache_release(openslide_cache_t *cache);
 
+/**
+ * Retrieve usage statistics for a cache.  The counters reflect all
+ * OpenSlide objects the cache has been attached to, and are useful for
+ * choosing an openslide_cache_create() capacity.  Any out-parameter may
+ * be NULL if the corresponding counter is not wanted.
+ *
+ * @param cache The cache to query.
+ * @param[out] hits Number of tile lookups served from the cache.
+ * @param[out] misses Number of tile lookups that required a decode.
+ * @param[out] insertions Number of entries added to the cache.
+ * @param[out] evictions Number of entries evicted to make room.
+ * @param[out] bytes Current cache occupancy, in bytes.
+ * @param[out] entries Current number of cached entries.
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+void openslide_cache_get_stats(openslide_cache_t *cache,
+                               uint64_t *hits, uint64_t *misses,
+                               uint64_t *insertions, uint64_t *evictions,
+                               uint64_t *bytes, uint64_t *entries);
+
+/**
+ * Retrieve cache hit statistics for a single OpenSlide object.  Unlike
+ * openslide_cache_get_stats(), these counters cover only lookups made
+ * through the given object, even when several objects share one cache.
+ * Either out-parameter may be NULL.
+ *
+ * @param osr The OpenSlide object.
+ * @param[out] hits Number of tile lookups served from the cache.
+ * @param[out] misses Number of tile lookups that required a decode.
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+void openslide_get_cache_stats(openslide_t *osr,
+                               uint64_t *hits, uint64_t *misses);
+
+/**
+ * Limit the bytes one OpenSlide object may keep resident in its cache.
+ *
+ * When several objects share a cache, eviction already prefers victims
+ * from objects holding more than their fair share of the capacity.  A
+ * quota additionally caps this object's resident bytes: once reached,
+ * its new tiles evict its own coldest tiles rather than other objects'
+ * entries.  Enforcement is approximate, within a few tiles of the cap.
+ *
+ * @param osr The OpenSlide object.
+ * @param bytes Maximum resident bytes, or 0 to remove the quota.
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+void openslide_set_cache_quota(openslide_t *osr, uint64_t bytes);
+
+/**
+ * Get the bytes an OpenSlide object currently keeps resident in its
+ * cache.
+ *
+ * @param osr The OpenSlide object.
+ * @return Resident decoded bytes attributed to this object.
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+uint64_t openslide_get_cache_usage(openslide_t *osr);
+
+//@}
+
+/**
+ * @name Performance
+ * Tuning the decode pipeline.
+ */
+//@{
+
+/**
+ * Set the number of worker threads used to decode tiles concurrently
+ * during openslide_read_region().
+ *
+ * By default tiles are decoded serially on the calling thread.  When a
+ * worker count is set, supported formats dispatch tile decodes to a
+ * shared pool and only the final compositing step runs on the caller.
+ * Formats whose decoders are not thread-safe keep the serial path.
+ *
+ * This function must not be called while other threads are reading
+ * from @p osr.
+ *
+ * @param osr The OpenSlide object.
+ * @param count The number of worker threads, or 0 to decode serially.
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+void openslide_set_tile_worker_count(openslide_t *osr, int32_t count);
+
+/**
+ * A stage of the region read pipeline, for openslide_get_timing().
+ *
+ * @since 3.5.0
+ */
+typedef enum {
+  /** Raw file reads. */
+  OPENSLIDE_TIMING_IO,
+  /** Entropy decode (JPEG, JPEG 2000, ...). */
+  OPENSLIDE_TIMING_DECODE,
+  /** Color conversion and pixel unpacking. */
+  OPENSLIDE_TIMING_CONVERT,
+  /** Compositing decoded tiles onto the output. */
+  OPENSLIDE_TIMING_COMPOSITE,
+  /** Waiting to acquire tile cache locks. */
+  OPENSLIDE_TIMING_CACHE_LOCK,
+  /** Waiting to acquire the TIFF handle pool lock. */
+  OPENSLIDE_TIMING_TIFFCACHE_LOCK,
+} openslide_timing_stage_t;
+
+/**
+ * Get the accumulated time spent in one stage of the read pipeline.
+ *
+ * Timing collection is off by default and is enabled by including
+ * <tt>timing</tt> in the <tt>OPENSLIDE_DEBUG</tt> environment
+ * variable; while disabled, this function returns 0 and the
+ * instrumentation costs one branch per sample.  Counters accumulate
+ * over the life of the object across all threads reading from it.
+ *
+ * @param osr The OpenSlide object.
+ * @param stage The pipeline stage.
+ * @return Accumulated nanoseconds spent in the stage.
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+int64_t openslide_get_timing(openslide_t *osr,
+                             openslide_timing_stage_t stage);
+
+/**
+ * Hint that a region will soon be read.
+ *
+ * The hinted region is decoded asynchronously on a low-priority
+ * background thread into the tile cache, so a subsequent
+ * openslide_read_region() of the same region is served from memory.
+ * Hints are best-effort: they never affect correctness, only latency.
+ *
+ * @param osr The OpenSlide object.
+ * @param x The top left x-coordinate, in the level 0 reference frame.
+ * @param y The top left y-coordinate, in the level 0 reference frame.
+ * @param level The desired level.
+ * @param w The width of the region. Must be non-negative.
+ * @param h The height of the region. Must be non-negative.
+ * @return An identifier for this hint, for use with
+ *         openslide_cancel_prefetch_hint().
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+int openslide_give_prefetch_hint(openslide_t *osr,
+                                 int64_t x, int64_t y,
+                                 int32_t level,
+                                 int64_t w, int64_t h);
+
+/**
+ * Cancel an earlier prefetch hint.
+ *
+ * If the hinted region has not started decoding yet, it never will.
+ * A hint that has already completed is silently ignored.
+ *
+ * @param osr The OpenSlide object.
+ * @param prefetch_id A hint identifier returned by
+ *                    openslide_give_prefetch_hint().
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+void openslide_cancel_prefetch_hint(openslide_t *osr, int prefetch_id);
+
+/**
+ * Asynchronously decode an entire level into the bound cache.
+ *
+ * Queues background decodes of every tile of @p level, so a later
+ * openslide_read_region() of the level is served from memory.  Warming
+ * runs below foreground reads and explicit prefetch hints and is
+ * best-effort; tiles may still be evicted before they are read if the
+ * cache is smaller than the level.  Intended for overview levels of
+ * slides about to become active in a viewer.
+ *
+ * @param osr The OpenSlide object.
+ * @param level The level to warm.
+ * @param priority Relative priority among warm jobs on this object;
+ *                 higher values are decoded first.
+ * @return A handle for openslide_cache_warm_cancel(), or 0 if the
+ *         level is invalid or the object is in error state.
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+int openslide_cache_warm(openslide_t *osr, int32_t level, int32_t priority);
+
+/**
+ * Cancel a cache warm job.
+ *
+ * Tiles not yet decoded never will be; decodes already in progress
+ * finish normally.  A completed or unknown handle is silently ignored.
+ *
+ * @param osr The OpenSlide object.
+ * @param warm_id A handle returned by openslide_cache_warm().
+ * @since 3.5.0
+ */
+OPENSLIDE_PUBLIC()
+void openslide_cache_warm_cancel(openslide_t *osr, int warm_id);
+
 //@}
 
 /**
@@ -627,17 +1316,6 @@ const char *openslide_get_comment(openslide_t *osr);
 
 //@}
 
-#ifndef OPENSLIDE_SIMPLIFY_HEADERS
-// these are meant to throw compile- and link-time errors,
-// since the functions they replace were never implemented
-int _openslide_give_prefetch_hint_UNIMPLEMENTED(void);
-void _openslide_cancel_prefetch_hint_UNIMPLEMENTED(void);
-#define openslide_give_prefetch_hint(osr, x, y, level, w, h)  \
-  _openslide_give_prefetch_hint_UNIMPLEMENTED(-1);
-#define openslide_cancel_prefetch_hint(osr, prefetch_id)  \
-  _openslide_cancel_prefetch_hint_UNIMPLEMENTED(-1)
-#endif
-
 /**
  * @mainpage OpenSlide
  *
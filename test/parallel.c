@@ -19,8 +19,11 @@
  *
  */
 
-/* Read the entirety of slide level 0, using the specified number of threads,
-   and report the runtime. */
+/* Scalability harness: read the entirety of slide level 0 with 1..N
+   threads and report aggregate throughput, per-thread fairness, and
+   time spent waiting on the tile cache and TIFF handle pool locks.
+   Optionally fails if scaling efficiency at N threads drops below a
+   threshold, to catch lock-contention regressions in CI. */
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -37,6 +40,11 @@ struct state {
   GAsyncQueue *completions;
 };
 
+struct worker {
+  struct state *state;
+  int64_t tiles;  // tiles this thread processed, for fairness
+};
+
 struct tile {
   int64_t x;
   int64_t y;
@@ -45,7 +53,8 @@ struct tile {
 static struct tile sentinel;
 
 static void *thread_func(void *data) {
-  struct state *state = data;
+  struct worker *worker = data;
+  struct state *state = worker->state;
   struct tile *tile;
   uint32_t bufsz = TILE_SIZE * TILE_SIZE * sizeof(uint32_t);
   uint32_t *buf = g_slice_alloc(bufsz);
@@ -58,6 +67,7 @@ static void *thread_func(void *data) {
     }
     openslide_read_region(state->osr, buf, tile->x, tile->y, 0, 0, TILE_SIZE,
                           TILE_SIZE);
+    worker->tiles++;
     g_async_queue_push(state->completions, tile);
   }
   g_async_queue_push(state->completions, &sentinel);
@@ -65,45 +75,26 @@ static void *thread_func(void *data) {
   return NULL;
 }
 
-int main(int argc, char **argv) {
-  struct state state;
+// read all of level 0 with the given number of threads; returns elapsed
+// seconds, or -1 on slide error.  min_share is the most-idle thread's
+// share of the mean per-thread tile count (1 == perfectly fair).
+static double run_pass(openslide_t *osr, int threads, double *min_share) {
+  struct state state = {
+    .osr = osr,
+    .jobs = g_async_queue_new(),
+    .completions = g_async_queue_new(),
+  };
+  struct worker *workers = g_new0(struct worker, threads);
 
-  common_fix_argv(&argc, &argv);
-  if (argc != 3) {
-    printf("Usage: %s <file> <threads>\n", argv[0]);
-    return 2;
-  }
-
-  int threads = atoi(argv[2]);
-  if (threads < 1) {
-    printf("Invalid thread count\n");
-    return 1;
-  }
-
-  // open file
-  state.osr = openslide_open(argv[1]);
-  if (!state.osr) {
-    printf("Unrecognized file\n");
-    return 1;
-  }
-  const char *error = openslide_get_error(state.osr);
-  if (error) {
-    printf("%s\n", error);
-    openslide_close(state.osr);
-    return 1;
-  }
-
-  // start threads
-  state.jobs = g_async_queue_new();
-  state.completions = g_async_queue_new();
   for (int i = 0; i < threads; i++) {
+    workers[i].state = &state;
 #if !GLIB_CHECK_VERSION(2,31,0)
-    if (g_thread_create(thread_func, &state, FALSE, NULL) == NULL) {
+    if (g_thread_create(thread_func, &workers[i], FALSE, NULL) == NULL) {
 #else
-    if (g_thread_new(NULL, thread_func, &state) == NULL) {
+    if (g_thread_new(NULL, thread_func, &workers[i]) == NULL) {
 #endif
       printf("Couldn't start thread\n");
-      return 1;
+      exit(1);
     }
   }
 
@@ -116,7 +107,7 @@ int main(int argc, char **argv) {
   struct tile *tile;
   int priming = 5 * threads;
   int64_t w, h;
-  openslide_get_level0_dimensions(state.osr, &w, &h);
+  openslide_get_level0_dimensions(osr, &w, &h);
   GTimer *timer = g_timer_new();
   for (int64_t y = 0; y < h; y += TILE_SIZE) {
     for (int64_t x = 0; x < w; x += TILE_SIZE) {
@@ -138,30 +129,138 @@ int main(int argc, char **argv) {
   }
 
   // wait for threads
-  while (threads > 0) {
+  int running = threads;
+  while (running > 0) {
     tile = g_async_queue_pop(state.completions);
     if (tile == &sentinel) {
-      threads--;
+      running--;
     } else {
       g_slice_free(struct tile, tile);
     }
   }
 
-  // print error or time
-  error = openslide_get_error(state.osr);
-  if (error) {
-    printf("%s\n", error);
-  } else {
-    double seconds = g_timer_elapsed(timer, NULL);
-    int tiles = (w + TILE_SIZE - 1) * (h + TILE_SIZE - 1) /
-                (TILE_SIZE * TILE_SIZE);
-    printf("%d tiles in %g seconds -> %g tiles/sec\n", tiles, seconds,
-           tiles / seconds);
+  double seconds = g_timer_elapsed(timer, NULL);
+  g_timer_destroy(timer);
+
+  int64_t total = 0;
+  int64_t min_tiles = G_MAXINT64;
+  for (int i = 0; i < threads; i++) {
+    total += workers[i].tiles;
+    min_tiles = MIN(min_tiles, workers[i].tiles);
   }
+  *min_share = total ? min_tiles * threads / (double) total : 0;
 
-  // clean up
-  openslide_close(state.osr);
+  g_free(workers);
   g_async_queue_unref(state.jobs);
   g_async_queue_unref(state.completions);
-  return 0;
+
+  if (openslide_get_error(osr)) {
+    return -1;
+  }
+  return seconds;
+}
+
+static openslide_t *open_slide(const char *file) {
+  openslide_t *osr = openslide_open(file);
+  if (!osr) {
+    printf("Unrecognized file\n");
+    exit(1);
+  }
+  const char *error = openslide_get_error(osr);
+  if (error) {
+    printf("%s\n", error);
+    openslide_close(osr);
+    exit(1);
+  }
+  return osr;
+}
+
+int main(int argc, char **argv) {
+  common_fix_argv(&argc, &argv);
+  if (argc < 3 || argc > 4) {
+    printf("Usage: %s <file> <max-threads> [min-efficiency]\n", argv[0]);
+    printf("  min-efficiency: fail if (throughput(N) / throughput(1)) / N\n");
+    printf("  at max-threads falls below this fraction (e.g. 0.7)\n");
+    return 2;
+  }
+
+  int max_threads = atoi(argv[2]);
+  if (max_threads < 1) {
+    printf("Invalid thread count\n");
+    return 1;
+  }
+  double min_efficiency = 0;
+  if (argc == 4) {
+    min_efficiency = atof(argv[3]);
+  }
+
+  // lock-wait counters are only collected when timing is enabled
+  if (!g_getenv("OPENSLIDE_DEBUG")) {
+    g_setenv("OPENSLIDE_DEBUG", "timing", TRUE);
+  }
+
+  int64_t w, h;
+  {
+    openslide_t *osr = open_slide(argv[1]);
+    openslide_get_level0_dimensions(osr, &w, &h);
+
+    // untimed warmup to prime the OS page cache, so the 1-thread
+    // baseline isn't penalized for cold file data
+    double min_share;
+    if (run_pass(osr, max_threads, &min_share) < 0) {
+      printf("%s\n", openslide_get_error(osr));
+      openslide_close(osr);
+      return 1;
+    }
+    openslide_close(osr);
+  }
+
+  int64_t tiles = ((w + TILE_SIZE - 1) / TILE_SIZE) *
+                  ((h + TILE_SIZE - 1) / TILE_SIZE);
+  double mbytes = tiles * (double) TILE_SIZE * TILE_SIZE *
+                  sizeof(uint32_t) / (1024 * 1024);
+
+  printf("%8s %10s %10s %9s %12s %12s %11s\n",
+         "threads", "seconds", "MB/s", "fairness", "cache-lock", "tiff-lock",
+         "efficiency");
+
+  double base_rate = 0;
+  double last_efficiency = 1;
+  int ret = 0;
+  for (int threads = 1; threads <= max_threads; threads++) {
+    // fresh handle per pass: cold tile cache, zeroed timing counters
+    openslide_t *osr = open_slide(argv[1]);
+
+    double min_share;
+    double seconds = run_pass(osr, threads, &min_share);
+    if (seconds < 0) {
+      printf("%s\n", openslide_get_error(osr));
+      openslide_close(osr);
+      return 1;
+    }
+
+    double cache_lock_s =
+      openslide_get_timing(osr, OPENSLIDE_TIMING_CACHE_LOCK) / 1e9;
+    double tiff_lock_s =
+      openslide_get_timing(osr, OPENSLIDE_TIMING_TIFFCACHE_LOCK) / 1e9;
+    openslide_close(osr);
+
+    double rate = mbytes / seconds;
+    if (threads == 1) {
+      base_rate = rate;
+    }
+    last_efficiency = rate / (base_rate * threads);
+
+    printf("%8d %10.3f %10.1f %9.3f %11.3fs %11.3fs %10.1f%%\n",
+           threads, seconds, rate, min_share, cache_lock_s, tiff_lock_s,
+           100 * last_efficiency);
+  }
+
+  if (min_efficiency > 0 && last_efficiency < min_efficiency) {
+    printf("FAILED: scaling efficiency %.1f%% below threshold %.1f%%\n",
+           100 * last_efficiency, 100 * min_efficiency);
+    ret = 1;
+  }
+
+  return ret;
 }
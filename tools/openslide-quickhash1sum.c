@@ -20,61 +20,174 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <glib.h>
 #include "openslide.h"
 #include "openslide-common.h"
 
-static gboolean process(const char *file) {
-  openslide_t *osr = openslide_open(file);
+#define MAX_JOBS 64
+
+// One slot per input file.  Workers claim files in order, hash them, and
+// record the output here; the main thread prints slots as they complete,
+// in command-line order, so -j output is identical to sequential output.
+struct hash_job {
+  const char *file;
+  char *out;   // stdout line, NULL on failure
+  char *err;   // stderr message, NULL on success
+  bool done;
+};
+
+struct hash_queue {
+  struct hash_job *jobs;
+  int count;
+  int next;    // next unclaimed job
+
+  GMutex *lock;
+  GCond *cond;
+};
+
+// hash one slide; fills in job->out or job->err
+static void process(struct hash_job *job) {
+  openslide_t *osr = openslide_open(job->file);
   if (osr == NULL) {
-    fprintf(stderr, "%s: %s: Not a file that OpenSlide can recognize\n",
-	    g_get_prgname(), file);
-    fflush(stderr);
-    return FALSE;
+    job->err = g_strdup_printf("%s: %s: Not a file that OpenSlide can "
+                               "recognize\n", g_get_prgname(), job->file);
+    return;
   }
 
   const char *err = openslide_get_error(osr);
   if (err) {
-    fprintf(stderr, "%s: %s: %s\n", g_get_prgname(), file, err);
-    fflush(stderr);
+    job->err = g_strdup_printf("%s: %s: %s\n", g_get_prgname(), job->file,
+                               err);
     openslide_close(osr);
-    return FALSE;
+    return;
   }
 
   const char *hash = openslide_get_property_value(osr,
         "openslide.quickhash-1");
   if (hash != NULL) {
-    printf("%s  %s\n", hash, file);
+    job->out = g_strdup_printf("%s  %s\n", hash, job->file);
   } else {
-    fprintf(stderr, "%s: %s: No quickhash-1 available\n", g_get_prgname(),
-            file);
-    fflush(stderr);
-    openslide_close(osr);
-    return FALSE;
+    job->err = g_strdup_printf("%s: %s: No quickhash-1 available\n",
+                               g_get_prgname(), job->file);
   }
 
   openslide_close(osr);
-  return TRUE;
 }
 
+static gpointer hash_worker(gpointer data) {
+  struct hash_queue *q = data;
+
+  g_mutex_lock(q->lock);
+  while (q->next < q->count) {
+    struct hash_job *job = &q->jobs[q->next++];
+    g_mutex_unlock(q->lock);
+
+    process(job);
+
+    g_mutex_lock(q->lock);
+    job->done = true;
+    g_cond_broadcast(q->cond);
+  }
+  g_mutex_unlock(q->lock);
+  return NULL;
+}
+
+
+// hash up to N slides concurrently.  Each slide is one sequential hash
+// stream, so N also bounds the I/O streams in flight.
+static int njobs = 1;
+
+static const GOptionEntry options[] = {
+  {"jobs", 'j', 0, G_OPTION_ARG_INT, &njobs,
+   "Hash up to N slides concurrently [1]", "N"},
+  {NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL}
+};
 
 static const struct common_usage_info usage_info = {
-  "FILE...",
+  "[-j N] FILE...",
   "Print OpenSlide quickhash-1 (256-bit) checksums.",
+  options,
 };
 
 int main (int argc, char **argv) {
   common_parse_commandline(&usage_info, &argc, &argv);
+
   if (argc < 2) {
     common_usage(&usage_info);
   }
+  if (njobs < 1 || njobs > MAX_JOBS) {
+    fprintf(stderr, "%s: job count must be between 1 and %d\n",
+            g_get_prgname(), MAX_JOBS);
+    return 2;
+  }
 
   int ret = 0;
-  for (int i = 1; i < argc; i++) {
-    if (!process(argv[i])) {
+
+  struct hash_queue q = {
+    .count = argc - 1,
+  };
+  q.jobs = g_new0(struct hash_job, q.count);
+  for (int i = 0; i < q.count; i++) {
+    q.jobs[i].file = argv[i + 1];
+  }
+#if !GLIB_CHECK_VERSION(2,31,0)
+  q.lock = g_mutex_new();
+  q.cond = g_cond_new();
+#else
+  GMutex lock_storage;
+  GCond cond_storage;
+  g_mutex_init(&lock_storage);
+  g_cond_init(&cond_storage);
+  q.lock = &lock_storage;
+  q.cond = &cond_storage;
+#endif
+
+  njobs = MIN(njobs, q.count);
+  GThread **threads = g_new(GThread *, njobs);
+  for (int i = 0; i < njobs; i++) {
+#if !GLIB_CHECK_VERSION(2,31,0)
+    threads[i] = g_thread_create(hash_worker, &q, TRUE, NULL);
+#else
+    threads[i] = g_thread_new("quickhash1sum", hash_worker, &q);
+#endif
+  }
+
+  // print results in input order as they complete
+  g_mutex_lock(q.lock);
+  for (int i = 0; i < q.count; i++) {
+    struct hash_job *job = &q.jobs[i];
+    while (!job->done) {
+      g_cond_wait(q.cond, q.lock);
+    }
+    g_mutex_unlock(q.lock);
+
+    if (job->out) {
+      fputs(job->out, stdout);
+    } else {
+      fputs(job->err, stderr);
+      fflush(stderr);
       ret = 1;
     }
+    g_free(job->out);
+    g_free(job->err);
+
+    g_mutex_lock(q.lock);
+  }
+  g_mutex_unlock(q.lock);
+
+  for (int i = 0; i < njobs; i++) {
+    g_thread_join(threads[i]);
   }
+  g_free(threads);
+  g_free(q.jobs);
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_free(q.lock);
+  g_cond_free(q.cond);
+#else
+  g_mutex_clear(q.lock);
+  g_cond_clear(q.cond);
+#endif
 
   return ret;
 }
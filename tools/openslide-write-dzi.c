@@ -0,0 +1,508 @@
+/*
+ *  OpenSlide, a library for reading whole slide image files
+ *
+ *  Copyright (c) 2007-2012 Carnegie Mellon University
+ *  All rights reserved.
+ *
+ *  OpenSlide is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, version 2.1.
+ *
+ *  OpenSlide is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with OpenSlide. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "openslide.h"
+#include "openslide-common.h"
+
+#include <jpeglib.h>
+#include <inttypes.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <setjmp.h>
+#include <math.h>
+
+// Pregenerate a full DeepZoom pyramid.  Only the deepest level is read
+// from the slide; every parent tile is produced by box-downsampling its
+// four already-generated children in memory, so the slide is decoded
+// exactly once.  The deepest-level work is split into quadtree subtrees
+// that worker threads claim independently; each subtree is generated
+// depth-first with one tile buffer per level in flight, then the few
+// small top levels are assembled from the subtree roots.
+
+#define TILE_SIZE 256
+#define JPEG_QUALITY 90
+#define MAX_THREADS 8
+
+static void fail(const char *format, ...) {
+  va_list ap;
+
+  va_start(ap, format);
+  char *msg = g_strdup_vprintf(format, ap);
+  va_end(ap);
+
+  fprintf(stderr, "%s: %s\n", g_get_prgname(), msg);
+  fflush(stderr);
+
+  exit(1);
+}
+
+struct pyramid {
+  openslide_t *osr;
+  char *files_dir;   // "<base>_files"
+  int32_t levels;    // DeepZoom level count; level levels-1 is full res
+  int64_t w;         // slide level 0 dimensions
+  int64_t h;
+
+  // deepest-level subtrees, claimed by worker threads
+  int32_t root_level;
+  int64_t root_cols;
+  int64_t root_rows;
+  uint32_t **root_imgs;  // half-res image of each root tile, row-major
+  gint next_root;
+  char *error;           // first failure, ends the run
+
+  GMutex *lock;
+};
+
+// pixel dimensions of a DeepZoom level
+static void level_dimensions(struct pyramid *pyr, int32_t level,
+                             int64_t *lw, int64_t *lh) {
+  int32_t shift = pyr->levels - 1 - level;
+  *lw = (pyr->w + ((int64_t) 1 << shift) - 1) >> shift;
+  *lh = (pyr->h + ((int64_t) 1 << shift) - 1) >> shift;
+}
+
+static void tile_dimensions(struct pyramid *pyr, int32_t level,
+                            int64_t col, int64_t row,
+                            int64_t *tw, int64_t *th) {
+  int64_t lw, lh;
+  level_dimensions(pyr, level, &lw, &lh);
+  *tw = MIN(TILE_SIZE, lw - col * TILE_SIZE);
+  *th = MIN(TILE_SIZE, lh - row * TILE_SIZE);
+}
+
+static void set_error(struct pyramid *pyr, const char *format, ...) {
+  va_list ap;
+
+  va_start(ap, format);
+  char *msg = g_strdup_vprintf(format, ap);
+  va_end(ap);
+
+  g_mutex_lock(pyr->lock);
+  if (pyr->error) {
+    g_free(msg);
+  } else {
+    pyr->error = msg;
+  }
+  g_mutex_unlock(pyr->lock);
+}
+
+static bool have_error(struct pyramid *pyr) {
+  g_mutex_lock(pyr->lock);
+  bool ret = pyr->error != NULL;
+  g_mutex_unlock(pyr->lock);
+  return ret;
+}
+
+// 2x box downsample of premultiplied ARGB; odd trailing column/row
+// average the one pixel available
+static void downsample_tile(const uint32_t *src, int64_t sw, int64_t sh,
+                            uint32_t *dest) {
+  int64_t dw = (sw + 1) / 2;
+  int64_t dh = (sh + 1) / 2;
+  for (int64_t y = 0; y < dh; y++) {
+    for (int64_t x = 0; x < dw; x++) {
+      int64_t x1 = MIN(2 * x + 1, sw - 1);
+      int64_t y1 = MIN(2 * y + 1, sh - 1);
+      const uint32_t p[4] = {
+        src[2 * y * sw + 2 * x],
+        src[2 * y * sw + x1],
+        src[y1 * sw + 2 * x],
+        src[y1 * sw + x1],
+      };
+      uint32_t a = 0, r = 0, g = 0, b = 0;
+      for (int i = 0; i < 4; i++) {
+        a += (p[i] >> 24) & 0xFF;
+        r += (p[i] >> 16) & 0xFF;
+        g += (p[i] >> 8) & 0xFF;
+        b += p[i] & 0xFF;
+      }
+      dest[y * dw + x] = ((a / 4) << 24) | ((r / 4) << 16) |
+                         ((g / 4) << 8) | (b / 4);
+    }
+  }
+}
+
+struct dzi_jpeg_error {
+  struct jpeg_error_mgr base;
+  jmp_buf env;
+};
+
+static void dzi_jpeg_error_exit(j_common_ptr cinfo) {
+  struct dzi_jpeg_error *jerr = (struct dzi_jpeg_error *) cinfo->err;
+  longjmp(jerr->env, 1);
+}
+
+// encode premultiplied ARGB to <files_dir>/<level>/<col>_<row>.jpeg
+static bool write_tile(struct pyramid *pyr, int32_t level,
+                       int64_t col, int64_t row,
+                       const uint32_t *pixels, int64_t tw, int64_t th) {
+  char *path = g_strdup_printf("%s/%d/%"PRId64"_%"PRId64".jpeg",
+                               pyr->files_dir, level, col, row);
+  FILE *f = g_fopen(path, "wb");
+  if (f == NULL) {
+    set_error(pyr, "Can't create %s: %s", path, g_strerror(errno));
+    g_free(path);
+    return false;
+  }
+
+  uint8_t *jpeg_row = g_malloc(tw * 3);
+  bool success = false;
+
+  struct jpeg_compress_struct cinfo;
+  struct dzi_jpeg_error jerr;
+  cinfo.err = jpeg_std_error(&jerr.base);
+  jerr.base.error_exit = dzi_jpeg_error_exit;
+
+  if (setjmp(jerr.env)) {
+    set_error(pyr, "JPEG compression failed for %s", path);
+    goto DONE;
+  }
+
+  jpeg_create_compress(&cinfo);
+  jpeg_stdio_dest(&cinfo, f);
+
+  cinfo.image_width = tw;
+  cinfo.image_height = th;
+  cinfo.input_components = 3;
+  cinfo.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, JPEG_QUALITY, TRUE);
+
+  jpeg_start_compress(&cinfo, TRUE);
+  while (cinfo.next_scanline < cinfo.image_height) {
+    const uint32_t *src = pixels + cinfo.next_scanline * tw;
+    for (int64_t i = 0; i < tw; i++) {
+      uint32_t p = src[i];
+      uint8_t a = (p >> 24) & 0xFF;
+      uint8_t r = (p >> 16) & 0xFF;
+      uint8_t g = (p >> 8) & 0xFF;
+      uint8_t b = p & 0xFF;
+      // un-premultiply; transparent background becomes white
+      if (a == 0) {
+        r = g = b = 255;
+      } else if (a != 255) {
+        r = (r * 255 + a / 2) / a;
+        g = (g * 255 + a / 2) / a;
+        b = (b * 255 + a / 2) / a;
+      }
+      jpeg_row[i * 3] = r;
+      jpeg_row[i * 3 + 1] = g;
+      jpeg_row[i * 3 + 2] = b;
+    }
+    JSAMPROW rows[1] = {jpeg_row};
+    jpeg_write_scanlines(&cinfo, rows, 1);
+  }
+  jpeg_finish_compress(&cinfo);
+  success = true;
+
+DONE:
+  jpeg_destroy_compress(&cinfo);
+  g_free(jpeg_row);
+  g_free(path);
+  if (fclose(f) && success) {
+    set_error(pyr, "Can't close tile file: %s", g_strerror(errno));
+    success = false;
+  }
+  return success;
+}
+
+/* Generate tile (level, col, row) and every tile below it, depth-first.
+   The deepest level reads from the slide; other levels paste the four
+   children's returned half-res images.  If down_OUT is non-NULL it
+   receives a newly-allocated 2x downsample of this tile for the caller
+   to paste into the parent. */
+static bool generate_subtree(struct pyramid *pyr, int32_t level,
+                             int64_t col, int64_t row,
+                             uint32_t **down_OUT) {
+  int64_t tw, th;
+  tile_dimensions(pyr, level, col, row, &tw, &th);
+  uint32_t *buf = g_malloc0(tw * th * sizeof(uint32_t));
+  bool success = false;
+
+  if (level == pyr->levels - 1) {
+    // deepest level: full resolution, read from slide level 0
+    openslide_read_region(pyr->osr, buf,
+                          col * TILE_SIZE, row * TILE_SIZE, 0, 0, tw, th);
+    const char *error = openslide_get_error(pyr->osr);
+    if (error) {
+      set_error(pyr, "%s", error);
+      goto DONE;
+    }
+  } else {
+    int64_t child_lw, child_lh;
+    level_dimensions(pyr, level + 1, &child_lw, &child_lh);
+    int64_t child_cols = (child_lw + TILE_SIZE - 1) / TILE_SIZE;
+    int64_t child_rows = (child_lh + TILE_SIZE - 1) / TILE_SIZE;
+    for (int dy = 0; dy < 2; dy++) {
+      for (int dx = 0; dx < 2; dx++) {
+        int64_t ccol = 2 * col + dx;
+        int64_t crow = 2 * row + dy;
+        if (ccol >= child_cols || crow >= child_rows) {
+          continue;
+        }
+        uint32_t *img;
+        if (!generate_subtree(pyr, level + 1, ccol, crow, &img)) {
+          goto DONE;
+        }
+        int64_t cw, ch;
+        tile_dimensions(pyr, level + 1, ccol, crow, &cw, &ch);
+        int64_t iw = (cw + 1) / 2;
+        int64_t ih = (ch + 1) / 2;
+        int64_t x0 = dx * (TILE_SIZE / 2);
+        int64_t y0 = dy * (TILE_SIZE / 2);
+        for (int64_t y = 0; y < ih; y++) {
+          memcpy(buf + (y0 + y) * tw + x0, img + y * iw,
+                 iw * sizeof(uint32_t));
+        }
+        g_free(img);
+      }
+    }
+  }
+
+  if (!write_tile(pyr, level, col, row, buf, tw, th)) {
+    goto DONE;
+  }
+
+  if (down_OUT) {
+    uint32_t *down = g_malloc(((tw + 1) / 2) * ((th + 1) / 2) *
+                              sizeof(uint32_t));
+    downsample_tile(buf, tw, th, down);
+    *down_OUT = down;
+  }
+  success = true;
+
+DONE:
+  g_free(buf);
+  return success;
+}
+
+static void *subtree_worker(void *data) {
+  struct pyramid *pyr = data;
+
+  while (!have_error(pyr)) {
+    gint i = g_atomic_int_add(&pyr->next_root, 1);
+    if (i >= pyr->root_cols * pyr->root_rows) {
+      break;
+    }
+    int64_t col = i % pyr->root_cols;
+    int64_t row = i / pyr->root_cols;
+    if (!generate_subtree(pyr, pyr->root_level, col, row,
+                          &pyr->root_imgs[i])) {
+      break;
+    }
+  }
+  return NULL;
+}
+
+static bool make_level_dir(struct pyramid *pyr, int32_t level) {
+  char *dir = g_strdup_printf("%s/%d", pyr->files_dir, level);
+  int ret = g_mkdir_with_parents(dir, 0777);
+  if (ret) {
+    fprintf(stderr, "%s: Can't create %s: %s\n", g_get_prgname(), dir,
+            g_strerror(errno));
+  }
+  g_free(dir);
+  return ret == 0;
+}
+
+static const struct common_usage_info usage_info = {
+  "slide-file output-base",
+  "Pregenerate a DeepZoom pyramid: output-base.dzi plus JPEG tiles\n"
+  "in output-base_files/.",
+};
+
+int main(int argc, char **argv) {
+  common_parse_commandline(&usage_info, &argc, &argv);
+  if (argc != 3) {
+    common_usage(&usage_info);
+  }
+  const char *slide = argv[1];
+  const char *base = argv[2];
+
+  openslide_t *osr = openslide_open(slide);
+  if (osr == NULL) {
+    fail("%s: Not a file that OpenSlide can recognize", slide);
+  }
+  const char *error = openslide_get_error(osr);
+  if (error) {
+    fail("%s: %s", slide, error);
+  }
+
+  struct pyramid pyr = {
+    .osr = osr,
+    .files_dir = g_strdup_printf("%s_files", base),
+  };
+  openslide_get_level0_dimensions(osr, &pyr.w, &pyr.h);
+
+  // DeepZoom level count: halvings until 1x1, plus the full-res level
+  pyr.levels = 1;
+  for (int64_t dim = MAX(pyr.w, pyr.h); dim > 1; dim = (dim + 1) / 2) {
+    pyr.levels++;
+  }
+
+#if GLIB_CHECK_VERSION(2,36,0)
+  int nthreads = MIN((int) g_get_num_processors(), MAX_THREADS);
+#else
+  int nthreads = 2;
+#endif
+
+  // root the parallel subtrees at the shallowest level with enough
+  // tiles to keep the workers busy
+  pyr.root_level = pyr.levels - 1;
+  for (int32_t level = 0; level < pyr.levels; level++) {
+    int64_t lw, lh;
+    level_dimensions(&pyr, level, &lw, &lh);
+    int64_t cols = (lw + TILE_SIZE - 1) / TILE_SIZE;
+    int64_t rows = (lh + TILE_SIZE - 1) / TILE_SIZE;
+    if (cols * rows >= MAX(64, 4 * nthreads)) {
+      pyr.root_level = level;
+      break;
+    }
+  }
+
+  int64_t root_lw, root_lh;
+  level_dimensions(&pyr, pyr.root_level, &root_lw, &root_lh);
+  pyr.root_cols = (root_lw + TILE_SIZE - 1) / TILE_SIZE;
+  pyr.root_rows = (root_lh + TILE_SIZE - 1) / TILE_SIZE;
+  pyr.root_imgs = g_new0(uint32_t *, pyr.root_cols * pyr.root_rows);
+
+#if !GLIB_CHECK_VERSION(2,31,0)
+  pyr.lock = g_mutex_new();
+#else
+  GMutex lock_storage;
+  g_mutex_init(&lock_storage);
+  pyr.lock = &lock_storage;
+#endif
+
+  for (int32_t level = 0; level < pyr.levels; level++) {
+    if (!make_level_dir(&pyr, level)) {
+      return 1;
+    }
+  }
+
+  // deepest levels: parallel depth-first subtree generation
+  GThread **threads = g_new(GThread *, nthreads);
+  for (int i = 0; i < nthreads; i++) {
+#if !GLIB_CHECK_VERSION(2,31,0)
+    threads[i] = g_thread_create(subtree_worker, &pyr, TRUE, NULL);
+#else
+    threads[i] = g_thread_new("write-dzi", subtree_worker, &pyr);
+#endif
+  }
+  for (int i = 0; i < nthreads; i++) {
+    g_thread_join(threads[i]);
+  }
+  g_free(threads);
+  if (pyr.error) {
+    fail("%s", pyr.error);
+  }
+
+  // remaining top levels, assembled from the subtree root images; each
+  // level's tiles are pasted from the half-res images of the level
+  // below, written out, and downsampled for the next level up
+  uint32_t **child_imgs = pyr.root_imgs;
+  int64_t child_cols = pyr.root_cols;
+  int64_t child_rows = pyr.root_rows;
+  for (int32_t level = pyr.root_level - 1; level >= 0; level--) {
+    int64_t lw, lh;
+    level_dimensions(&pyr, level, &lw, &lh);
+    int64_t cols = (lw + TILE_SIZE - 1) / TILE_SIZE;
+    int64_t rows = (lh + TILE_SIZE - 1) / TILE_SIZE;
+    uint32_t **imgs = g_new0(uint32_t *, cols * rows);
+
+    for (int64_t row = 0; row < rows; row++) {
+      for (int64_t col = 0; col < cols; col++) {
+        int64_t tw, th;
+        tile_dimensions(&pyr, level, col, row, &tw, &th);
+        uint32_t *buf = g_malloc0(tw * th * sizeof(uint32_t));
+
+        for (int dy = 0; dy < 2; dy++) {
+          for (int dx = 0; dx < 2; dx++) {
+            int64_t ccol = 2 * col + dx;
+            int64_t crow = 2 * row + dy;
+            if (ccol >= child_cols || crow >= child_rows) {
+              continue;
+            }
+            uint32_t *img = child_imgs[crow * child_cols + ccol];
+            int64_t cw, ch;
+            tile_dimensions(&pyr, level + 1, ccol, crow, &cw, &ch);
+            int64_t iw = (cw + 1) / 2;
+            int64_t ih = (ch + 1) / 2;
+            int64_t x0 = dx * (TILE_SIZE / 2);
+            int64_t y0 = dy * (TILE_SIZE / 2);
+            for (int64_t y = 0; y < ih; y++) {
+              memcpy(buf + (y0 + y) * tw + x0, img + y * iw,
+                     iw * sizeof(uint32_t));
+            }
+          }
+        }
+
+        if (!write_tile(&pyr, level, col, row, buf, tw, th)) {
+          fail("%s", pyr.error);
+        }
+        imgs[row * cols + col] = g_malloc(((tw + 1) / 2) * ((th + 1) / 2) *
+                                          sizeof(uint32_t));
+        downsample_tile(buf, tw, th, imgs[row * cols + col]);
+        g_free(buf);
+      }
+    }
+
+    for (int64_t i = 0; i < child_cols * child_rows; i++) {
+      g_free(child_imgs[i]);
+    }
+    g_free(child_imgs);
+    child_imgs = imgs;
+    child_cols = cols;
+    child_rows = rows;
+  }
+  for (int64_t i = 0; i < child_cols * child_rows; i++) {
+    g_free(child_imgs[i]);
+  }
+  g_free(child_imgs);
+
+  // descriptor
+  char *dzi_path = g_strdup_printf("%s.dzi", base);
+  FILE *f = g_fopen(dzi_path, "wb");
+  if (f == NULL) {
+    fail("Can't create %s: %s", dzi_path, g_strerror(errno));
+  }
+  fprintf(f,
+          "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+          "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\"\n"
+          "       Format=\"jpeg\" Overlap=\"0\" TileSize=\"%d\">\n"
+          "  <Size Width=\"%"PRId64"\" Height=\"%"PRId64"\"/>\n"
+          "</Image>\n",
+          TILE_SIZE, pyr.w, pyr.h);
+  if (fclose(f)) {
+    fail("Can't close %s: %s", dzi_path, g_strerror(errno));
+  }
+  g_free(dzi_path);
+
+  openslide_close(osr);
+  g_free(pyr.files_dir);
+  return 0;
+}
@@ -59,6 +59,120 @@ static void fail(const char *format, ...) {
 }
 
 
+// The region is read in tile-row bands: worker threads decode and
+// un-premultiply bands a bounded number of slots ahead while the main
+// thread feeds completed bands to libpng in order, so decode overlaps
+// compression with fixed memory use regardless of region size.
+
+#define DEFAULT_BAND_HEIGHT 256
+#define MAX_THREADS 8
+
+struct band_slot {
+  uint32_t *pixels;
+  int32_t index;     // the band currently decoded into the slot
+  bool done;         // decode finished; consumed by the writer
+  int32_t free_for;  // the next band allowed to claim the slot
+};
+
+struct pipeline {
+  openslide_t *osr;
+  int64_t x;
+  int32_t yy0;  // first row, in level coordinates
+  int32_t level;
+  double ds;
+  int32_t w;
+  int32_t h;
+  int32_t band_h;
+  int32_t band_count;
+
+  struct band_slot *slots;
+  int32_t slot_count;
+  int32_t next_band;  // next band not yet claimed by a worker
+  char *error;        // first failure, ends the pipeline
+
+  GMutex *lock;
+  GCond *cond;
+};
+
+static void unpremultiply_band(uint32_t *pixels, int64_t count) {
+  // un-premultiply alpha and pack into expected format
+  for (int64_t i = 0; i < count; i++) {
+    uint32_t p = pixels[i];
+    uint8_t *p8 = (uint8_t *) (pixels + i);
+
+    uint8_t a = (p >> 24) & 0xFF;
+    uint8_t r = (p >> 16) & 0xFF;
+    uint8_t g = (p >> 8) & 0xFF;
+    uint8_t b = p & 0xFF;
+
+    switch (a) {
+    case 0:
+      r = 0;
+      b = 0;
+      g = 0;
+      break;
+
+    case 255:
+      // no action
+      break;
+
+    default:
+      r = (r * 255 + a / 2) / a;
+      g = (g * 255 + a / 2) / a;
+      b = (b * 255 + a / 2) / a;
+      break;
+    }
+
+    // write back
+    p8[0] = r;
+    p8[1] = g;
+    p8[2] = b;
+    p8[3] = a;
+  }
+}
+
+static gpointer band_worker(gpointer data) {
+  struct pipeline *pl = data;
+
+  g_mutex_lock(pl->lock);
+  while (pl->next_band < pl->band_count && !pl->error) {
+    int32_t band = pl->next_band++;
+    struct band_slot *slot = &pl->slots[band % pl->slot_count];
+
+    // wait for the writer to retire the band previously in the slot
+    while (slot->free_for != band && !pl->error) {
+      g_cond_wait(pl->cond, pl->lock);
+    }
+    if (pl->error) {
+      break;
+    }
+    slot->index = band;
+    slot->done = false;
+    g_mutex_unlock(pl->lock);
+
+    int32_t first_row = band * pl->band_h;
+    int32_t rows = MIN(pl->band_h, pl->h - first_row);
+    openslide_read_region(pl->osr, slot->pixels,
+                          pl->x, (int64_t) ((pl->yy0 + first_row) * pl->ds),
+                          0, pl->level, pl->w, rows);
+
+    const char *err = openslide_get_error(pl->osr);
+    if (!err) {
+      unpremultiply_band(slot->pixels, (int64_t) pl->w * rows);
+    }
+
+    g_mutex_lock(pl->lock);
+    if (err && !pl->error) {
+      pl->error = g_strdup(err);
+    }
+    slot->done = true;
+    g_cond_broadcast(pl->cond);
+  }
+  g_cond_broadcast(pl->cond);
+  g_mutex_unlock(pl->lock);
+  return NULL;
+}
+
 static void write_png(openslide_t *osr, FILE *f,
 		      int64_t x, int64_t y, int32_t level,
 		      int32_t w, const int32_t h) {
@@ -110,61 +224,113 @@ static void write_png(openslide_t *osr, FILE *f,
   // start writing
   png_write_info(png_ptr, info_ptr);
 
-  uint32_t *dest = g_malloc(w * 4);
-  int32_t lines_to_draw = h;
-  double ds = openslide_get_level_downsample(osr, level);
-  int32_t yy = y / ds;
-  while (lines_to_draw) {
-    openslide_read_region(osr, dest,
-			  x, yy * ds, level, w, 1);
-
-    const char *err = openslide_get_error(osr);
-    if (err) {
-      fail("%s", err);
+  // band height follows the slide's tile geometry so each band decodes
+  // exactly one tile row
+  char *tile_h_prop = g_strdup_printf("openslide.level[%d].tile-height",
+                                      level);
+  int64_t band_h = 0;
+  if (!openslide_get_property_int64(osr, tile_h_prop, &band_h) ||
+      band_h <= 0) {
+    band_h = DEFAULT_BAND_HEIGHT;
+  }
+  g_free(tile_h_prop);
+
+#if GLIB_CHECK_VERSION(2,36,0)
+  int nthreads = MIN((int) g_get_num_processors(), MAX_THREADS);
+#else
+  int nthreads = 2;
+#endif
+
+  struct pipeline pl = {
+    .osr = osr,
+    .x = x,
+    .level = level,
+    .ds = openslide_get_level_downsample(osr, level),
+    .w = w,
+    .h = h,
+    .band_h = MIN(band_h, h),
+    .slot_count = nthreads + 2,
+  };
+  pl.yy0 = y / pl.ds;
+  pl.band_count = (h + pl.band_h - 1) / pl.band_h;
+  pl.slot_count = MIN(pl.slot_count, pl.band_count);
+#if !GLIB_CHECK_VERSION(2,31,0)
+  pl.lock = g_mutex_new();
+  pl.cond = g_cond_new();
+#else
+  GMutex lock_storage;
+  GCond cond_storage;
+  g_mutex_init(&lock_storage);
+  g_cond_init(&cond_storage);
+  pl.lock = &lock_storage;
+  pl.cond = &cond_storage;
+#endif
+
+  pl.slots = g_new0(struct band_slot, pl.slot_count);
+  for (int32_t i = 0; i < pl.slot_count; i++) {
+    pl.slots[i].pixels = g_malloc((int64_t) w * pl.band_h * 4);
+    pl.slots[i].free_for = i;
+  }
+
+  GThread **threads = g_new0(GThread *, nthreads);
+  for (int i = 0; i < nthreads; i++) {
+#if !GLIB_CHECK_VERSION(2,31,0)
+    threads[i] = g_thread_create(band_worker, &pl, TRUE, NULL);
+#else
+    threads[i] = g_thread_new("write-png", band_worker, &pl);
+#endif
+  }
+
+  // feed completed bands to libpng in order
+  char *error = NULL;
+  g_mutex_lock(pl.lock);
+  for (int32_t band = 0; band < pl.band_count && !pl.error; band++) {
+    struct band_slot *slot = &pl.slots[band % pl.slot_count];
+    while (!(slot->index == band && slot->done) && !pl.error) {
+      g_cond_wait(pl.cond, pl.lock);
+    }
+    if (pl.error) {
+      break;
     }
+    g_mutex_unlock(pl.lock);
 
-    // un-premultiply alpha and pack into expected format
-    for (int i = 0; i < w; i++) {
-      uint32_t p = dest[i];
-      uint8_t *p8 = (uint8_t *) (dest + i);
-
-      uint8_t a = (p >> 24) & 0xFF;
-      uint8_t r = (p >> 16) & 0xFF;
-      uint8_t g = (p >> 8) & 0xFF;
-      uint8_t b = p & 0xFF;
-
-      switch (a) {
-      case 0:
-	r = 0;
-	b = 0;
-	g = 0;
-	break;
-
-      case 255:
-	// no action
-	break;
-
-      default:
-	r = (r * 255 + a / 2) / a;
-	g = (g * 255 + a / 2) / a;
-	b = (b * 255 + a / 2) / a;
-	break;
-      }
-
-      // write back
-      p8[0] = r;
-      p8[1] = g;
-      p8[2] = b;
-      p8[3] = a;
+    int32_t rows = MIN(pl.band_h, h - band * pl.band_h);
+    for (int32_t row = 0; row < rows; row++) {
+      png_write_row(png_ptr, (png_bytep) (slot->pixels + (int64_t) row * w));
     }
 
-    png_write_row(png_ptr, (png_bytep) dest);
-    yy++;
-    lines_to_draw--;
+    g_mutex_lock(pl.lock);
+    slot->free_for = band + pl.slot_count;
+    g_cond_broadcast(pl.cond);
+  }
+  error = g_strdup(pl.error);
+  g_mutex_unlock(pl.lock);
+
+  for (int i = 0; i < nthreads; i++) {
+    if (threads[i]) {
+      g_thread_join(threads[i]);
+    }
+  }
+  g_free(threads);
+  for (int32_t i = 0; i < pl.slot_count; i++) {
+    g_free(pl.slots[i].pixels);
+  }
+  g_free(pl.slots);
+#if !GLIB_CHECK_VERSION(2,31,0)
+  g_mutex_free(pl.lock);
+  g_cond_free(pl.cond);
+#else
+  g_mutex_clear(pl.lock);
+  g_cond_clear(pl.cond);
+#endif
+  g_free(pl.error);
+
+  if (error) {
+    fail("%s", error);
   }
+  g_free(error);
 
   // end
-  g_free(dest);
   g_free(key);
   g_free(text);
   png_write_end(png_ptr, info_ptr);